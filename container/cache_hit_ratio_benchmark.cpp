@@ -0,0 +1,127 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Replay synthetic access traces through ShardedLruCache with each policy
+// and print the hit ratio of point lookups. The cache is used as a
+// read-through cache: a missed key is put into it.
+//
+// Workloads:
+//   zipf: point lookups of Zipf distributed keys.
+//   scan: the same lookups, and every --scan_interval lookups a scan of
+//         --scan_length keys which are never accessed again.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "toft/base/random.h"
+#include "toft/base/string/algorithm.h"
+#include "toft/base/string/number.h"
+#include "toft/container/cache_policy.h"
+#include "toft/container/sharded_lru_cache.h"
+
+#include "thirdparty/gflags/gflags.h"
+
+DEFINE_int32(num_keys, 1000000, "# of distinct keys of point lookups");
+DEFINE_int32(trace_length, 2000000, "# of point lookups of each trace");
+DEFINE_double(zipf_alpha, 0.99, "skewness of the Zipf distribution");
+DEFINE_string(cache_capacities, "1000,10000,100000", "cache sizes to test");
+DEFINE_int32(scan_interval, 100000, "# of point lookups between two scans");
+DEFINE_int32(scan_length, 50000, "# of keys of each scan");
+
+namespace toft {
+
+// Sample keys in [0, n) whose probability is proportional to 1 / (k+1)^alpha.
+class ZipfGenerator {
+public:
+    ZipfGenerator(int n, double alpha, int seed) : m_random(seed) {
+        m_cdf.resize(n);
+        double sum = 0;
+        for (int i = 0; i < n; ++i) {
+            sum += 1.0 / pow(i + 1.0, alpha);
+            m_cdf[i] = sum;
+        }
+        for (int i = 0; i < n; ++i)
+            m_cdf[i] /= sum;
+    }
+
+    int Next() {
+        double u = m_random.Next() / 2147483647.0;
+        return std::lower_bound(m_cdf.begin(), m_cdf.end(), u) - m_cdf.begin();
+    }
+
+private:
+    Random m_random;
+    std::vector<double> m_cdf;
+};
+
+static void GenerateTrace(bool with_scan, std::vector<int64_t>* trace) {
+    ZipfGenerator zipf(FLAGS_num_keys, FLAGS_zipf_alpha, 301);
+    int64_t next_scan_key = FLAGS_num_keys;
+    trace->clear();
+    for (int i = 0; i < FLAGS_trace_length; ++i) {
+        trace->push_back(zipf.Next());
+        if (with_scan && i % FLAGS_scan_interval == FLAGS_scan_interval - 1) {
+            for (int j = 0; j < FLAGS_scan_length; ++j)
+                trace->push_back(next_scan_key++);
+        }
+    }
+}
+
+template <typename PolicyType>
+static double Replay(const std::vector<int64_t>& trace, size_t capacity) {
+    ShardedLruCache<int64_t, int64_t, std::unordered_map<int64_t, int>::hasher,
+                    Mutex, PolicyType> cache(capacity);
+    int64_t lookups = 0;
+    int64_t hits = 0;
+    int64_t value;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        // Keys out of the range are scanned.
+        bool is_lookup = trace[i] < FLAGS_num_keys;
+        lookups += is_lookup;
+        if (cache.Get(trace[i], &value)) {
+            hits += is_lookup;
+        } else {
+            cache.Put(trace[i], trace[i]);
+        }
+    }
+    return 100.0 * hits / lookups;
+}
+
+static void RunWorkload(const char* name, bool with_scan,
+                        const std::vector<size_t>& capacities) {
+    std::vector<int64_t> trace;
+    GenerateTrace(with_scan, &trace);
+    for (size_t i = 0; i < capacities.size(); ++i) {
+        printf("%-6s %10zu %9.2f%% %9.2f%% %9.2f%%\n", name, capacities[i],
+               Replay<LruPolicy>(trace, capacities[i]),
+               Replay<ClockPolicy>(trace, capacities[i]),
+               Replay<TinyLfuPolicy>(trace, capacities[i]));
+    }
+}
+
+}  // namespace toft
+
+int main(int argc, char** argv) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    std::vector<std::string> sizes;
+    toft::SplitString(FLAGS_cache_capacities, ",", &sizes);
+    std::vector<size_t> capacities;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        size_t capacity;
+        if (!toft::StringToNumber(sizes[i], &capacity)) {
+            fprintf(stderr, "invalid capacity: %s\n", sizes[i].c_str());
+            return 1;
+        }
+        capacities.push_back(capacity);
+    }
+
+    printf("%-6s %10s %10s %10s %10s\n", "trace", "capacity", "lru", "clock", "tinylfu");
+    toft::RunWorkload("zipf", false, capacities);
+    toft::RunWorkload("scan", true, capacities);
+    return 0;
+}
@@ -0,0 +1,275 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Admission and eviction policies of LruCache, ShardedLruCache and the
+// sstable BlockCache.
+//
+// A policy instance manages the entries of one cache or shard, it's
+// protected by the lock of it. Entries are charged by CacheEntry::charge,
+// 1 for caches bounded by the # of entries. The interface is:
+//
+//   // Max total charge of entries to keep, and about how many entries it
+//   // is, to size the policy's own state.
+//   void Init(size_t capacity, size_t expected_entries);
+//   // Whether RecordAccess and CacheEntry::hash are used, keys need not be
+//   // hashed for LruCache otherwise.
+//   static const bool kNeedsHash;
+//   // Every lookup or store of a key, hit or not.
+//   void RecordAccess(uint64_t hash);
+//   // Add a new entry.
+//   void Insert(CacheEntry* entry);
+//   // Take out an entry to make room while the total charge is over the
+//   // capacity, NULL if not. It may be a new one which is not admitted.
+//   CacheEntry* Evict();
+//   // A cached entry is hit.
+//   void Touch(CacheEntry* entry);
+//   // A cached entry is removed by the user.
+//   void Remove(CacheEntry* entry);
+//   // Forget all entries.
+//   void Clear();
+
+#ifndef TOFT_CONTAINER_CACHE_POLICY_H_
+#define TOFT_CONTAINER_CACHE_POLICY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "toft/base/intrusive_list.h"
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/uncopyable.h"
+#include "toft/container/count_min_sketch.h"
+
+namespace toft {
+
+// Nodes of caches derive from it to be managed by a policy.
+struct CacheEntry {
+    CacheEntry() : hash(0), charge(1), state(0) {}
+    list_node link;
+    uint64_t hash;
+    size_t charge;
+    int state;  // Policy specific
+};
+
+// Evict the least recently used entry.
+class LruPolicy {
+    TOFT_DECLARE_UNCOPYABLE(LruPolicy);
+
+public:
+    static const bool kNeedsHash = false;
+
+    LruPolicy() : m_capacity(0), m_size(0) {}
+
+    void Init(size_t capacity, size_t expected_entries) {
+        m_capacity = capacity;
+    }
+
+    void RecordAccess(uint64_t hash) {}
+
+    void Insert(CacheEntry* entry) {
+        m_list.push_front(entry);
+        m_size += entry->charge;
+    }
+
+    CacheEntry* Evict() {
+        if (m_size <= m_capacity)
+            return NULL;
+        CacheEntry* victim = &m_list.back();
+        Remove(victim);
+        return victim;
+    }
+
+    void Touch(CacheEntry* entry) {
+        List::erase(entry);
+        m_list.push_front(entry);
+    }
+
+    void Remove(CacheEntry* entry) {
+        List::erase(entry);
+        m_size -= entry->charge;
+    }
+
+    void Clear() {
+        m_list.clear();
+        m_size = 0;
+    }
+
+private:
+    typedef intrusive_list<CacheEntry> List;
+    List m_list;  // Most recently used first
+    size_t m_capacity;
+    size_t m_size;
+};
+
+// CLOCK (second chance): a hit only sets the reference bit of the entry.
+// The hand sweeps from the oldest entry, clears the bits it meets and evicts
+// the first unreferenced one. Entries that are never hit again, such as the
+// ones loaded by a scan, are evicted before the referenced ones.
+class ClockPolicy {
+    TOFT_DECLARE_UNCOPYABLE(ClockPolicy);
+
+public:
+    static const bool kNeedsHash = false;
+
+    ClockPolicy() : m_capacity(0), m_size(0) {}
+
+    void Init(size_t capacity, size_t expected_entries) {
+        m_capacity = capacity;
+    }
+
+    void RecordAccess(uint64_t hash) {}
+
+    void Insert(CacheEntry* entry) {
+        // Behind the hand, the last one to be swept.
+        entry->state = 0;
+        m_ring.push_back(entry);
+        m_size += entry->charge;
+    }
+
+    CacheEntry* Evict() {
+        if (m_size <= m_capacity)
+            return NULL;
+        for (;;) {
+            CacheEntry* hand = &m_ring.front();
+            List::erase(hand);
+            if (hand->state == 0) {
+                m_size -= hand->charge;
+                return hand;
+            }
+            hand->state = 0;
+            m_ring.push_back(hand);
+        }
+    }
+
+    void Touch(CacheEntry* entry) {
+        entry->state = 1;
+    }
+
+    void Remove(CacheEntry* entry) {
+        List::erase(entry);
+        m_size -= entry->charge;
+    }
+
+    void Clear() {
+        m_ring.clear();
+        m_size = 0;
+    }
+
+private:
+    typedef intrusive_list<CacheEntry> List;
+    // The front is where the hand points to.
+    List m_ring;
+    size_t m_capacity;
+    size_t m_size;
+};
+
+// W-TinyLFU: new entries enter a small LRU window. An entry leaving the
+// window is admitted into the main LRU only if it's more frequently
+// accessed than the main victim, according to a count-min sketch of the
+// recent accesses. One-hit wonders of a scan can't flush the popular ones.
+class TinyLfuPolicy {
+    TOFT_DECLARE_UNCOPYABLE(TinyLfuPolicy);
+
+public:
+    static const bool kNeedsHash = true;
+    static const int kWindowPercent = 1;
+
+    TinyLfuPolicy() : m_window_capacity(0), m_window_size(0),
+                      m_main_capacity(0), m_main_size(0) {}
+
+    void Init(size_t capacity, size_t expected_entries) {
+        m_window_capacity = std::max<size_t>(1, capacity * kWindowPercent / 100);
+        m_main_capacity = capacity > m_window_capacity ? capacity - m_window_capacity : 0;
+        m_sketch.reset(new CountMinSketch(std::max<size_t>(1, expected_entries)));
+    }
+
+    void RecordAccess(uint64_t hash) {
+        m_sketch->Increment(hash);
+    }
+
+    void Insert(CacheEntry* entry) {
+        entry->state = kWindow;
+        m_window.push_front(entry);
+        m_window_size += entry->charge;
+    }
+
+    CacheEntry* Evict() {
+        while (m_window_size > m_window_capacity) {
+            CacheEntry* candidate = &m_window.back();
+            Remove(candidate);
+            if (m_main_size + candidate->charge <= m_main_capacity) {
+                AddToMain(candidate);
+                continue;
+            }
+            if (m_main.empty())
+                return candidate;
+
+            CacheEntry* victim = &m_main.back();
+            if (m_sketch->Estimate(candidate->hash) <= m_sketch->Estimate(victim->hash))
+                return candidate;
+            Remove(victim);
+            AddToMain(candidate);
+            return victim;
+        }
+        // A large candidate admitted for a smaller victim.
+        if (m_main_size > m_main_capacity) {
+            CacheEntry* victim = &m_main.back();
+            Remove(victim);
+            return victim;
+        }
+        return NULL;
+    }
+
+    void Touch(CacheEntry* entry) {
+        List::erase(entry);
+        if (entry->state == kWindow) {
+            m_window.push_front(entry);
+        } else {
+            m_main.push_front(entry);
+        }
+    }
+
+    void Remove(CacheEntry* entry) {
+        List::erase(entry);
+        if (entry->state == kWindow) {
+            m_window_size -= entry->charge;
+        } else {
+            m_main_size -= entry->charge;
+        }
+    }
+
+    void Clear() {
+        m_window.clear();
+        m_main.clear();
+        m_window_size = 0;
+        m_main_size = 0;
+        m_sketch->Clear();
+    }
+
+private:
+    enum {
+        kWindow = 0,
+        kMain = 1
+    };
+
+    void AddToMain(CacheEntry* entry) {
+        entry->state = kMain;
+        m_main.push_front(entry);
+        m_main_size += entry->charge;
+    }
+
+private:
+    typedef intrusive_list<CacheEntry> List;
+    List m_window;  // Most recently used first
+    size_t m_window_capacity;
+    size_t m_window_size;
+    List m_main;    // Most recently used first
+    size_t m_main_capacity;
+    size_t m_main_size;
+    scoped_ptr<CountMinSketch> m_sketch;
+};
+
+}  // namespace toft
+
+#endif  // TOFT_CONTAINER_CACHE_POLICY_H_
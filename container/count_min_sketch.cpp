@@ -0,0 +1,68 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/container/count_min_sketch.h"
+
+#include <algorithm>
+
+namespace toft {
+
+// Odd multipliers to derive independent row indexes from one hash.
+static const uint64_t kSeeds[CountMinSketch::kDepth] = {
+    0x9E3779B97F4A7C15ULL,
+    0xC2B2AE3D27D4EB4FULL,
+    0x165667B19E3779F9ULL,
+    0xD6E8FEB86659FD93ULL,
+};
+
+const int CountMinSketch::kDepth;
+const int CountMinSketch::kMaxCount;
+
+CountMinSketch::CountMinSketch(size_t expected_items)
+    : m_mask(0), m_sample_size(0), m_additions(0) {
+    // 4 counters per item in each row keep collisions rare.
+    size_t width = 16;
+    while (width < expected_items * 4)
+        width <<= 1;
+    m_mask = width - 1;
+    m_sample_size = std::max<size_t>(expected_items, 1) * 10;
+    m_table.resize(width * kDepth);
+}
+
+size_t CountMinSketch::IndexOf(uint64_t hash, int row) const {
+    uint64_t h = (hash + row) * kSeeds[row];
+    return row * Width() + (static_cast<size_t>(h >> 32) & m_mask);
+}
+
+void CountMinSketch::Increment(uint64_t hash) {
+    bool added = false;
+    for (int i = 0; i < kDepth; ++i) {
+        uint8_t& counter = m_table[IndexOf(hash, i)];
+        if (counter < kMaxCount) {
+            ++counter;
+            added = true;
+        }
+    }
+    if (added && ++m_additions >= m_sample_size)
+        Age();
+}
+
+int CountMinSketch::Estimate(uint64_t hash) const {
+    int count = kMaxCount;
+    for (int i = 0; i < kDepth; ++i)
+        count = std::min<int>(count, m_table[IndexOf(hash, i)]);
+    return count;
+}
+
+void CountMinSketch::Age() {
+    for (size_t i = 0; i < m_table.size(); ++i)
+        m_table[i] >>= 1;
+    m_additions /= 2;
+}
+
+void CountMinSketch::Clear() {
+    std::fill(m_table.begin(), m_table.end(), 0);
+    m_additions = 0;
+}
+
+}  // namespace toft
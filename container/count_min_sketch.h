@@ -0,0 +1,54 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_CONTAINER_COUNT_MIN_SKETCH_H_
+#define TOFT_CONTAINER_COUNT_MIN_SKETCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace toft {
+
+// Approximate frequency of hashed items in small fixed memory.
+//
+// Counters saturate at kMaxCount, and all of them are halved once the
+// number of increments reaches the sample size, so the estimation follows
+// the recent popularity rather than the history. It is the frequency
+// histogram used by the TinyLFU admission policy. It's not thread safe.
+class CountMinSketch {
+public:
+    static const int kDepth = 4;
+    static const int kMaxCount = 15;
+
+    // expected_items is the # of distinct items to be tracked, the sample
+    // size is 10 times of it. It takes 16 bytes per expected item.
+    explicit CountMinSketch(size_t expected_items);
+
+    void Increment(uint64_t hash);
+
+    // Never less than the real count in the current sample.
+    int Estimate(uint64_t hash) const;
+
+    void Clear();
+
+    size_t Width() const {
+        return m_mask + 1;
+    }
+
+private:
+    size_t IndexOf(uint64_t hash, int row) const;
+    // Halve all counters.
+    void Age();
+
+private:
+    std::vector<uint8_t> m_table;  // kDepth rows of counters
+    size_t m_mask;                 // width of each row - 1
+    size_t m_sample_size;
+    size_t m_additions;
+};
+
+}  // namespace toft
+
+#endif  // TOFT_CONTAINER_COUNT_MIN_SKETCH_H_
@@ -0,0 +1,50 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/container/count_min_sketch.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+TEST(CountMinSketch, Estimate) {
+    CountMinSketch sketch(1000);
+    EXPECT_EQ(4096U, sketch.Width());
+    for (uint64_t i = 0; i < 100; ++i) {
+        for (uint64_t j = 0; j <= i % 10; ++j)
+            sketch.Increment(i);
+    }
+    int overestimated = 0;
+    for (uint64_t i = 0; i < 100; ++i) {
+        int count = sketch.Estimate(i);
+        EXPECT_GE(count, static_cast<int>(i % 10 + 1));
+        if (count > static_cast<int>(i % 10 + 1))
+            ++overestimated;
+    }
+    EXPECT_LT(overestimated, 5);
+    EXPECT_EQ(0, sketch.Estimate(12345));
+}
+
+TEST(CountMinSketch, Saturate) {
+    CountMinSketch sketch(1000);
+    for (int i = 0; i < 100; ++i)
+        sketch.Increment(1);
+    EXPECT_EQ(CountMinSketch::kMaxCount, sketch.Estimate(1));
+    sketch.Clear();
+    EXPECT_EQ(0, sketch.Estimate(1));
+}
+
+TEST(CountMinSketch, Age) {
+    CountMinSketch sketch(16);
+    for (int i = 0; i < 8; ++i)
+        sketch.Increment(1);
+    EXPECT_EQ(8, sketch.Estimate(1));
+    // The sample size is 160, counters are halved after that. Others may
+    // collide with 1, so it's not exactly 4.
+    for (uint64_t i = 100; i < 252; ++i)
+        sketch.Increment(i);
+    EXPECT_GE(sketch.Estimate(1), 4);
+    EXPECT_LT(sketch.Estimate(1), 8);
+}
+
+}  // namespace toft
@@ -8,19 +8,56 @@
 
 #include <stdint.h>
 
-#include <list>
 #include <map>
-#include <utility>
 
+#include "toft/base/cxx11.h"
 #include "toft/base/uncopyable.h"
+#include "toft/base/unordered_map.h"
+#include "toft/container/cache_policy.h"
 #include "toft/system/threading/mutex.h"
 
 #include "thirdparty/glog/logging.h"
 
 namespace toft {
 
+// Hash of keys by std::hash, only instantiated for policies needing it, so
+// keys of other caches need only operator<.
+template<typename KeyType>
+struct DefaultCacheHash {
+    size_t operator()(const KeyType& key) const {
+        return typename std::unordered_map<KeyType, int>::hasher()(key);
+    }
+};
+
+namespace internal {
+
+template<bool kNeedsHash>
+struct CacheKeyHash {
+    template<typename HashType, typename KeyType>
+    static uint64_t Hash(const HashType& hash, const KeyType& key) {
+        return hash(key);
+    }
+};
+
+template<>
+struct CacheKeyHash<false> {
+    template<typename HashType, typename KeyType>
+    static uint64_t Hash(const HashType&, const KeyType&) {
+        return 0;
+    }
+};
+
+}  // namespace internal
+
 //  It is not thread safe.
-template<typename KeyType, typename ValueType, typename LockType = Mutex>
+//
+// PolicyType replaces LRU by another admission and eviction policy, see
+// cache_policy.h, keys are hashed by HashType only if it needs. ClockCache
+// and TinyLfuCache below are for caches shared by point lookups and scans.
+template<typename KeyType, typename ValueType,
+         typename HashType = DefaultCacheHash<KeyType>,
+         typename LockType = Mutex,
+         typename PolicyType = LruPolicy>
 class LruCache {
     TOFT_DECLARE_UNCOPYABLE(LruCache);
 
@@ -57,7 +94,7 @@ public:
 
     size_t Size() const {
         typename LockType::Locker locker(&m_mutex);
-        return value_list_.size();
+        return index_.size();
     }
 
     size_t Capacity() const {
@@ -67,7 +104,7 @@ public:
 
     bool IsEmpty() const {
         typename LockType::Locker locker(&m_mutex);
-        return value_list_.empty();
+        return index_.empty();
     }
 
     bool IsFull() const {
@@ -76,44 +113,60 @@ public:
     }
 
 private:
+    struct Node : public CacheEntry {
+        Node(const KeyType &k, const ValueType &v) : key(k), value(v) {}
+        KeyType key;
+        ValueType value;
+    };
+
+    typedef std::map<KeyType, Node*> Map;
+
     bool InternalRemove(const KeyType &key);
 
+    uint64_t Hash(const KeyType &key) const {
+        return internal::CacheKeyHash<PolicyType::kNeedsHash>::Hash(hash_, key);
+    }
+
 private:
-    typedef std::list<std::pair<KeyType, ValueType> > List;
-    typedef std::map<KeyType, typename List::iterator> Map;
     mutable LockType m_mutex;
-    List value_list_;
+    HashType hash_;
+    PolicyType policy_;
     Map index_;
     size_t capacity_;
 };
 
-template<typename KeyType, typename ValueType, typename LockType>
-LruCache<KeyType, ValueType, LockType>::LruCache(size_t capacity)
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+LruCache<KeyType, ValueType, HashType, LockType, PolicyType>::LruCache(size_t capacity)
                 : capacity_(capacity) {
+    policy_.Init(capacity, capacity);
 }
 
-template<typename KeyType, typename ValueType, typename LockType>
-LruCache<KeyType, ValueType, LockType>::~LruCache() {
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+LruCache<KeyType, ValueType, HashType, LockType, PolicyType>::~LruCache() {
     Clear();
 }
 
-template<typename KeyType, typename ValueType, typename LockType>
-bool LruCache<KeyType, ValueType, LockType>::Get(const KeyType &key, ValueType* value) {
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+bool LruCache<KeyType, ValueType, HashType, LockType, PolicyType>::Get(
+    const KeyType &key, ValueType* value) {
     typename LockType::Locker locker(&m_mutex);
+    if (PolicyType::kNeedsHash)
+        policy_.RecordAccess(Hash(key));
     typename Map::iterator iter = index_.find(key);
     if (iter != index_.end()) {
-        value_list_.splice(value_list_.begin(), value_list_, iter->second);
-
-        // Update index.
-        iter->second = value_list_.begin();
-        *value = iter->second->second;
+        policy_.Touch(iter->second);
+        *value = iter->second->value;
         return true;
     }
     return false;
 }
 
-template<typename KeyType, typename ValueType, typename LockType>
-ValueType LruCache<KeyType, ValueType, LockType>::GetOrDefault(
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+ValueType LruCache<KeyType, ValueType, HashType, LockType, PolicyType>::GetOrDefault(
         const KeyType &key,
         const ValueType& default_value) {
     ValueType value;
@@ -122,53 +175,82 @@ ValueType LruCache<KeyType, ValueType, LockType>::GetOrDefault(
     return default_value;
 }
 
-template<typename KeyType, typename ValueType, typename LockType>
-void LruCache<KeyType, ValueType, LockType>::Put(const KeyType &key,
-                                                 const ValueType& value) {
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+void LruCache<KeyType, ValueType, HashType, LockType, PolicyType>::Put(
+    const KeyType &key, const ValueType& value) {
     typename LockType::Locker locker(&m_mutex);
-    {
-        // Remove if exists
-        typename Map::iterator iter = index_.find(key);
-        if (iter != index_.end()) {
-            // The inserted value is the same with the one to be deleted.
-            if (iter->second->second == value)
-                return;
-            InternalRemove(key);
-        }
+    uint64_t hash = Hash(key);
+    if (PolicyType::kNeedsHash)
+        policy_.RecordAccess(hash);
+    typename Map::iterator iter = index_.find(key);
+    if (iter != index_.end()) {
+        // The inserted value is the same with the one to be replaced.
+        if (iter->second->value == value)
+            return;
+        iter->second->value = value;
+        policy_.Touch(iter->second);
+        return;
     }
 
-    // Insert to list
-    value_list_.push_front(std::make_pair(key, value));
-
-    // Update index
-    typename List::iterator iter = value_list_.begin();
-    index_[key] = iter;
-
-    // Check overflow
-    if (index_.size() > capacity_) {
-        iter = value_list_.end();
-        --iter;
-        InternalRemove(iter->first);
+    Node* node = new Node(key, value);
+    node->hash = hash;
+    index_[key] = node;
+    policy_.Insert(node);
+    // Check overflow, may be the new node itself if it's not admitted.
+    Node* evicted;
+    while ((evicted = static_cast<Node*>(policy_.Evict())) != NULL) {
+        index_.erase(evicted->key);
+        delete evicted;
     }
 }
 
-template<typename KeyType, typename ValueType, typename LockType>
-bool LruCache<KeyType, ValueType, LockType>::InternalRemove(const KeyType &key) {
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+bool LruCache<KeyType, ValueType, HashType, LockType, PolicyType>::InternalRemove(
+    const KeyType &key) {
     typename Map::iterator iter = index_.find(key);
     if (iter == index_.end())
         return false;
-    value_list_.erase(iter->second);
+    Node* node = iter->second;
     index_.erase(iter);
+    policy_.Remove(node);
+    delete node;
     return true;
 }
 
-template<typename KeyType, typename ValueType, typename LockType>
-void LruCache<KeyType, ValueType, LockType>::Clear() {
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+void LruCache<KeyType, ValueType, HashType, LockType, PolicyType>::Clear() {
     typename LockType::Locker locker(&m_mutex);
-    value_list_.clear();
+    policy_.Clear();
+    for (typename Map::iterator iter = index_.begin(); iter != index_.end(); ++iter) {
+        delete iter->second;
+    }
     index_.clear();
 }
 
+// LruCache evicting by CLOCK, see ClockPolicy.
+template<typename KeyType, typename ValueType,
+         typename HashType = DefaultCacheHash<KeyType>,
+         typename LockType = Mutex>
+class ClockCache : public LruCache<KeyType, ValueType, HashType, LockType, ClockPolicy> {
+public:
+    explicit ClockCache(size_t capacity)
+        : LruCache<KeyType, ValueType, HashType, LockType, ClockPolicy>(capacity) {}
+};
+
+// LruCache admitting and evicting by W-TinyLFU, see TinyLfuPolicy.
+// Keys need std::hash or HashType.
+template<typename KeyType, typename ValueType,
+         typename HashType = DefaultCacheHash<KeyType>,
+         typename LockType = Mutex>
+class TinyLfuCache : public LruCache<KeyType, ValueType, HashType, LockType, TinyLfuPolicy> {
+public:
+    explicit TinyLfuCache(size_t capacity)
+        : LruCache<KeyType, ValueType, HashType, LockType, TinyLfuPolicy>(capacity) {}
+};
+
 }  // namespace toft
 
 #endif  // TOFT_CONTAINER_LRU_CACHE_H_
@@ -0,0 +1,67 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Compare LruCache and ShardedLruCache under concurrent access, the range
+// is the number of threads. Each thread mixes 90% Get and 10% Put over a
+// key space twice the capacity.
+
+#include <vector>
+
+#include "toft/base/benchmark.h"
+#include "toft/base/functional.h"
+#include "toft/base/random.h"
+#include "toft/container/lru_cache.h"
+#include "toft/container/sharded_lru_cache.h"
+#include "toft/system/threading/thread.h"
+
+namespace toft {
+
+static const int kCapacity = 1 << 16;
+static const int kKeySpace = kCapacity * 2;
+
+template <typename Cache>
+static void Access(Cache *cache, int seed, int iters) {
+    Random random(seed);
+    int value;
+    for (int i = 0; i < iters; ++i) {
+        int key = random.Uniform(kKeySpace);
+        if (i % 10 == 0) {
+            cache->Put(key, key);
+        } else {
+            cache->Get(key, &value);
+        }
+    }
+}
+
+template <typename Cache>
+static void RunThreads(int n, int num_threads) {
+    StopBenchmarkTiming();
+    Cache cache(kCapacity);
+    for (int i = 0; i < kCapacity; ++i)
+        cache.Put(i, i);
+    std::vector<Thread*> threads;
+    StartBenchmarkTiming();
+
+    int iters = n / num_threads + 1;
+    for (int i = 0; i < num_threads; ++i) {
+        threads.push_back(new Thread(std::bind(&Access<Cache>, &cache, i + 1, iters)));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->Join();
+        delete threads[i];
+    }
+    SetBenchmarkItemsProcessed(iters * num_threads);
+}
+
+static void LruCacheAccess(int n, int num_threads) {
+    RunThreads<LruCache<int, int> >(n, num_threads);
+}
+
+static void ShardedLruCacheAccess(int n, int num_threads) {
+    RunThreads<ShardedLruCache<int, int> >(n, num_threads);
+}
+
+TOFT_BENCHMARK_RANGE(LruCacheAccess, 1, 32)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(ShardedLruCacheAccess, 1, 32)->ThreadRange(1, 1);
+
+}  // namespace toft
@@ -90,6 +90,61 @@ TEST(LruCacheTest, Overflow) {
     EXPECT_EQ(4, cache.GetOrDefault(4));
 }
 
+// Only ordered, not hashable.
+struct OrderedKey {
+    explicit OrderedKey(int v = 0) : value(v) {}
+    bool operator<(const OrderedKey& other) const { return value < other.value; }
+    bool operator==(const OrderedKey& other) const { return value == other.value; }
+    int value;
+};
+
+TEST(LruCacheTest, KeysNeedNoHash) {
+    LruCache<OrderedKey, int> lru(2);
+    ClockCache<OrderedKey, int> clock(2);
+    for (int i = 0; i < 3; ++i) {
+        lru.Put(OrderedKey(i), i);
+        clock.Put(OrderedKey(i), i);
+    }
+    EXPECT_FALSE(lru.HasKey(OrderedKey(0)));
+    EXPECT_EQ(2, lru.GetOrDefault(OrderedKey(2)));
+    EXPECT_EQ(2U, clock.Size());
+}
+
+TEST(LruCacheTest, ClockCache) {
+    ClockCache<int, int> cache(3);
+    cache.Put(1, 1);
+    cache.Put(2, 2);
+    cache.Put(3, 3);
+    // Referenced entries get a second chance.
+    EXPECT_EQ(1, cache.GetOrDefault(1));
+    cache.Put(4, 4);
+    EXPECT_TRUE(cache.HasKey(1));
+    EXPECT_FALSE(cache.HasKey(2));
+    EXPECT_EQ(3U, cache.Size());
+    EXPECT_TRUE(cache.IsFull());
+}
+
+TEST(LruCacheTest, TinyLfuCacheResistsScan) {
+    TinyLfuCache<int, int> cache(100);
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 50; ++i) {
+            if (!cache.HasKey(i))
+                cache.Put(i, i);
+            cache.GetOrDefault(i);
+        }
+    }
+    // Keys of a scan are accessed only once.
+    for (int i = 1000; i < 2000; ++i)
+        cache.Put(i, i);
+    int hits = 0;
+    for (int i = 0; i < 50; ++i) {
+        if (cache.HasKey(i))
+            ++hits;
+    }
+    EXPECT_GE(hits, 49);
+    EXPECT_LE(cache.Size(), 100U);
+}
+
 static void SetCache(LruCache<int, int> *cache, int multiplier) {
     for (int i = 2; i < 1000; ++i) {
         cache->Put(i, i * multiplier);
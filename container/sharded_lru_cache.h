@@ -0,0 +1,271 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_CONTAINER_SHARDED_LRU_CACHE_H_
+#define TOFT_CONTAINER_SHARDED_LRU_CACHE_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "toft/base/cxx11.h"
+#include "toft/base/uncopyable.h"
+#include "toft/base/unordered_map.h"
+#include "toft/container/cache_policy.h"
+#include "toft/system/threading/mutex.h"
+
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+
+// Thread safe LruCache for concurrent access.
+//
+// Keys are spread into shards by hash, each shard has its own lock, hash
+// index and intrusive LRU list, so all operations are O(1) and threads
+// touching different shards never contend. The eviction order is LRU in
+// each shard, which approximates the global LRU order.
+//
+// PolicyType replaces LRU by another admission and eviction policy, see
+// cache_policy.h. ShardedClockCache and ShardedTinyLfuCache below are for
+// caches shared by point lookups and scans.
+template<typename KeyType, typename ValueType,
+         typename HashType = typename std::unordered_map<KeyType, int>::hasher,
+         typename LockType = Mutex,
+         typename PolicyType = LruPolicy>
+class ShardedLruCache {
+    TOFT_DECLARE_UNCOPYABLE(ShardedLruCache);
+
+public:
+    static const size_t kDefaultNumShards = 16;
+
+    // capacity is the max # of items of all shards.
+    explicit ShardedLruCache(size_t capacity,
+                             size_t num_shards = kDefaultNumShards);
+
+    ~ShardedLruCache();
+
+    // Gets the value from the cache and also update the cache.
+    // return false if no value found.
+    bool Get(const KeyType &key, ValueType* value);
+
+    // Get the value from the cache if exist, return default_value otherwise.
+    ValueType GetOrDefault(const KeyType &key,
+                           const ValueType& default_value = ValueType());
+
+    // Saves value in cache.
+    // If the key already exists, the new value will replace the old one.
+    void Put(const KeyType &key, const ValueType& value);
+
+    // Remove by key
+    bool Remove(const KeyType &key);
+
+    bool HasKey(const KeyType& key) const;
+
+    // Clear all values
+    void Clear();
+
+    size_t Size() const;
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+    bool IsEmpty() const {
+        return Size() == 0;
+    }
+
+private:
+    struct Node : public CacheEntry {
+        Node(const KeyType &k, const ValueType &v) : key(k), value(v) {}
+        KeyType key;
+        ValueType value;
+    };
+
+    typedef std::unordered_map<KeyType, Node*, HashType> Map;
+
+    struct Shard {
+        mutable LockType mutex;
+        PolicyType policy;
+        Map index;
+    };
+
+    uint64_t Hash(const KeyType &key) const {
+        // The hash of integers is often identity, mix it before taking the
+        // shard, otherwise the index of each shard degenerates.
+        return static_cast<uint64_t>(hash_(key)) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    Shard* GetShard(uint64_t hash) const {
+        return &shards_[(hash >> 32) % num_shards_];
+    }
+
+    static void EraseNode(Shard* shard, typename Map::iterator iter) {
+        Node* node = iter->second;
+        shard->index.erase(iter);
+        shard->policy.Remove(node);
+        delete node;
+    }
+
+private:
+    HashType hash_;
+    size_t capacity_;
+    size_t num_shards_;
+    Shard* shards_;
+};
+
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+ShardedLruCache<KeyType, ValueType, HashType, LockType, PolicyType>::ShardedLruCache(
+    size_t capacity, size_t num_shards)
+                : capacity_(capacity) {
+    CHECK_GT(num_shards, 0U);
+    // Every shard should be able to hold at least one item.
+    num_shards_ = std::max<size_t>(1, std::min(num_shards, capacity));
+    shards_ = new Shard[num_shards_];
+    for (size_t i = 0; i < num_shards_; ++i) {
+        size_t shard_capacity = capacity / num_shards_ +
+                                (i < capacity % num_shards_ ? 1 : 0);
+        shards_[i].policy.Init(shard_capacity, shard_capacity);
+    }
+}
+
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+ShardedLruCache<KeyType, ValueType, HashType, LockType, PolicyType>::~ShardedLruCache() {
+    Clear();
+    delete[] shards_;
+}
+
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+bool ShardedLruCache<KeyType, ValueType, HashType, LockType, PolicyType>::Get(
+    const KeyType &key, ValueType* value) {
+    uint64_t hash = Hash(key);
+    Shard* shard = GetShard(hash);
+    typename LockType::Locker locker(&shard->mutex);
+    shard->policy.RecordAccess(hash);
+    typename Map::iterator iter = shard->index.find(key);
+    if (iter == shard->index.end())
+        return false;
+    Node* node = iter->second;
+    shard->policy.Touch(node);
+    *value = node->value;
+    return true;
+}
+
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+ValueType ShardedLruCache<KeyType, ValueType, HashType, LockType, PolicyType>::GetOrDefault(
+    const KeyType &key,
+    const ValueType& default_value) {
+    ValueType value;
+    if (Get(key, &value))
+        return value;
+    return default_value;
+}
+
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+void ShardedLruCache<KeyType, ValueType, HashType, LockType, PolicyType>::Put(
+    const KeyType &key, const ValueType& value) {
+    uint64_t hash = Hash(key);
+    Shard* shard = GetShard(hash);
+    typename LockType::Locker locker(&shard->mutex);
+    shard->policy.RecordAccess(hash);
+    typename Map::iterator iter = shard->index.find(key);
+    if (iter != shard->index.end()) {
+        Node* node = iter->second;
+        node->value = value;
+        shard->policy.Touch(node);
+        return;
+    }
+
+    Node* node = new Node(key, value);
+    node->hash = hash;
+    shard->index[key] = node;
+    shard->policy.Insert(node);
+    // May be the new node itself if it's not admitted.
+    Node* evicted;
+    while ((evicted = static_cast<Node*>(shard->policy.Evict())) != NULL) {
+        shard->index.erase(evicted->key);
+        delete evicted;
+    }
+}
+
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+bool ShardedLruCache<KeyType, ValueType, HashType, LockType, PolicyType>::Remove(
+    const KeyType &key) {
+    Shard* shard = GetShard(Hash(key));
+    typename LockType::Locker locker(&shard->mutex);
+    typename Map::iterator iter = shard->index.find(key);
+    if (iter == shard->index.end())
+        return false;
+    EraseNode(shard, iter);
+    return true;
+}
+
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+bool ShardedLruCache<KeyType, ValueType, HashType, LockType, PolicyType>::HasKey(
+    const KeyType &key) const {
+    Shard* shard = GetShard(Hash(key));
+    typename LockType::Locker locker(&shard->mutex);
+    return shard->index.find(key) != shard->index.end();
+}
+
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+void ShardedLruCache<KeyType, ValueType, HashType, LockType, PolicyType>::Clear() {
+    for (size_t i = 0; i < num_shards_; ++i) {
+        Shard* shard = &shards_[i];
+        typename LockType::Locker locker(&shard->mutex);
+        shard->policy.Clear();
+        for (typename Map::iterator iter = shard->index.begin();
+             iter != shard->index.end(); ++iter) {
+            delete iter->second;
+        }
+        shard->index.clear();
+    }
+}
+
+template<typename KeyType, typename ValueType, typename HashType, typename LockType,
+         typename PolicyType>
+size_t ShardedLruCache<KeyType, ValueType, HashType, LockType, PolicyType>::Size() const {
+    size_t size = 0;
+    for (size_t i = 0; i < num_shards_; ++i) {
+        typename LockType::Locker locker(&shards_[i].mutex);
+        size += shards_[i].index.size();
+    }
+    return size;
+}
+
+// ShardedLruCache evicting by CLOCK, see ClockPolicy.
+template<typename KeyType, typename ValueType,
+         typename HashType = typename std::unordered_map<KeyType, int>::hasher,
+         typename LockType = Mutex>
+class ShardedClockCache
+    : public ShardedLruCache<KeyType, ValueType, HashType, LockType, ClockPolicy> {
+public:
+    explicit ShardedClockCache(size_t capacity,
+                               size_t num_shards = ShardedClockCache::kDefaultNumShards)
+        : ShardedLruCache<KeyType, ValueType, HashType, LockType, ClockPolicy>(
+            capacity, num_shards) {}
+};
+
+// ShardedLruCache admitting and evicting by W-TinyLFU, see TinyLfuPolicy.
+template<typename KeyType, typename ValueType,
+         typename HashType = typename std::unordered_map<KeyType, int>::hasher,
+         typename LockType = Mutex>
+class ShardedTinyLfuCache
+    : public ShardedLruCache<KeyType, ValueType, HashType, LockType, TinyLfuPolicy> {
+public:
+    explicit ShardedTinyLfuCache(size_t capacity,
+                                 size_t num_shards = ShardedTinyLfuCache::kDefaultNumShards)
+        : ShardedLruCache<KeyType, ValueType, HashType, LockType, TinyLfuPolicy>(
+            capacity, num_shards) {}
+};
+
+}  // namespace toft
+
+#endif  // TOFT_CONTAINER_SHARDED_LRU_CACHE_H_
@@ -0,0 +1,171 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/container/sharded_lru_cache.h"
+
+#include <string>
+
+#include "toft/base/closure.h"
+#include "toft/system/threading/thread_pool.h"
+#include "toft/system/time/clock.h"
+
+#include "thirdparty/glog/logging.h"
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+TEST(ShardedLruCacheTest, Normal) {
+    ShardedLruCache<int, int> cache(100);
+    cache.Put(2, 2);
+    cache.Put(1, 1);
+    cache.Put(3, 3);
+    EXPECT_EQ(1, cache.GetOrDefault(1));
+    EXPECT_EQ(3, cache.GetOrDefault(3));
+    EXPECT_EQ(2, cache.GetOrDefault(2));
+    EXPECT_FALSE(cache.HasKey(4));
+    EXPECT_EQ(0, cache.GetOrDefault(4));
+}
+
+TEST(ShardedLruCacheTest, SameKey) {
+    ShardedLruCache<std::string, int> cache(100);
+    cache.Put("1", 1);
+    cache.Put("1", 2);
+    cache.Put("3", 3);
+    EXPECT_EQ(2, cache.GetOrDefault("1"));
+    EXPECT_EQ(3, cache.GetOrDefault("3"));
+    EXPECT_EQ(2U, cache.Size());
+}
+
+TEST(ShardedLruCacheTest, Size) {
+    ShardedLruCache<int, int> cache(64, 4);
+    EXPECT_EQ(0U, cache.Size());
+    EXPECT_EQ(64U, cache.Capacity());
+    EXPECT_TRUE(cache.IsEmpty());
+    for (int i = 0; i < 1000; ++i)
+        cache.Put(i, i);
+    EXPECT_FALSE(cache.IsEmpty());
+    // All shards are full.
+    EXPECT_EQ(64U, cache.Size());
+    cache.Clear();
+    EXPECT_TRUE(cache.IsEmpty());
+}
+
+TEST(ShardedLruCacheTest, Remove) {
+    ShardedLruCache<int, int> cache(2);
+    cache.Put(1, 1);
+    EXPECT_TRUE(cache.Remove(1));
+    EXPECT_EQ(0U, cache.Size());
+    EXPECT_TRUE(cache.IsEmpty());
+    EXPECT_FALSE(cache.Remove(2));
+}
+
+TEST(ShardedLruCacheTest, Overflow) {
+    // One shard to check the exact LRU order.
+    ShardedLruCache<int, int> cache(3, 1);
+    cache.Put(1, 1);
+    cache.Put(2, 2);
+    cache.Put(2, 1);
+    cache.Put(3, 3);
+    cache.Put(4, 4);
+    EXPECT_EQ(1, cache.GetOrDefault(2));
+    EXPECT_EQ(3, cache.GetOrDefault(3));
+    EXPECT_EQ(0, cache.GetOrDefault(1));
+    EXPECT_EQ(4, cache.GetOrDefault(4));
+
+    // 2 is the least recently used one now.
+    EXPECT_EQ(3, cache.GetOrDefault(3));
+    EXPECT_EQ(4, cache.GetOrDefault(4));
+    cache.Put(5, 5);
+    EXPECT_FALSE(cache.HasKey(2));
+    EXPECT_TRUE(cache.HasKey(3));
+}
+
+TEST(ShardedLruCacheTest, ClockPolicy) {
+    ShardedClockCache<int, int> cache(3, 1);
+    cache.Put(1, 1);
+    cache.Put(2, 2);
+    cache.Put(3, 3);
+    // Referenced entries get a second chance.
+    EXPECT_EQ(1, cache.GetOrDefault(1));
+    EXPECT_EQ(3, cache.GetOrDefault(3));
+    cache.Put(4, 4);
+    EXPECT_TRUE(cache.HasKey(1));
+    EXPECT_FALSE(cache.HasKey(2));
+    EXPECT_TRUE(cache.HasKey(3));
+    EXPECT_TRUE(cache.HasKey(4));
+
+    // The hand clears the bit of 3 and stops at 4.
+    cache.Put(5, 5);
+    EXPECT_TRUE(cache.HasKey(1));
+    EXPECT_TRUE(cache.HasKey(3));
+    EXPECT_FALSE(cache.HasKey(4));
+    EXPECT_EQ(3U, cache.Size());
+    EXPECT_TRUE(cache.Remove(3));
+    cache.Put(6, 6);
+    EXPECT_EQ(3U, cache.Size());
+}
+
+TEST(ShardedLruCacheTest, TinyLfuPolicyResistsScan) {
+    ShardedTinyLfuCache<int, int> cache(100, 1);
+    // A hot set accessed many times.
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 50; ++i) {
+            if (!cache.HasKey(i))
+                cache.Put(i, i);
+            cache.GetOrDefault(i);
+        }
+    }
+    // Followed by a long scan of keys which are accessed only once.
+    for (int i = 1000; i < 2000; ++i)
+        cache.Put(i, i);
+    int hits = 0;
+    for (int i = 0; i < 50; ++i) {
+        if (cache.HasKey(i))
+            ++hits;
+    }
+    EXPECT_GE(hits, 49);
+    EXPECT_LE(cache.Size(), 100U);
+
+    cache.Clear();
+    EXPECT_TRUE(cache.IsEmpty());
+}
+
+typedef ShardedLruCache<int, int> IntCache;
+
+static void SetThread(IntCache *cache) {
+    int64_t now = RealtimeClock.MicroSeconds();
+    int multiplier = 1;
+    while (RealtimeClock.MicroSeconds() - now < 500) {
+        for (int i = 2; i < 1000; ++i)
+            cache->Put(i, i * multiplier);
+        ++multiplier;
+    }
+}
+
+static void ReadThread(IntCache *cache) {
+    int64_t now = RealtimeClock.MicroSeconds();
+    int value;
+    while (RealtimeClock.MicroSeconds() - now < 500) {
+        for (int i = 2; i < 1000; ++i) {
+            bool r = cache->Get(i, &value);
+            if (r)
+                ASSERT_EQ(0, value % i);
+        }
+    }
+}
+
+TEST(ShardedLruCacheTest, MultiThread) {
+    IntCache cache(900);
+    {
+        ThreadPool pool(7);
+        for (int i = 0; i < 2; ++i) {
+            pool.AddTask(NewClosure(SetThread, &cache));
+        }
+        for (int i = 0; i < 5; ++i) {
+            pool.AddTask(NewClosure(ReadThread, &cache));
+        }
+    }
+    EXPECT_LE(cache.Size(), 900U);
+}
+
+}  // namespace toft
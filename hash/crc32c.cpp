@@ -0,0 +1,107 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/hash/crc32c.h"
+
+#include <string.h>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+namespace {
+
+#ifndef __SSE4_2__
+// Tables of slicing-by-8, table[k][i] is the CRC of byte i followed by k
+// zero bytes.
+static const uint32_t (*InitCrc32cTables())[256] {
+    // CRC-32C polynomial, in reversed form.
+    static const uint32_t kCrc32cPolynomial = 0x82F63B78;
+    static uint32_t tables[8][256];
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (size_t j = 0; j < 8; ++j)
+            c = (c & 1) ? (kCrc32cPolynomial ^ (c >> 1)) : (c >> 1);
+        tables[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+        for (size_t k = 1; k < 8; ++k)
+            tables[k][i] = tables[0][tables[k - 1][i] & 0xFF] ^ (tables[k - 1][i] >> 8);
+    }
+    return tables;
+}
+
+static const uint32_t (*Crc32cTables())[256] {
+    static const uint32_t (*tables)[256] = InitCrc32cTables();
+    return tables;
+}
+#endif
+
+} // namespace
+
+namespace toft {
+
+CRC32C::CRC32C() {
+    Init();
+}
+
+CRC32C::~CRC32C() {}
+
+void CRC32C::Init() {
+    result_ = 0U;
+}
+
+void CRC32C::Update(StringPiece sp) {
+    result_ = Extend(result_, sp.data(), sp.size());
+}
+
+uint32_t CRC32C::Final() const {
+    return result_;
+}
+
+uint32_t CRC32C::Digest(StringPiece sp) {
+    return Extend(0, sp.data(), sp.size());
+}
+
+#ifdef __SSE4_2__
+
+uint32_t CRC32C::Extend(uint32_t crc, const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t c = crc ^ 0xFFFFFFFFU;
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        c = _mm_crc32_u64(c, word);
+    }
+    uint32_t c32 = static_cast<uint32_t>(c);
+    for (; size > 0; --size, ++p)
+        c32 = _mm_crc32_u8(c32, *p);
+    return c32 ^ 0xFFFFFFFFU;
+}
+
+#else
+
+uint32_t CRC32C::Extend(uint32_t crc, const void* data, size_t size) {
+    const uint32_t (*t)[256] = Crc32cTables();
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint32_t c = crc ^ 0xFFFFFFFFU;
+    // Little endian only, like the rest of our formats.
+    for (; size >= 8; size -= 8, p += 8) {
+        uint32_t low;
+        uint32_t high;
+        memcpy(&low, p, 4);
+        memcpy(&high, p + 4, 4);
+        low ^= c;
+        c = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^
+            t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+            t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^
+            t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+    }
+    for (; size > 0; --size, ++p)
+        c = t[0][(c ^ *p) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFU;
+}
+
+#endif
+
+}  // namespace toft
@@ -0,0 +1,47 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_HASH_CRC32C_H
+#define TOFT_HASH_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "toft/base/string/string_piece.h"
+
+namespace toft {
+
+// CRC-32C (Castagnoli), the checksum of iSCSI, ext4 and leveldb. It detects
+// more errors than CRC32 of the same size, and runs on the crc32 instruction
+// when built with SSE 4.2.
+class CRC32C {
+public:
+    CRC32C();
+    ~CRC32C();
+
+    void Init();
+    void Update(StringPiece sp);
+    uint32_t Final() const;
+
+    static uint32_t Digest(StringPiece sp);
+
+    // CRC of data appended to what crc is of.
+    static uint32_t Extend(uint32_t crc, const void* data, size_t size);
+
+    // CRC of data which embeds CRCs is problematic, store masked CRCs in it.
+    static uint32_t Mask(uint32_t crc) {
+        return ((crc >> 15) | (crc << 17)) + kMaskDelta;
+    }
+    static uint32_t Unmask(uint32_t masked_crc) {
+        uint32_t rot = masked_crc - kMaskDelta;
+        return ((rot >> 17) | (rot << 15));
+    }
+
+private:
+    static const uint32_t kMaskDelta = 0xa282ead8U;
+    uint32_t result_;
+};
+
+}  // namespace toft
+
+#endif  // TOFT_HASH_CRC32C_H
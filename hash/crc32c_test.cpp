@@ -0,0 +1,50 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/hash/crc32c.h"
+
+#include <string>
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+// Test vectors of RFC 3720, section B.4.
+TEST(Crc32cTest, Standard) {
+    EXPECT_EQ(0U, CRC32C::Digest(""));
+    EXPECT_EQ(0x8A9136AAU, CRC32C::Digest(std::string(32, '\0')));
+    EXPECT_EQ(0x62A8AB43U, CRC32C::Digest(std::string(32, '\xff')));
+    std::string ascending;
+    for (int i = 0; i < 32; ++i)
+        ascending.push_back(static_cast<char>(i));
+    EXPECT_EQ(0x46DD794EU, CRC32C::Digest(ascending));
+    std::string descending;
+    for (int i = 31; i >= 0; --i)
+        descending.push_back(static_cast<char>(i));
+    EXPECT_EQ(0x113FDB5CU, CRC32C::Digest(descending));
+    EXPECT_EQ(0xE3069283U, CRC32C::Digest("123456789"));
+}
+
+TEST(Crc32cTest, Extend) {
+    std::string input = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    uint32_t expected = CRC32C::Digest(input);
+    // All splits, across words and tails.
+    for (size_t i = 0; i <= input.size(); ++i) {
+        uint32_t crc = CRC32C::Extend(0, input.data(), i);
+        EXPECT_EQ(expected, CRC32C::Extend(crc, input.data() + i, input.size() - i)) << i;
+    }
+    CRC32C crc32c;
+    for (size_t i = 0; i < input.size(); ++i)
+        crc32c.Update(StringPiece(input.data() + i, 1));
+    EXPECT_EQ(expected, crc32c.Final());
+}
+
+TEST(Crc32cTest, Mask) {
+    uint32_t crc = CRC32C::Digest("foo");
+    EXPECT_NE(crc, CRC32C::Mask(crc));
+    EXPECT_NE(crc, CRC32C::Mask(CRC32C::Mask(crc)));
+    EXPECT_EQ(crc, CRC32C::Unmask(CRC32C::Mask(crc)));
+    EXPECT_EQ(crc, CRC32C::Unmask(CRC32C::Unmask(CRC32C::Mask(CRC32C::Mask(crc)))));
+}
+
+} // namespace toft
@@ -6,6 +6,7 @@
 
 #include "toft/hash/city.h"
 #include "toft/hash/crc32.h"
+#include "toft/hash/crc32c.h"
 #include "toft/hash/fingerprint.h"
 #include "toft/hash/jenkins.h"
 #include "toft/hash/murmur.h"
@@ -66,6 +66,12 @@ static void CRC32(int n) {
     }
 }
 
+static void CRC32C(int n) {
+    for (int i = 0; i < n; i++) {
+        toft::CRC32C::Digest(test_str);
+    }
+}
+
 TOFT_BENCHMARK(CityHash32)->ThreadRange(1, NumCPUs());
 TOFT_BENCHMARK(CityHash64)->ThreadRange(1, NumCPUs());
 TOFT_BENCHMARK(CityHash128)->ThreadRange(1, NumCPUs());
@@ -76,4 +82,4 @@ TOFT_BENCHMARK(SuperFastHash)->ThreadRange(1, NumCPUs());
 TOFT_BENCHMARK(MurmurHash64A)->ThreadRange(1, NumCPUs());
 TOFT_BENCHMARK(MurmurHash64B)->ThreadRange(1, NumCPUs());
 TOFT_BENCHMARK(CRC32)->ThreadRange(1, NumCPUs());
-
+TOFT_BENCHMARK(CRC32C)->ThreadRange(1, NumCPUs());
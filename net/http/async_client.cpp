@@ -0,0 +1,835 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/net/http/async_client.h"
+
+#include <errno.h>
+#include <algorithm>
+#include <list>
+#include <set>
+#include <vector>
+
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/algorithm.h"
+#include "toft/base/string/number.h"
+#include "toft/net/http/framing.h"
+#include "toft/net/uri/uri.h"
+#include "toft/system/event_dispatcher/event_dispatcher.h"
+#include "toft/system/net/domain_resolver.h"
+#include "toft/system/net/socket.h"
+#include "toft/system/threading/mutex.h"
+#include "toft/system/threading/thread_pool.h"
+
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+
+namespace {
+
+const char kHttpScheme[] = "http";
+const char kDefaultPath[] = "/";
+const uint16_t kDefaultHttpPort = 80;
+// The same as HttpClient.
+const size_t kDefaultMaxResponseLength = 1024 * 1024 * 2;
+
+// Receive buffers grow by at least so many bytes.
+const size_t kMinReceiveSize = 16 * 1024;
+
+// Threads to resolve host names, shared by all clients.
+const int kResolverThreads = 4;
+
+ThreadPool* ResolverThreadPool() {
+    static ThreadPool* thread_pool = new ThreadPool(kResolverThreads);
+    return thread_pool;
+}
+
+// Frames a response out of the data received from a connection.
+//
+// Data are received into the buffer it gives, which grows as needed: headers
+// and chunks go to a receive buffer, and bodies of known length go right to
+// the body of the response, without copying.
+class HttpResponseReader {
+    TOFT_DECLARE_UNCOPYABLE(HttpResponseReader);
+
+public:
+    enum Status {
+        Status_Incomplete,
+        Status_Complete,
+        Status_Error
+    };
+
+    HttpResponseReader() {
+        Reset(false, kDefaultMaxResponseLength);
+    }
+
+    void Reset(bool head_request, size_t max_length) {
+        m_head_request = head_request;
+        m_max_length = max_length;
+        m_state = State_Headers;
+        m_buffer.clear();
+        m_size = 0;
+        m_position = 0;
+        m_body_size = 0;
+        m_body_received_size = 0;
+        m_received_size = 0;
+        m_keep_alive = false;
+        m_error = HttpClient::SUCCESS;
+        m_response.Reset();
+    }
+
+    // Buffer to receive more data into.
+    char* ReceiveBuffer(size_t* size) {
+        if (m_state == State_Body) {
+            *size = m_body_size - m_body_received_size;
+            return &(*m_response.MutableBody())[m_body_received_size];
+        }
+        if (m_state == State_UntilClose)
+            return GrowBuffer(m_response.MutableBody(), m_body_received_size, size);
+        return GrowBuffer(&m_buffer, m_size, size);
+    }
+
+    // size bytes were received into the buffer.
+    Status OnReceived(size_t size) {
+        m_received_size += size;
+        if (m_received_size > m_max_length)
+            return Error(HttpClient::ERROR_FAIL_TO_GET_RESPONSE);
+        if (m_state == State_Body || m_state == State_UntilClose) {
+            m_body_received_size += size;
+            return CheckBodyComplete();
+        }
+        m_size += size;
+        if (m_state == State_Headers) {
+            Status status = ParseHeaders();
+            if (status != Status_Incomplete || m_state != State_ChunkSize)
+                return status;
+        }
+        return ParseChunks();
+    }
+
+    // The peer closed the connection.
+    Status OnClosed() {
+        if (m_state != State_UntilClose)
+            return Error(HttpClient::ERROR_FAIL_TO_GET_RESPONSE);
+        m_response.MutableBody()->resize(m_body_received_size);
+        return Status_Complete;
+    }
+
+    HttpResponse* MutableResponse() { return &m_response; }
+    HttpClient::ErrorCode LastError() const { return m_error; }
+    size_t ReceivedSize() const { return m_received_size; }
+    // Whether the connection can be used for the next request.
+    bool IsKeepAlive() const { return m_keep_alive; }
+
+private:
+    enum State {
+        State_Headers,
+        State_Body,
+        State_UntilClose,
+        State_ChunkSize,
+        State_ChunkData,
+        State_Trailers,
+    };
+
+    static char* GrowBuffer(std::string* buffer, size_t used_size, size_t* size) {
+        if (buffer->size() - used_size < kMinReceiveSize)
+            buffer->resize(std::max(buffer->size() * 2, used_size + kMinReceiveSize));
+        *size = buffer->size() - used_size;
+        return &(*buffer)[used_size];
+    }
+
+    Status ParseHeaders() {
+        StringPiece data(m_buffer.data(), m_size);
+        size_t header_size = FindHeaderEnd(data, m_position);
+        if (header_size == StringPiece::npos) {
+            m_position = m_size;
+            return Status_Incomplete;
+        }
+
+        HttpMessage::ErrorCode error = HttpMessage::SUCCESS;
+        if (m_response.ParseHeaders(data.substr(0, header_size), &error) == 0 ||
+            error != HttpMessage::SUCCESS) {
+            return Error(HttpClient::ERROR_INVALID_RESPONSE_HEADER);
+        }
+        m_keep_alive = m_response.IsKeepAlive();
+        StringPiece rest = data.substr(header_size);
+
+        // According to RFC2616, responses of HEAD, status 1xx, 204, and 304
+        // have no body.
+        int status = m_response.Status();
+        if (m_head_request || status < 200 || status == 204 || status == 304)
+            return Complete(rest.size());
+
+        std::string transfer_encoding;
+        if (m_response.GetHeader("Transfer-Encoding", &transfer_encoding)) {
+            StringToLower(&transfer_encoding);
+            if (transfer_encoding != "identity") {
+                if (transfer_encoding.find("chunked") == std::string::npos)
+                    return Error(HttpClient::ERROR_CONTENT_TYPE_NOT_SUPPORTED);
+                m_position = header_size;
+                m_state = State_ChunkSize;
+                return Status_Incomplete;
+            }
+        }
+
+        // The rest of received data are moved to the body, where the body
+        // is received into then.
+        std::string* body = m_response.MutableBody();
+        if (m_response.HasHeader("Content-Length")) {
+            int content_length = m_response.GetContentLength();
+            if (content_length < 0)
+                return Error(HttpClient::ERROR_INVALID_RESPONSE_HEADER);
+            if (header_size + content_length > m_max_length)
+                return Error(HttpClient::ERROR_FAIL_TO_GET_RESPONSE);
+            m_body_size = content_length;
+            m_body_received_size = std::min(rest.size(), m_body_size);
+            if (rest.size() > m_body_size)
+                m_keep_alive = false;
+            body->resize(m_body_size);
+            m_state = State_Body;
+        } else {
+            // Old servers close the connection after the response.
+            m_keep_alive = false;
+            m_body_received_size = rest.size();
+            body->resize(m_body_received_size);
+            m_state = State_UntilClose;
+        }
+        body->replace(0, m_body_received_size, rest.data(), m_body_received_size);
+        m_buffer.clear();
+        m_size = 0;
+        return CheckBodyComplete();
+    }
+
+    Status CheckBodyComplete() {
+        if (m_state == State_Body && m_body_received_size == m_body_size)
+            return Status_Complete;
+        return Status_Incomplete;
+    }
+
+    Status ParseChunks() {
+        StringPiece data(m_buffer.data(), m_size);
+        std::string* body = m_response.MutableBody();
+        for (;;) {
+            if (m_state == State_ChunkData) {
+                // Chunk data and its line ending.
+                size_t end = m_position + m_body_size;
+                if (data.size() < end)
+                    break;
+                int line_ending_size = MatchLineEnding(data.substr(end));
+                if (line_ending_size == 0)
+                    break;
+                if (line_ending_size < 0)
+                    return Error(HttpClient::ERROR_FAIL_TO_READ_CHUNKSIZE);
+                body->append(data.data() + m_position, m_body_size);
+                m_position = end + line_ending_size;
+                m_state = State_ChunkSize;
+                continue;
+            }
+
+            size_t eol = data.find('\n', m_position);
+            if (eol == StringPiece::npos)
+                break;
+            StringPiece line = data.substr(m_position, eol - m_position);
+            m_position = eol + 1;
+            if (line.ends_with("\r"))
+                line.remove_suffix(1);
+
+            if (m_state == State_Trailers) {
+                if (line.empty())
+                    return Complete(data.size() - m_position);
+                continue;
+            }
+
+            // Chunk extensions after ';' are ignored.
+            size_t chunk_size = 0;
+            if (!ParseChunkSizeLine(line, m_max_length, &chunk_size))
+                return Error(HttpClient::ERROR_FAIL_TO_READ_CHUNKSIZE);
+            if (chunk_size > m_max_length)
+                return Error(HttpClient::ERROR_FAIL_TO_GET_RESPONSE);
+            if (chunk_size == 0) {
+                m_state = State_Trailers;
+                continue;
+            }
+            m_body_size = chunk_size;
+            m_state = State_ChunkData;
+        }
+        // Drop parsed data if they take the most of the buffer.
+        if (m_position > m_size / 2) {
+            m_buffer.erase(0, m_position);
+            m_size -= m_position;
+            m_position = 0;
+        }
+        return Status_Incomplete;
+    }
+
+    // extra_size bytes received after the response.
+    Status Complete(size_t extra_size) {
+        if (extra_size > 0)
+            m_keep_alive = false;
+        return Status_Complete;
+    }
+
+    Status Error(HttpClient::ErrorCode error) {
+        m_error = error;
+        return Status_Error;
+    }
+
+private:
+    bool m_head_request;
+    size_t m_max_length;
+    State m_state;
+    // Receive buffer of headers and chunks.
+    std::string m_buffer;
+    size_t m_size;
+    size_t m_position;
+    // Size of the body in State_Body, or the current chunk in State_ChunkData.
+    size_t m_body_size;
+    size_t m_body_received_size;
+    size_t m_received_size;
+    bool m_keep_alive;
+    HttpClient::ErrorCode m_error;
+    HttpResponse m_response;
+};
+
+} // namespace
+
+struct AsyncHttpClient::PendingRequest {
+    PendingRequest()
+        : head(false), max_response_length(0), retried(false),
+          pool(NULL), connection(NULL) {}
+    // The serialized request.
+    std::string data;
+    bool head;
+    size_t max_response_length;
+    // A request failed on a reused connection before any response is tried
+    // again, the server may have closed the connection.
+    bool retried;
+    Callback callback;
+    HostPool* pool;
+    Connection* connection;
+    scoped_ptr<TimerEventWatcher> timer;
+};
+
+struct AsyncHttpClient::HostPool {
+    HostPool(const std::string& host, uint16_t port)
+        : host(host), port(port), resolving(false), next_address(0) {}
+    std::string host;
+    uint16_t port;
+    // Resolved in background once and cached, until connecting fails.
+    // Requests needing a new connection wait while resolving.
+    bool resolving;
+    std::vector<SocketAddressInet4> addresses;
+    size_t next_address;
+    std::set<Connection*> connections;
+    // Most recently used at the back.
+    std::vector<Connection*> idle_connections;
+    std::list<PendingRequest*> waiting_requests;
+};
+
+struct AsyncHttpClient::ResolveContext {
+    explicit ResolveContext(AsyncHttpClient* client) : client(client) {}
+    Mutex mutex;
+    // NULL after the client is deleted, the results are dropped then.
+    AsyncHttpClient* client;
+};
+
+// A keep-alive connection to a host, which serves one request at a time.
+class AsyncHttpClient::Connection {
+    TOFT_DECLARE_UNCOPYABLE(Connection);
+
+public:
+    Connection(AsyncHttpClient* client, HostPool* pool)
+        : m_client(client),
+          m_pool(pool),
+          m_watcher(client->m_dispatcher,
+                    std::bind(&Connection::OnIoEvents, this, std::placeholders::_1)),
+          m_connecting(false),
+          m_request(NULL),
+          m_sent_size(0),
+          m_served_count(0) {
+    }
+
+    ~Connection() {
+        m_watcher.Stop();
+    }
+
+    bool Connect(const SocketAddress& address) {
+        if (!m_socket.Create(AF_INET) || !m_socket.SetBlocking(false))
+            return false;
+        m_socket.SetTcpNoDelay();
+        if (!m_socket.Connect(address))
+            return false;
+        m_connecting = true;
+        m_watcher.Set(m_socket.Handle(), EventMask_Write);
+        m_watcher.Start();
+        return true;
+    }
+
+    // Data are sent when the loop finds the socket writeable.
+    void Send(PendingRequest* request) {
+        m_request = request;
+        request->connection = this;
+        m_sent_size = 0;
+        m_reader.Reset(request->head, request->max_response_length);
+        if (!m_connecting)
+            m_watcher.Set(EventMask_Read | EventMask_Write);
+    }
+
+    PendingRequest* DetachRequest() {
+        PendingRequest* request = m_request;
+        if (request != NULL)
+            request->connection = NULL;
+        m_request = NULL;
+        return request;
+    }
+
+    // Watch for close by the server when idle.
+    void SetIdle() {
+        m_watcher.Set(EventMask_Read);
+    }
+
+    HostPool* Pool() const { return m_pool; }
+    HttpResponse* MutableResponse() { return m_reader.MutableResponse(); }
+    bool IsReused() const { return m_served_count > 0; }
+    bool HasReceived() const { return m_reader.ReceivedSize() > 0; }
+
+private:
+    void OnIoEvents(int events) {
+        if (m_connecting) {
+            int error = 0;
+            if ((events & EventMask_Error) || !m_socket.GetError(&error) || error != 0) {
+                m_client->OnConnectionClosed(this, HttpClient::ERROR_FAIL_TO_CONNECT_SERVER);
+                return;
+            }
+            m_connecting = false;
+            m_watcher.Set(EventMask_Read | EventMask_Write);
+        }
+        if (m_request == NULL) {
+            // Idle connections are closed by the server, or are in error.
+            m_client->OnConnectionClosed(this, HttpClient::SUCCESS);
+            return;
+        }
+        if (events & EventMask_Write) {
+            if (!OnWriteable())
+                return;
+        }
+        if (events & EventMask_Read)
+            OnReadable();
+    }
+
+    bool OnWriteable() {
+        const std::string& data = m_request->data;
+        if (m_sent_size < data.size()) {
+            size_t sent_size;
+            errno = 0;
+            if (!m_socket.Send(data.data() + m_sent_size, data.size() - m_sent_size,
+                               &sent_size, MSG_NOSIGNAL)) {
+                if (Socket::IsLastErrorWouldBlock())
+                    return true;
+                m_client->OnConnectionClosed(this, HttpClient::ERROR_FAIL_TO_SEND_REQUEST);
+                return false;
+            }
+            m_sent_size += sent_size;
+        }
+        if (m_sent_size == data.size())
+            m_watcher.Set(EventMask_Read);
+        return true;
+    }
+
+    void OnReadable() {
+        for (;;) {
+            size_t buffer_size;
+            char* buffer = m_reader.ReceiveBuffer(&buffer_size);
+            size_t received_size = 0;
+            errno = 0;
+            HttpResponseReader::Status status;
+            if (m_socket.Receive(buffer, buffer_size, &received_size)) {
+                status = m_reader.OnReceived(received_size);
+            } else if (errno == 0) {
+                status = m_reader.OnClosed();
+            } else if (Socket::IsLastErrorWouldBlock()) {
+                return;
+            } else {
+                status = HttpResponseReader::Status_Error;
+            }
+
+            if (status == HttpResponseReader::Status_Incomplete)
+                continue;
+            if (status == HttpResponseReader::Status_Error) {
+                HttpClient::ErrorCode error = m_reader.LastError();
+                if (error == HttpClient::SUCCESS)
+                    error = HttpClient::ERROR_FAIL_TO_GET_RESPONSE;
+                m_client->OnConnectionClosed(this, error);
+                return;
+            }
+            ++m_served_count;
+            // The server may respond before the whole request is received.
+            bool keep_alive = received_size > 0 && m_reader.IsKeepAlive() &&
+                m_sent_size == m_request->data.size();
+            m_client->OnResponse(this, keep_alive);
+            return;
+        }
+    }
+
+private:
+    AsyncHttpClient* m_client;
+    HostPool* m_pool;
+    StreamSocket m_socket;
+    IoEventWatcher m_watcher;
+    bool m_connecting;
+    PendingRequest* m_request;
+    size_t m_sent_size;
+    int m_served_count;
+    HttpResponseReader m_reader;
+};
+
+AsyncHttpClient::AsyncHttpClient(EventDispatcher* dispatcher)
+    : m_dispatcher(dispatcher),
+      m_user_agent("SosoDownloader/1.0(compatible; MSIE 7.0; Windows NT 5.1)"),
+      m_max_connections_per_host(kDefaultMaxConnectionsPerHost),
+      m_timeout(0),
+      m_pending_request_count(0),
+      m_resolve_context(new ResolveContext(this)) {
+}
+
+AsyncHttpClient::~AsyncHttpClient() {
+    {
+        MutexLocker locker(&m_resolve_context->mutex);
+        m_resolve_context->client = NULL;
+    }
+    for (std::map<std::string, HostPool*>::iterator i = m_host_pools.begin();
+         i != m_host_pools.end(); ++i) {
+        HostPool* pool = i->second;
+        for (std::set<Connection*>::iterator j = pool->connections.begin();
+             j != pool->connections.end(); ++j) {
+            delete (*j)->DetachRequest();
+            delete *j;
+        }
+        for (std::list<PendingRequest*>::iterator j = pool->waiting_requests.begin();
+             j != pool->waiting_requests.end(); ++j) {
+            delete *j;
+        }
+        delete pool;
+    }
+}
+
+AsyncHttpClient& AsyncHttpClient::SetProxy(const std::string& proxy) {
+    m_proxy = proxy;
+    return *this;
+}
+
+AsyncHttpClient& AsyncHttpClient::SetUserAgent(const std::string& user_agent) {
+    m_user_agent = user_agent;
+    return *this;
+}
+
+AsyncHttpClient& AsyncHttpClient::SetMaxConnectionsPerHost(size_t count) {
+    CHECK_GT(count, 0U);
+    m_max_connections_per_host = count;
+    return *this;
+}
+
+AsyncHttpClient& AsyncHttpClient::SetTimeout(int64_t timeout_ms) {
+    m_timeout = timeout_ms;
+    return *this;
+}
+
+size_t AsyncHttpClient::ConnectionCount() const {
+    size_t count = 0;
+    for (std::map<std::string, HostPool*>::const_iterator i = m_host_pools.begin();
+         i != m_host_pools.end(); ++i) {
+        count += i->second->connections.size();
+    }
+    return count;
+}
+
+void AsyncHttpClient::CloseIdleConnections() {
+    for (std::map<std::string, HostPool*>::iterator i = m_host_pools.begin();
+         i != m_host_pools.end(); ++i) {
+        HostPool* pool = i->second;
+        while (!pool->idle_connections.empty())
+            ReleaseConnection(pool->idle_connections.back());
+    }
+}
+
+void AsyncHttpClient::Get(const std::string& url, const Callback& callback) {
+    Request(HttpRequest::METHOD_GET, url, "", Options(), callback);
+}
+
+void AsyncHttpClient::Get(const std::string& url, const Options& options,
+                          const Callback& callback) {
+    Request(HttpRequest::METHOD_GET, url, "", options, callback);
+}
+
+void AsyncHttpClient::Post(const std::string& url, const std::string& data,
+                           const Callback& callback) {
+    Request(HttpRequest::METHOD_POST, url, data, Options(), callback);
+}
+
+void AsyncHttpClient::Post(const std::string& url, const std::string& data,
+                           const Options& options, const Callback& callback) {
+    Request(HttpRequest::METHOD_POST, url, data, options, callback);
+}
+
+void AsyncHttpClient::Request(HttpRequest::MethodType method,
+                              const std::string& url,
+                              const std::string& data,
+                              const Options& options,
+                              const Callback& callback) {
+    HttpResponse empty_response;
+    URI uri;
+    if (!uri.Parse(url)) {
+        callback(HttpClient::ERROR_INVALID_URI_ADDRESS, &empty_response);
+        return;
+    }
+
+    HttpRequest request;
+    request.SetMethod(method);
+    const HttpHeaders& headers = options.Headers();
+    for (size_t i = 0; i < headers.Count(); ++i) {
+        std::pair<std::string, std::string> header;
+        headers.GetAt(i, &header);
+        request.AddHeader(header.first, header.second);
+    }
+    request.SetHeader("User-Agent", m_user_agent);
+    request.SetHeader("Host", uri.Host());
+    request.SetHeader("Content-Length", IntegerToString(data.size()));
+
+    std::string path_and_query = uri.PathAndQuery();
+    const URI* server_uri = &uri;
+    URI proxy_uri;
+    if (!m_proxy.empty()) {
+        if (!proxy_uri.Parse(m_proxy)) {
+            callback(HttpClient::ERROR_INVALID_PROXY_ADDRESS, &empty_response);
+            return;
+        }
+        server_uri = &proxy_uri;
+        path_and_query = url;
+    }
+    request.SetUri(path_and_query.empty() ? kDefaultPath : path_and_query);
+
+    uint16_t port = kDefaultHttpPort;
+    if (server_uri->HasPort()) {
+        if (!StringToNumber(server_uri->Port(), &port)) {
+            callback(HttpClient::ERROR_INVALID_URI_ADDRESS, &empty_response);
+            return;
+        }
+    } else if (!server_uri->Scheme().empty() && server_uri->Scheme() != kHttpScheme) {
+        callback(HttpClient::ERROR_PROTOCAL_NOT_SUPPORTED, &empty_response);
+        return;
+    }
+
+    PendingRequest* pending_request = new PendingRequest();
+    request.HeadersToString(&pending_request->data);
+    pending_request->data.append(data);
+    pending_request->head = method == HttpRequest::METHOD_HEAD;
+    pending_request->max_response_length = options.MaxResponseLength() ?
+        options.MaxResponseLength() : kDefaultMaxResponseLength;
+    pending_request->callback = callback;
+    pending_request->pool = GetHostPool(server_uri->Host(), port);
+    if (m_timeout > 0) {
+        pending_request->timer.reset(new TimerEventWatcher(
+                m_dispatcher,
+                std::bind(&AsyncHttpClient::OnTimeout, this, pending_request),
+                m_timeout));
+        pending_request->timer->Start();
+    }
+    ++m_pending_request_count;
+    Dispatch(pending_request->pool, pending_request);
+}
+
+AsyncHttpClient::HostPool* AsyncHttpClient::GetHostPool(const std::string& host,
+                                                        uint16_t port) {
+    std::string key = host + ":" + IntegerToString(port);
+    HostPool*& pool = m_host_pools[key];
+    if (pool == NULL)
+        pool = new HostPool(host, port);
+    return pool;
+}
+
+AsyncHttpClient::Connection* AsyncHttpClient::NewConnection(HostPool* pool,
+                                                            ErrorCode* error) {
+    // Connections are spread over the addresses.
+    const SocketAddressInet4& address =
+        pool->addresses[pool->next_address++ % pool->addresses.size()];
+    Connection* connection = new Connection(this, pool);
+    if (!connection->Connect(address)) {
+        delete connection;
+        pool->addresses.clear();
+        *error = HttpClient::ERROR_FAIL_TO_CONNECT_SERVER;
+        return NULL;
+    }
+    pool->connections.insert(connection);
+    return connection;
+}
+
+void AsyncHttpClient::Dispatch(HostPool* pool, PendingRequest* request) {
+    if (!pool->idle_connections.empty()) {
+        Connection* connection = pool->idle_connections.back();
+        pool->idle_connections.pop_back();
+        connection->Send(request);
+        return;
+    }
+    if (pool->connections.size() >= m_max_connections_per_host) {
+        pool->waiting_requests.push_back(request);
+        return;
+    }
+    if (pool->addresses.empty()) {
+        pool->waiting_requests.push_back(request);
+        Resolve(pool);
+        return;
+    }
+    ErrorCode error = HttpClient::SUCCESS;
+    Connection* connection = NewConnection(pool, &error);
+    if (connection == NULL) {
+        Finish(request, error, NULL);
+        return;
+    }
+    connection->Send(request);
+}
+
+void AsyncHttpClient::DispatchWaitingRequests(HostPool* pool) {
+    while (!pool->waiting_requests.empty() &&
+           (!pool->idle_connections.empty() ||
+            pool->connections.size() < m_max_connections_per_host)) {
+        if (pool->idle_connections.empty() && pool->addresses.empty()) {
+            Resolve(pool);
+            return;
+        }
+        PendingRequest* request = pool->waiting_requests.front();
+        pool->waiting_requests.pop_front();
+        Dispatch(pool, request);
+    }
+}
+
+void AsyncHttpClient::Resolve(HostPool* pool) {
+    if (pool->resolving)
+        return;
+    // Ip addresses need no resolving.
+    IpAddress ip_address;
+    if (ip_address.Assign(pool->host)) {
+        pool->addresses.push_back(SocketAddressInet4(ip_address, pool->port));
+        DispatchWaitingRequests(pool);
+        return;
+    }
+    pool->resolving = true;
+    ResolverThreadPool()->AddTask(std::bind(&AsyncHttpClient::ResolveInBackground,
+                                            m_resolve_context, pool, pool->host));
+}
+
+void AsyncHttpClient::ResolveInBackground(const std::shared_ptr<ResolveContext>& context,
+                                          HostPool* pool, const std::string& host) {
+    std::vector<IpAddress> ip_addresses;
+    int error_code;
+    if (!DomainResolver::ResolveIpAddress(host, &ip_addresses, &error_code)) {
+        VLOG(3) << "Can't resolve " << host << ": "
+                << DomainResolver::ErrorString(error_code);
+        ip_addresses.clear();
+    }
+    // The dispatcher outlives the client, and is only touched before the
+    // client is deleted.
+    MutexLocker locker(&context->mutex);
+    if (context->client != NULL) {
+        context->client->m_dispatcher->Post(std::bind(&AsyncHttpClient::RunResolvedTask,
+                                                      context, pool, ip_addresses));
+    }
+}
+
+void AsyncHttpClient::RunResolvedTask(const std::shared_ptr<ResolveContext>& context,
+                                      HostPool* pool,
+                                      const std::vector<IpAddress>& ip_addresses) {
+    // Run in the dispatcher thread, where the client is deleted.
+    if (context->client != NULL)
+        context->client->OnResolved(pool, ip_addresses);
+}
+
+void AsyncHttpClient::OnResolved(HostPool* pool, const std::vector<IpAddress>& ip_addresses) {
+    pool->resolving = false;
+    for (size_t i = 0; i < ip_addresses.size(); ++i)
+        pool->addresses.push_back(SocketAddressInet4(ip_addresses[i], pool->port));
+    if (!pool->addresses.empty()) {
+        DispatchWaitingRequests(pool);
+        return;
+    }
+    // Requests which would have new connections fail, others wait for the
+    // busy connections.
+    std::vector<PendingRequest*> failed_requests;
+    while (!pool->waiting_requests.empty() &&
+           pool->connections.size() + failed_requests.size() < m_max_connections_per_host) {
+        failed_requests.push_back(pool->waiting_requests.front());
+        pool->waiting_requests.pop_front();
+    }
+    for (size_t i = 0; i < failed_requests.size(); ++i)
+        Finish(failed_requests[i], HttpClient::ERROR_FAIL_TO_RESOLVE_ADDRESS, NULL);
+}
+
+void AsyncHttpClient::ReleaseConnection(Connection* connection) {
+    HostPool* pool = connection->Pool();
+    std::vector<Connection*>::iterator i = std::find(
+        pool->idle_connections.begin(), pool->idle_connections.end(), connection);
+    if (i != pool->idle_connections.end())
+        pool->idle_connections.erase(i);
+    pool->connections.erase(connection);
+    delete connection;
+}
+
+void AsyncHttpClient::Finish(PendingRequest* request, ErrorCode error,
+                             HttpResponse* response) {
+    --m_pending_request_count;
+    Callback callback;
+    std::swap(callback, request->callback);
+    delete request;
+    HttpResponse empty_response;
+    callback(error, response != NULL ? response : &empty_response);
+}
+
+void AsyncHttpClient::OnResponse(Connection* connection, bool keep_alive) {
+    PendingRequest* request = connection->DetachRequest();
+    HostPool* pool = connection->Pool();
+    HttpResponse response;
+    response.Swap(connection->MutableResponse());
+    if (keep_alive) {
+        connection->SetIdle();
+        pool->idle_connections.push_back(connection);
+    } else {
+        ReleaseConnection(connection);
+    }
+    DispatchWaitingRequests(pool);
+    ErrorCode error = response.Status() == HttpResponse::Status_OK ?
+        HttpClient::SUCCESS : HttpClient::ERROR_HTTP_STATUS_CODE;
+    Finish(request, error, &response);
+}
+
+void AsyncHttpClient::OnConnectionClosed(Connection* connection, ErrorCode error) {
+    PendingRequest* request = connection->DetachRequest();
+    HostPool* pool = connection->Pool();
+    bool retry = request != NULL && !request->retried && connection->IsReused() &&
+        !connection->HasReceived();
+    if (error == HttpClient::ERROR_FAIL_TO_CONNECT_SERVER)
+        pool->addresses.clear();
+    ReleaseConnection(connection);
+    if (retry) {
+        VLOG(3) << "Retry request on a new connection to " << pool->host;
+        request->retried = true;
+        pool->waiting_requests.push_front(request);
+    }
+    DispatchWaitingRequests(pool);
+    if (request != NULL && !retry)
+        Finish(request, error, NULL);
+}
+
+void AsyncHttpClient::OnTimeout(PendingRequest* request) {
+    HostPool* pool = request->pool;
+    if (request->connection != NULL) {
+        Connection* connection = request->connection;
+        connection->DetachRequest();
+        ReleaseConnection(connection);
+        DispatchWaitingRequests(pool);
+    } else {
+        pool->waiting_requests.remove(request);
+    }
+    // Called by the timer, which is deleted after returning.
+    m_fired_timer.reset(request->timer.release());
+    Finish(request, HttpClient::ERROR_TIMEOUT, NULL);
+}
+
+} // namespace toft
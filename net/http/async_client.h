@@ -0,0 +1,131 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_NET_HTTP_ASYNC_CLIENT_H
+#define TOFT_NET_HTTP_ASYNC_CLIENT_H
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/shared_ptr.h"
+#include "toft/base/uncopyable.h"
+#include "toft/net/http/client.h"
+#include "toft/net/http/request.h"
+#include "toft/net/http/response.h"
+
+namespace toft {
+
+class EventDispatcher;
+class IpAddress;
+class TimerEventWatcher;
+
+// Event driven http client. Requests to a host are sent on a pool of
+// keep-alive connections, many requests are in flight at the same time, and
+// results are delivered to callbacks.
+//
+// It is not thread safe: all methods must be called in the thread running
+// the dispatcher, where the callbacks are called too. Host names are
+// resolved in background threads shared by all clients, never blocking the
+// dispatcher.
+class AsyncHttpClient {
+    TOFT_DECLARE_UNCOPYABLE(AsyncHttpClient);
+
+public:
+    typedef HttpClient::ErrorCode ErrorCode;
+    typedef HttpClient::Options Options;
+
+    // response is only valid in the callback. It is also filled for
+    // ERROR_HTTP_STATUS_CODE, like HttpClient.
+    typedef std::function<void (ErrorCode error, HttpResponse* response)> Callback;
+
+    static const size_t kDefaultMaxConnectionsPerHost = 8;
+
+    explicit AsyncHttpClient(EventDispatcher* dispatcher);
+    // Pending requests are dropped without callbacks.
+    ~AsyncHttpClient();
+
+    AsyncHttpClient& SetProxy(const std::string& proxy);
+    const std::string& Proxy() const { return m_proxy; }
+
+    AsyncHttpClient& SetUserAgent(const std::string& user_agent);
+    const std::string& UserAgent() const { return m_user_agent; }
+
+    // More requests to a host wait for a connection to be free.
+    AsyncHttpClient& SetMaxConnectionsPerHost(size_t count);
+
+    // Requests not finished in time fail with ERROR_TIMEOUT, 0 means never.
+    AsyncHttpClient& SetTimeout(int64_t timeout_ms);
+
+    // Failures detected at once, such as invalid url, are also called back
+    // before these methods return.
+    void Get(const std::string& url, const Callback& callback);
+    void Get(const std::string& url, const Options& options, const Callback& callback);
+    void Post(const std::string& url, const std::string& data, const Callback& callback);
+    void Post(const std::string& url, const std::string& data,
+              const Options& options, const Callback& callback);
+    void Request(HttpRequest::MethodType method,
+                 const std::string& url,
+                 const std::string& data,
+                 const Options& options,
+                 const Callback& callback);
+
+    void CloseIdleConnections();
+
+    // Number of requests not called back yet.
+    size_t PendingRequestCount() const { return m_pending_request_count; }
+    // Number of open connections, busy or idle.
+    size_t ConnectionCount() const;
+
+private:
+    class Connection;
+    struct HostPool;
+    struct PendingRequest;
+    struct ResolveContext;
+    friend class Connection;
+
+    HostPool* GetHostPool(const std::string& host, uint16_t port);
+    Connection* NewConnection(HostPool* pool, ErrorCode* error);
+    void Dispatch(HostPool* pool, PendingRequest* request);
+    void DispatchWaitingRequests(HostPool* pool);
+    // Resolve the host of pool if not yet, waiting requests are dispatched
+    // when it is done.
+    void Resolve(HostPool* pool);
+    static void ResolveInBackground(const std::shared_ptr<ResolveContext>& context,
+                                    HostPool* pool, const std::string& host);
+    static void RunResolvedTask(const std::shared_ptr<ResolveContext>& context,
+                                HostPool* pool,
+                                const std::vector<IpAddress>& ip_addresses);
+    void OnResolved(HostPool* pool, const std::vector<IpAddress>& ip_addresses);
+    void ReleaseConnection(Connection* connection);
+    void Finish(PendingRequest* request, ErrorCode error, HttpResponse* response);
+
+    // Called by connections as their last action, the connection may be
+    // deleted in them.
+    void OnResponse(Connection* connection, bool keep_alive);
+    void OnConnectionClosed(Connection* connection, ErrorCode error);
+    void OnTimeout(PendingRequest* request);
+
+private:
+    EventDispatcher* m_dispatcher;
+    std::string m_proxy;
+    std::string m_user_agent;
+    size_t m_max_connections_per_host;
+    int64_t m_timeout;
+    // Keyed by "host:port".
+    std::map<std::string, HostPool*> m_host_pools;
+    size_t m_pending_request_count;
+    // Shared with resolving tasks, which may outlive the client.
+    std::shared_ptr<ResolveContext> m_resolve_context;
+    // Timer of the last timeout, deleted after its callback returns.
+    scoped_ptr<TimerEventWatcher> m_fired_timer;
+};
+
+} // namespace toft
+
+#endif // TOFT_NET_HTTP_ASYNC_CLIENT_H
@@ -0,0 +1,320 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/net/http/async_client.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/number.h"
+#include "toft/net/http/server/handler.h"
+#include "toft/net/http/server/server.h"
+#include "toft/system/event_dispatcher/event_dispatcher.h"
+#include "toft/system/net/socket.h"
+#include "toft/system/threading/thread.h"
+
+#include "thirdparty/glog/logging.h"
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+class EchoHandler : public HttpHandler {
+public:
+    virtual void HandleGet(const HttpRequest* req, HttpResponse* resp) {
+        resp->SetBody("GET " + req->Uri());
+    }
+    virtual void HandlePost(const HttpRequest* req, HttpResponse* resp) {
+        resp->SetBody("POST " + req->Uri() + " " + req->Body());
+    }
+};
+
+// Serve connections one by one with a canned response for every request.
+class RawServer {
+public:
+    RawServer(const std::string& response, bool close_after_response)
+        : m_response(response), m_close_after_response(close_after_response),
+          m_listener(SocketAddressInet4("127.0.0.1", 0)) {
+        CHECK(m_listener.Listen());
+        CHECK(m_listener.GetLocalAddress(&m_address));
+    }
+
+    // Accept count connections.
+    void Serve(int count) {
+        m_thread.reset(new Thread(std::bind(&RawServer::Run, this, count)));
+    }
+
+    ~RawServer() {
+        if (m_thread != NULL)
+            m_thread->Join();
+    }
+
+    std::string Url(const std::string& path) const {
+        return "http://" + m_address.ToString() + path;
+    }
+
+private:
+    void Run(int count) {
+        for (int i = 0; i < count; ++i) {
+            StreamSocket socket;
+            if (!m_listener.Accept(&socket))
+                return;
+            std::string request;
+            for (;;) {
+                char buffer[4096];
+                size_t received_size;
+                if (!socket.Receive(buffer, sizeof(buffer), &received_size))
+                    break;
+                request.append(buffer, received_size);
+                size_t end = request.find("\r\n\r\n");
+                if (end == std::string::npos)
+                    continue;
+                request.erase(0, end + 4);
+                if (!m_response.empty())
+                    socket.SendAll(m_response.data(), m_response.size());
+                if (m_close_after_response)
+                    break;
+            }
+        }
+    }
+
+    std::string m_response;
+    bool m_close_after_response;
+    ListenerSocket m_listener;
+    SocketAddressInet4 m_address;
+    scoped_ptr<Thread> m_thread;
+};
+
+struct Result {
+    AsyncHttpClient::ErrorCode error;
+    int status;
+    std::string body;
+    bool operator<(const Result& other) const {
+        return body < other.body;
+    }
+};
+
+class AsyncHttpClientTest : public testing::Test {
+protected:
+    AsyncHttpClientTest() : m_client(&m_dispatcher), m_remaining(0) {
+        m_client.SetTimeout(10000);
+    }
+
+    void StartServer() {
+        m_server.RegisterHttpHandler("/echo", &m_handler);
+        ASSERT_TRUE(m_server.Bind(SocketAddressInet4("127.0.0.1", 0), &m_address));
+        ASSERT_TRUE(m_server.Start());
+        m_server_thread.reset(new Thread(std::bind(&HttpServer::Run, &m_server)));
+    }
+
+    virtual void TearDown() {
+        if (m_server_thread != NULL) {
+            m_server.Close();
+            m_server_thread->Join();
+        }
+    }
+
+    std::string Url(const std::string& path) const {
+        return "http://" + m_address.ToString() + path;
+    }
+
+    AsyncHttpClient::Callback Callback() {
+        ++m_remaining;
+        return std::bind(&AsyncHttpClientTest::OnResponse, this,
+                         std::placeholders::_1, std::placeholders::_2);
+    }
+
+    void OnResponse(AsyncHttpClient::ErrorCode error, HttpResponse* response) {
+        Result result;
+        result.error = error;
+        result.status = response->Status();
+        result.body = response->Body();
+        m_results.push_back(result);
+        if (--m_remaining == 0)
+            m_dispatcher.Break();
+    }
+
+    void Wait() {
+        if (m_remaining > 0)
+            m_dispatcher.Run();
+        EXPECT_EQ(0U, m_client.PendingRequestCount());
+    }
+
+    EventDispatcher m_dispatcher;
+    AsyncHttpClient m_client;
+    int m_remaining;
+    std::vector<Result> m_results;
+
+    EchoHandler m_handler;
+    HttpServer m_server;
+    SocketAddressInet4 m_address;
+    scoped_ptr<Thread> m_server_thread;
+};
+
+TEST_F(AsyncHttpClientTest, KeepAlive) {
+    StartServer();
+    m_client.Get(Url("/echo/1"), Callback());
+    Wait();
+    m_client.Post(Url("/echo/2"), "hello", Callback());
+    Wait();
+    ASSERT_EQ(2U, m_results.size());
+    EXPECT_EQ(HttpClient::SUCCESS, m_results[0].error);
+    EXPECT_EQ("GET /echo/1", m_results[0].body);
+    EXPECT_EQ(HttpClient::SUCCESS, m_results[1].error);
+    EXPECT_EQ("POST /echo/2 hello", m_results[1].body);
+    // The same connection is used.
+    EXPECT_EQ(1U, m_client.ConnectionCount());
+}
+
+TEST_F(AsyncHttpClientTest, Pool) {
+    StartServer();
+    m_client.SetMaxConnectionsPerHost(4);
+    std::vector<Result> expected;
+    for (int i = 0; i < 100; ++i) {
+        std::string path = "/echo/" + IntegerToString(i);
+        m_client.Get(Url(path), Callback());
+        Result result;
+        result.error = HttpClient::SUCCESS;
+        result.status = HttpResponse::Status_OK;
+        result.body = "GET " + path;
+        expected.push_back(result);
+    }
+    EXPECT_EQ(4U, m_client.ConnectionCount());
+    EXPECT_EQ(100U, m_client.PendingRequestCount());
+    Wait();
+    EXPECT_EQ(4U, m_client.ConnectionCount());
+
+    ASSERT_EQ(expected.size(), m_results.size());
+    std::sort(expected.begin(), expected.end());
+    std::sort(m_results.begin(), m_results.end());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].error, m_results[i].error);
+        EXPECT_EQ(expected[i].status, m_results[i].status);
+        EXPECT_EQ(expected[i].body, m_results[i].body);
+    }
+}
+
+TEST_F(AsyncHttpClientTest, Errors) {
+    StartServer();
+    m_client.Get("http://-www.qq.com", Callback());
+    EXPECT_EQ(0, m_remaining);
+    m_client.Get("ftp://127.0.0.1/", Callback());
+    EXPECT_EQ(0, m_remaining);
+    m_client.Get(Url("/missing"), Callback());
+    m_client.Get("http://127.0.0.1:8/", Callback());
+    Wait();
+    ASSERT_EQ(4U, m_results.size());
+    EXPECT_EQ(HttpClient::ERROR_INVALID_URI_ADDRESS, m_results[0].error);
+    EXPECT_EQ(HttpClient::ERROR_PROTOCAL_NOT_SUPPORTED, m_results[1].error);
+    // The last two are finished in any order.
+    if (m_results[2].error != HttpClient::ERROR_HTTP_STATUS_CODE)
+        std::swap(m_results[2], m_results[3]);
+    EXPECT_EQ(HttpClient::ERROR_HTTP_STATUS_CODE, m_results[2].error);
+    EXPECT_EQ(HttpResponse::Status_NotFound, m_results[2].status);
+    EXPECT_EQ(HttpClient::ERROR_FAIL_TO_CONNECT_SERVER, m_results[3].error);
+}
+
+TEST_F(AsyncHttpClientTest, Resolve) {
+    StartServer();
+    // Host names are resolved in background, and the requests are called
+    // back in the dispatcher.
+    std::string url = "http://localhost:" + IntegerToString(m_address.GetPort()) + "/echo/1";
+    m_client.Get(url, Callback());
+    m_client.Get(url, Callback());
+    m_client.Get("http://nonexistent.invalid/", Callback());
+    EXPECT_EQ(3, m_remaining);
+    Wait();
+    ASSERT_EQ(3U, m_results.size());
+    std::sort(m_results.begin(), m_results.end());
+    EXPECT_EQ(HttpClient::ERROR_FAIL_TO_RESOLVE_ADDRESS, m_results[0].error);
+    for (size_t i = 1; i < m_results.size(); ++i) {
+        EXPECT_EQ(HttpClient::SUCCESS, m_results[i].error);
+        EXPECT_EQ("GET /echo/1", m_results[i].body);
+    }
+
+    // Results of resolving after the client is deleted are dropped.
+    scoped_ptr<AsyncHttpClient> client(new AsyncHttpClient(&m_dispatcher));
+    client->Get("http://nonexistent.invalid/", Callback());
+    client.reset();
+    --m_remaining;
+}
+
+TEST_F(AsyncHttpClientTest, Chunked) {
+    RawServer server("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                     "5\r\nhello\r\n7;name=value\r\n, world\r\n0\r\nX-Trailer: 1\r\n\r\n",
+                     false);
+    server.Serve(1);
+    m_client.Get(server.Url("/"), Callback());
+    Wait();
+    m_client.Get(server.Url("/"), Callback());
+    Wait();
+    ASSERT_EQ(2U, m_results.size());
+    for (size_t i = 0; i < m_results.size(); ++i) {
+        EXPECT_EQ(HttpClient::SUCCESS, m_results[i].error);
+        EXPECT_EQ("hello, world", m_results[i].body);
+    }
+    EXPECT_EQ(1U, m_client.ConnectionCount());
+    m_client.CloseIdleConnections();
+    EXPECT_EQ(0U, m_client.ConnectionCount());
+}
+
+TEST_F(AsyncHttpClientTest, UntilClose) {
+    std::string body(100000, 'x');
+    RawServer server("HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n\r\n" + body, true);
+    server.Serve(2);
+    m_client.Get(server.Url("/"), Callback());
+    Wait();
+    m_client.Get(server.Url("/"), Callback());
+    Wait();
+    ASSERT_EQ(2U, m_results.size());
+    for (size_t i = 0; i < m_results.size(); ++i) {
+        EXPECT_EQ(HttpClient::SUCCESS, m_results[i].error);
+        EXPECT_TRUE(body == m_results[i].body);
+    }
+    EXPECT_EQ(0U, m_client.ConnectionCount());
+}
+
+TEST_F(AsyncHttpClientTest, ServerClosesIdleConnection) {
+    RawServer server("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok", true);
+    server.Serve(3);
+    // The second request is sent on the closed connection if the close is
+    // not found yet, and is tried again on a new connection.
+    for (int i = 0; i < 3; ++i) {
+        m_client.Get(server.Url("/"), Callback());
+        Wait();
+    }
+    ASSERT_EQ(3U, m_results.size());
+    for (size_t i = 0; i < m_results.size(); ++i) {
+        EXPECT_EQ(HttpClient::SUCCESS, m_results[i].error);
+        EXPECT_EQ("ok", m_results[i].body);
+    }
+    m_client.CloseIdleConnections();
+}
+
+TEST_F(AsyncHttpClientTest, MaxResponseLength) {
+    StartServer();
+    HttpClient::Options options;
+    options.SetMaxResponseLength(100);
+    m_client.Get(Url("/echo/" + std::string(100, 'x')), options, Callback());
+    m_client.Get(Url("/echo/1"), options, Callback());
+    Wait();
+    ASSERT_EQ(2U, m_results.size());
+    std::sort(m_results.begin(), m_results.end());
+    EXPECT_EQ(HttpClient::ERROR_FAIL_TO_GET_RESPONSE, m_results[0].error);
+    EXPECT_EQ(HttpClient::SUCCESS, m_results[1].error);
+}
+
+TEST_F(AsyncHttpClientTest, Timeout) {
+    RawServer server("", false);
+    server.Serve(1);
+    m_client.SetTimeout(100);
+    m_client.Get(server.Url("/"), Callback());
+    Wait();
+    ASSERT_EQ(1U, m_results.size());
+    EXPECT_EQ(HttpClient::ERROR_TIMEOUT, m_results[0].error);
+    EXPECT_EQ(0U, m_client.ConnectionCount());
+}
+
+} // namespace toft
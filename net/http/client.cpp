@@ -424,6 +424,8 @@ const char* HttpClient::GetErrorMessage(ErrorCode error_code)
         return "Error http status code";
     case ERROR_TOO_MANY_REDIRECTS:
         return "Too many redirections";
+    case ERROR_TIMEOUT:
+        return "Timeout";
     // DO NOT ADD default: here, or not handled error_code will be ignored.
     }
 
@@ -37,6 +37,7 @@ public:
         ERROR_CONTENT_TYPE_NOT_SUPPORTED,
         ERROR_HTTP_STATUS_CODE, // such as HTTP 404
         ERROR_TOO_MANY_REDIRECTS, // TODO(chen3feng): support redirection
+        ERROR_TIMEOUT,
     };
 
     // query error message from error code
@@ -0,0 +1,53 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/net/http/framing.h"
+#include "toft/encoding/ascii.h"
+
+namespace toft {
+
+size_t FindHeaderEnd(const StringPiece& data, size_t searched_size) {
+    size_t start = searched_size > 3 ? searched_size - 3 : 0;
+    size_t header_size = StringPiece::npos;
+    size_t pos = data.find("\r\n\r\n", start);
+    if (pos != StringPiece::npos)
+        header_size = pos + 4;
+    pos = data.find("\n\n", start);
+    if (pos != StringPiece::npos && pos + 2 < header_size)
+        header_size = pos + 2;
+    return header_size;
+}
+
+int MatchLineEnding(const StringPiece& data) {
+    if (data.empty())
+        return 0;
+    if (data[0] == '\n')
+        return 1;
+    if (data[0] != '\r')
+        return -1;
+    if (data.size() < 2)
+        return 0;
+    return data[1] == '\n' ? 2 : -1;
+}
+
+bool ParseChunkSizeLine(const StringPiece& line, size_t max_size, size_t* chunk_size) {
+    size_t size = 0;
+    size_t i = 0;
+    for (; i < line.size() && Ascii::IsHexDigit(line[i]); ++i) {
+        int digit = Ascii::IsDigit(line[i]) ? line[i] - '0' :
+            Ascii::ToLower(line[i]) - 'a' + 10;
+        size = size * 16 + digit;
+        if (size > max_size) {
+            *chunk_size = max_size + 1;
+            return true;
+        }
+    }
+    if (i == 0 || (i < line.size() && line[i] != ';' && line[i] != ' ' &&
+                   line[i] != '\t')) {
+        return false;
+    }
+    *chunk_size = size;
+    return true;
+}
+
+} // namespace toft
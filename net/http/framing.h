@@ -0,0 +1,35 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Framing of HTTP/1.1 messages, shared by the request parser of the server
+// and the response reader of AsyncHttpClient. Lines may end with CRLF or a
+// bare LF.
+
+#ifndef TOFT_NET_HTTP_FRAMING_H
+#define TOFT_NET_HTTP_FRAMING_H
+#pragma once
+
+#include <stddef.h>
+#include "toft/base/string/string_piece.h"
+
+namespace toft {
+
+// Size of the headers up to the empty line ending them, or StringPiece::npos
+// if it's not received yet. The first searched_size bytes were searched
+// before without the end, they are not searched again except the last 3,
+// which the end may span.
+size_t FindHeaderEnd(const StringPiece& data, size_t searched_size);
+
+// Size of the line ending at the beginning of data, such as the one after
+// chunk data: 2 of CRLF, 1 of LF, 0 if more data are needed, or -1 if it's
+// not a line ending.
+int MatchLineEnding(const StringPiece& data);
+
+// Parse the line of a chunk size without its line ending, chunk extensions
+// after the size are ignored. Return false if it's invalid. A size larger
+// than max_size is returned as max_size + 1.
+bool ParseChunkSizeLine(const StringPiece& line, size_t max_size, size_t* chunk_size);
+
+} // namespace toft
+
+#endif // TOFT_NET_HTTP_FRAMING_H
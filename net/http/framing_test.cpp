@@ -0,0 +1,68 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/net/http/framing.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+TEST(HttpFraming, FindHeaderEnd) {
+    EXPECT_EQ(StringPiece::npos, FindHeaderEnd("", 0));
+    EXPECT_EQ(StringPiece::npos, FindHeaderEnd("Host: a\r\n", 0));
+    EXPECT_EQ(11U, FindHeaderEnd("Host: a\r\n\r\nbody", 0));
+    EXPECT_EQ(9U, FindHeaderEnd("Host: a\n\nbody", 0));
+    // The first end wins.
+    EXPECT_EQ(9U, FindHeaderEnd("Host: a\n\nbody\r\n\r\n", 0));
+}
+
+TEST(HttpFraming, FindHeaderEndSpanningSearchedData) {
+    StringPiece data = "Host: a\r\n\r\n";
+    // "Host: a\r\n\r" was searched before.
+    EXPECT_EQ(11U, FindHeaderEnd(data, 10));
+    EXPECT_EQ(11U, FindHeaderEnd(data, 8));
+    EXPECT_EQ(StringPiece::npos, FindHeaderEnd("Host: a\r\n\r", 9));
+}
+
+TEST(HttpFraming, MatchLineEnding) {
+    EXPECT_EQ(0, MatchLineEnding(""));
+    EXPECT_EQ(0, MatchLineEnding("\r"));
+    EXPECT_EQ(2, MatchLineEnding("\r\n"));
+    EXPECT_EQ(2, MatchLineEnding("\r\nmore"));
+    EXPECT_EQ(1, MatchLineEnding("\nmore"));
+    EXPECT_EQ(-1, MatchLineEnding("x\r\n"));
+    EXPECT_EQ(-1, MatchLineEnding("\rx"));
+}
+
+TEST(HttpFraming, ParseChunkSizeLine) {
+    size_t size = 0;
+    EXPECT_TRUE(ParseChunkSizeLine("0", 100, &size));
+    EXPECT_EQ(0U, size);
+    EXPECT_TRUE(ParseChunkSizeLine("1a", 100, &size));
+    EXPECT_EQ(26U, size);
+    EXPECT_TRUE(ParseChunkSizeLine("1A;name=value", 100, &size));
+    EXPECT_EQ(26U, size);
+    EXPECT_TRUE(ParseChunkSizeLine("a \t", 100, &size));
+    EXPECT_EQ(10U, size);
+}
+
+TEST(HttpFraming, ParseInvalidChunkSizeLine) {
+    size_t size = 0;
+    EXPECT_FALSE(ParseChunkSizeLine("", 100, &size));
+    EXPECT_FALSE(ParseChunkSizeLine(";name", 100, &size));
+    EXPECT_FALSE(ParseChunkSizeLine("xyz", 100, &size));
+    EXPECT_FALSE(ParseChunkSizeLine("1g", 100, &size));
+}
+
+TEST(HttpFraming, ParseTooLargeChunkSize) {
+    size_t size = 0;
+    EXPECT_TRUE(ParseChunkSizeLine("64", 100, &size));
+    EXPECT_EQ(100U, size);
+    EXPECT_TRUE(ParseChunkSizeLine("65", 100, &size));
+    EXPECT_EQ(101U, size);
+    // Overflow is stopped by the limit.
+    EXPECT_TRUE(ParseChunkSizeLine("ffffffffffffffffffffffff", 100, &size));
+    EXPECT_EQ(101U, size);
+}
+
+} // namespace toft
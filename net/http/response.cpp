@@ -154,6 +154,9 @@ void HttpResponse::FillWithHtmlPage(StatusCode code, const StringPiece& title,
 void HttpResponse::Reset() {
     HttpMessage::Reset();
     m_status = Status_None;
+    m_body_file.reset();
+    m_body_file_offset = 0;
+    m_body_file_size = 0;
 }
 
 } // namespace toft
@@ -9,12 +9,16 @@
 #define TOFT_NET_HTTP_RESPONSE_H
 #pragma once
 
+#include <stdint.h>
 #include <algorithm>
 #include <string>
+#include "toft/base/shared_ptr.h"
 #include "toft/net/http/message.h"
 
 namespace toft {
 
+class LocalFile;
+
 // Describes a http response.
 class HttpResponse : public HttpMessage {
 public:
@@ -72,7 +76,8 @@ public:
                           const StringPiece& body = "");
 
 public:
-    HttpResponse() : m_status(Status_None) {}
+    HttpResponse()
+        : m_status(Status_None), m_body_file_offset(0), m_body_file_size(0) {}
     ~HttpResponse() {}
     virtual void Reset();
 
@@ -89,10 +94,26 @@ public:
 
     static const char* StatusCodeToDescription(StatusCode status_code);
 
+    // Send size bytes of file from offset as the body instead of Body(),
+    // HttpServer sends it by sendfile without copying. It is not included
+    // in ToString.
+    void SetBodyFile(const std::shared_ptr<LocalFile>& file,
+                     int64_t offset, int64_t size) {
+        m_body_file = file;
+        m_body_file_offset = offset;
+        m_body_file_size = size;
+    }
+    const std::shared_ptr<LocalFile>& BodyFile() const { return m_body_file; }
+    int64_t BodyFileOffset() const { return m_body_file_offset; }
+    int64_t BodyFileSize() const { return m_body_file_size; }
+
     void Swap(HttpResponse* other) {
         HttpMessage::Swap(other);
         using std::swap;
         swap(m_status, other->m_status);
+        m_body_file.swap(other->m_body_file);
+        swap(m_body_file_offset, other->m_body_file_offset);
+        swap(m_body_file_size, other->m_body_file_size);
     }
 
 private:
@@ -103,6 +124,9 @@ private:
     bool ParseStatusCode(StringPiece status);
 
     StatusCode m_status;
+    std::shared_ptr<LocalFile> m_body_file;
+    int64_t m_body_file_offset;
+    int64_t m_body_file_size;
 };
 
 } // namespace toft
@@ -0,0 +1,211 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/net/http/server/buffer_chain.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "toft/storage/file/local_file.h"
+
+#include "thirdparty/glog/logging.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+namespace toft {
+
+// Size of buffers allocated for copied data.
+static const size_t kBufferSize = 4096;
+
+// Strings shorter than it are copied rather than taken.
+static const size_t kMinTakeSize = 512;
+
+// Bytes written by one sendfile.
+static const int64_t kMaxSendFileSize = 0x7ffff000;
+
+BufferChain::BufferChain() : m_size(0) {
+}
+
+BufferChain::~BufferChain() {
+}
+
+void BufferChain::Append(const StringPiece& data) {
+    if (data.empty())
+        return;
+    m_size += data.size();
+    if (!m_segments.empty()) {
+        Segment& tail = m_segments.back();
+        std::string* buffer = tail.buffer.get();
+        // Append in place if the buffer is not shared and has enough room.
+        if (buffer != NULL && tail.buffer.unique() &&
+            tail.offset + tail.size == static_cast<int64_t>(buffer->size()) &&
+            buffer->capacity() - buffer->size() >= data.size()) {
+            data.append_to_string(buffer);
+            tail.size += data.size();
+            return;
+        }
+    }
+    Segment segment;
+    segment.buffer.reset(new std::string());
+    segment.buffer->reserve(std::max(kBufferSize, data.size()));
+    data.append_to_string(segment.buffer.get());
+    segment.size = data.size();
+    m_segments.push_back(segment);
+}
+
+void BufferChain::Append(std::string* data) {
+    if (data->size() < kMinTakeSize) {
+        Append(StringPiece(*data));
+        data->clear();
+        return;
+    }
+    Segment segment;
+    segment.buffer.reset(new std::string());
+    segment.buffer->swap(*data);
+    segment.size = segment.buffer->size();
+    m_size += segment.size;
+    m_segments.push_back(segment);
+}
+
+void BufferChain::Append(const BufferChain& other) {
+    CHECK_NE(this, &other);
+    m_segments.insert(m_segments.end(), other.m_segments.begin(), other.m_segments.end());
+    m_size += other.m_size;
+}
+
+void BufferChain::AppendFile(const std::shared_ptr<LocalFile>& file,
+                             int64_t offset, int64_t size) {
+    if (size <= 0)
+        return;
+    Segment segment;
+    segment.file = file;
+    segment.offset = offset;
+    segment.size = size;
+    m_size += size;
+    m_segments.push_back(segment);
+}
+
+void BufferChain::Consume(int64_t size) {
+    CHECK_LE(size, m_size);
+    m_size -= size;
+    while (size > 0) {
+        Segment& head = m_segments.front();
+        if (size < head.size) {
+            head.offset += size;
+            head.size -= size;
+            return;
+        }
+        size -= head.size;
+        m_segments.pop_front();
+    }
+}
+
+void BufferChain::Clear() {
+    m_segments.clear();
+    m_size = 0;
+}
+
+bool BufferChain::AppendToString(std::string* result) const {
+    for (size_t i = 0; i < m_segments.size(); ++i) {
+        const Segment& segment = m_segments[i];
+        if (segment.buffer) {
+            result->append(*segment.buffer, segment.offset, segment.size);
+            continue;
+        }
+        size_t old_size = result->size();
+        result->resize(old_size + segment.size);
+        ssize_t n = pread(segment.file->Fileno(), &(*result)[old_size], segment.size,
+                          segment.offset);
+        if (n != segment.size) {
+            result->resize(old_size);
+            return false;
+        }
+    }
+    return true;
+}
+
+ssize_t BufferChain::WriteTo(int fd) {
+    ssize_t total_size = 0;
+    while (!m_segments.empty()) {
+        int64_t expected_size = 0;
+        ssize_t size = m_segments.front().file ? WriteFile(fd, &expected_size) :
+            WriteBuffers(fd, &expected_size);
+        if (size < 0) {
+            if (errno == EINTR)
+                continue;
+            return total_size > 0 ? total_size : -1;
+        }
+        Consume(size);
+        total_size += size;
+        // fd is full.
+        if (size < expected_size)
+            break;
+    }
+    return total_size;
+}
+
+ssize_t BufferChain::WriteBuffers(int fd, int64_t* expected_size) {
+    struct iovec iov[IOV_MAX];
+    size_t count = 0;
+    *expected_size = 0;
+    for (; count < m_segments.size() && count < IOV_MAX; ++count) {
+        const Segment& segment = m_segments[count];
+        if (!segment.buffer)
+            break;
+        iov[count].iov_base = &(*segment.buffer)[segment.offset];
+        iov[count].iov_len = segment.size;
+        *expected_size += segment.size;
+    }
+    struct msghdr message = {};
+    message.msg_iov = iov;
+    message.msg_iovlen = count;
+    int flags = MSG_NOSIGNAL;
+    // Headers followed by a file go in the same packets.
+    if (count < m_segments.size() && m_segments[count].file)
+        flags |= MSG_MORE;
+    return sendmsg(fd, &message, flags);
+}
+
+// sendfile has no MSG_NOSIGNAL, so SIGPIPE is blocked in this thread and the
+// pending one is discarded.
+static ssize_t SendFileNoSignal(int out_fd, int in_fd, off_t* offset, size_t size) {
+    sigset_t pipe_set;
+    sigset_t old_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+    ssize_t result = sendfile(out_fd, in_fd, offset, size);
+    if (result < 0 && errno == EPIPE && !sigismember(&old_set, SIGPIPE)) {
+        struct timespec timeout = { 0, 0 };
+        sigtimedwait(&pipe_set, NULL, &timeout);
+        errno = EPIPE;
+    }
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    return result;
+}
+
+ssize_t BufferChain::WriteFile(int fd, int64_t* expected_size) {
+    const Segment& segment = m_segments.front();
+    off_t offset = segment.offset;
+    *expected_size = std::min(segment.size, kMaxSendFileSize);
+    ssize_t size = SendFileNoSignal(fd, segment.file->Fileno(), &offset, *expected_size);
+    if (size == 0) {
+        // The file is shorter than expected, never finish.
+        LOG(ERROR) << "Unexpected end of file at " << segment.offset;
+        errno = EIO;
+        return -1;
+    }
+    return size;
+}
+
+} // namespace toft
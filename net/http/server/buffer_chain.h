@@ -0,0 +1,81 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_NET_HTTP_SERVER_BUFFER_CHAIN_H
+#define TOFT_NET_HTTP_SERVER_BUFFER_CHAIN_H
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <deque>
+#include <string>
+#include "toft/base/shared_ptr.h"
+#include "toft/base/string/string_piece.h"
+#include "toft/base/uncopyable.h"
+
+namespace toft {
+
+class LocalFile;
+
+// A chain of segments of refcounted buffers or files to be sent.
+//
+// Small data are copied and packed into the tail buffer, large strings are
+// taken without copying, and buffers are shared by chains appended to each
+// other. The chain is written with one sendmsg over up to IOV_MAX segments,
+// and file segments are written by sendfile.
+class BufferChain {
+    TOFT_DECLARE_UNCOPYABLE(BufferChain);
+
+public:
+    BufferChain();
+    ~BufferChain();
+
+    // Copy data into the chain.
+    void Append(const StringPiece& data);
+    // Take the content of *data without copying, *data is cleared.
+    void Append(std::string* data);
+    // Share buffers of other, files are shared too.
+    void Append(const BufferChain& other);
+    // Append size bytes of file from offset. The file is kept open until
+    // the segment is consumed.
+    void AppendFile(const std::shared_ptr<LocalFile>& file,
+                    int64_t offset, int64_t size);
+
+    // Remove size bytes from the front.
+    void Consume(int64_t size);
+    void Clear();
+
+    int64_t Size() const { return m_size; }
+    bool Empty() const { return m_size == 0; }
+    size_t SegmentCount() const { return m_segments.size(); }
+
+    // Data of file segments are read too.
+    bool AppendToString(std::string* result) const;
+
+    // Write to fd until all sent or fd would block, the written data are
+    // consumed. Return the written size, or -1 if nothing written and errno
+    // is set, like write(2). SIGPIPE is not raised.
+    ssize_t WriteTo(int fd);
+
+private:
+    struct Segment {
+        Segment() : offset(0), size(0) {}
+        // One of buffer and file.
+        std::shared_ptr<std::string> buffer;
+        std::shared_ptr<LocalFile> file;
+        int64_t offset;
+        int64_t size;
+    };
+
+    // Write segments in front, expected_size is set to the size tried.
+    ssize_t WriteBuffers(int fd, int64_t* expected_size);
+    ssize_t WriteFile(int fd, int64_t* expected_size);
+
+    std::deque<Segment> m_segments;
+    int64_t m_size;
+};
+
+} // namespace toft
+
+#endif // TOFT_NET_HTTP_SERVER_BUFFER_CHAIN_H
@@ -0,0 +1,166 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/net/http/server/buffer_chain.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+
+#include "toft/storage/file/local_file.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+static std::string ToString(const BufferChain& chain) {
+    std::string result;
+    EXPECT_TRUE(chain.AppendToString(&result));
+    return result;
+}
+
+TEST(BufferChain, Append) {
+    BufferChain chain;
+    EXPECT_TRUE(chain.Empty());
+    chain.Append("hello");
+    chain.Append(", ");
+    // Packed into one buffer.
+    EXPECT_EQ(1U, chain.SegmentCount());
+
+    std::string large(1000, 'x');
+    chain.Append(&large);
+    EXPECT_TRUE(large.empty());
+    EXPECT_EQ(2U, chain.SegmentCount());
+    chain.Append("!");
+    EXPECT_EQ(3U, chain.SegmentCount());
+    EXPECT_EQ(1008, chain.Size());
+    EXPECT_EQ("hello, " + std::string(1000, 'x') + "!", ToString(chain));
+
+    chain.Clear();
+    EXPECT_TRUE(chain.Empty());
+    EXPECT_EQ(0U, chain.SegmentCount());
+}
+
+TEST(BufferChain, Share) {
+    BufferChain a;
+    a.Append("hello");
+    BufferChain b;
+    b.Append(a);
+    b.Append(a);
+    // Shared buffers are not written in place.
+    a.Append(" world");
+    EXPECT_EQ("hello world", ToString(a));
+    EXPECT_EQ("hellohello", ToString(b));
+    a.Clear();
+    EXPECT_EQ("hellohello", ToString(b));
+}
+
+TEST(BufferChain, Consume) {
+    BufferChain chain;
+    std::string large(600, 'a');
+    chain.Append("0123456789");
+    chain.Append(&large);
+    chain.Append("xyz");
+    chain.Consume(5);
+    EXPECT_EQ("56789" + std::string(600, 'a') + "xyz", ToString(chain));
+    chain.Consume(5);
+    EXPECT_EQ(2U, chain.SegmentCount());
+    chain.Consume(601);
+    EXPECT_EQ("yz", ToString(chain));
+    chain.Consume(2);
+    EXPECT_TRUE(chain.Empty());
+    EXPECT_EQ(0U, chain.SegmentCount());
+}
+
+class BufferChainWriteTest : public testing::Test {
+protected:
+    virtual void SetUp() {
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, m_fds));
+        ASSERT_EQ(0, fcntl(m_fds[0], F_SETFL, O_NONBLOCK));
+        ASSERT_EQ(0, fcntl(m_fds[1], F_SETFL, O_NONBLOCK));
+    }
+    virtual void TearDown() {
+        close(m_fds[0]);
+        if (m_fds[1] >= 0)
+            close(m_fds[1]);
+    }
+
+    // Write chain to the socket and read it from the peer, until all sent.
+    std::string Transfer(BufferChain* chain) {
+        std::string result;
+        while (!chain->Empty()) {
+            ssize_t size = chain->WriteTo(m_fds[0]);
+            if (size < 0) {
+                EXPECT_EQ(EAGAIN, errno);
+                if (errno != EAGAIN)
+                    break;
+            }
+            char buffer[65536];
+            ssize_t n;
+            while ((n = read(m_fds[1], buffer, sizeof(buffer))) > 0)
+                result.append(buffer, n);
+        }
+        return result;
+    }
+
+    int m_fds[2];
+};
+
+TEST_F(BufferChainWriteTest, ManySegments) {
+    BufferChain block;
+    block.Append("0123456789");
+    BufferChain chain;
+    std::string expected;
+    // More than IOV_MAX segments.
+    for (int i = 0; i < 3000; ++i) {
+        chain.Append(block);
+        expected += "0123456789";
+    }
+    EXPECT_EQ(3000U, chain.SegmentCount());
+    EXPECT_EQ(expected, Transfer(&chain));
+}
+
+TEST_F(BufferChainWriteTest, Large) {
+    BufferChain chain;
+    std::string expected;
+    for (int i = 0; i < 100; ++i) {
+        std::string data(100000, 'a' + i % 26);
+        expected += data;
+        chain.Append(&data);
+    }
+    EXPECT_EQ(expected, Transfer(&chain));
+}
+
+TEST_F(BufferChainWriteTest, File) {
+    std::string content;
+    for (int i = 0; i < 100000; ++i)
+        content += static_cast<char>('a' + i % 26);
+    const char* path = "buffer_chain_test.dat";
+    FILE* fp = fopen(path, "wb");
+    ASSERT_TRUE(fp != NULL);
+    ASSERT_EQ(content.size(), fwrite(content.data(), 1, content.size(), fp));
+    fclose(fp);
+    std::shared_ptr<LocalFile> file(dynamic_cast<LocalFile*>(File::Open(path, "r")));
+    ASSERT_TRUE(file != NULL);
+    unlink(path);
+
+    BufferChain chain;
+    chain.Append("header\r\n");
+    chain.AppendFile(file, 10, 50000);
+    chain.Append("trailer");
+    chain.AppendFile(file, 0, content.size());
+    EXPECT_EQ("header\r\n" + content.substr(10, 50000) + "trailer" + content,
+              Transfer(&chain));
+
+    // Closed peer.
+    chain.AppendFile(file, 0, content.size());
+    close(m_fds[1]);
+    m_fds[1] = -1;
+    EXPECT_EQ(-1, chain.WriteTo(m_fds[0]));
+    EXPECT_EQ(EPIPE, errno);
+}
+
+} // namespace toft
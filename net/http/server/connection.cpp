@@ -4,104 +4,187 @@
 // Author: CHEN Feng <chen3feng@gmail.com>
 
 #include "toft/net/http/server/connection.h"
+#include <errno.h>
 #include "thirdparty/glog/logging.h"
-#include "toft/base/string/format.h"
 #include "toft/base/string/number.h"
-#include "toft/net/http/request.h"
-#include "toft/net/http/response.h"
+#include "toft/net/http/server/handler.h"
+#include "toft/net/http/server/path_trie.h"
+#include "toft/storage/file/local_file.h"
 
 namespace toft {
 
-HttpConnection::HttpConnection(EventDispatcher* dispatcher, int fd)
+static const size_t kReceiveSize = 65536;
+
+// Stop handling requests when so many response bytes are waiting for the
+// peer to receive.
+static const int64_t kMaxPendingSendSize = 4 * 1024 * 1024;
+
+HttpConnection::HttpConnection(EventDispatcher* dispatcher, int fd,
+                               const PathTrie* handlers,
+                               const ClosedCallback& closed_callback)
     : m_watcher(dispatcher, std::bind(&HttpConnection::OnIoEvents, this,
                                       std::placeholders::_1),
                 fd, EventMask_Read),
-      m_sent_size(0) {
+      m_handlers(handlers),
+      m_closing(false),
+      m_closed(false),
+      m_closed_callback(closed_callback) {
     m_socket.Attach(fd);
     m_watcher.Start();
 }
 
 void HttpConnection::Send(const StringPiece& data) {
-    m_send_queue.push_back(data.as_string());
+    m_send_buffer.Append(data);
 }
 
 void HttpConnection::Close() {
+    m_closing = true;
+    if (!m_closed && OnWriteable())
+        UpdateEvents();
 }
 
 void HttpConnection::OnIoEvents(int events) {
-    LOG(INFO) << "HttpConnection::OnIoEvents";
+    VLOG(3) << "HttpConnection::OnIoEvents " << events;
     if (events & EventMask_Error) {
         LOG(INFO) << "Error";
-        m_watcher.Stop();
+        OnClosed();
         return;
     }
     if (events & EventMask_Read) {
-        LOG(INFO) << "Read";
         if (!OnReadable())
             return;
     }
-    if (events & EventMask_Write) {
-        LOG(INFO) << "Write";
-        if (!OnWriteable())
-            return;
-    }
+    // Also requests left by the limit of pending sends.
+    if (!m_closing)
+        HandleRequests();
+    // Responses of all requests handled in this iteration go in one write.
+    if (!OnWriteable())
+        return;
+    UpdateEvents();
+}
 
-    int new_events = EventMask_Read;
-    if (!m_send_queue.empty())
+void HttpConnection::UpdateEvents() {
+    int64_t pending_size = m_send_buffer.Size();
+    if (m_closing && pending_size == 0) {
+        OnClosed();
+        return;
+    }
+    int new_events = EventMask_None;
+    if (!m_closing && pending_size < kMaxPendingSendSize)
+        new_events |= EventMask_Read;
+    if (pending_size > 0)
         new_events |= EventMask_Write;
     m_watcher.Set(new_events);
 }
 
 bool HttpConnection::OnReadable() {
-    size_t kBufferSize = 65536;
     size_t received_size = m_receive_buffer.size();
-    m_receive_buffer.resize(received_size + kBufferSize);
+    m_receive_buffer.resize(received_size + kReceiveSize);
     char* buf = &m_receive_buffer[received_size];
     size_t new_received_size;
-    if (!m_socket.Receive(buf, kBufferSize, &new_received_size)) {
+    errno = 0;
+    if (!m_socket.Receive(buf, kReceiveSize, &new_received_size)) {
+        m_receive_buffer.resize(received_size);
+        if (new_received_size == 0 && errno != 0 && Socket::IsLastErrorWouldBlock())
+            return true;
         OnClosed();
         return false;
     }
     m_receive_buffer.resize(received_size + new_received_size);
-    LOG(INFO) << m_receive_buffer;
-    HttpRequest request;
-    if (request.ParseHeaders(m_receive_buffer)) {
-        LOG(INFO) << "Request URI: " << request.Uri();
-        HttpResponse response;
-        response.SetStatus(HttpResponse::Status_OK);
-        static int i = 0;
-        std::string body = StringPrint("Hello %d", ++i);
-        response.SetBody(body);
-        response.SetHeader("Content-Length", NumberToString(body.size()));
-        Send(response.ToString());
+    return true;
+}
+
+void HttpConnection::HandleRequests() {
+    size_t start = 0;
+    while (!m_closing && m_send_buffer.Size() < kMaxPendingSendSize) {
+        size_t request_size = 0;
+        HttpRequestParser::Status status = m_parser.Parse(
+            StringPiece(m_receive_buffer).substr(start), &m_request, &request_size);
+        if (status == HttpRequestParser::Status_Incomplete)
+            break;
+        if (status == HttpRequestParser::Status_Error) {
+            VLOG(1) << "Bad request, status " << m_parser.ErrorStatus();
+            SendError(m_parser.ErrorStatus());
+            m_closing = true;
+            break;
+        }
+        start += request_size;
+        m_parser.Reset();
+        HandleRequest();
+    }
+    if (m_closing) {
         m_receive_buffer.clear();
+    } else if (start > 0) {
+        // Positions of the parser are relative to the current request.
+        m_receive_buffer.erase(0, start);
     }
+}
 
-    return true;
+void HttpConnection::HandleRequest() {
+    VLOG(1) << "Request URI: " << m_request.Uri();
+    HttpResponse response;
+    HttpHandler* handler = m_handlers ? m_handlers->Match(m_request.Uri()) : NULL;
+    if (handler != NULL) {
+        handler->HandleRequest(&m_request, &response);
+        if (response.Status() == HttpResponse::Status_None)
+            response.SetStatus(HttpResponse::Status_OK);
+    } else {
+        response.FillWithHtmlPage(HttpResponse::Status_NotFound);
+    }
+
+    if (!m_request.IsKeepAlive() || !response.IsKeepAlive()) {
+        response.SetHeader("Connection", "close");
+        m_closing = true;
+    } else if (m_request.Version() < HttpVersion(1, 1)) {
+        response.SetHeader("Connection", "keep-alive");
+    }
+    SendResponse(&response, m_request.Method() == HttpRequest::METHOD_HEAD);
+}
+
+void HttpConnection::SendResponse(HttpResponse* response, bool head_only) {
+    bool has_file = response->BodyFile() != NULL;
+    if (!response->HasHeader("Content-Length")) {
+        int64_t body_size = has_file ? response->BodyFileSize() :
+            static_cast<int64_t>(response->Body().size());
+        response->SetHeader("Content-Length", NumberToString(body_size));
+    }
+    std::string headers;
+    response->AppendHeadersToString(&headers);
+    m_send_buffer.Append(headers);
+    if (head_only)
+        return;
+    if (has_file) {
+        m_send_buffer.AppendFile(response->BodyFile(), response->BodyFileOffset(),
+                                 response->BodyFileSize());
+    } else {
+        m_send_buffer.Append(response->MutableBody());
+    }
+}
+
+void HttpConnection::SendError(HttpResponse::StatusCode status) {
+    HttpResponse response;
+    response.FillWithHtmlPage(status);
+    response.SetHeader("Connection", "close");
+    SendResponse(&response, false);
 }
 
 bool HttpConnection::OnWriteable() {
-    while (!m_send_queue.empty()) {
-        const std::string& data = m_send_queue.front();
-        size_t data_size = data.size() - m_sent_size;
-        size_t sent_size;
-        if (m_socket.Send(data.data() + m_sent_size, data_size, &sent_size)) {
-            if (sent_size == data_size) {
-                m_send_queue.pop_front();
-                m_sent_size = 0;
-            } else {
-                m_sent_size += sent_size;
-                break;
-            }
-        } else {
-            break;
-        }
+    if (m_send_buffer.Empty())
+        return true;
+    if (m_send_buffer.WriteTo(m_socket.Handle()) < 0 && !Socket::IsLastErrorWouldBlock()) {
+        OnClosed();
+        return false;
     }
     return true;
 }
 
 void HttpConnection::OnClosed() {
+    if (m_closed)
+        return;
+    m_closed = true;
     m_watcher.Stop();
+    if (m_closed_callback)
+        m_closed_callback(this);
 }
 
 } // namespace toft
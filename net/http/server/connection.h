@@ -7,36 +7,66 @@
 #define TOFT_NET_HTTP_SERVER_CONNECTION_H
 #pragma once
 
-#include <list>
 #include <string>
-#include <vector>
+#include "toft/base/functional.h"
 #include "toft/base/string/string_piece.h"
+#include "toft/net/http/request.h"
+#include "toft/net/http/response.h"
+#include "toft/net/http/server/buffer_chain.h"
+#include "toft/net/http/server/request_parser.h"
 #include "toft/system/event_dispatcher/event_dispatcher.h"
 #include "toft/system/net/socket.h"
 
 namespace toft {
 
+class PathTrie;
+
+// A keep-alive connection of HttpServer. Pipelined requests are parsed out of
+// the receive buffer and dispatched to handlers in order, and their responses
+// are gathered in a buffer chain without copying bodies and sent in one write
+// per event loop iteration.
 class HttpConnection {
     TOFT_DECLARE_UNCOPYABLE(HttpConnection);
 
 public:
-    HttpConnection(EventDispatcher* dispatcher, int fd);
+    // Called in the event loop when the connection is closed by peer or on
+    // error, the connection can be deleted after the callback returned.
+    typedef std::function<void (HttpConnection*)> ClosedCallback;
+
+    // Requests are dispatched to handlers, which must not be changed while
+    // the connection is alive.
+    HttpConnection(EventDispatcher* dispatcher, int fd,
+                   const PathTrie* handlers,
+                   const ClosedCallback& closed_callback = ClosedCallback());
     void Send(const StringPiece& data);
+    // Close after the pending data are sent.
     void Close();
 
 private:
     void OnIoEvents(int events);
-    void OnError();
     bool OnReadable();
     bool OnWriteable();
     void OnClosed();
+    void UpdateEvents();
+
+    // Handle all complete requests in the receive buffer.
+    void HandleRequests();
+    void HandleRequest();
+    void SendResponse(HttpResponse* response, bool head_only);
+    void SendError(HttpResponse::StatusCode status);
 
 private:
     StreamSocket m_socket;
     IoEventWatcher m_watcher;
+    const PathTrie* m_handlers;
     std::string m_receive_buffer;
-    std::list<std::string> m_send_queue;
-    size_t m_sent_size;
+    HttpRequestParser m_parser;
+    HttpRequest m_request;
+    BufferChain m_send_buffer;
+    // No more requests are read, close after all data sent.
+    bool m_closing;
+    bool m_closed;
+    ClosedCallback m_closed_callback;
 };
 
 } // namespace toft
@@ -4,10 +4,24 @@
 // Author: CHEN Feng <chen3feng@gmail.com>
 
 #include "toft/net/http/server/server.h"
+#include "toft/net/http/server/handler.h"
 
 #include "thirdparty/gflags/gflags.h"
 #include "thirdparty/glog/logging.h"
 
+namespace toft {
+
+class HelloHandler : public HttpHandler {
+public:
+    virtual void HandleGet(const HttpRequest* req, HttpResponse* resp) {
+        resp->SetStatus(HttpResponse::Status_OK);
+        resp->SetHeader("Content-Type", "text/plain");
+        resp->SetBody("Hello " + req->Uri() + "\n");
+    }
+};
+
+} // namespace toft
+
 int main(int argc, char** argv) {
     FLAGS_alsologtostderr = true;
     google::ParseCommandLineFlags(&argc, &argv, true);
@@ -15,6 +29,8 @@ int main(int argc, char** argv) {
 
     using namespace toft;
     HttpServer server;
+    HelloHandler hello_handler;
+    server.RegisterHttpHandler("/", &hello_handler);
     server.Bind(SocketAddressInet4("127.0.0.1", 8080));
     LOG(INFO) << "Listen on http://127.0.0.1:8080/";
     server.Start();
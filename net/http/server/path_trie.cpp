@@ -0,0 +1,79 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/net/http/server/path_trie.h"
+
+namespace toft {
+
+PathTrie::Node::~Node() {
+    for (std::map<std::string, Node*>::iterator i = children.begin();
+         i != children.end(); ++i) {
+        delete i->second;
+    }
+}
+
+PathTrie::PathTrie() {
+}
+
+PathTrie::~PathTrie() {
+}
+
+bool PathTrie::NextSegment(StringPiece* path, StringPiece* segment) {
+    // Empty segments of "//" are skipped.
+    while (!path->empty() && (*path)[0] == '/')
+        path->remove_prefix(1);
+    if (path->empty())
+        return false;
+    size_t pos = path->find('/');
+    if (pos == StringPiece::npos)
+        pos = path->size();
+    *segment = path->substr(0, pos);
+    path->remove_prefix(pos);
+    return true;
+}
+
+bool PathTrie::Register(const StringPiece& path, HttpHandler* handler) {
+    Node* node = &m_root;
+    StringPiece remain = path;
+    StringPiece segment;
+    while (NextSegment(&remain, &segment)) {
+        Node*& child = node->children[segment.as_string()];
+        if (child == NULL)
+            child = new Node();
+        node = child;
+    }
+    if (node->handler != NULL)
+        return false;
+    node->handler = handler;
+    return true;
+}
+
+HttpHandler* PathTrie::Match(const StringPiece& uri) const {
+    StringPiece path = uri;
+    // Absolute form, "http://host/path".
+    size_t pos = path.find("://");
+    if (pos != StringPiece::npos) {
+        path.remove_prefix(pos + 3);
+        pos = path.find('/');
+        path.remove_prefix(pos == StringPiece::npos ? path.size() : pos);
+    }
+    pos = path.find_first_of("?#");
+    if (pos != StringPiece::npos)
+        path = path.substr(0, pos);
+
+    const Node* node = &m_root;
+    HttpHandler* handler = node->handler;
+    StringPiece segment;
+    while (NextSegment(&path, &segment)) {
+        std::map<std::string, Node*>::const_iterator i =
+            node->children.find(segment.as_string());
+        if (i == node->children.end())
+            break;
+        node = i->second;
+        if (node->handler != NULL)
+            handler = node->handler;
+    }
+    return handler;
+}
+
+} // namespace toft
@@ -0,0 +1,51 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_NET_HTTP_SERVER_PATH_TRIE_H
+#define TOFT_NET_HTTP_SERVER_PATH_TRIE_H
+#pragma once
+
+#include <map>
+#include <string>
+#include "toft/base/string/string_piece.h"
+#include "toft/base/uncopyable.h"
+
+namespace toft {
+
+class HttpHandler;
+
+// Maps path prefixes to handlers. Paths are split into '/' separated
+// segments, and a request path matches the registered path of the longest
+// common segments, so "/foo" matches "/foo" and "/foo/bar", but not
+// "/foobar", and "/" matches all.
+class PathTrie {
+    TOFT_DECLARE_UNCOPYABLE(PathTrie);
+
+public:
+    PathTrie();
+    ~PathTrie();
+
+    // Return false if the path is already registered.
+    bool Register(const StringPiece& path, HttpHandler* handler);
+
+    // uri can be in absolute form with scheme and host, its query and
+    // fragment are ignored. Return NULL if no one matches.
+    HttpHandler* Match(const StringPiece& uri) const;
+
+private:
+    struct Node {
+        Node() : handler(NULL) {}
+        ~Node();
+        std::map<std::string, Node*> children;
+        HttpHandler* handler;
+    };
+
+    // Return next segment from *path, and remove it from *path.
+    static bool NextSegment(StringPiece* path, StringPiece* segment);
+
+    Node m_root;
+};
+
+} // namespace toft
+
+#endif // TOFT_NET_HTTP_SERVER_PATH_TRIE_H
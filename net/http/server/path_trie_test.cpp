@@ -0,0 +1,49 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/net/http/server/path_trie.h"
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+// Only addresses of handlers are used.
+static HttpHandler* const kRoot = reinterpret_cast<HttpHandler*>(1);
+static HttpHandler* const kFoo = reinterpret_cast<HttpHandler*>(2);
+static HttpHandler* const kFooBar = reinterpret_cast<HttpHandler*>(3);
+
+TEST(PathTrie, Empty) {
+    PathTrie trie;
+    EXPECT_TRUE(trie.Match("/") == NULL);
+    EXPECT_TRUE(trie.Match("/foo") == NULL);
+}
+
+TEST(PathTrie, LongestPrefix) {
+    PathTrie trie;
+    EXPECT_TRUE(trie.Register("/foo", kFoo));
+    EXPECT_TRUE(trie.Register("/foo/bar/", kFooBar));
+    EXPECT_FALSE(trie.Register("/foo/", kFoo));
+
+    EXPECT_TRUE(trie.Match("/") == NULL);
+    EXPECT_TRUE(trie.Match("/foobar") == NULL);
+    EXPECT_EQ(kFoo, trie.Match("/foo"));
+    EXPECT_EQ(kFoo, trie.Match("/foo/"));
+    EXPECT_EQ(kFoo, trie.Match("/foo/ba"));
+    EXPECT_EQ(kFooBar, trie.Match("/foo/bar"));
+    EXPECT_EQ(kFooBar, trie.Match("//foo//bar/baz"));
+
+    EXPECT_TRUE(trie.Register("/", kRoot));
+    EXPECT_EQ(kRoot, trie.Match("/foobar"));
+    EXPECT_EQ(kRoot, trie.Match(""));
+}
+
+TEST(PathTrie, Uri) {
+    PathTrie trie;
+    EXPECT_TRUE(trie.Register("/foo", kFoo));
+    EXPECT_EQ(kFoo, trie.Match("/foo?a=b/c"));
+    EXPECT_EQ(kFoo, trie.Match("/foo#bar"));
+    EXPECT_EQ(kFoo, trie.Match("http://example.com/foo/bar"));
+    EXPECT_TRUE(trie.Match("http://foo") == NULL);
+    EXPECT_TRUE(trie.Match("/bar?/foo") == NULL);
+}
+
+} // namespace toft
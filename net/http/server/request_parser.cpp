@@ -0,0 +1,158 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/net/http/server/request_parser.h"
+#include <string>
+#include "toft/base/string/algorithm.h"
+#include "toft/net/http/framing.h"
+
+namespace toft {
+
+// Lines of chunk size and trailers are short.
+static const size_t kMaxLineSize = 4096;
+
+HttpRequestParser::HttpRequestParser(size_t max_header_size, size_t max_body_size)
+    : m_max_header_size(max_header_size),
+      m_max_body_size(max_body_size) {
+    Reset();
+}
+
+void HttpRequestParser::Reset() {
+    m_state = State_Headers;
+    m_position = 0;
+    m_body_size = 0;
+    m_error_status = HttpResponse::Status_None;
+}
+
+HttpRequestParser::Status HttpRequestParser::Parse(
+    const StringPiece& data, HttpRequest* request, size_t* request_size) {
+    if (m_error_status != HttpResponse::Status_None)
+        return Status_Error;
+    if (m_state == State_Headers) {
+        Status status = ParseHeaders(data, request, request_size);
+        if (status != Status_Incomplete || m_state == State_Headers)
+            return status;
+    }
+    if (m_state == State_Body) {
+        if (data.size() < m_position + m_body_size)
+            return Status_Incomplete;
+        request->SetBody(data.substr(m_position, m_body_size));
+        return Complete(m_position + m_body_size, request_size);
+    }
+    return ParseChunks(data, request, request_size);
+}
+
+HttpRequestParser::Status HttpRequestParser::ParseHeaders(
+    const StringPiece& data, HttpRequest* request, size_t* request_size) {
+    size_t header_size = FindHeaderEnd(data, m_position);
+    if (header_size == StringPiece::npos) {
+        if (data.size() > m_max_header_size)
+            return Error(HttpResponse::Status_RequestEntityTooLarge);
+        m_position = data.size();
+        return Status_Incomplete;
+    }
+    if (header_size > m_max_header_size)
+        return Error(HttpResponse::Status_RequestEntityTooLarge);
+
+    request->Reset();
+    HttpMessage::ErrorCode error = HttpMessage::SUCCESS;
+    if (request->ParseHeaders(data.substr(0, header_size), &error) == 0 ||
+        error != HttpMessage::SUCCESS) {
+        return Error(HttpResponse::Status_BadRequest);
+    }
+    m_position = header_size;
+
+    std::string transfer_encoding;
+    if (request->GetHeader("Transfer-Encoding", &transfer_encoding)) {
+        StringToLower(&transfer_encoding);
+        if (transfer_encoding.find("chunked") == std::string::npos) {
+            if (transfer_encoding != "identity")
+                return Error(HttpResponse::Status_NotImplemented);
+        } else {
+            m_state = State_ChunkSize;
+            return Status_Incomplete;
+        }
+    }
+
+    // A request without Content-Length has no body.
+    if (request->HasHeader("Content-Length")) {
+        int content_length = request->GetContentLength();
+        if (content_length < 0)
+            return Error(HttpResponse::Status_BadRequest);
+        if (static_cast<size_t>(content_length) > m_max_body_size)
+            return Error(HttpResponse::Status_RequestEntityTooLarge);
+        if (content_length > 0) {
+            m_body_size = content_length;
+            m_state = State_Body;
+            return Status_Incomplete;
+        }
+    }
+    return Complete(header_size, request_size);
+}
+
+HttpRequestParser::Status HttpRequestParser::ParseChunks(
+    const StringPiece& data, HttpRequest* request, size_t* request_size) {
+    for (;;) {
+        if (m_state == State_ChunkData) {
+            // Chunk data and its line ending.
+            size_t end = m_position + m_body_size;
+            if (data.size() < end)
+                return Status_Incomplete;
+            int line_ending_size = MatchLineEnding(data.substr(end));
+            if (line_ending_size == 0)
+                return Status_Incomplete;
+            if (line_ending_size < 0)
+                return Error(HttpResponse::Status_BadRequest);
+            request->MutableBody()->append(data.data() + m_position, m_body_size);
+            m_position = end + line_ending_size;
+            m_state = State_ChunkSize;
+            continue;
+        }
+
+        size_t eol = data.find('\n', m_position);
+        if (eol == StringPiece::npos) {
+            if (data.size() - m_position > kMaxLineSize)
+                return Error(HttpResponse::Status_BadRequest);
+            return Status_Incomplete;
+        }
+        StringPiece line = data.substr(m_position, eol - m_position);
+        m_position = eol + 1;
+        if (line.ends_with("\r"))
+            line.remove_suffix(1);
+
+        if (m_state == State_Trailers) {
+            // Trailer fields are ignored until the empty line.
+            if (line.empty())
+                return Complete(m_position, request_size);
+            continue;
+        }
+
+        // State_ChunkSize, chunk extensions after ';' are ignored.
+        size_t chunk_size = 0;
+        if (!ParseChunkSizeLine(line, m_max_body_size, &chunk_size))
+            return Error(HttpResponse::Status_BadRequest);
+        if (chunk_size > m_max_body_size)
+            return Error(HttpResponse::Status_RequestEntityTooLarge);
+        if (chunk_size == 0) {
+            m_state = State_Trailers;
+            continue;
+        }
+        if (request->Body().size() + chunk_size > m_max_body_size)
+            return Error(HttpResponse::Status_RequestEntityTooLarge);
+        m_body_size = chunk_size;
+        m_state = State_ChunkData;
+    }
+}
+
+HttpRequestParser::Status HttpRequestParser::Complete(size_t size,
+                                                      size_t* request_size) {
+    *request_size = size;
+    return Status_Complete;
+}
+
+HttpRequestParser::Status HttpRequestParser::Error(HttpResponse::StatusCode status) {
+    m_error_status = status;
+    return Status_Error;
+}
+
+} // namespace toft
@@ -0,0 +1,77 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_NET_HTTP_SERVER_REQUEST_PARSER_H
+#define TOFT_NET_HTTP_SERVER_REQUEST_PARSER_H
+#pragma once
+
+#include <stddef.h>
+#include "toft/base/string/string_piece.h"
+#include "toft/base/uncopyable.h"
+#include "toft/net/http/request.h"
+#include "toft/net/http/response.h"
+
+namespace toft {
+
+// Frames requests out of the receive buffer of a connection, one after
+// another, with bodies of Content-Length or chunked transfer encoding.
+//
+// Parse is called with the data from the start of the current request every
+// time more data is received, and remembers how far it got, so every byte is
+// scanned only once. After a request is complete or an error occurs, Reset
+// before parsing the next one.
+class HttpRequestParser {
+    TOFT_DECLARE_UNCOPYABLE(HttpRequestParser);
+
+public:
+    enum Status {
+        Status_Incomplete,
+        Status_Complete,
+        Status_Error
+    };
+
+    static const size_t kDefaultMaxHeaderSize = 64 * 1024;
+    static const size_t kDefaultMaxBodySize = 64 * 1024 * 1024;
+
+    explicit HttpRequestParser(size_t max_header_size = kDefaultMaxHeaderSize,
+                               size_t max_body_size = kDefaultMaxBodySize);
+
+    // Parse into request. When complete, request_size is set to the bytes
+    // taken by the request, data after it belongs to the next request.
+    Status Parse(const StringPiece& data, HttpRequest* request,
+                 size_t* request_size);
+
+    void Reset();
+
+    // Response status of the error.
+    HttpResponse::StatusCode ErrorStatus() const { return m_error_status; }
+
+private:
+    enum State {
+        State_Headers,
+        State_Body,
+        State_ChunkSize,
+        State_ChunkData,
+        State_Trailers
+    };
+
+    Status ParseHeaders(const StringPiece& data, HttpRequest* request,
+                        size_t* request_size);
+    Status ParseChunks(const StringPiece& data, HttpRequest* request,
+                       size_t* request_size);
+    Status Complete(size_t size, size_t* request_size);
+    Status Error(HttpResponse::StatusCode status);
+
+    size_t m_max_header_size;
+    size_t m_max_body_size;
+    State m_state;
+    // Where to go on scanning or parsing in data.
+    size_t m_position;
+    // Size of the body in State_Body, or the current chunk in State_ChunkData.
+    size_t m_body_size;
+    HttpResponse::StatusCode m_error_status;
+};
+
+} // namespace toft
+
+#endif // TOFT_NET_HTTP_SERVER_REQUEST_PARSER_H
@@ -0,0 +1,93 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/net/http/server/request_parser.h"
+#include <string>
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+TEST(HttpRequestParser, NoBody) {
+    HttpRequestParser parser;
+    HttpRequest request;
+    size_t size = 0;
+    std::string data = "GET /a HTTP/1.1\r\nHost: x\r\n\r\nGET /b HTTP/1.1\r\n\r\n";
+    ASSERT_EQ(HttpRequestParser::Status_Complete, parser.Parse(data, &request, &size));
+    EXPECT_EQ("/a", request.Uri());
+    EXPECT_EQ(data.find("GET /b"), size);
+
+    parser.Reset();
+    ASSERT_EQ(HttpRequestParser::Status_Complete,
+              parser.Parse(StringPiece(data).substr(size), &request, &size));
+    EXPECT_EQ("/b", request.Uri());
+    EXPECT_EQ("", request.Body());
+}
+
+TEST(HttpRequestParser, ContentLength) {
+    std::string data = "POST /a HTTP/1.1\r\nContent-Length: 5\r\n\r\nhelloGET";
+    // Feed byte by byte.
+    HttpRequestParser parser;
+    HttpRequest request;
+    size_t size = 0;
+    for (size_t i = 0; i < data.size() - 3; ++i) {
+        ASSERT_EQ(HttpRequestParser::Status_Incomplete,
+                  parser.Parse(StringPiece(data.data(), i), &request, &size)) << i;
+    }
+    ASSERT_EQ(HttpRequestParser::Status_Complete, parser.Parse(data, &request, &size));
+    EXPECT_EQ("hello", request.Body());
+    EXPECT_EQ(data.size() - 3, size);
+}
+
+TEST(HttpRequestParser, Chunked) {
+    std::string data =
+        "POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5;name=value\r\nhello\r\n"
+        "A\r\n, 01234567\r\n"
+        "0\r\nX-Trailer: 1\r\n\r\n";
+    HttpRequestParser parser;
+    HttpRequest request;
+    size_t size = 0;
+    for (size_t i = 0; i < data.size(); ++i) {
+        ASSERT_EQ(HttpRequestParser::Status_Incomplete,
+                  parser.Parse(StringPiece(data.data(), i), &request, &size)) << i;
+    }
+    ASSERT_EQ(HttpRequestParser::Status_Complete, parser.Parse(data, &request, &size));
+    EXPECT_EQ("hello, 01234567", request.Body());
+    EXPECT_EQ(data.size(), size);
+
+    // All at once.
+    parser.Reset();
+    ASSERT_EQ(HttpRequestParser::Status_Complete, parser.Parse(data, &request, &size));
+    EXPECT_EQ("hello, 01234567", request.Body());
+}
+
+static HttpResponse::StatusCode ParseError(const std::string& data,
+                                           size_t max_body_size = 1024) {
+    HttpRequestParser parser(1024, max_body_size);
+    HttpRequest request;
+    size_t size = 0;
+    if (parser.Parse(data, &request, &size) != HttpRequestParser::Status_Error)
+        return HttpResponse::Status_None;
+    return parser.ErrorStatus();
+}
+
+TEST(HttpRequestParser, Errors) {
+    EXPECT_EQ(HttpResponse::Status_BadRequest,
+              ParseError("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nxyz\r\n"));
+    EXPECT_EQ(HttpResponse::Status_BadRequest,
+              ParseError("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                         "1\r\nabc\r\n"));
+    EXPECT_EQ(HttpResponse::Status_NotImplemented,
+              ParseError("POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n"));
+    EXPECT_EQ(HttpResponse::Status_RequestEntityTooLarge,
+              ParseError("POST / HTTP/1.1\r\nContent-Length: 2000\r\n\r\n"));
+    EXPECT_EQ(HttpResponse::Status_RequestEntityTooLarge,
+              ParseError("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                         "fffffffff\r\n"));
+    EXPECT_EQ(HttpResponse::Status_RequestEntityTooLarge,
+              ParseError("GET / HTTP/1.1\r\n" + std::string(2000, 'x')));
+    EXPECT_EQ(HttpResponse::Status_None,
+              ParseError("POST / HTTP/1.1\r\nContent-Length: 1000\r\n\r\n"));
+}
+
+} // namespace toft
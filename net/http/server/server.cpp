@@ -5,70 +5,255 @@
 
 #include "toft/net/http/server/server.h"
 #include <set>
+#include <vector>
+#include "toft/base/scoped_ptr.h"
 #include "toft/net/http/server/connection.h"
+#include "toft/net/http/server/path_trie.h"
 #include "toft/system/event_dispatcher/event_dispatcher.h"
+#include "toft/system/info/info.h"
 #include "toft/system/net/socket.h"
+#include "toft/system/threading/mutex.h"
+#include "toft/system/threading/thread.h"
 
 #include "thirdparty/glog/logging.h"
 
+// Not defined by old glibc.
+#ifndef SO_REUSEPORT
+#define SO_REUSEPORT 15
+#endif
+
 namespace toft {
 
-struct HttpServer::Impl {
-    Impl()
-        : m_listen_socket(AF_INET, SOCK_STREAM, 0),
+namespace {
+
+// An event loop and the connections on it. Other threads talk to it by
+// queueing requests and waking it up.
+class EventLoop {
+    TOFT_DECLARE_UNCOPYABLE(EventLoop);
+
+public:
+    explicit EventLoop(const PathTrie* handlers)
+        : m_handlers(handlers),
+          m_wakeup_watcher(&m_event_dispatcher,
+                           std::bind(&EventLoop::OnWakeUp, this,
+                                     std::placeholders::_1)),
           m_listen_watcher(&m_event_dispatcher,
-                           std::bind(&Impl::OnAccept, this,
-                                     std::placeholders::_1)) {
-        m_listen_socket.SetBlocking(false);
+                           std::bind(&EventLoop::OnAccept, this,
+                                     std::placeholders::_1)),
+          m_loops(NULL), m_next_loop(0), m_stopping(false) {
+        m_wakeup_watcher.Start();
     }
 
-public:
-    bool Bind(const SocketAddress& address, SocketAddress* real_address) {
-        if (!m_listen_socket.Bind(address))
-            return false;
-        if (real_address)
-            return m_listen_socket.GetLocalAddress(real_address);
-        return true;
+    ~EventLoop() {
+        m_listen_watcher.Stop();
+        m_wakeup_watcher.Stop();
+        DeleteClosedConnections();
+        for (std::set<HttpConnection*>::iterator i = m_connections.begin();
+             i != m_connections.end(); ++i) {
+            delete *i;
+        }
+        for (size_t i = 0; i < m_pending_fds.size(); ++i) {
+            StreamSocket socket;
+            socket.Attach(m_pending_fds[i]);
+        }
     }
 
-    bool Start() {
-        if (!m_listen_socket.Listen()) {
-            return false;
+    ListenerSocket* CreateListener(bool reuse_port) {
+        m_listener.reset(new ListenerSocket(AF_INET, SOCK_STREAM, 0));
+        m_listener->SetBlocking(false);
+        if (reuse_port && !m_listener->SetOption(SOL_SOCKET, SO_REUSEPORT, 1)) {
+            LOG(ERROR) << "Can't set SO_REUSEPORT on listen socket";
+            return NULL;
         }
-        m_listen_watcher.Set(m_listen_socket.Handle(), EventMask_Write);
-        m_listen_watcher.Start();
-        return true;
+        return m_listener.get();
     }
 
-    bool RegisterHttpHandler(const std::string& path, HttpHandler* handler) {
-        return m_handler_map.insert(std::make_pair(path, handler)).second;
+    // Accept connections of the listener, and hand them to loops round
+    // robin if loops is not NULL.
+    bool StartListen(const std::vector<EventLoop*>* loops) {
+        if (!m_listener->Listen())
+            return false;
+        m_loops = loops;
+        m_listen_watcher.Set(m_listener->Handle(), EventMask_Read);
+        m_listen_watcher.Start();
+        return true;
     }
 
     void Run() {
         m_event_dispatcher.Run();
     }
 
+    // Called in any thread.
+    void Stop() {
+        {
+            MutexLocker locker(&m_mutex);
+            m_stopping = true;
+        }
+        m_wakeup_watcher.Send();
+    }
+
+    // Called in any thread, the connection is created in this loop.
+    void AddConnection(int fd) {
+        {
+            MutexLocker locker(&m_mutex);
+            m_pending_fds.push_back(fd);
+        }
+        m_wakeup_watcher.Send();
+    }
+
 private:
     void OnAccept(int events) {
-        StreamSocket socket;
-        SocketAddressStorage address;
-        if (m_listen_socket.Accept(&socket, &address)) {
-            LOG(INFO) << "Connect from " << address.ToString() << " acceptted.";
+        // Drain the backlog, new connections keep coming under load.
+        for (int i = 0; i < kMaxAcceptsPerEvent; ++i) {
+            StreamSocket socket;
+            SocketAddressStorage address;
+            if (!m_listener->Accept(&socket, &address))
+                break;
+            VLOG(1) << "Connect from " << address.ToString() << " acceptted.";
             socket.SetBlocking(false);
-            m_connections.insert(new HttpConnection(&m_event_dispatcher,
-                                                    socket.Detach()));
+            socket.SetTcpNoDelay();
+            EventLoop* loop = this;
+            if (m_loops != NULL)
+                loop = (*m_loops)[m_next_loop++ % m_loops->size()];
+            if (loop == this) {
+                NewConnection(socket.Detach());
+            } else {
+                loop->AddConnection(socket.Detach());
+            }
+        }
+    }
+
+    void NewConnection(int fd) {
+        m_connections.insert(new HttpConnection(
+                &m_event_dispatcher, fd, m_handlers,
+                std::bind(&EventLoop::OnConnectionClosed, this,
+                          std::placeholders::_1)));
+    }
+
+    // Its watcher is still running, delete it later.
+    void OnConnectionClosed(HttpConnection* connection) {
+        m_connections.erase(connection);
+        m_closed_connections.push_back(connection);
+        m_wakeup_watcher.Send();
+    }
+
+    void DeleteClosedConnections() {
+        for (size_t i = 0; i < m_closed_connections.size(); ++i)
+            delete m_closed_connections[i];
+        m_closed_connections.clear();
+    }
+
+    void OnWakeUp(int events) {
+        DeleteClosedConnections();
+        std::vector<int> fds;
+        bool stopping;
+        {
+            MutexLocker locker(&m_mutex);
+            fds.swap(m_pending_fds);
+            stopping = m_stopping;
         }
+        for (size_t i = 0; i < fds.size(); ++i)
+            NewConnection(fds[i]);
+        if (stopping)
+            m_event_dispatcher.Break();
     }
 
 private:
-    std::map<std::string, HttpHandler*> m_handler_map;
+    static const int kMaxAcceptsPerEvent = 64;
+
+    const PathTrie* m_handlers;
     EventDispatcher m_event_dispatcher;
-    ListenerSocket m_listen_socket;
+    AsyncEventWatcher m_wakeup_watcher;
+    scoped_ptr<ListenerSocket> m_listener;
     IoEventWatcher m_listen_watcher;
+    const std::vector<EventLoop*>* m_loops;
+    size_t m_next_loop;
     std::set<HttpConnection*> m_connections;
+    std::vector<HttpConnection*> m_closed_connections;
+
+    Mutex m_mutex;
+    std::vector<int> m_pending_fds;
+    bool m_stopping;
+};
+
+} // namespace
+
+struct HttpServer::Impl {
+    Impl(int num_event_loops, AcceptMode accept_mode)
+        : m_accept_mode(accept_mode) {
+        if (num_event_loops <= 0)
+            num_event_loops = GetLogicalCpuNumber();
+        for (int i = 0; i < num_event_loops; ++i)
+            m_loops.push_back(new EventLoop(&m_handlers));
+    }
+
+    ~Impl() {
+        for (size_t i = 0; i < m_loops.size(); ++i)
+            delete m_loops[i];
+    }
+
+public:
+    bool Bind(const SocketAddress& address, SocketAddress* real_address) {
+        SocketAddressStorage bound_address;
+        size_t num_listeners =
+            m_accept_mode == AcceptMode_ReusePort ? m_loops.size() : 1;
+        for (size_t i = 0; i < num_listeners; ++i) {
+            ListenerSocket* listener =
+                m_loops[i]->CreateListener(m_accept_mode == AcceptMode_ReusePort);
+            if (listener == NULL)
+                return false;
+            // Others are bound to the real port of the first one, in case
+            // the port is 0.
+            if (!listener->Bind(i == 0 ? address : bound_address))
+                return false;
+            if (i == 0 && !listener->GetLocalAddress(&bound_address))
+                return false;
+        }
+        if (real_address)
+            return real_address->CopyFrom(bound_address);
+        return true;
+    }
+
+    bool Start() {
+        if (m_accept_mode == AcceptMode_ReusePort) {
+            for (size_t i = 0; i < m_loops.size(); ++i) {
+                if (!m_loops[i]->StartListen(NULL))
+                    return false;
+            }
+            return true;
+        }
+        return m_loops[0]->StartListen(m_loops.size() > 1 ? &m_loops : NULL);
+    }
+
+    bool RegisterHttpHandler(const std::string& path, HttpHandler* handler) {
+        return m_handlers.Register(path, handler);
+    }
+
+    void Close() {
+        for (size_t i = 0; i < m_loops.size(); ++i)
+            m_loops[i]->Stop();
+    }
+
+    void Run() {
+        std::vector<Thread*> threads;
+        for (size_t i = 1; i < m_loops.size(); ++i)
+            threads.push_back(new Thread(std::bind(&EventLoop::Run, m_loops[i])));
+        m_loops[0]->Run();
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads[i]->Join();
+            delete threads[i];
+        }
+    }
+
+private:
+    AcceptMode m_accept_mode;
+    // Shared by all event loops, not changed after Start.
+    PathTrie m_handlers;
+    std::vector<EventLoop*> m_loops;
 };
 
-HttpServer::HttpServer() : m_impl(new Impl()) {
+HttpServer::HttpServer(int num_event_loops, AcceptMode accept_mode)
+    : m_impl(new Impl(num_event_loops, accept_mode)) {
 }
 
 HttpServer::~HttpServer() {
@@ -87,6 +272,10 @@ bool HttpServer::Start() {
     return m_impl->Start();
 }
 
+void HttpServer::Close() {
+    m_impl->Close();
+}
+
 void HttpServer::Run() {
     return m_impl->Run();
 }
@@ -21,12 +21,30 @@ class HttpServer {
     TOFT_DECLARE_UNCOPYABLE(HttpServer);
 
 public:
-    HttpServer();
+    // How accepted connections are distributed to event loops.
+    enum AcceptMode {
+        // The first event loop accepts all connections, and hands them to
+        // event loops round robin.
+        AcceptMode_RoundRobin,
+        // Every event loop accepts from its own listener bound to the same
+        // address with SO_REUSEPORT, and the kernel balances connections.
+        AcceptMode_ReusePort
+    };
+
+    /// @param num_event_loops number of event loops, each runs in its own
+    /// thread and owns the connections accepted to it, -1 means cpu number.
+    explicit HttpServer(int num_event_loops = 1,
+                        AcceptMode accept_mode = AcceptMode_RoundRobin);
     virtual ~HttpServer();
+    // Requests are handled by the handler registered with the longest
+    // matched path prefix, in segments. Must be called before Start.
     bool RegisterHttpHandler(const std::string& path, HttpHandler* handler);
     bool Bind(const SocketAddress& address, SocketAddress* real_address = NULL);
     bool Start();
+    // Stop all event loops, can be called in any thread.
     void Close();
+    // Run the first event loop in the calling thread and the others in new
+    // threads, return after Close.
     void Run();
 
 private:
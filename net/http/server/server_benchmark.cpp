@@ -0,0 +1,167 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Load generator of HttpServer. For every number of event loops, a server
+// runs in this process and client threads send requests on keep-alive
+// connections as fast as they can, then requests/s and latencies are
+// reported:
+//
+//   server_benchmark --event_loops=1,4,16 --connections=64 --seconds=5
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/base/string/algorithm.h"
+#include "toft/base/string/number.h"
+#include "toft/net/http/server/handler.h"
+#include "toft/net/http/server/server.h"
+#include "toft/system/net/socket.h"
+#include "toft/system/threading/thread.h"
+#include "toft/system/time/clock.h"
+
+#include "thirdparty/gflags/gflags.h"
+#include "thirdparty/glog/logging.h"
+
+DEFINE_string(event_loops, "1,4,16", "numbers of server event loops to run");
+DEFINE_string(accept_mode, "round_robin", "round_robin | reuse_port");
+DEFINE_int32(connections, 64, "client connections, each on its own thread");
+DEFINE_int32(seconds, 5, "seconds to run for every number of event loops");
+
+namespace toft {
+
+struct ClientResult {
+    ClientResult() : errors(0) {}
+    std::vector<int64_t> latencies;  // in us
+    int errors;
+};
+
+class BenchmarkHandler : public HttpHandler {
+public:
+    virtual void HandleGet(const HttpRequest* req, HttpResponse* resp) {
+        resp->SetBody("Hello");
+    }
+};
+
+static bool ReceiveResponse(StreamSocket* socket, std::string* buffer) {
+    buffer->clear();
+    for (;;) {
+        char data[4096];
+        size_t received_size;
+        if (!socket->Receive(data, sizeof(data), &received_size))
+            return false;
+        buffer->append(data, received_size);
+        size_t header_end = buffer->find("\r\n\r\n");
+        if (header_end == std::string::npos)
+            continue;
+        size_t length_pos = buffer->find("Content-Length: ");
+        if (length_pos > header_end)
+            return false;
+        size_t content_length = atoi(buffer->c_str() + length_pos + 16);
+        if (buffer->size() >= header_end + 4 + content_length)
+            return true;
+    }
+}
+
+static void RunClient(const SocketAddress* address, int64_t deadline,
+                      ClientResult* result) {
+    static const char kRequest[] =
+        "GET /benchmark HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    StreamSocket socket;
+    if (!socket.Create() || !socket.Connect(*address)) {
+        ++result->errors;
+        return;
+    }
+    socket.SetTcpNoDelay();
+    std::string buffer;
+    for (;;) {
+        int64_t start = RealtimeClock.MicroSeconds();
+        if (start >= deadline)
+            break;
+        if (!socket.SendAll(kRequest, sizeof(kRequest) - 1) ||
+            !ReceiveResponse(&socket, &buffer)) {
+            ++result->errors;
+            break;
+        }
+        result->latencies.push_back(RealtimeClock.MicroSeconds() - start);
+    }
+}
+
+static int64_t Percentile(const std::vector<int64_t>& sorted, double percent) {
+    if (sorted.empty())
+        return 0;
+    size_t index = static_cast<size_t>(sorted.size() * percent / 100);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void RunBenchmark(int num_event_loops, HttpServer::AcceptMode mode) {
+    HttpServer server(num_event_loops, mode);
+    BenchmarkHandler handler;
+    server.RegisterHttpHandler("/benchmark", &handler);
+    SocketAddressInet4 address;
+    CHECK(server.Bind(SocketAddressInet4("127.0.0.1", 0), &address));
+    CHECK(server.Start());
+    Thread server_thread(std::bind(&HttpServer::Run, &server));
+
+    int64_t start = RealtimeClock.MicroSeconds();
+    int64_t deadline = start + FLAGS_seconds * 1000000LL;
+    std::vector<ClientResult> results(FLAGS_connections);
+    std::vector<Thread*> threads;
+    for (int i = 0; i < FLAGS_connections; ++i) {
+        threads.push_back(new Thread(
+                std::bind(&RunClient, &address, deadline, &results[i])));
+    }
+    std::vector<int64_t> latencies;
+    int errors = 0;
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->Join();
+        delete threads[i];
+        latencies.insert(latencies.end(), results[i].latencies.begin(),
+                         results[i].latencies.end());
+        errors += results[i].errors;
+    }
+    double elapsed = (RealtimeClock.MicroSeconds() - start) / 1000000.0;
+    server.Close();
+    server_thread.Join();
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("%11d %12.0f %10lld %10lld %10lld %8d\n",
+           num_event_loops, latencies.size() / elapsed,
+           static_cast<long long>(Percentile(latencies, 50)),  // NOLINT
+           static_cast<long long>(Percentile(latencies, 99)),  // NOLINT
+           static_cast<long long>(Percentile(latencies, 99.9)),  // NOLINT
+           errors);
+    fflush(stdout);
+}
+
+} // namespace toft
+
+int main(int argc, char** argv) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    using namespace toft;
+    HttpServer::AcceptMode mode = HttpServer::AcceptMode_RoundRobin;
+    if (FLAGS_accept_mode == "reuse_port") {
+        mode = HttpServer::AcceptMode_ReusePort;
+    } else if (FLAGS_accept_mode != "round_robin") {
+        LOG(FATAL) << "Unknown accept mode: " << FLAGS_accept_mode;
+    }
+
+    std::vector<std::string> event_loops;
+    SplitString(FLAGS_event_loops, ",", &event_loops);
+    printf("accept_mode=%s connections=%d seconds=%d\n",
+           FLAGS_accept_mode.c_str(), FLAGS_connections, FLAGS_seconds);
+    printf("event_loops        req/s   p50(us)    p99(us)  p99.9(us)   errors\n");
+    for (size_t i = 0; i < event_loops.size(); ++i) {
+        int num_event_loops;
+        CHECK(StringToNumber(event_loops[i], &num_event_loops))
+            << "Invalid --event_loops: " << FLAGS_event_loops;
+        RunBenchmark(num_event_loops, mode);
+    }
+    return 0;
+}
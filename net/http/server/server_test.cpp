@@ -4,6 +4,17 @@
 // Author: CHEN Feng <chen3feng@gmail.com>
 
 #include "toft/net/http/server/server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "toft/base/functional.h"
+#include "toft/net/http/server/handler.h"
+#include "toft/storage/file/local_file.h"
+#include "toft/system/net/socket.h"
+#include "toft/system/threading/this_thread.h"
+#include "toft/system/threading/thread.h"
 #include "thirdparty/gtest/gtest.h"
 
 namespace toft {
@@ -12,4 +23,282 @@ TEST(HttpServer, Ctor) {
     HttpServer server;
 }
 
+// Respond the name and the body of the request.
+class EchoHandler : public HttpHandler {
+public:
+    explicit EchoHandler(const std::string& name) : m_name(name) {}
+    virtual void HandleGet(const HttpRequest* req, HttpResponse* resp) {
+        resp->SetBody(m_name);
+    }
+    virtual void HandlePost(const HttpRequest* req, HttpResponse* resp) {
+        resp->SetBody(m_name + ":" + req->Body());
+    }
+private:
+    std::string m_name;
+};
+
+// Respond a range of a local file.
+class FileHandler : public HttpHandler {
+public:
+    FileHandler(const std::shared_ptr<LocalFile>& file, int64_t offset, int64_t size)
+        : m_file(file), m_offset(offset), m_size(size) {}
+    virtual void HandleGet(const HttpRequest* req, HttpResponse* resp) {
+        resp->SetBodyFile(m_file, m_offset, m_size);
+    }
+private:
+    std::shared_ptr<LocalFile> m_file;
+    int64_t m_offset;
+    int64_t m_size;
+};
+
+// Receive count responses, return their bodies.
+static bool ReceiveResponses(StreamSocket* socket, size_t count,
+                             std::vector<std::string>* bodies) {
+    std::string data;
+    bodies->clear();
+    while (bodies->size() < count) {
+        size_t header_end = data.find("\r\n\r\n");
+        size_t length_pos = data.find("Content-Length: ");
+        if (header_end != std::string::npos && length_pos < header_end) {
+            size_t content_length = atoi(data.c_str() + length_pos + 16);
+            size_t size = header_end + 4 + content_length;
+            if (data.size() >= size) {
+                if (data.compare(0, 9, "HTTP/1.1 ") != 0)
+                    return false;
+                std::string status = data.substr(9, 3);
+                std::string body = data.substr(header_end + 4, content_length);
+                bodies->push_back(status == "200" ? body : status);
+                data.erase(0, size);
+                continue;
+            }
+        }
+        char buffer[4096];
+        size_t received_size;
+        if (!socket->Receive(buffer, sizeof(buffer), &received_size))
+            return false;
+        data.append(buffer, received_size);
+    }
+    return data.empty();
+}
+
+// Send a request and receive the whole response of the connection.
+static bool Get(StreamSocket* socket, const std::string& path, std::string* body) {
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    std::vector<std::string> bodies;
+    if (!socket->SendAll(request.data(), request.size()) ||
+        !ReceiveResponses(socket, 1, &bodies)) {
+        return false;
+    }
+    *body = bodies[0];
+    return true;
+}
+
+class HttpServerTest : public testing::Test {
+protected:
+    HttpServerTest() : m_root("root"), m_foo("foo"), m_foo_bar("foo/bar") {}
+
+    void StartServer(HttpServer* server) {
+        server->RegisterHttpHandler("/", &m_root);
+        server->RegisterHttpHandler("/foo", &m_foo);
+        server->RegisterHttpHandler("/foo/bar", &m_foo_bar);
+        ASSERT_TRUE(server->Bind(SocketAddressInet4("127.0.0.1", 0), &m_address));
+        ASSERT_NE(0, m_address.GetPort());
+        ASSERT_TRUE(server->Start());
+    }
+
+    void Connect(StreamSocket* socket) {
+        ASSERT_TRUE(socket->Create());
+        ASSERT_TRUE(socket->Connect(m_address));
+    }
+
+    void TestServer(int num_event_loops, HttpServer::AcceptMode mode);
+
+    EchoHandler m_root;
+    EchoHandler m_foo;
+    EchoHandler m_foo_bar;
+    SocketAddressInet4 m_address;
+};
+
+void HttpServerTest::TestServer(int num_event_loops, HttpServer::AcceptMode mode) {
+    HttpServer server(num_event_loops, mode);
+    StartServer(&server);
+    Thread thread(std::bind(&HttpServer::Run, &server));
+
+    std::vector<StreamSocket*> sockets;
+    for (int i = 0; i < 3 * num_event_loops; ++i) {
+        StreamSocket* socket = new StreamSocket();
+        sockets.push_back(socket);
+        Connect(socket);
+    }
+    // Keep alive.
+    for (int round = 0; round < 3; ++round) {
+        for (size_t i = 0; i < sockets.size(); ++i) {
+            std::string body;
+            ASSERT_TRUE(Get(sockets[i], "/", &body));
+            EXPECT_EQ("root", body);
+        }
+    }
+    // Closed connections are released by their loops.
+    for (size_t i = 0; i < sockets.size(); ++i)
+        delete sockets[i];
+
+    server.Close();
+    thread.Join();
+}
+
+TEST_F(HttpServerTest, SingleEventLoop) {
+    TestServer(1, HttpServer::AcceptMode_RoundRobin);
+}
+
+TEST_F(HttpServerTest, RoundRobin) {
+    TestServer(4, HttpServer::AcceptMode_RoundRobin);
+}
+
+TEST_F(HttpServerTest, ReusePort) {
+    TestServer(4, HttpServer::AcceptMode_ReusePort);
+}
+
+TEST_F(HttpServerTest, Route) {
+    HttpServer server;
+    StartServer(&server);
+    Thread thread(std::bind(&HttpServer::Run, &server));
+    StreamSocket socket;
+    Connect(&socket);
+    std::string body;
+    ASSERT_TRUE(Get(&socket, "/foo", &body));
+    EXPECT_EQ("foo", body);
+    ASSERT_TRUE(Get(&socket, "/foo/baz?a=1", &body));
+    EXPECT_EQ("foo", body);
+    ASSERT_TRUE(Get(&socket, "/foo/bar/baz", &body));
+    EXPECT_EQ("foo/bar", body);
+    ASSERT_TRUE(Get(&socket, "/foobar", &body));
+    EXPECT_EQ("root", body);
+    server.Close();
+    thread.Join();
+}
+
+TEST(HttpServer, NotFound) {
+    HttpServer server;
+    SocketAddressInet4 address;
+    ASSERT_TRUE(server.Bind(SocketAddressInet4("127.0.0.1", 0), &address));
+    ASSERT_TRUE(server.Start());
+    Thread thread(std::bind(&HttpServer::Run, &server));
+    StreamSocket socket;
+    ASSERT_TRUE(socket.Create());
+    ASSERT_TRUE(socket.Connect(address));
+    std::string body;
+    ASSERT_TRUE(Get(&socket, "/", &body));
+    EXPECT_EQ("404", body);
+    // Still alive.
+    ASSERT_TRUE(Get(&socket, "/", &body));
+    EXPECT_EQ("404", body);
+    server.Close();
+    thread.Join();
+}
+
+TEST_F(HttpServerTest, Pipeline) {
+    HttpServer server;
+    StartServer(&server);
+    Thread thread(std::bind(&HttpServer::Run, &server));
+    StreamSocket socket;
+    Connect(&socket);
+    static const char kRequests[] =
+        "GET /foo HTTP/1.1\r\n\r\n"
+        "POST /foo/bar HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "3;ext=1\r\nabc\r\n2\r\nde\r\n0\r\nX-Trailer: 1\r\n\r\n"
+        "GET /nothing HTTP/1.1\r\n\r\n";
+    // Split the requests at every place.
+    for (size_t split = 1; split < sizeof(kRequests) - 1; split += 7) {
+        ASSERT_TRUE(socket.SendAll(kRequests, split));
+        if (split % 2 == 0)
+            ThisThread::Sleep(1);
+        ASSERT_TRUE(socket.SendAll(kRequests + split, sizeof(kRequests) - 1 - split));
+        std::vector<std::string> bodies;
+        ASSERT_TRUE(ReceiveResponses(&socket, 4, &bodies));
+        EXPECT_EQ("foo", bodies[0]);
+        EXPECT_EQ("foo/bar:hello", bodies[1]);
+        EXPECT_EQ("root:abcde", bodies[2]);
+        EXPECT_EQ("root", bodies[3]);
+    }
+    server.Close();
+    thread.Join();
+}
+
+TEST_F(HttpServerTest, ConnectionClose) {
+    HttpServer server;
+    StartServer(&server);
+    Thread thread(std::bind(&HttpServer::Run, &server));
+    StreamSocket socket;
+    Connect(&socket);
+    static const char kRequests[] =
+        "GET /foo HTTP/1.1\r\nConnection: close\r\n\r\n"
+        "GET /foo HTTP/1.1\r\n\r\n";
+    ASSERT_TRUE(socket.SendAll(kRequests, sizeof(kRequests) - 1));
+    std::vector<std::string> bodies;
+    ASSERT_TRUE(ReceiveResponses(&socket, 1, &bodies));
+    EXPECT_EQ("foo", bodies[0]);
+    char buffer[16];
+    size_t received_size;
+    EXPECT_FALSE(socket.Receive(buffer, sizeof(buffer), &received_size));
+    EXPECT_EQ(0U, received_size);
+    server.Close();
+    thread.Join();
+}
+
+TEST_F(HttpServerTest, BadRequest) {
+    HttpServer server;
+    StartServer(&server);
+    Thread thread(std::bind(&HttpServer::Run, &server));
+    StreamSocket socket;
+    Connect(&socket);
+    static const char kRequest[] =
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nxyz\r\n";
+    ASSERT_TRUE(socket.SendAll(kRequest, sizeof(kRequest) - 1));
+    std::vector<std::string> bodies;
+    ASSERT_TRUE(ReceiveResponses(&socket, 1, &bodies));
+    EXPECT_EQ("400", bodies[0]);
+    server.Close();
+    thread.Join();
+}
+
+TEST_F(HttpServerTest, LargeBodies) {
+    std::string content;
+    for (int i = 0; i < 3000000; ++i)
+        content += static_cast<char>('a' + i % 26);
+    const char* path = "server_test.dat";
+    FILE* fp = fopen(path, "wb");
+    ASSERT_TRUE(fp != NULL);
+    ASSERT_EQ(content.size(), fwrite(content.data(), 1, content.size(), fp));
+    fclose(fp);
+    std::shared_ptr<LocalFile> file(dynamic_cast<LocalFile*>(File::Open(path, "r")));
+    ASSERT_TRUE(file != NULL);
+    unlink(path);
+    FileHandler file_handler(file, 100, content.size() - 200);
+
+    HttpServer server;
+    server.RegisterHttpHandler("/file", &file_handler);
+    StartServer(&server);
+    Thread thread(std::bind(&HttpServer::Run, &server));
+    StreamSocket socket;
+    Connect(&socket);
+    std::string body = "POST /foo HTTP/1.1\r\nContent-Length: 2000000\r\n\r\n" +
+        content.substr(0, 2000000) + "GET /file HTTP/1.1\r\n\r\n";
+    ASSERT_TRUE(socket.SendAll(body.data(), body.size()));
+    std::vector<std::string> bodies;
+    ASSERT_TRUE(ReceiveResponses(&socket, 2, &bodies));
+    EXPECT_TRUE("foo:" + content.substr(0, 2000000) == bodies[0]);
+    EXPECT_TRUE(content.substr(100, content.size() - 200) == bodies[1]);
+    server.Close();
+    thread.Join();
+}
+
+TEST(HttpServer, CloseBeforeRun) {
+    HttpServer server(2);
+    ASSERT_TRUE(server.Bind(SocketAddressInet4("127.0.0.1", 0)));
+    ASSERT_TRUE(server.Start());
+    server.Close();
+    server.Run();
+}
+
 } // namespace toft
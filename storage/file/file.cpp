@@ -51,6 +51,12 @@ bool FileSystem::ReadLines(const std::string& file_path,
 File::File() {}
 File::~File() {}
 
+bool File::Sync()
+{
+    errno = ENOTSUP;
+    return false;
+}
+
 FileSystem* File::GetFileSystemByPath(const std::string& file_path)
 {
     // "/mfs/abc" -> "mfs"
@@ -78,6 +78,10 @@ public:
     // Write of all user-space buffered data to file system.
     virtual bool Flush() = 0;
 
+    // Flush, then make the data written durable on the storage device, as
+    // fdatasync. Return false with errno ENOTSUP if not supported.
+    virtual bool Sync();
+
     // Close a file object. After closed, all other operations are invalid.
     // You can call close multiple time safely. Close a closed file object
     // will return true.
@@ -69,6 +69,13 @@ TEST_F(FileTest, Flush) {
     EXPECT_TRUE(fp->Flush());
 }
 
+TEST_F(FileTest, Sync) {
+    scoped_ptr<File> fp(File::Open("file.dat", "w"));
+    int64_t nwrite = fp->Write("hello", 5);
+    EXPECT_EQ(5, nwrite);
+    EXPECT_TRUE(fp->Sync());
+}
+
 TEST_F(FileTest, FlushError) {
     scoped_ptr<File> fp(File::Open("/dev/full", "w"));
     int64_t nwrite = fp->Write("hello", 5);
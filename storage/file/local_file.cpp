@@ -181,6 +181,11 @@ bool LocalFile::Flush()
     return fflush(m_fp) == 0;
 }
 
+bool LocalFile::Sync()
+{
+    return fflush(m_fp) == 0 && fdatasync(fileno(m_fp)) == 0;
+}
+
 bool LocalFile::Close()
 {
     if (m_fp == NULL)
@@ -200,6 +205,11 @@ int64_t LocalFile::Tell()
     return ftello(m_fp);
 }
 
+int LocalFile::Fileno() const
+{
+    return m_fp == NULL ? -1 : fileno(m_fp);
+}
+
 bool LocalFile::ReadLine(std::string* line, size_t max_size)
 {
     line->resize(max_size + 1);
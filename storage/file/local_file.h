@@ -38,10 +38,15 @@ public:
     virtual int64_t Read(void* buffer, int64_t size);
     virtual int64_t Write(const void* buffer, int64_t size);
     virtual bool Flush();
+    virtual bool Sync();
     virtual bool Close();
     virtual bool Seek(int64_t offset, int whence);
     virtual int64_t Tell();
     virtual bool ReadLine(std::string* line, size_t max_size);
+
+    // File descriptor of the underlying FILE, -1 if closed. For positioned
+    // IO such as pread or sendfile, which bypasses the buffer of FILE.
+    int Fileno() const;
 private:
     FILE* m_fp;
 };
@@ -29,6 +29,10 @@ bool FileMock::Flush() {
     return m_mock->Flush();
 }
 
+bool FileMock::Sync() {
+    return m_mock->Sync();
+}
+
 bool FileMock::Close() {
     return m_mock->Close();
 }
@@ -31,6 +31,7 @@ public:
     MOCK_METHOD2(Read, int64_t (void* buffer, int64_t size));
     MOCK_METHOD2(Write, int64_t (const void* buffer, int64_t size));
     MOCK_METHOD0(Flush, bool ());
+    MOCK_METHOD0(Sync, bool ());
     MOCK_METHOD0(Close, bool ());
     MOCK_METHOD2(Seek, bool (int64_t offset, int whence));
     MOCK_METHOD0(Tell, int64_t ());
@@ -51,6 +52,7 @@ public:
     virtual int64_t Read(void* buffer, int64_t size);
     virtual int64_t Write(const void* buffer, int64_t size);
     virtual bool Flush();
+    virtual bool Sync();
     virtual bool Close();
     virtual bool Seek(int64_t offset, int whence);
     virtual int64_t Tell();
@@ -0,0 +1,191 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Benchmarks of KVStore in the way of db_bench of LevelDB. Fills start from
+// an empty store, reads run on what the fills before them wrote:
+//
+//   db_bench --benchmarks=fillseq,fillrandom,readrandom,seekrandom --num=1000000
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "toft/base/random.h"
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/algorithm.h"
+#include "toft/storage/file/file.h"
+#include "toft/storage/kv/kv_store.h"
+#include "toft/system/time/clock.h"
+
+#include "thirdparty/gflags/gflags.h"
+#include "thirdparty/glog/logging.h"
+
+DEFINE_string(db, "./kv_bench", "directory of the store, on the disk to test");
+DEFINE_string(benchmarks, "fillseq,fillrandom,readrandom,seekrandom",
+              "fillseq | fillrandom | readrandom | seekrandom, run in order");
+DEFINE_int32(num, 1000000, "number of entries to write");
+DEFINE_int32(reads, -1, "number of reads or seeks, -1 means --num");
+DEFINE_int32(value_size, 100, "bytes of every value");
+DEFINE_int32(seek_nexts, 0, "entries read by Next after every seek");
+DEFINE_int32(memtable_size, 4 * 1024 * 1024, "bytes of a memtable");
+DEFINE_int32(background_threads, 2, "threads to flush and compact");
+DEFINE_bool(sync, false, "sync the log on every commit");
+
+namespace toft {
+
+class Benchmark {
+public:
+    Benchmark() : m_random(301), m_done(0), m_found(0), m_bytes(0), m_start(0) {}
+
+    void Run(const std::string& name) {
+        bool fill = name == "fillseq" || name == "fillrandom";
+        if (fill) {
+            m_store.reset();
+            RemoveStore();
+        }
+        if (m_store == NULL) {
+            KVStoreOptions options;
+            options.memtable_size = FLAGS_memtable_size;
+            options.background_threads = FLAGS_background_threads;
+            options.log_options.sync = FLAGS_sync;
+            m_store.reset(KVStore::Open(FLAGS_db, options));
+            CHECK(m_store != NULL) << "Can't open " << FLAGS_db;
+        }
+
+        m_done = 0;
+        m_found = 0;
+        m_bytes = 0;
+        m_start = RealtimeClock.MicroSeconds();
+        if (name == "fillseq") {
+            Write(false);
+        } else if (name == "fillrandom") {
+            Write(true);
+        } else if (name == "readrandom") {
+            ReadRandom();
+        } else if (name == "seekrandom") {
+            SeekRandom();
+        } else {
+            LOG(FATAL) << "Unknown benchmark: " << name;
+        }
+        Report(name, fill);
+    }
+
+private:
+    static std::string MakeKey(int index) {
+        char key[32];
+        snprintf(key, sizeof(key), "%016d", index);
+        return key;
+    }
+
+    int NumReads() const {
+        return FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads;
+    }
+
+    void Write(bool random) {
+        std::string value(FLAGS_value_size, 'x');
+        for (int i = 0; i < FLAGS_num; ++i) {
+            std::string key = MakeKey(random ? m_random.Uniform(FLAGS_num) : i);
+            CHECK(m_store->Put(key, value)) << "Can't put " << key;
+            m_bytes += key.size() + value.size();
+            ++m_done;
+        }
+    }
+
+    void ReadRandom() {
+        std::string value;
+        for (int i = 0; i < NumReads(); ++i) {
+            std::string key = MakeKey(m_random.Uniform(FLAGS_num));
+            if (m_store->Get(key, &value)) {
+                m_bytes += key.size() + value.size();
+                ++m_found;
+            }
+            ++m_done;
+        }
+    }
+
+    void SeekRandom() {
+        for (int i = 0; i < NumReads(); ++i) {
+            std::string key = MakeKey(m_random.Uniform(FLAGS_num));
+            scoped_ptr<KVStore::Iterator> iter(m_store->Scan(key));
+            if (iter->Valid() && iter->key() == key) {
+                ++m_found;
+            }
+            for (int j = 0; j < FLAGS_seek_nexts && iter->Valid(); ++j) {
+                m_bytes += iter->key().size() + iter->value().size();
+                iter->Next();
+            }
+            ++m_done;
+        }
+    }
+
+    void Report(const std::string& name, bool fill) {
+        // Writes are done when they are in memtables, background work
+        // goes on.
+        double seconds = (RealtimeClock.MicroSeconds() - m_start) / 1000000.0;
+        std::string extra;
+        if (m_bytes > 0) {
+            char rate[64];
+            snprintf(rate, sizeof(rate), "%6.1f MB/s", m_bytes / 1048576.0 / seconds);
+            extra = rate;
+        }
+        if (!fill) {
+            char found[64];
+            snprintf(found, sizeof(found), "%s(%lld of %lld found)",
+                     extra.empty() ? "" : " ",
+                     static_cast<long long>(m_found),  // NOLINT
+                     static_cast<long long>(m_done));  // NOLINT
+            extra += found;
+        }
+        printf("%-12s : %11.3f micros/op; %s\n",
+               name.c_str(), seconds * 1000000 / m_done, extra.c_str());
+        if (fill) {
+            int64_t start = RealtimeClock.MicroSeconds();
+            m_store->WaitForIdle();
+            printf("%-12s   %11.3f s waiting for the background, %d sstables\n", "",
+                   (RealtimeClock.MicroSeconds() - start) / 1000000.0,
+                   m_store->NumTables());
+        }
+        fflush(stdout);
+    }
+
+    static void RemoveFiles(const std::string& dir) {
+        scoped_ptr<FileIterator> iter(File::Iterate(dir, "*", FileType_Regular));
+        if (iter == NULL)
+            return;
+        FileEntry entry;
+        while (iter->GetNext(&entry))
+            File::Delete(dir + "/" + entry.name);
+    }
+
+    static void RemoveStore() {
+        RemoveFiles(FLAGS_db + "/wal");
+        RemoveFiles(FLAGS_db);
+    }
+
+private:
+    scoped_ptr<KVStore> m_store;
+    Random m_random;
+    int64_t m_done;
+    int64_t m_found;
+    int64_t m_bytes;
+    int64_t m_start;
+};
+
+} // namespace toft
+
+int main(int argc, char** argv) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    std::vector<std::string> benchmarks;
+    toft::SplitString(FLAGS_benchmarks, ",", &benchmarks);
+    printf("db=%s num=%d value_size=%d memtable_size=%d sync=%d\n",
+           FLAGS_db.c_str(), FLAGS_num, FLAGS_value_size, FLAGS_memtable_size,
+           FLAGS_sync);
+    toft::Benchmark benchmark;
+    for (size_t i = 0; i < benchmarks.size(); ++i) {
+        benchmark.Run(benchmarks[i]);
+    }
+    return 0;
+}
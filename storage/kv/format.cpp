@@ -0,0 +1,66 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/kv/format.h"
+
+#include <string.h>
+
+#include "toft/base/byte_order.h"
+#include "toft/encoding/varint.h"
+
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+
+void EncodeValueTag(uint64_t sequence, ValueType type, char* buffer) {
+    DCHECK_LE(sequence, kMaxSequence);
+    uint64_t tag = ByteOrder::ToBigEndian<uint64_t>(~(sequence << 8 | type));
+    memcpy(buffer, &tag, sizeof(tag));
+}
+
+void AppendTaggedValue(uint64_t sequence, ValueType type,
+                       const StringPiece& value, std::string* result) {
+    char tag[kValueTagSize];
+    EncodeValueTag(sequence, type, tag);
+    result->append(tag, sizeof(tag));
+    result->append(value.data(), value.size());
+}
+
+bool ParseTaggedValue(const StringPiece& tagged, uint64_t* sequence,
+                      ValueType* type, StringPiece* value) {
+    if (tagged.size() < kValueTagSize) {
+        return false;
+    }
+    uint64_t tag;
+    memcpy(&tag, tagged.data(), sizeof(tag));
+    tag = ~ByteOrder::FromBigEndian<uint64_t>(tag);
+    int type_value = static_cast<int>(tag & 0xff);
+    if (type_value != ValueType_Deletion && type_value != ValueType_Value) {
+        return false;
+    }
+    *sequence = tag >> 8;
+    *type = static_cast<ValueType>(type_value);
+    value->set(tagged.data() + kValueTagSize, tagged.size() - kValueTagSize);
+    return true;
+}
+
+void EncodeLogRecord(const StringPiece& key, uint64_t sequence, ValueType type,
+                     const StringPiece& value, std::string* record) {
+    record->clear();
+    record->reserve(Varint::EncodedLength(key) + kValueTagSize + value.size());
+    Varint::PutLengthPrefixedStringPiece(record, key);
+    AppendTaggedValue(sequence, type, value, record);
+}
+
+bool DecodeLogRecord(const StringPiece& record, StringPiece* key,
+                     StringPiece* tagged_value) {
+    StringPiece input = record;
+    if (!Varint::GetLengthPrefixedStringPiece(&input, key) ||
+        input.size() < kValueTagSize) {
+        return false;
+    }
+    *tagged_value = input;
+    return true;
+}
+
+} // namespace toft
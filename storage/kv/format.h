@@ -0,0 +1,53 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Entries of KVStore, in memtables, sstables and the log, are the user key
+// and a tagged value, which is the value prefixed by a 8 bytes tag of the
+// sequence number and the type of the write:
+//
+//   big endian of ~(sequence << 8 | type) | value
+//
+// Tags are stored inverted so that of the entries of a key, which are
+// ordered by the tagged value as duplicated keys in IteratorHeap, the newest
+// one comes first.
+
+#ifndef TOFT_STORAGE_KV_FORMAT_H
+#define TOFT_STORAGE_KV_FORMAT_H
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "toft/base/string/string_piece.h"
+
+namespace toft {
+
+enum ValueType {
+    ValueType_Deletion = 0,
+    ValueType_Value = 1,
+};
+
+static const size_t kValueTagSize = 8;
+static const uint64_t kMaxSequence = (1ULL << 56) - 1;
+
+// Append the tagged value to result.
+void AppendTaggedValue(uint64_t sequence, ValueType type,
+                       const StringPiece& value, std::string* result);
+
+// Encode the tag into kValueTagSize bytes of buffer.
+void EncodeValueTag(uint64_t sequence, ValueType type, char* buffer);
+
+// Return false if tagged is not a valid tagged value.
+bool ParseTaggedValue(const StringPiece& tagged, uint64_t* sequence,
+                      ValueType* type, StringPiece* value);
+
+// Record of the log is the length prefixed key and the tagged value.
+void EncodeLogRecord(const StringPiece& key, uint64_t sequence, ValueType type,
+                     const StringPiece& value, std::string* record);
+bool DecodeLogRecord(const StringPiece& record, StringPiece* key,
+                     StringPiece* tagged_value);
+
+} // namespace toft
+
+#endif // TOFT_STORAGE_KV_FORMAT_H
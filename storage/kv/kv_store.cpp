@@ -0,0 +1,873 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/kv/kv_store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "toft/base/functional.h"
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/algorithm.h"
+#include "toft/base/string/number.h"
+#include "toft/storage/file/file.h"
+#include "toft/storage/recordio/recordio.h"
+#include "toft/storage/sstable/merged_sstable_reader.h"
+#include "toft/storage/sstable/writer/unsorted_sstable_writer.h"
+
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+
+namespace {
+
+const char kManifestName[] = "MANIFEST";
+const char kLogDirName[] = "wal";
+const char kTableSuffix[] = ".sst";
+const char kTempTableSuffix[] = ".sstmp";
+
+// Bytes of keys and values the first writer commits in a group.
+const size_t kMaxGroupBytes = 1024 * 1024;
+
+// Number of a log segment or an sstable from its path.
+int64_t FileNumber(const std::string& path) {
+    return strtoll(path.c_str() + path.rfind('/') + 1, NULL, 10);
+}
+
+int64_t FileSize(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return -1;
+    }
+    return st.st_size;
+}
+
+// Make data of a file or entries of a dir durable.
+bool SyncPath(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+bool MakeDir(const std::string& dir, bool create) {
+    if (create && mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        LOG(ERROR) << "Can't create " << dir << ": " << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        LOG(ERROR) << dir << " is not a directory";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+struct KVStore::Table {
+    Table() : number(0), size(0), obsolete(false) {}
+    ~Table() {
+        reader.reset();
+        // Compacted, and no more read by iterators.
+        if (obsolete && !File::Delete(path)) {
+            LOG(WARNING) << "Can't delete " << path;
+        }
+    }
+
+    int64_t number;
+    std::string path;
+    int64_t size;
+    scoped_ptr<SSTableReader> reader;
+    bool obsolete;
+};
+
+struct KVStore::Version {
+    // From the newest to the oldest, the newer wins for the same key.
+    std::vector<std::shared_ptr<Table> > tables;
+};
+
+struct KVStore::Writer {
+    Writer(Mutex* mutex, ValueType type, const StringPiece& key, const StringPiece& value)
+        : type(type), key(key), value(value), flush(false), done(false), ok(false),
+          cond(mutex) {}
+    ValueType type;
+    StringPiece key;
+    StringPiece value;
+    // Switch the memtable by Flush instead of writing.
+    bool flush;
+    bool done;
+    bool ok;
+    ConditionVariable cond;
+};
+
+KVStore::KVStore(const std::string& dir, const KVStoreOptions& options)
+    : m_dir(dir),
+      m_options(options),
+      m_background_cond(&m_mutex),
+      m_sequence(0),
+      m_next_file_number(1),
+      m_mem(new MemTable),
+      m_mem_log_number(0),
+      m_version(new Version),
+      m_flush_scheduled(false),
+      m_compaction_scheduled(false),
+      m_closing(false),
+      m_failed(false),
+      m_log_number(0),
+      m_log(LogDir(), options.log_options),
+      m_thread_pool(options.background_threads) {
+}
+
+KVStore::~KVStore() {
+    {
+        MutexLocker locker(&m_mutex);
+        m_closing = true;
+        // The memtable being flushed is finished, but no more compaction.
+        while (m_flush_scheduled || m_compaction_scheduled) {
+            m_background_cond.Wait();
+        }
+    }
+    m_log.Close();
+}
+
+KVStore* KVStore::Open(const std::string& dir, const KVStoreOptions& options) {
+    if (!MakeDir(dir, options.create_if_missing) ||
+        !MakeDir(dir + "/" + kLogDirName, true)) {
+        return NULL;
+    }
+    scoped_ptr<KVStore> store(new KVStore(dir, options));
+    if (!store->Recover()) {
+        LOG(ERROR) << "Can't open the store in " << dir;
+        return NULL;
+    }
+    return store.release();
+}
+
+std::string KVStore::TablePath(int64_t number) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%06lld%s",
+             static_cast<long long>(number), kTableSuffix);  // NOLINT
+    return m_dir + "/" + name;
+}
+
+std::string KVStore::LogDir() const {
+    return m_dir + "/" + kLogDirName;
+}
+
+std::string KVStore::ManifestPath() const {
+    return m_dir + "/" + kManifestName;
+}
+
+bool KVStore::Recover() {
+    std::vector<int64_t> table_numbers;
+    if (!LoadManifest(&table_numbers)) {
+        return false;
+    }
+    for (size_t i = 0; i < table_numbers.size(); ++i) {
+        std::shared_ptr<Table> table = OpenTable(table_numbers[i]);
+        if (table == NULL) {
+            return false;
+        }
+        m_version->tables.push_back(table);
+    }
+
+    // Writes not flushed before.
+    std::vector<std::string> paths;
+    if (!WriteAheadLog::ListSegments(LogDir(), &paths)) {
+        return false;
+    }
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (FileNumber(paths[i]) >= m_log_number && !ReplayLog(paths[i])) {
+            return false;
+        }
+    }
+
+    if (!m_log.Open() || !WriteAheadLog::ListSegments(LogDir(), &paths)) {
+        return false;
+    }
+    // Segments replayed are kept until the memtable is flushed.
+    m_mem_log_number = m_mem->IsEmpty() ? FileNumber(paths.back()) : m_log_number;
+    RemoveObsoleteFiles(m_mem_log_number);
+
+    MutexLocker locker(&m_mutex);
+    MaybeScheduleCompaction();
+    return true;
+}
+
+// The manifest is lines of a name and a number, tables are from the newest
+// to the oldest:
+//
+//   next_file_number 12
+//   sequence 10000
+//   log_number 5
+//   table 11
+//   table 8
+bool KVStore::LoadManifest(std::vector<int64_t>* table_numbers) {
+    table_numbers->clear();
+    if (!File::Exists(ManifestPath())) {
+        return true;
+    }
+    std::vector<std::string> lines;
+    if (!File::ReadLines(ManifestPath(), &lines)) {
+        LOG(ERROR) << "Can't read " << ManifestPath();
+        return false;
+    }
+    for (size_t i = 0; i < lines.size(); ++i) {
+        std::vector<std::string> fields;
+        SplitString(lines[i], " ", &fields);
+        int64_t number;
+        if (fields.size() != 2 || !StringToNumber(fields[1], &number)) {
+            LOG(ERROR) << "Invalid line of " << ManifestPath() << ": " << lines[i];
+            return false;
+        }
+        if (fields[0] == "next_file_number") {
+            m_next_file_number = number;
+        } else if (fields[0] == "sequence") {
+            m_sequence = number;
+        } else if (fields[0] == "log_number") {
+            m_log_number = number;
+        } else if (fields[0] == "table") {
+            table_numbers->push_back(number);
+        } else {
+            LOG(ERROR) << "Invalid line of " << ManifestPath() << ": " << lines[i];
+            return false;
+        }
+    }
+    return true;
+}
+
+bool KVStore::ReplayLog(const std::string& path) {
+    scoped_ptr<File> file(File::Open(path, "r"));
+    if (file == NULL) {
+        LOG(ERROR) << "Can't open " << path;
+        return false;
+    }
+    RecordReader reader(file.get());
+    int ret;
+    while ((ret = reader.Next()) == 1) {
+        StringPiece record;
+        StringPiece key;
+        StringPiece tagged_value;
+        uint64_t sequence;
+        ValueType type;
+        StringPiece value;
+        if (!reader.ReadRecord(&record) ||
+            !DecodeLogRecord(record, &key, &tagged_value) ||
+            !ParseTaggedValue(tagged_value, &sequence, &type, &value)) {
+            LOG(ERROR) << "Invalid record in " << path;
+            return false;
+        }
+        m_mem->Add(sequence, type, key, value);
+        m_sequence = std::max(m_sequence, sequence);
+    }
+    // The last group may be written partly as the process crashed, it was
+    // not committed.
+    LOG_IF(WARNING, ret < 0 || reader.SkippedBytes() > 0)
+        << "Corrupted log " << path << ", replayed " << m_mem->NumEntries()
+        << " entries in all";
+    return true;
+}
+
+void KVStore::RemoveObsoleteFiles(int64_t log_number) {
+    RemoveLogs(log_number);
+
+    // Outputs of flushes and compactions not finished, and tables compacted
+    // but not deleted before.
+    std::vector<int64_t> live;
+    for (size_t i = 0; i < m_version->tables.size(); ++i) {
+        live.push_back(m_version->tables[i]->number);
+    }
+    std::sort(live.begin(), live.end());
+    scoped_ptr<FileIterator> iter(File::Iterate(m_dir, "*", FileType_Regular));
+    if (iter == NULL) {
+        return;
+    }
+    FileEntry entry;
+    while (iter->GetNext(&entry)) {
+        std::string path = m_dir + "/" + entry.name;
+        if (StringEndsWith(entry.name, kTempTableSuffix) ||
+            (StringEndsWith(entry.name, kTableSuffix) &&
+             !std::binary_search(live.begin(), live.end(), FileNumber(path)))) {
+            LOG(INFO) << "Delete obsolete " << path;
+            File::Delete(path);
+        }
+    }
+}
+
+void KVStore::RemoveLogs(int64_t log_number) {
+    std::vector<std::string> paths;
+    if (!WriteAheadLog::ListSegments(LogDir(), &paths)) {
+        return;
+    }
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (FileNumber(paths[i]) < log_number && !File::Delete(paths[i])) {
+            LOG(WARNING) << "Can't delete " << paths[i];
+        }
+    }
+}
+
+bool KVStore::Put(const StringPiece& key, const StringPiece& value) {
+    return Write(ValueType_Value, key, value);
+}
+
+bool KVStore::Delete(const StringPiece& key) {
+    return Write(ValueType_Deletion, key, StringPiece());
+}
+
+bool KVStore::Write(ValueType type, const StringPiece& key, const StringPiece& value) {
+    Writer writer(&m_mutex, type, key, value);
+    MutexLocker locker(&m_mutex);
+    WaitForTurn(&writer);
+    if (writer.done) {
+        return writer.ok;
+    }
+    if (!MakeRoomForWrite()) {
+        FinishWriters(&writer, false);
+        return false;
+    }
+
+    // Writes of other threads queued meanwhile are committed in a group, in
+    // the order of sequences. Only the first writer writes, so the log and
+    // the memtable are used without m_mutex held.
+    std::vector<Writer*> group;
+    size_t group_bytes = 0;
+    for (std::deque<Writer*>::iterator i = m_writers.begin();
+         i != m_writers.end() && !(*i)->flush && group_bytes < kMaxGroupBytes; ++i) {
+        group.push_back(*i);
+        group_bytes += (*i)->key.size() + (*i)->value.size();
+    }
+    std::shared_ptr<MemTable> mem = m_mem;
+    uint64_t sequence = m_sequence;
+    m_mutex.Unlock();
+
+    std::string record;
+    Future<bool> committed;
+    for (size_t i = 0; i < group.size(); ++i) {
+        EncodeLogRecord(group[i]->key, sequence + i + 1, group[i]->type, group[i]->value,
+                        &record);
+        committed = m_log.Append(record);
+    }
+    // Records are committed in order, so are all of the group with the last.
+    bool ok = committed.Get();
+    if (ok) {
+        // Visible to Get at once, and to Scan after m_sequence is updated.
+        for (size_t i = 0; i < group.size(); ++i) {
+            mem->Add(sequence + i + 1, group[i]->type, group[i]->key, group[i]->value);
+        }
+    }
+
+    m_mutex.Lock();
+    if (ok) {
+        m_sequence = sequence + group.size();
+    } else {
+        LOG(ERROR) << "Can't log the write to " << m_dir;
+        m_failed = true;
+    }
+    FinishWriters(group.back(), ok);
+    return ok;
+}
+
+void KVStore::WaitForTurn(Writer* writer) {
+    m_writers.push_back(writer);
+    while (!writer->done && writer != m_writers.front()) {
+        writer->cond.Wait();
+    }
+}
+
+void KVStore::FinishWriters(Writer* last, bool ok) {
+    for (;;) {
+        Writer* writer = m_writers.front();
+        m_writers.pop_front();
+        writer->done = true;
+        writer->ok = ok;
+        writer->cond.Signal();
+        if (writer == last) {
+            break;
+        }
+    }
+    if (!m_writers.empty()) {
+        m_writers.front()->cond.Signal();
+    }
+}
+
+bool KVStore::MakeRoomForWrite() {
+    for (;;) {
+        if (m_failed) {
+            return false;
+        }
+        if (m_mem->MemoryUsage() < m_options.memtable_size) {
+            return true;
+        }
+        if (m_imm != NULL ||
+            (static_cast<int>(m_version->tables.size()) >= m_options.max_tables &&
+             m_compaction_scheduled)) {
+            // Flushed or compacted slower than written.
+            m_background_cond.Wait();
+            continue;
+        }
+        if (!SwitchMemTable()) {
+            return false;
+        }
+    }
+}
+
+bool KVStore::SwitchMemTable() {
+    // Start a new segment for the new memtable. Nothing is appended by
+    // others, and closing waits for the commit of the segment, so it's done
+    // without m_mutex held.
+    std::vector<std::string> paths;
+    m_mutex.Unlock();
+    bool ok = m_log.Close() && m_log.Open() &&
+              WriteAheadLog::ListSegments(LogDir(), &paths);
+    m_mutex.Lock();
+    if (!ok) {
+        LOG(ERROR) << "Can't switch the log of " << m_dir;
+        m_failed = true;
+        return false;
+    }
+    m_mem_log_number = FileNumber(paths.back());
+    m_imm = m_mem;
+    m_mem.reset(new MemTable);
+    m_flush_scheduled = true;
+    m_thread_pool.AddTask(std::bind(&KVStore::BackgroundFlush, this));
+    return true;
+}
+
+bool KVStore::Get(const StringPiece& key, std::string* value) {
+    std::shared_ptr<MemTable> mem;
+    std::shared_ptr<MemTable> imm;
+    std::shared_ptr<Version> version;
+    {
+        MutexLocker locker(&m_mutex);
+        mem = m_mem;
+        imm = m_imm;
+        version = m_version;
+    }
+    bool deleted;
+    if (mem->Get(key, value, &deleted) ||
+        (imm != NULL && imm->Get(key, value, &deleted))) {
+        return !deleted;
+    }
+
+    std::string key_string = key.as_string();
+    std::string tagged_value;
+    for (size_t i = 0; i < version->tables.size(); ++i) {
+        // Filtered by the bloom filter without I/O mostly.
+        if (!version->tables[i]->reader->Lookup(key_string, &tagged_value)) {
+            continue;
+        }
+        uint64_t sequence;
+        ValueType type;
+        StringPiece data;
+        if (!ParseTaggedValue(tagged_value, &sequence, &type, &data)) {
+            LOG(ERROR) << "Invalid value of " << key << " in "
+                       << version->tables[i]->path;
+            return false;
+        }
+        if (type == ValueType_Deletion) {
+            return false;
+        }
+        value->assign(data.data(), data.size());
+        return true;
+    }
+    return false;
+}
+
+KVStore::Iterator* KVStore::Scan(const StringPiece& start) {
+    std::shared_ptr<MemTable> mem;
+    std::shared_ptr<MemTable> imm;
+    std::shared_ptr<Version> version;
+    uint64_t sequence;
+    {
+        MutexLocker locker(&m_mutex);
+        mem = m_mem;
+        imm = m_imm;
+        version = m_version;
+        sequence = m_sequence;
+    }
+    return new Iterator(mem, imm, version, sequence, start);
+}
+
+bool KVStore::Flush() {
+    // Queued as a writer, so no write is applied to the memtable switched.
+    Writer writer(&m_mutex, ValueType_Value, StringPiece(), StringPiece());
+    writer.flush = true;
+    MutexLocker locker(&m_mutex);
+    WaitForTurn(&writer);
+    bool ok = FlushMemTable();
+    FinishWriters(&writer, ok);
+    return ok;
+}
+
+bool KVStore::FlushMemTable() {
+    while (m_imm != NULL && !m_failed) {
+        m_background_cond.Wait();
+    }
+    if (m_failed) {
+        return false;
+    }
+    if (m_mem->IsEmpty()) {
+        return true;
+    }
+    if (!SwitchMemTable()) {
+        return false;
+    }
+    while (m_imm != NULL && !m_failed) {
+        m_background_cond.Wait();
+    }
+    return !m_failed;
+}
+
+void KVStore::WaitForIdle() {
+    MutexLocker locker(&m_mutex);
+    while (m_flush_scheduled || m_compaction_scheduled) {
+        m_background_cond.Wait();
+    }
+}
+
+int KVStore::NumTables() const {
+    MutexLocker locker(&m_mutex);
+    return m_version->tables.size();
+}
+
+void KVStore::MaybeScheduleCompaction() {
+    size_t first;
+    size_t last;
+    if (m_compaction_scheduled || m_closing || m_failed ||
+        !PickCompaction(*m_version, &first, &last)) {
+        return;
+    }
+    m_compaction_scheduled = true;
+    m_thread_pool.AddTask(std::bind(&KVStore::BackgroundCompaction, this));
+}
+
+bool KVStore::PickCompaction(const Version& version, size_t* first, size_t* last) const {
+    const std::vector<std::shared_ptr<Table> >& tables = version.tables;
+    size_t trigger = std::max(m_options.compaction_trigger, 2);
+    for (size_t i = 0; i + trigger <= tables.size(); ++i) {
+        // Tables of a tier are of similar sizes, the next tier is larger.
+        int64_t total_size = 0;
+        size_t j = i;
+        for (; j < tables.size() &&
+               j - i < static_cast<size_t>(m_options.max_compaction_width); ++j) {
+            if (j > i && tables[j]->size >
+                m_options.compaction_size_ratio * total_size / (j - i)) {
+                break;
+            }
+            total_size += tables[j]->size;
+        }
+        if (j - i >= trigger) {
+            *first = i;
+            *last = j;
+            return true;
+        }
+    }
+    return false;
+}
+
+void KVStore::BackgroundFlush() {
+    std::shared_ptr<MemTable> imm;
+    int64_t number;
+    int64_t log_number;
+    {
+        MutexLocker locker(&m_mutex);
+        imm = m_imm;
+        number = m_next_file_number++;
+        log_number = m_mem_log_number;
+    }
+
+    std::shared_ptr<Table> table;
+    scoped_ptr<SSTableReader::Iterator> iter(imm->Seek(StringPiece()));
+    bool ok = WriteTable(iter.get(), number, false, &table);
+    iter.reset();
+    if (ok) {
+        MutexLocker manifest_locker(&m_manifest_mutex);
+        std::shared_ptr<Version> version(new Version);
+        if (table != NULL) {
+            version->tables.push_back(table);
+        }
+        {
+            MutexLocker locker(&m_mutex);
+            version->tables.insert(version->tables.end(),
+                                   m_version->tables.begin(), m_version->tables.end());
+        }
+        ok = InstallVersion(version, log_number);
+    }
+    if (ok) {
+        // Writes of the memtable are in the sstable now.
+        RemoveLogs(log_number);
+    } else {
+        LOG(ERROR) << "Can't flush the memtable of " << m_dir;
+    }
+
+    MutexLocker locker(&m_mutex);
+    if (ok) {
+        m_imm.reset();
+    } else {
+        m_failed = true;
+    }
+    m_flush_scheduled = false;
+    MaybeScheduleCompaction();
+    m_background_cond.Broadcast();
+}
+
+void KVStore::BackgroundCompaction() {
+    std::vector<std::shared_ptr<Table> > inputs;
+    bool drop_deletions;
+    int64_t number;
+    {
+        MutexLocker locker(&m_mutex);
+        size_t first;
+        size_t last;
+        if (!PickCompaction(*m_version, &first, &last)) {
+            m_compaction_scheduled = false;
+            m_background_cond.Broadcast();
+            return;
+        }
+        inputs.assign(m_version->tables.begin() + first, m_version->tables.begin() + last);
+        // Nothing older is left to be deleted.
+        drop_deletions = last == m_version->tables.size();
+        number = m_next_file_number++;
+    }
+
+    // Runs are read by MergedSSTableReader, the newest entry of a key comes
+    // first.
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        paths.push_back(inputs[i]->path);
+    }
+    MergedSSTableReader reader;
+    std::shared_ptr<Table> table;
+    bool ok = reader.Open(paths, SSTableReader::ON_DISK, false);
+    if (ok) {
+        scoped_ptr<SSTableReader::Iterator> iter(reader.Seek(std::string()));
+        ok = WriteTable(iter.get(), number, drop_deletions, &table);
+    }
+    if (ok) {
+        MutexLocker manifest_locker(&m_manifest_mutex);
+        std::shared_ptr<Version> version(new Version);
+        {
+            MutexLocker locker(&m_mutex);
+            // Only flushes are installed meanwhile, which add newer tables.
+            const std::vector<std::shared_ptr<Table> >& tables = m_version->tables;
+            size_t first = std::find(tables.begin(), tables.end(), inputs[0]) - tables.begin();
+            CHECK_LE(first + inputs.size(), tables.size());
+            version->tables.assign(tables.begin(), tables.begin() + first);
+            if (table != NULL) {
+                version->tables.push_back(table);
+            }
+            version->tables.insert(version->tables.end(),
+                                   tables.begin() + first + inputs.size(), tables.end());
+        }
+        ok = InstallVersion(version, m_log_number);
+    }
+    LOG_IF(INFO, ok) << "Compacted " << inputs.size() << " sstables of " << m_dir
+                     << " into " << (table != NULL ? table->path : "nothing");
+    LOG_IF(ERROR, !ok) << "Can't compact sstables of " << m_dir;
+
+    MutexLocker locker(&m_mutex);
+    if (ok) {
+        // Deleted when no more read.
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            inputs[i]->obsolete = true;
+        }
+    } else {
+        m_failed = true;
+    }
+    m_compaction_scheduled = false;
+    MaybeScheduleCompaction();
+    m_background_cond.Broadcast();
+}
+
+bool KVStore::WriteTable(SSTableReader::Iterator* iter, int64_t number,
+                         bool drop_deletions, std::shared_ptr<Table>* table) {
+    SSTableWriteOption option;
+    option.set_path(TablePath(number));
+    option.set_temp_dir(m_dir);
+    option.set_block_size(m_options.block_size);
+    option.set_compress_type(m_options.compress_type);
+    option.set_bloom_filter_false_positive_prob(m_options.bloom_filter_false_positive_prob);
+    // Entries are added in order, so the sstable is sorted without sorting
+    // them again.
+    scoped_ptr<UnsortedSSTableWriter> writer;
+
+    std::string key;
+    std::string value;
+    bool has_key = false;
+    for (; iter->Valid(); iter->Next()) {
+        StringPiece key_piece = iter->key_piece();
+        if (has_key && key_piece == key) {
+            // Older ones.
+            continue;
+        }
+        key.assign(key_piece.data(), key_piece.size());
+        has_key = true;
+
+        StringPiece value_piece = iter->value_piece();
+        uint64_t sequence;
+        ValueType type;
+        StringPiece data;
+        if (!ParseTaggedValue(value_piece, &sequence, &type, &data)) {
+            LOG(ERROR) << "Invalid value of " << key;
+            return false;
+        }
+        if (drop_deletions && type == ValueType_Deletion) {
+            continue;
+        }
+        if (writer == NULL) {
+            writer.reset(new UnsortedSSTableWriter(option));
+        }
+        value.assign(value_piece.data(), value_piece.size());
+        if (!writer->Add(key, value)) {
+            LOG(ERROR) << "Can't write " << option.path();
+            return false;
+        }
+    }
+
+    table->reset();
+    if (writer == NULL) {
+        return true;
+    }
+    if (!writer->Flush()) {
+        LOG(ERROR) << "Can't write " << option.path();
+        return false;
+    }
+    if (m_options.log_options.sync && !SyncPath(option.path())) {
+        LOG(ERROR) << "Can't sync " << option.path() << ": " << strerror(errno);
+        return false;
+    }
+    *table = OpenTable(number);
+    return *table != NULL;
+}
+
+std::shared_ptr<KVStore::Table> KVStore::OpenTable(int64_t number) {
+    std::shared_ptr<Table> table(new Table);
+    table->number = number;
+    table->path = TablePath(number);
+    table->size = FileSize(table->path);
+    table->reader.reset(SSTableReader::Open(table->path, m_options.read_mode));
+    if (table->size < 0 || table->reader == NULL) {
+        LOG(ERROR) << "Can't open sstable " << table->path;
+        return std::shared_ptr<Table>();
+    }
+    return table;
+}
+
+bool KVStore::InstallVersion(const std::shared_ptr<Version>& new_version,
+                             int64_t log_number) {
+    int64_t next_file_number;
+    uint64_t sequence;
+    {
+        MutexLocker locker(&m_mutex);
+        next_file_number = m_next_file_number;
+        sequence = m_sequence;
+    }
+    if (!WriteManifest(*new_version, log_number, next_file_number, sequence)) {
+        return false;
+    }
+    m_log_number = log_number;
+    MutexLocker locker(&m_mutex);
+    m_version = new_version;
+    return true;
+}
+
+bool KVStore::WriteManifest(const Version& version, int64_t log_number,
+                            int64_t next_file_number, uint64_t sequence) {
+    std::string content;
+    content += "next_file_number " + NumberToString(next_file_number) + "\n";
+    content += "sequence " + NumberToString(sequence) + "\n";
+    content += "log_number " + NumberToString(log_number) + "\n";
+    for (size_t i = 0; i < version.tables.size(); ++i) {
+        content += "table " + NumberToString(version.tables[i]->number) + "\n";
+    }
+
+    // Replaced as a whole by rename.
+    std::string temp_path = ManifestPath() + ".tmp";
+    scoped_ptr<File> file(File::Open(temp_path, "w"));
+    if (file == NULL) {
+        LOG(ERROR) << "Can't open " << temp_path;
+        return false;
+    }
+    bool ok = file->Write(content.data(), content.size()) ==
+                  static_cast<int64_t>(content.size()) &&
+              (m_options.log_options.sync ? file->Sync() : file->Flush());
+    ok = file->Close() && ok;
+    if (!ok || !File::Rename(temp_path, ManifestPath()) ||
+        (m_options.log_options.sync && !SyncPath(m_dir))) {
+        LOG(ERROR) << "Can't write " << ManifestPath() << ": " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+KVStore::Iterator::Iterator(const std::shared_ptr<MemTable>& mem,
+                            const std::shared_ptr<MemTable>& imm,
+                            const std::shared_ptr<Version>& version,
+                            uint64_t sequence,
+                            const StringPiece& start)
+    : m_mem(mem),
+      m_imm(imm),
+      m_version(version),
+      m_sequence(sequence),
+      m_valid(false),
+      m_has_key(false) {
+    // Entries of the same key are ordered by tagged values in the heap, so
+    // the newest one comes first.
+    m_heap.Push(m_mem->Seek(start));
+    if (m_imm != NULL) {
+        m_heap.Push(m_imm->Seek(start));
+    }
+    std::string start_key = start.as_string();
+    for (size_t i = 0; i < m_version->tables.size(); ++i) {
+        m_heap.Push(m_version->tables[i]->reader->Seek(start_key));
+    }
+    FindNextEntry();
+}
+
+KVStore::Iterator::~Iterator() {
+}
+
+void KVStore::Iterator::Next() {
+    CHECK(m_valid);
+    m_heap.Next();
+    FindNextEntry();
+}
+
+void KVStore::Iterator::FindNextEntry() {
+    m_valid = false;
+    for (; !m_heap.IsEmpty(); m_heap.Next()) {
+        SSTableReader::Iterator* top = m_heap.Top();
+        StringPiece key = top->key_piece();
+        uint64_t sequence;
+        ValueType type;
+        StringPiece value;
+        if (!ParseTaggedValue(top->value_piece(), &sequence, &type, &value)) {
+            LOG(ERROR) << "Invalid value of " << key;
+            continue;
+        }
+        if (sequence > m_sequence || (m_has_key && key == m_key)) {
+            // Written after the iterator is created, or older ones.
+            continue;
+        }
+        m_key.assign(key.data(), key.size());
+        m_has_key = true;
+        if (type == ValueType_Value) {
+            m_value = value;
+            m_valid = true;
+            return;
+        }
+    }
+}
+
+} // namespace toft
@@ -0,0 +1,251 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Embedded key-value store of the log-structured merge tree:
+//
+//   scoped_ptr<KVStore> store(KVStore::Open("/data/kv", KVStoreOptions()));
+//   CHECK(store != NULL);
+//   store->Put("key", "value");
+//   std::string value;
+//   if (store->Get("key", &value)) ...
+//   scoped_ptr<KVStore::Iterator> iter(store->Scan("k"));
+//   for (; iter->Valid(); iter->Next()) ...
+//
+// Writes are queued, the first writer logs the writes queued behind it to
+// the WriteAheadLog as a group, and applies them to a memtable after they
+// are committed. A full memtable is frozen
+// and flushed to a new sstable in the background, and sstables of similar
+// sizes are merged into one by size-tiered compaction, both on a ThreadPool.
+// The live sstables are listed in the MANIFEST file of the directory.
+//
+// It's thread safe.
+
+#ifndef TOFT_STORAGE_KV_KV_STORE_H
+#define TOFT_STORAGE_KV_KV_STORE_H
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "toft/base/shared_ptr.h"
+#include "toft/base/string/string_piece.h"
+#include "toft/base/uncopyable.h"
+#include "toft/storage/kv/memtable.h"
+#include "toft/storage/recordio/write_ahead_log.h"
+#include "toft/storage/sstable/reader/iterator_heap.h"
+#include "toft/storage/sstable/sstable_reader.h"
+#include "toft/storage/sstable/types.h"
+#include "toft/system/threading/condition_variable.h"
+#include "toft/system/threading/mutex.h"
+#include "toft/system/threading/thread_pool.h"
+
+namespace toft {
+
+struct KVStoreOptions {
+    KVStoreOptions()
+        : create_if_missing(true),
+          memtable_size(4 * 1024 * 1024),
+          background_threads(2),
+          compaction_trigger(4),
+          max_compaction_width(32),
+          compaction_size_ratio(2.0),
+          max_tables(24),
+          block_size(64 * 1024),
+          compress_type(CompressType_kUnCompress),
+          bloom_filter_false_positive_prob(0.01),
+          read_mode(SSTableReader::MMAP) {
+        // As written to the file system, writes survive a crash of the
+        // process but not of the machine.
+        log_options.sync = false;
+    }
+
+    bool create_if_missing;
+    // A memtable is flushed when its memory gets larger.
+    size_t memtable_size;
+    // Threads to flush memtables and compact sstables.
+    int background_threads;
+
+    // Size-tiered compaction merges at least compaction_trigger and at most
+    // max_compaction_width adjacent sstables, from the newest to the oldest,
+    // as long as the next one is no larger than compaction_size_ratio times
+    // the average of those before it.
+    int compaction_trigger;
+    int max_compaction_width;
+    double compaction_size_ratio;
+    // Writes wait for compactions while there are so many sstables.
+    int max_tables;
+
+    // Of sstables.
+    int block_size;
+    CompressType compress_type;
+    double bloom_filter_false_positive_prob;
+    SSTableReader::ReadMode read_mode;
+
+    WriteAheadLogOptions log_options;
+};
+
+class KVStore {
+    TOFT_DECLARE_UNCOPYABLE(KVStore);
+
+    struct Table;
+    struct Version;
+    struct Writer;
+
+public:
+    class Iterator;
+
+    // Open the store in dir, recover writes in the log. Return NULL if
+    // failed.
+    static KVStore* Open(const std::string& dir, const KVStoreOptions& options);
+    // Wait for the background flush and compaction. Writes of the memtable
+    // are kept in the log.
+    ~KVStore();
+
+    // Return false if the write can't be logged, then the store fails and
+    // no more writes are accepted.
+    bool Put(const StringPiece& key, const StringPiece& value);
+    bool Delete(const StringPiece& key);
+
+    // Return false if key is not found.
+    bool Get(const StringPiece& key, std::string* value);
+
+    // New an iterator to the first key not less than start. It sees the
+    // snapshot of the store when it's created. The caller owns the iterator.
+    Iterator* Scan(const StringPiece& start);
+
+    // Flush the memtable into an sstable and wait for it.
+    bool Flush();
+    // Wait until there is no flush or compaction in the background.
+    void WaitForIdle();
+
+    int NumTables() const;
+
+private:
+    KVStore(const std::string& dir, const KVStoreOptions& options);
+
+    bool Recover();
+    bool LoadManifest(std::vector<int64_t>* table_numbers);
+    bool ReplayLog(const std::string& path);
+    // Remove log segments before log_number and sstables not in the current
+    // version.
+    void RemoveObsoleteFiles(int64_t log_number);
+    void RemoveLogs(int64_t log_number);
+
+    bool Write(ValueType type, const StringPiece& key, const StringPiece& value);
+    // Queue writer and wait until it's the first one or done by the first
+    // one, m_mutex is held.
+    void WaitForTurn(Writer* writer);
+    // Pop the writers until last, which are done with ok, and wake up the
+    // next first one, m_mutex is held.
+    void FinishWriters(Writer* last, bool ok);
+    // Switch memtables if the current one is full, m_mutex is held by the
+    // first writer.
+    bool MakeRoomForWrite();
+    // Called by the first writer, m_mutex is released while rotating the
+    // log.
+    bool SwitchMemTable();
+    // Switch the memtable and wait for its flush, by the first writer.
+    bool FlushMemTable();
+
+    void MaybeScheduleCompaction();
+    void BackgroundFlush();
+    void BackgroundCompaction();
+    // Pick adjacent tables of version to compact into [*first, *last).
+    bool PickCompaction(const Version& version, size_t* first, size_t* last) const;
+    // Write entries of iter into a new sstable, only the newest entry of a
+    // key is kept. *table is NULL if nothing is left.
+    bool WriteTable(SSTableReader::Iterator* iter, int64_t number,
+                    bool drop_deletions, std::shared_ptr<Table>* table);
+    std::shared_ptr<Table> OpenTable(int64_t number);
+    // Make new_version current after it's recorded in the manifest along
+    // with log_number, m_manifest_mutex is held.
+    bool InstallVersion(const std::shared_ptr<Version>& new_version, int64_t log_number);
+    bool WriteManifest(const Version& version, int64_t log_number,
+                       int64_t next_file_number, uint64_t sequence);
+
+    std::string TablePath(int64_t number) const;
+    std::string LogDir() const;
+    std::string ManifestPath() const;
+
+private:
+    const std::string m_dir;
+    const KVStoreOptions m_options;
+
+    mutable Mutex m_mutex;
+    // Signaled when a background flush or compaction is done.
+    ConditionVariable m_background_cond;
+    // Of the last write applied to the memtable.
+    uint64_t m_sequence;
+    // Writers waiting, the first one writes for those behind it.
+    std::deque<Writer*> m_writers;
+    int64_t m_next_file_number;
+    std::shared_ptr<MemTable> m_mem;
+    // The memtable being flushed.
+    std::shared_ptr<MemTable> m_imm;
+    // First log segment of writes in m_mem.
+    int64_t m_mem_log_number;
+    std::shared_ptr<Version> m_version;
+    bool m_flush_scheduled;
+    bool m_compaction_scheduled;
+    bool m_closing;
+    bool m_failed;
+
+    // Serializes updates of the manifest by flushes and compactions.
+    Mutex m_manifest_mutex;
+    // First log segment not flushed, in the manifest.
+    int64_t m_log_number;
+    WriteAheadLog m_log;
+    ThreadPool m_thread_pool;
+};
+
+class KVStore::Iterator {
+    TOFT_DECLARE_UNCOPYABLE(Iterator);
+
+public:
+    ~Iterator();
+
+    bool Valid() const {
+        return m_valid;
+    }
+    // Only valid until the iterator is moved.
+    StringPiece key() const {
+        return m_key;
+    }
+    StringPiece value() const {
+        return m_value;
+    }
+    void Next();
+
+private:
+    friend class KVStore;
+    Iterator(const std::shared_ptr<MemTable>& mem,
+             const std::shared_ptr<MemTable>& imm,
+             const std::shared_ptr<Version>& version,
+             uint64_t sequence,
+             const StringPiece& start);
+
+    // Find the newest entry of the next key which is not deleted, from the
+    // top of m_heap.
+    void FindNextEntry();
+
+private:
+    std::shared_ptr<MemTable> m_mem;
+    std::shared_ptr<MemTable> m_imm;
+    std::shared_ptr<Version> m_version;
+    // Entries written after it are not seen.
+    uint64_t m_sequence;
+    // Of the memtables and sstables.
+    IteratorHeap m_heap;
+    bool m_valid;
+    // Key of the last entry found, older entries of it are skipped.
+    std::string m_key;
+    bool m_has_key;
+    StringPiece m_value;
+};
+
+} // namespace toft
+
+#endif // TOFT_STORAGE_KV_KV_STORE_H
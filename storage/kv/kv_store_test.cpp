@@ -0,0 +1,275 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/kv/kv_store.h"
+
+#include <stdio.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/base/random.h"
+#include "toft/base/scoped_ptr.h"
+#include "toft/storage/file/file.h"
+#include "toft/system/threading/thread.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+static const char kDir[] = "./kv_store_test";
+
+static void RemoveFiles(const std::string& dir) {
+    scoped_ptr<FileIterator> iter(File::Iterate(dir, "*", FileType_Regular));
+    if (iter == NULL)
+        return;
+    FileEntry entry;
+    while (iter->GetNext(&entry))
+        File::Delete(dir + "/" + entry.name);
+}
+
+static std::string MakeKey(int index) {
+    char key[32];
+    snprintf(key, sizeof(key), "key%08d", index);
+    return key;
+}
+
+class KVStoreTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        RemoveFiles(std::string(kDir) + "/wal");
+        RemoveFiles(kDir);
+        Reopen();
+    }
+
+    void Reopen() {
+        m_store.reset();
+        m_store.reset(KVStore::Open(kDir, m_options));
+        ASSERT_TRUE(m_store != NULL);
+    }
+
+    std::string Get(const std::string& key) {
+        std::string value;
+        return m_store->Get(key, &value) ? value : "NOT_FOUND";
+    }
+
+    std::string ScanAll(const std::string& start) {
+        scoped_ptr<KVStore::Iterator> iter(m_store->Scan(start));
+        std::string result;
+        for (; iter->Valid(); iter->Next()) {
+            result += iter->key().as_string() + "=" + iter->value().as_string() + ",";
+        }
+        return result;
+    }
+
+    // Check the store has exactly the entries of model.
+    void Verify(const std::map<std::string, std::string>& model) {
+        scoped_ptr<KVStore::Iterator> iter(m_store->Scan(""));
+        std::map<std::string, std::string>::const_iterator it = model.begin();
+        for (; it != model.end(); ++it) {
+            ASSERT_TRUE(iter->Valid()) << it->first;
+            ASSERT_EQ(it->first, iter->key().as_string());
+            ASSERT_EQ(it->second, iter->value().as_string());
+            ASSERT_EQ(it->second, Get(it->first));
+            iter->Next();
+        }
+        EXPECT_FALSE(iter->Valid());
+    }
+
+    KVStoreOptions m_options;
+    scoped_ptr<KVStore> m_store;
+};
+
+TEST_F(KVStoreTest, PutGetDelete) {
+    EXPECT_EQ("NOT_FOUND", Get("a"));
+    ASSERT_TRUE(m_store->Put("a", "1"));
+    ASSERT_TRUE(m_store->Put("b", "2"));
+    EXPECT_EQ("1", Get("a"));
+    EXPECT_EQ("2", Get("b"));
+    ASSERT_TRUE(m_store->Put("a", "3"));
+    EXPECT_EQ("3", Get("a"));
+    ASSERT_TRUE(m_store->Delete("a"));
+    EXPECT_EQ("NOT_FOUND", Get("a"));
+    ASSERT_TRUE(m_store->Delete("not_exist"));
+    ASSERT_TRUE(m_store->Put("", "empty key"));
+    EXPECT_EQ("empty key", Get(""));
+
+    // Found in sstables.
+    ASSERT_TRUE(m_store->Flush());
+    EXPECT_EQ(1, m_store->NumTables());
+    EXPECT_EQ("NOT_FOUND", Get("a"));
+    EXPECT_EQ("2", Get("b"));
+    ASSERT_TRUE(m_store->Put("a", "4"));
+    ASSERT_TRUE(m_store->Delete("b"));
+    ASSERT_TRUE(m_store->Flush());
+    EXPECT_EQ(2, m_store->NumTables());
+    EXPECT_EQ("4", Get("a"));
+    EXPECT_EQ("NOT_FOUND", Get("b"));
+}
+
+TEST_F(KVStoreTest, Scan) {
+    ASSERT_TRUE(m_store->Put("a", "1"));
+    ASSERT_TRUE(m_store->Put("c", "2"));
+    ASSERT_TRUE(m_store->Put("e", "3"));
+    ASSERT_TRUE(m_store->Flush());
+    ASSERT_TRUE(m_store->Put("b", "4"));
+    ASSERT_TRUE(m_store->Put("c", "5"));
+    ASSERT_TRUE(m_store->Delete("e"));
+    ASSERT_TRUE(m_store->Flush());
+    ASSERT_TRUE(m_store->Put("d", "6"));
+    ASSERT_TRUE(m_store->Delete("a"));
+
+    EXPECT_EQ("b=4,c=5,d=6,", ScanAll(""));
+    EXPECT_EQ("c=5,d=6,", ScanAll("bb"));
+    EXPECT_EQ("", ScanAll("e"));
+}
+
+TEST_F(KVStoreTest, ScanSnapshot) {
+    ASSERT_TRUE(m_store->Put("a", "1"));
+    ASSERT_TRUE(m_store->Put("b", "2"));
+    scoped_ptr<KVStore::Iterator> iter(m_store->Scan(""));
+    ASSERT_TRUE(m_store->Put("a", "3"));
+    ASSERT_TRUE(m_store->Delete("b"));
+    ASSERT_TRUE(m_store->Put("c", "4"));
+    // Sstables read by the iterator are kept even if compacted.
+    ASSERT_TRUE(m_store->Flush());
+
+    std::string result;
+    for (; iter->Valid(); iter->Next()) {
+        result += iter->key().as_string() + "=" + iter->value().as_string() + ",";
+    }
+    EXPECT_EQ("a=1,b=2,", result);
+    EXPECT_EQ("a=3,c=4,", ScanAll(""));
+}
+
+TEST_F(KVStoreTest, Recover) {
+    ASSERT_TRUE(m_store->Put("a", "1"));
+    ASSERT_TRUE(m_store->Put("b", "2"));
+    ASSERT_TRUE(m_store->Flush());
+    ASSERT_TRUE(m_store->Put("a", "3"));
+    ASSERT_TRUE(m_store->Delete("b"));
+    ASSERT_TRUE(m_store->Put("c", "4"));
+
+    // Writes not flushed are replayed from the log.
+    Reopen();
+    EXPECT_EQ(1, m_store->NumTables());
+    EXPECT_EQ("a=3,c=4,", ScanAll(""));
+    ASSERT_TRUE(m_store->Put("d", "5"));
+    Reopen();
+    EXPECT_EQ("a=3,c=4,d=5,", ScanAll(""));
+
+    ASSERT_TRUE(m_store->Flush());
+    Reopen();
+    EXPECT_EQ("a=3,c=4,d=5,", ScanAll(""));
+    // Sequences go on after the sstables.
+    ASSERT_TRUE(m_store->Put("a", "6"));
+    EXPECT_EQ("6", Get("a"));
+    Reopen();
+    EXPECT_EQ("6", Get("a"));
+}
+
+TEST_F(KVStoreTest, Compaction) {
+    m_options.memtable_size = 64 * 1024;
+    m_options.block_size = 4096;
+    Reopen();
+
+    std::map<std::string, std::string> model;
+    Random random(301);
+    for (int i = 0; i < 50000; ++i) {
+        std::string key = MakeKey(random.Uniform(5000));
+        if (random.OneIn(5)) {
+            ASSERT_TRUE(m_store->Delete(key));
+            model.erase(key);
+        } else {
+            std::string value = key + ":" + std::string(random.Uniform(100), 'v');
+            ASSERT_TRUE(m_store->Put(key, value));
+            model[key] = value;
+        }
+    }
+    ASSERT_TRUE(m_store->Flush());
+    m_store->WaitForIdle();
+    // Many more memtables are flushed.
+    EXPECT_LT(m_store->NumTables(), m_options.compaction_trigger * 3);
+    Verify(model);
+
+    Reopen();
+    Verify(model);
+
+    // Only sstables in the manifest are left.
+    scoped_ptr<FileIterator> iter(File::Iterate(kDir, "*.sst", FileType_Regular));
+    ASSERT_TRUE(iter != NULL);
+    int num_files = 0;
+    FileEntry entry;
+    while (iter->GetNext(&entry))
+        ++num_files;
+    EXPECT_EQ(m_store->NumTables(), num_files);
+}
+
+static void PutKeys(KVStore* store, int thread, int count) {
+    for (int i = 0; i < count; ++i) {
+        std::string key = MakeKey(thread * count + i);
+        ASSERT_TRUE(store->Put(key, key));
+    }
+}
+
+TEST_F(KVStoreTest, Threads) {
+    const int kThreads = 4;
+    const int kKeys = 5000;
+    m_options.memtable_size = 64 * 1024;
+    Reopen();
+
+    std::vector<Thread*> threads;
+    for (int i = 0; i < kThreads; ++i)
+        threads.push_back(new Thread(std::bind(&PutKeys, m_store.get(), i, kKeys)));
+    // Read while writing.
+    for (int i = 0; i < 1000; ++i) {
+        std::string value;
+        std::string key = MakeKey(i);
+        if (m_store->Get(key, &value))
+            ASSERT_EQ(key, value);
+    }
+    for (int i = 0; i < kThreads; ++i) {
+        threads[i]->Join();
+        delete threads[i];
+    }
+
+    std::map<std::string, std::string> model;
+    for (int i = 0; i < kThreads * kKeys; ++i)
+        model[MakeKey(i)] = MakeKey(i);
+    Verify(model);
+    Reopen();
+    Verify(model);
+}
+
+TEST_F(KVStoreTest, FlushWhileWriting) {
+    const int kThreads = 4;
+    const int kKeys = 2000;
+    std::vector<Thread*> threads;
+    for (int i = 0; i < kThreads; ++i)
+        threads.push_back(new Thread(std::bind(&PutKeys, m_store.get(), i, kKeys)));
+    // Flushes are queued with the writes, none is lost in a switch.
+    for (int i = 0; i < 10; ++i)
+        ASSERT_TRUE(m_store->Flush());
+    for (int i = 0; i < kThreads; ++i) {
+        threads[i]->Join();
+        delete threads[i];
+    }
+
+    std::map<std::string, std::string> model;
+    for (int i = 0; i < kThreads * kKeys; ++i)
+        model[MakeKey(i)] = MakeKey(i);
+    Verify(model);
+    Reopen();
+    Verify(model);
+}
+
+TEST_F(KVStoreTest, MissingDir) {
+    KVStoreOptions options;
+    options.create_if_missing = false;
+    scoped_ptr<KVStore> store(KVStore::Open("./kv_store_test_missing", options));
+    EXPECT_TRUE(store == NULL);
+}
+
+} // namespace toft
@@ -0,0 +1,128 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/kv/memtable.h"
+
+#include <string.h>
+
+#include "toft/encoding/varint.h"
+
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+
+namespace {
+
+// Decode the key and the tagged value of an entry, which are valid.
+void DecodeEntry(const char* entry, StringPiece* key, StringPiece* tagged_value) {
+    uint32_t size;
+    const char* p = Varint::Decode32(entry, entry + 5, &size);
+    key->set(p, size);
+    p += size;
+    const char* value = Varint::Decode32(p, p + 5, &size);
+    tagged_value->set(value, size);
+}
+
+} // namespace
+
+int MemTable::KeyComparator::operator()(const char* a, const char* b) const {
+    StringPiece a_key, a_value, b_key, b_value;
+    DecodeEntry(a, &a_key, &a_value);
+    DecodeEntry(b, &b_key, &b_value);
+    int result = a_key.compare(b_key);
+    if (result != 0) {
+        return result;
+    }
+    // The newer, the smaller the tag.
+    return memcmp(a_value.data(), b_value.data(), kValueTagSize);
+}
+
+class MemTable::Iterator : public SSTableReader::Iterator {
+    TOFT_DECLARE_UNCOPYABLE(Iterator);
+
+public:
+    explicit Iterator(const Table* table) : m_iter(table) {}
+
+    virtual void Next() {
+        m_iter.Next();
+        Update();
+    }
+
+    virtual void SeekKey(const std::string& key) {
+        std::string entry;
+        Varint::PutLengthPrefixedStringPiece(&entry, key);
+        // The smallest tag, before all entries of key.
+        Varint::PutLengthPrefixedStringPiece(
+            &entry, StringPiece(std::string(kValueTagSize, '\0')));
+        m_iter.Seek(entry.data());
+        Update();
+    }
+
+    virtual StringPiece key_piece() const {
+        return m_key;
+    }
+    virtual StringPiece value_piece() const {
+        return m_value;
+    }
+
+private:
+    void Update() {
+        valid_ = m_iter.Valid();
+        if (valid_) {
+            DecodeEntry(m_iter.key(), &m_key, &m_value);
+        }
+    }
+
+private:
+    Table::Iterator m_iter;
+    StringPiece m_key;
+    StringPiece m_value;
+};
+
+MemTable::MemTable()
+    : m_table(KeyComparator(), &m_arena),
+      m_num_entries(0) {
+}
+
+MemTable::~MemTable() {
+}
+
+void MemTable::Add(uint64_t sequence, ValueType type,
+                   const StringPiece& key, const StringPiece& value) {
+    size_t tagged_size = kValueTagSize + value.size();
+    size_t size = Varint::EncodedLength(key) +
+                  Varint::EncodedLength(tagged_size) + tagged_size;
+    char* entry = m_arena.Allocate(size);
+    char* p = Varint::UnsafeEncode32(entry, key.size());
+    memcpy(p, key.data(), key.size());
+    p = Varint::UnsafeEncode32(p + key.size(), tagged_size);
+    EncodeValueTag(sequence, type, p);
+    memcpy(p + kValueTagSize, value.data(), value.size());
+    m_table.Insert(entry);
+    ++m_num_entries;
+}
+
+bool MemTable::Get(const StringPiece& key, std::string* value, bool* deleted) const {
+    Iterator iter(&m_table);
+    iter.SeekKey(key.as_string());
+    if (!iter.Valid() || iter.key_piece() != key) {
+        return false;
+    }
+    uint64_t sequence;
+    ValueType type;
+    StringPiece data;
+    CHECK(ParseTaggedValue(iter.value_piece(), &sequence, &type, &data));
+    *deleted = type == ValueType_Deletion;
+    if (!*deleted) {
+        value->assign(data.data(), data.size());
+    }
+    return true;
+}
+
+SSTableReader::Iterator* MemTable::Seek(const StringPiece& key) const {
+    Iterator* iter = new Iterator(&m_table);
+    iter->SeekKey(key.as_string());
+    return iter;
+}
+
+} // namespace toft
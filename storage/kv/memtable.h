@@ -0,0 +1,73 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// In memory table of KVStore, a SkipList of entries allocated in an Arena.
+// Every write is a new entry, the entries of a key are ordered from the
+// newest to the oldest. Add needs external synchronization, while Get and
+// iterators can run concurrently with it.
+
+#ifndef TOFT_STORAGE_KV_MEMTABLE_H
+#define TOFT_STORAGE_KV_MEMTABLE_H
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "toft/base/arena.h"
+#include "toft/base/string/string_piece.h"
+#include "toft/base/uncopyable.h"
+#include "toft/container/skiplist.h"
+#include "toft/storage/kv/format.h"
+#include "toft/storage/sstable/sstable_reader.h"
+
+namespace toft {
+
+class MemTable {
+    TOFT_DECLARE_UNCOPYABLE(MemTable);
+
+public:
+    MemTable();
+    ~MemTable();
+
+    void Add(uint64_t sequence, ValueType type,
+             const StringPiece& key, const StringPiece& value);
+
+    // Return false if there is no entry of key, otherwise the newest entry
+    // is a deletion if *deleted is true, or its value is in *value.
+    bool Get(const StringPiece& key, std::string* value, bool* deleted) const;
+
+    // New an iterator to the first entry of key or after. As an sstable
+    // iterator, key_piece() is the user key and value_piece() is the tagged
+    // value. The caller owns the iterator, which must be deleted before the
+    // memtable.
+    SSTableReader::Iterator* Seek(const StringPiece& key) const;
+
+    bool IsEmpty() const {
+        return m_num_entries == 0;
+    }
+    int64_t NumEntries() const {
+        return m_num_entries;
+    }
+    size_t MemoryUsage() const {
+        return m_arena.MemoryUsage();
+    }
+
+private:
+    // Entries are the length prefixed key and the length prefixed tagged
+    // value.
+    struct KeyComparator {
+        int operator()(const char* a, const char* b) const;
+    };
+    typedef SkipList<const char*, KeyComparator> Table;
+    class Iterator;
+
+private:
+    Arena m_arena;
+    Table m_table;
+    int64_t m_num_entries;
+};
+
+} // namespace toft
+
+#endif // TOFT_STORAGE_KV_MEMTABLE_H
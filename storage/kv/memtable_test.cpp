@@ -0,0 +1,90 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/kv/memtable.h"
+
+#include <string>
+
+#include "toft/base/scoped_ptr.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+TEST(MemTable, Get) {
+    MemTable table;
+    EXPECT_TRUE(table.IsEmpty());
+    table.Add(1, ValueType_Value, "b", "b1");
+    table.Add(2, ValueType_Value, "a", "a2");
+    table.Add(3, ValueType_Value, "b", "b3");
+    table.Add(4, ValueType_Deletion, "a", "");
+    table.Add(5, ValueType_Value, "", "empty");
+    EXPECT_EQ(5, table.NumEntries());
+
+    std::string value;
+    bool deleted;
+    ASSERT_TRUE(table.Get("b", &value, &deleted));
+    EXPECT_FALSE(deleted);
+    EXPECT_EQ("b3", value);
+    ASSERT_TRUE(table.Get("a", &value, &deleted));
+    EXPECT_TRUE(deleted);
+    ASSERT_TRUE(table.Get("", &value, &deleted));
+    EXPECT_FALSE(deleted);
+    EXPECT_EQ("empty", value);
+    EXPECT_FALSE(table.Get("c", &value, &deleted));
+    EXPECT_FALSE(table.Get("aa", &value, &deleted));
+}
+
+TEST(MemTable, Seek) {
+    MemTable table;
+    table.Add(1, ValueType_Value, "b", "b1");
+    table.Add(2, ValueType_Value, "a", "a2");
+    table.Add(3, ValueType_Value, "b", "b3");
+    table.Add(4, ValueType_Deletion, "c", "");
+
+    // Entries of a key are from the newest to the oldest.
+    const char* expected_keys[] = { "a", "b", "b", "c" };
+    const uint64_t expected_sequences[] = { 2, 3, 1, 4 };
+    scoped_ptr<SSTableReader::Iterator> iter(table.Seek(""));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(iter->Valid());
+        EXPECT_EQ(expected_keys[i], iter->key());
+        uint64_t sequence;
+        ValueType type;
+        StringPiece value;
+        ASSERT_TRUE(ParseTaggedValue(iter->value_piece(), &sequence, &type, &value));
+        EXPECT_EQ(expected_sequences[i], sequence);
+        EXPECT_EQ(i == 3 ? ValueType_Deletion : ValueType_Value, type);
+        iter->Next();
+    }
+    EXPECT_FALSE(iter->Valid());
+
+    iter->SeekKey("b");
+    ASSERT_TRUE(iter->Valid());
+    EXPECT_EQ("b", iter->key());
+    iter->SeekKey("bb");
+    ASSERT_TRUE(iter->Valid());
+    EXPECT_EQ("c", iter->key());
+    iter->SeekKey("d");
+    EXPECT_FALSE(iter->Valid());
+}
+
+TEST(MemTable, TaggedValueOrder) {
+    // The newer, the smaller, of the same key.
+    std::string older;
+    std::string newer;
+    AppendTaggedValue(100, ValueType_Value, "z", &older);
+    AppendTaggedValue(101, ValueType_Deletion, "", &newer);
+    EXPECT_LT(newer, older);
+
+    uint64_t sequence;
+    ValueType type;
+    StringPiece value;
+    ASSERT_TRUE(ParseTaggedValue(older, &sequence, &type, &value));
+    EXPECT_EQ(100U, sequence);
+    EXPECT_EQ(ValueType_Value, type);
+    EXPECT_EQ("z", value);
+    EXPECT_FALSE(ParseTaggedValue("short", &sequence, &type, &value));
+}
+
+} // namespace toft
@@ -0,0 +1,200 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/recordio/readahead_reader.h"
+
+#include <algorithm>
+
+#include "toft/base/functional.h"
+
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+
+ReadaheadReader::ReadaheadReader(File* file, size_t buffer_size, bool async)
+    : m_file(file),
+      m_buffer_size(buffer_size),
+      m_async(async),
+      m_current(-1),
+      m_position(0),
+      m_offset(0),
+      m_eof(false),
+      m_cond(&m_mutex),
+      m_stopping(false),
+      m_filling(false),
+      m_busy(false),
+      m_fill_index(0),
+      m_error(false) {
+    CHECK_GT(buffer_size, 0U);
+}
+
+ReadaheadReader::~ReadaheadReader() {
+    StopReading();
+}
+
+bool ReadaheadReader::Seek(int64_t offset) {
+    PauseReading();
+    if (!m_file->Seek(offset, SEEK_SET)) {
+        LOG(ERROR) << "Seek error.";
+        return false;
+    }
+    MutexLocker locker(&m_mutex);
+    for (int i = 0; i < 2; ++i) {
+        m_chunks[i].size = 0;
+        m_chunks[i].ready = false;
+    }
+    m_current = -1;
+    m_position = 0;
+    m_offset = offset;
+    m_eof = false;
+    m_error = false;
+    m_fill_index = 0;
+    // Read ahead from here, by the thread started or to be started.
+    m_filling = m_async;
+    m_cond.Broadcast();
+    return true;
+}
+
+int64_t ReadaheadReader::Size() {
+    // The file is not shared with the reading thread while seeking.
+    PauseReading();
+    int64_t size = -1;
+    if (m_file->Seek(0, SEEK_END)) {
+        size = m_file->Tell();
+    }
+    if (size < 0) {
+        LOG(ERROR) << "Can't get the file size.";
+    }
+    // Go on from where it was.
+    if (!Seek(m_offset)) {
+        return -1;
+    }
+    return size;
+}
+
+void ReadaheadReader::PauseReading() {
+    MutexLocker locker(&m_mutex);
+    m_filling = false;
+    while (m_busy)
+        m_cond.Wait();
+}
+
+void ReadaheadReader::StopReading() {
+    if (m_thread == NULL)
+        return;
+    {
+        MutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_cond.Broadcast();
+    }
+    m_thread->Join();
+    m_thread.reset();
+    m_stopping = false;
+}
+
+bool ReadaheadReader::FillChunk(Chunk* chunk) {
+    if (chunk->data == NULL)
+        chunk->data.reset(new char[m_buffer_size]);
+    chunk->size = 0;
+    while (chunk->size < m_buffer_size) {
+        int64_t ret = m_file->Read(chunk->data.get() + chunk->size,
+                                   m_buffer_size - chunk->size);
+        if (ret < 0) {
+            LOG(ERROR) << "Read error.";
+            return false;
+        }
+        if (ret == 0)
+            break;
+        chunk->size += ret;
+    }
+    return true;
+}
+
+void ReadaheadReader::ReadaheadLoop() {
+    // Chunks are filled in turn, and taken in the same order. A seek pauses
+    // the loop and sets where to go on.
+    MutexLocker locker(&m_mutex);
+    for (;;) {
+        while (!m_stopping && (!m_filling || m_chunks[m_fill_index].ready))
+            m_cond.Wait();
+        if (m_stopping)
+            return;
+        Chunk* chunk = &m_chunks[m_fill_index];
+        m_busy = true;
+        m_mutex.Unlock();
+        bool ok = FillChunk(chunk);
+        m_mutex.Lock();
+        m_busy = false;
+        m_error = !ok;
+        chunk->ready = true;
+        m_fill_index ^= 1;
+        if (!ok || chunk->size < m_buffer_size) {
+            // Nothing more until the next seek.
+            m_filling = false;
+        }
+        m_cond.Broadcast();
+    }
+}
+
+bool ReadaheadReader::NextChunk() {
+    if (!m_async) {
+        // Data of the current chunk has been copied out if still needed.
+        m_current = 0;
+        m_position = 0;
+        return FillChunk(&m_chunks[0]);
+    }
+
+    if (m_thread == NULL)
+        m_thread.reset(new Thread(std::bind(&ReadaheadReader::ReadaheadLoop, this)));
+    int next = m_current < 0 ? 0 : m_current ^ 1;
+    MutexLocker locker(&m_mutex);
+    if (m_current >= 0) {
+        // Give it back to be filled.
+        m_chunks[m_current].ready = false;
+        m_cond.Broadcast();
+    }
+    m_current = next;
+    m_position = 0;
+    while (!m_chunks[next].ready)
+        m_cond.Wait();
+    if (m_error) {
+        m_chunks[next].size = 0;
+        return false;
+    }
+    return true;
+}
+
+int64_t ReadaheadReader::Read(size_t size, StringPiece* data) {
+    if (m_current < 0 && !NextChunk())
+        return -1;
+    Chunk* chunk = &m_chunks[m_current];
+    size_t available = chunk->size - m_position;
+    if (size <= available) {
+        data->set(chunk->data.get() + m_position, size);
+        m_position += size;
+        m_offset += size;
+        return size;
+    }
+
+    // Across chunks.
+    m_scratch.assign(chunk->data.get() + m_position, available);
+    m_position += available;
+    while (m_scratch.size() < size && !m_eof) {
+        if (chunk->size < m_buffer_size) {
+            // It was the last one.
+            m_eof = true;
+            break;
+        }
+        if (!NextChunk())
+            return -1;
+        chunk = &m_chunks[m_current];
+        size_t copy_size = std::min(size - m_scratch.size(), chunk->size);
+        m_scratch.append(chunk->data.get(), copy_size);
+        m_position = copy_size;
+    }
+    data->set(m_scratch.data(), m_scratch.size());
+    m_offset += m_scratch.size();
+    return m_scratch.size();
+}
+
+} // namespace toft
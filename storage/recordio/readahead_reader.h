@@ -0,0 +1,91 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_STORAGE_RECORDIO_READAHEAD_READER_H
+#define TOFT_STORAGE_RECORDIO_READAHEAD_READER_H
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "toft/base/scoped_array.h"
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/string_piece.h"
+#include "toft/base/uncopyable.h"
+#include "toft/storage/file/file.h"
+#include "toft/system/threading/condition_variable.h"
+#include "toft/system/threading/mutex.h"
+#include "toft/system/threading/thread.h"
+
+namespace toft {
+
+// Reads a file sequentially in chunks. With async, a background thread
+// reads the next chunk into a second buffer while the caller parses the
+// current one, so parsing overlaps I/O. The thread is started by the first
+// read and kept across seeks; without async only one buffer is allocated.
+//
+// Data read is returned as views into the buffers, copied only when it
+// crosses chunks. A view is valid until the next Read or Seek.
+class ReadaheadReader {
+    TOFT_DECLARE_UNCOPYABLE(ReadaheadReader);
+
+public:
+    // The file is read only by this object since the first Seek.
+    ReadaheadReader(File* file, size_t buffer_size, bool async);
+    ~ReadaheadReader();
+
+    bool Seek(int64_t offset);
+    int64_t Tell() const { return m_offset; }
+    // Size of the file, -1 on errors. Views read before are invalidated.
+    int64_t Size();
+
+    // Read size bytes into data, less at the end of file. Return the size
+    // read, or -1 on errors.
+    int64_t Read(size_t size, StringPiece* data);
+
+private:
+    struct Chunk {
+        Chunk() : size(0), ready(false) {}
+        scoped_array<char> data;
+        size_t size;
+        bool ready;
+    };
+
+    // Wait for the reading thread to leave the file to the caller.
+    void PauseReading();
+    void StopReading();
+    // Read a chunk from the file, return false on errors.
+    bool FillChunk(Chunk* chunk);
+    void ReadaheadLoop();
+    // Take the next chunk from the reading thread.
+    bool NextChunk();
+
+private:
+    File* m_file;
+    size_t m_buffer_size;
+    bool m_async;
+    Chunk m_chunks[2];
+
+    // Of the caller.
+    int m_current;
+    size_t m_position;
+    int64_t m_offset;
+    std::string m_scratch;
+    bool m_eof;
+
+    // Shared with the reading thread. It fills chunks from m_fill_index on
+    // while m_filling, m_busy when it's reading the file.
+    Mutex m_mutex;
+    ConditionVariable m_cond;
+    bool m_stopping;
+    bool m_filling;
+    bool m_busy;
+    int m_fill_index;
+    bool m_error;
+    scoped_ptr<Thread> m_thread;
+};
+
+} // namespace toft
+
+#endif // TOFT_STORAGE_RECORDIO_READAHEAD_READER_H
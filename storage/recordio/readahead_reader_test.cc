@@ -0,0 +1,109 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/recordio/readahead_reader.h"
+
+#include <algorithm>
+#include <string>
+
+#include "thirdparty/gtest/gtest.h"
+#include "toft/base/random.h"
+#include "toft/base/scoped_ptr.h"
+
+namespace toft {
+
+class ReadaheadReaderTest : public ::testing::TestWithParam<bool> {
+protected:
+    ReadaheadReaderTest() : m_path("./readahead_test.dat") {}
+
+    virtual void SetUp() {
+        Random random(1);
+        for (int i = 0; i < 100000; ++i)
+            m_content.push_back(random.Uniform(256));
+        scoped_ptr<File> file(File::Open(m_path, "w"));
+        ASSERT_TRUE(file != NULL);
+        ASSERT_EQ(static_cast<int64_t>(m_content.size()),
+                  file->Write(m_content.data(), m_content.size()));
+        ASSERT_TRUE(file->Close());
+        m_file.reset(File::Open(m_path, "r"));
+        ASSERT_TRUE(m_file != NULL);
+    }
+
+    std::string m_path;
+    std::string m_content;
+    scoped_ptr<File> m_file;
+};
+
+TEST_P(ReadaheadReaderTest, Read) {
+    const size_t kBufferSizes[] = { 1, 7, 4096, 1 << 20 };
+    for (size_t i = 0; i < sizeof(kBufferSizes) / sizeof(kBufferSizes[0]); ++i) {
+        ReadaheadReader reader(m_file.get(), kBufferSizes[i], GetParam());
+        ASSERT_TRUE(reader.Seek(0));
+        Random random(2);
+        size_t offset = 0;
+        while (offset < m_content.size()) {
+            size_t size = random.Uniform(10000);
+            StringPiece data;
+            int64_t ret = reader.Read(size, &data);
+            size_t expected_size = std::min(size, m_content.size() - offset);
+            ASSERT_EQ(static_cast<int64_t>(expected_size), ret);
+            ASSERT_EQ(StringPiece(m_content.data() + offset, expected_size), data);
+            offset += ret;
+            ASSERT_EQ(static_cast<int64_t>(offset), reader.Tell());
+        }
+        StringPiece data;
+        EXPECT_EQ(0, reader.Read(100, &data));
+        EXPECT_EQ(0, reader.Read(100, &data));
+    }
+}
+
+TEST_P(ReadaheadReaderTest, ZeroCopy) {
+    ReadaheadReader reader(m_file.get(), 1000, GetParam());
+    ASSERT_TRUE(reader.Seek(0));
+    StringPiece first;
+    ASSERT_EQ(100, reader.Read(100, &first));
+    StringPiece second;
+    ASSERT_EQ(100, reader.Read(100, &second));
+    // In the same buffer.
+    EXPECT_EQ(first.data() + 100, second.data());
+}
+
+TEST_P(ReadaheadReaderTest, Seek) {
+    ReadaheadReader reader(m_file.get(), 4096, GetParam());
+    const size_t kOffsets[] = { 5000, 0, 99990, 4096, 100000 };
+    for (size_t i = 0; i < sizeof(kOffsets) / sizeof(kOffsets[0]); ++i) {
+        ASSERT_TRUE(reader.Seek(kOffsets[i]));
+        StringPiece data;
+        int64_t ret = reader.Read(20, &data);
+        size_t expected_size = std::min<size_t>(20, m_content.size() - kOffsets[i]);
+        ASSERT_EQ(static_cast<int64_t>(expected_size), ret);
+        EXPECT_EQ(StringPiece(m_content.data() + kOffsets[i], expected_size), data);
+    }
+    // Destroyed while reading ahead.
+    ASSERT_TRUE(reader.Seek(0));
+}
+
+TEST_P(ReadaheadReaderTest, SeekWhileReading) {
+    // Seeks go on with the same reading thread.
+    ReadaheadReader reader(m_file.get(), 1000, GetParam());
+    Random random(3);
+    for (int i = 0; i < 1000; ++i) {
+        size_t offset = random.Uniform(m_content.size());
+        ASSERT_TRUE(reader.Seek(offset));
+        int reads = random.Uniform(5);
+        for (int j = 0; j < reads; ++j) {
+            StringPiece data;
+            int64_t ret = reader.Read(random.Uniform(3000), &data);
+            ASSERT_GE(ret, 0);
+            ASSERT_EQ(StringPiece(m_content.data() + offset, ret), data);
+            offset += ret;
+        }
+        if (random.OneIn(10))
+            ASSERT_EQ(static_cast<int64_t>(m_content.size()), reader.Size());
+        ASSERT_EQ(static_cast<int64_t>(offset), reader.Tell());
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(Async, ReadaheadReaderTest, ::testing::Bool());
+
+} // namespace toft
@@ -2,18 +2,146 @@
 // Author: An Qin <anqin.qin@gmail.com>
 //
 // Description:
+//
+// Format V2 is made of blocks of block_size bytes. The first block starts
+// with the file header:
+//
+//   magic (8) | block_size (4) | compression name (16) | masked crc (4)
+//
+// Every record is cut into fragments which never cross blocks:
+//
+//   masked crc (4) | length (2) | type (1) | payload (length)
+//
+// The crc is the CRC32C of type and payload. The type is FULL for a record
+// in one fragment, otherwise FIRST, MIDDLE... and LAST, with
+// kCompressedFlag if the record is compressed. The tail of a block shorter
+// than a fragment header is filled with zeros. Integers are little endian.
+//
+// A reader which finds a fragment corrupted skips the rest of the block, and
+// fragments of records which began before are skipped as well, so it goes
+// on at the first record starting after the corruption.
+//
+// Records of metadata have kMetaFlag, never compressed, and are not returned
+// to users. The first byte of them is the kind. An index is a meta record:
+//
+//   kMetaIndex (1) | segment start (8) | number of records (8)
+//   | number of entries (8) | entries of record number (8) and offset (8)
+//
+// of records written since the segment start, the file size when a writer
+// began. It's followed by the last fragment of the file, a FULL one in the
+// same block holding the offset of the index:
+//
+//   kMetaTrailer (1) | index offset (8)
+//
+// A file appended to has the trailer of what was there before at the
+// segment start, so the index of the whole file is a chain of them.
 
 #include "toft/storage/recordio/recordio.h"
 
+#include <string.h>
+#include <algorithm>
+
+#include "toft/base/byte_order.h"
+#include "toft/compress/block/block_compression.h"
+#include "toft/hash/crc32c.h"
+#include "toft/storage/recordio/readahead_reader.h"
+
 #include "thirdparty/glog/logging.h"
 
 namespace toft {
 
+namespace {
+
+const char kMagic[8] = { 'T', 'R', 'E', 'C', 'O', 'R', 'D', '2' };
+const uint32_t kFileHeaderSize = 32;
+const uint32_t kCompressionNameSize = 16;
+const uint32_t kFragmentHeaderSize = 7;
+
+enum FragmentType {
+    // Zeros, tails of blocks, or preallocated space.
+    FragmentType_Zero = 0,
+    FragmentType_Full = 1,
+    FragmentType_First = 2,
+    FragmentType_Middle = 3,
+    FragmentType_Last = 4
+};
+const int kCompressedFlag = 0x80;
+const int kMetaFlag = 0x40;
+
+enum MetaKind {
+    MetaKind_Index = 1,
+    MetaKind_Trailer = 2
+};
+const uint32_t kIndexHeaderSize = 1 + 8 + 8 + 8;
+const uint32_t kTrailerSize = 1 + 8;
+
+void EncodeFixed32(char* dst, uint32_t value) {
+    value = ByteOrder::ToLittleEndian<uint32_t>(value);
+    memcpy(dst, &value, sizeof(value));
+}
+
+void EncodeFixed64(char* dst, uint64_t value) {
+    value = ByteOrder::ToLittleEndian<uint64_t>(value);
+    memcpy(dst, &value, sizeof(value));
+}
+
+void EncodeFixed16(char* dst, uint16_t value) {
+    value = ByteOrder::ToLittleEndian<uint16_t>(value);
+    memcpy(dst, &value, sizeof(value));
+}
+
+uint32_t DecodeFixed32(const char* ptr) {
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return ByteOrder::FromLittleEndian<uint32_t>(value);
+}
+
+uint64_t DecodeFixed64(const char* ptr) {
+    uint64_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return ByteOrder::FromLittleEndian<uint64_t>(value);
+}
+
+uint16_t DecodeFixed16(const char* ptr) {
+    uint16_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return ByteOrder::FromLittleEndian<uint16_t>(value);
+}
+
+uint32_t FragmentCrc(char type, const char* data, uint32_t size) {
+    uint32_t crc = CRC32C::Extend(0, &type, 1);
+    return CRC32C::Mask(CRC32C::Extend(crc, data, size));
+}
+
+} // namespace
+
 RecordWriter::RecordWriter(File *file)
-    : m_file(file) {
+    : m_file(file), m_started(false), m_block_offset(0), m_offset(0),
+      m_indexed(false), m_segment_start(0), m_num_records(0) {
     CHECK(m_file != NULL);
 }
 
+RecordWriter::RecordWriter(File *file, const RecordWriterOptions& options)
+    : m_file(file), m_options(options), m_started(false), m_block_offset(0),
+      m_offset(0), m_segment_start(0), m_num_records(0) {
+    CHECK(m_file != NULL);
+    m_indexed = m_options.index_interval_records > 0 ||
+                m_options.index_interval_bytes > 0;
+    if (m_indexed) {
+        CHECK_EQ(RecordFormat_V2, m_options.format) << "Only V2 files are indexed.";
+    }
+    if (m_options.format == RecordFormat_V2) {
+        CHECK_GE(m_options.block_size, RecordWriterOptions::kMinBlockSize);
+        CHECK_LE(m_options.block_size, RecordWriterOptions::kMaxBlockSize);
+        CHECK_LT(m_options.compression.size(), kCompressionNameSize);
+        if (!m_options.compression.empty()) {
+            m_compression.reset(TOFT_CREATE_BLOCK_COMPRESSION(m_options.compression));
+            CHECK(m_compression != NULL)
+                << "Unknown compression: " << m_options.compression;
+        }
+    }
+}
+
 RecordWriter::~RecordWriter() {}
 
 bool RecordWriter::WriteMessage(const ::google::protobuf::Message& message) {
@@ -33,6 +161,9 @@ bool RecordWriter::WriteMessage(const ::google::protobuf::Message& message) {
 }
 
 bool RecordWriter::WriteRecord(const char *data, uint32_t size) {
+    if (m_options.format == RecordFormat_V2) {
+        return WriteRecordV2(data, size);
+    }
     if (!Write(reinterpret_cast<char*>(&size), sizeof(size))) {
         return false;
     }
@@ -50,6 +181,171 @@ bool RecordWriter::WriteRecord(const StringPiece& data) {
     return WriteRecord(data.data(), data.size());
 }
 
+bool RecordWriter::WriteHeader() {
+    CHECK_EQ(RecordFormat_V2, m_options.format) << "Only V2 files have a header.";
+    if (m_started) {
+        return true;
+    }
+    if (!WriteFileHeader()) {
+        return false;
+    }
+    m_started = true;
+    return true;
+}
+
+bool RecordWriter::WriteRecordV2(const char *data, uint32_t size) {
+    if (!WriteHeader()) {
+        return false;
+    }
+
+    if (m_indexed) {
+        // Where the first fragment goes.
+        if (!PadBlock(kFragmentHeaderSize)) {
+            return false;
+        }
+        if (m_index.empty() ||
+            (m_options.index_interval_records > 0 &&
+             m_num_records - m_index.back().first >= m_options.index_interval_records) ||
+            (m_options.index_interval_bytes > 0 &&
+             m_offset - m_index.back().second >= m_options.index_interval_bytes)) {
+            m_index.push_back(std::make_pair(m_num_records, m_offset));
+        }
+        ++m_num_records;
+    }
+
+    int compressed_flag = 0;
+    if (m_compression != NULL) {
+        m_compressed.clear();
+        if (m_compression->Compress(data, size, &m_compressed) &&
+            m_compressed.size() < size) {
+            data = m_compressed.data();
+            size = m_compressed.size();
+            compressed_flag = kCompressedFlag;
+        }
+    }
+    return WriteFragments(compressed_flag, data, size);
+}
+
+bool RecordWriter::WriteIndex() {
+    if (!m_indexed) {
+        LOG(ERROR) << "RecordWriter is not indexed.";
+        return false;
+    }
+    if (!WriteHeader()) {
+        return false;
+    }
+
+    if (!PadBlock(kFragmentHeaderSize)) {
+        return false;
+    }
+    int64_t index_offset = m_offset;
+    std::string index(kIndexHeaderSize + m_index.size() * 16, '\0');
+    index[0] = MetaKind_Index;
+    EncodeFixed64(&index[1], m_segment_start);
+    EncodeFixed64(&index[9], m_num_records);
+    EncodeFixed64(&index[17], m_index.size());
+    for (size_t i = 0; i < m_index.size(); ++i) {
+        EncodeFixed64(&index[kIndexHeaderSize + i * 16], m_index[i].first);
+        EncodeFixed64(&index[kIndexHeaderSize + i * 16 + 8], m_index[i].second);
+    }
+    if (!WriteFragments(kMetaFlag, index.data(), index.size())) {
+        return false;
+    }
+
+    char trailer[kTrailerSize];
+    trailer[0] = MetaKind_Trailer;
+    EncodeFixed64(trailer + 1, index_offset);
+    if (!PadBlock(kFragmentHeaderSize + kTrailerSize)) {
+        return false;
+    }
+    return WriteFragment(FragmentType_Full | kMetaFlag, trailer, kTrailerSize);
+}
+
+bool RecordWriter::PadBlock(uint32_t size) {
+    uint32_t left_in_block = m_options.block_size - m_block_offset;
+    if (left_in_block >= size) {
+        return true;
+    }
+    static const char kZeros[kFragmentHeaderSize + kTrailerSize] = { 0 };
+    if (!Write(kZeros, left_in_block)) {
+        return false;
+    }
+    m_block_offset = 0;
+    return true;
+}
+
+bool RecordWriter::WriteFragments(int flags, const char *data, uint32_t size) {
+    bool first = true;
+    do {
+        if (!PadBlock(kFragmentHeaderSize)) {
+            return false;
+        }
+        uint32_t left_in_block = m_options.block_size - m_block_offset;
+        uint32_t fragment_size = std::min(size, left_in_block - kFragmentHeaderSize);
+        bool last = fragment_size == size;
+        int type;
+        if (first && last) {
+            type = FragmentType_Full;
+        } else if (first) {
+            type = FragmentType_First;
+        } else if (last) {
+            type = FragmentType_Last;
+        } else {
+            type = FragmentType_Middle;
+        }
+        if (!WriteFragment(type | flags, data, fragment_size)) {
+            return false;
+        }
+        data += fragment_size;
+        size -= fragment_size;
+        first = false;
+    } while (size > 0);
+    return true;
+}
+
+bool RecordWriter::WriteFileHeader() {
+    // Appending to an existing file, go on in its last block.
+    int64_t offset = -1;
+    if (m_options.overwrite) {
+        offset = m_file->Tell();
+    } else if (m_file->Seek(0, SEEK_END)) {
+        offset = m_file->Tell();
+    }
+    if (offset < 0) {
+        LOG(ERROR) << "RecordWriter can't get the file size.";
+        return false;
+    }
+    m_offset = offset;
+    m_segment_start = offset;
+    if (offset > 0) {
+        m_block_offset = offset % m_options.block_size;
+        return true;
+    }
+
+    char header[kFileHeaderSize] = { 0 };
+    memcpy(header, kMagic, sizeof(kMagic));
+    EncodeFixed32(header + 8, m_options.block_size);
+    memcpy(header + 12, m_options.compression.data(), m_options.compression.size());
+    EncodeFixed32(header + 28, CRC32C::Mask(CRC32C::Extend(0, header, 28)));
+    if (!Write(header, kFileHeaderSize)) {
+        return false;
+    }
+    m_block_offset = kFileHeaderSize;
+    return true;
+}
+
+bool RecordWriter::WriteFragment(int type, const char *data, uint32_t size) {
+    char header[kFragmentHeaderSize];
+    EncodeFixed32(header, FragmentCrc(static_cast<char>(type), data, size));
+    EncodeFixed16(header + 4, size);
+    header[6] = static_cast<char>(type);
+    if (!Write(header, kFragmentHeaderSize) || !Write(data, size)) {
+        return false;
+    }
+    m_block_offset += kFragmentHeaderSize + size;
+    return true;
+}
+
 bool RecordWriter::Write(const char *data, uint32_t size) {
     uint32_t write_size = 0;
     while (write_size < size) {
@@ -60,79 +356,526 @@ bool RecordWriter::Write(const char *data, uint32_t size) {
         }
         write_size += ret;
     }
+    m_offset += size;
     return true;
 }
 
 RecordReader::RecordReader(File *file)
     : m_file(file),
-      m_buffer_size(1 * 1024 * 1024) {
+      m_format(RecordFormat_V1),
+      m_block_size(0),
+      m_block_offset(0),
+      m_last_block(false),
+      m_fragment_offset(0),
+      m_end_offset(-1),
+      m_skipped_bytes(0),
+      m_file_size(-1),
+      m_indexed(false),
+      m_num_records(0) {
+    CHECK(m_file != NULL);
+    RecordReaderOptions options;
+    m_reader.reset(new ReadaheadReader(m_file, options.buffer_size, options.readahead));
+    Reset();
+}
+
+RecordReader::RecordReader(File *file, const RecordReaderOptions& options)
+    : m_file(file),
+      m_format(RecordFormat_V1),
+      m_block_size(0),
+      m_block_offset(0),
+      m_last_block(false),
+      m_fragment_offset(0),
+      m_end_offset(-1),
+      m_skipped_bytes(0),
+      m_file_size(-1),
+      m_indexed(false),
+      m_num_records(0) {
     CHECK(m_file != NULL);
-    m_buffer.reset(new char[m_buffer_size]);
+    m_reader.reset(new ReadaheadReader(m_file, options.buffer_size, options.readahead));
     Reset();
 }
 
 RecordReader::~RecordReader() {}
 
 bool RecordReader::Reset() {
-    if (!m_file->Seek(0, SEEK_END)) {
+    m_record.clear();
+    m_skipped_bytes = 0;
+    m_fragment_offset = 0;
+    m_end_offset = -1;
+    // The file may have grown.
+    m_file_size = -1;
+    if (!m_reader->Seek(0)) {
         LOG(ERROR) << "RecordReader Reset error.";
         return false;
     }
-    m_file_size = m_file->Tell();
-    if (!m_file->Seek(0, SEEK_SET)) {
-        LOG(ERROR) << "RecordReader Reset error.";
+
+    bool is_v2 = false;
+    if (!ReadFileHeader(&is_v2)) {
         return false;
     }
+    if (!is_v2) {
+        m_format = RecordFormat_V1;
+        return m_reader->Seek(0);
+    }
+    // Go on in the first block after the header.
+    m_format = RecordFormat_V2;
+    m_block.clear();
+    m_block_offset = 0;
+    m_last_block = false;
+    return true;
+}
+
+bool RecordReader::ReadFileHeader(bool* is_v2) {
+    *is_v2 = false;
+    StringPiece header;
+    int64_t ret = m_reader->Read(kFileHeaderSize, &header);
+    if (ret < 0) {
+        LOG(ERROR) << "Read file header error.";
+        return false;
+    }
+    if (ret < kFileHeaderSize || memcmp(header.data(), kMagic, sizeof(kMagic)) != 0) {
+        return true;
+    }
+    *is_v2 = true;
+    if (CRC32C::Unmask(DecodeFixed32(header.data() + 28)) !=
+        CRC32C::Extend(0, header.data(), 28)) {
+        LOG(ERROR) << "Corrupted file header.";
+        return false;
+    }
+    m_block_size = DecodeFixed32(header.data() + 8);
+    if (m_block_size < RecordWriterOptions::kMinBlockSize ||
+        m_block_size > RecordWriterOptions::kMaxBlockSize) {
+        LOG(ERROR) << "Invalid block size: " << m_block_size;
+        return false;
+    }
+    std::string compression(header.data() + 12,
+                            strnlen(header.data() + 12, kCompressionNameSize));
+    m_compression.reset();
+    if (!compression.empty()) {
+        m_compression.reset(TOFT_CREATE_BLOCK_COMPRESSION(compression));
+        if (m_compression == NULL) {
+            LOG(ERROR) << "Unknown compression: " << compression;
+            return false;
+        }
+    }
     return true;
 }
 
 int RecordReader::Next() {
-    // read size
-    int64_t ret = m_file->Tell();
-    if (ret == -1) {
-        LOG(ERROR) << "Tell error.";
+    if (m_format == RecordFormat_V2) {
+        return NextV2();
+    }
+    return NextV1();
+}
+
+int RecordReader::NextV1() {
+    StringPiece data;
+    uint32_t size;
+    int64_t ret = m_reader->Read(sizeof(size), &data);
+    if (ret <= 0) {
+        return ret;
+    }
+    if (ret < static_cast<int64_t>(sizeof(size))) {
+        LOG(ERROR) << "Incomplete record size at the end of file.";
+        return -1;
+    }
+    memcpy(&size, data.data(), sizeof(size));
+
+    ret = m_reader->Read(size, &m_record);
+    if (ret < 0) {
+        return -1;
+    }
+    if (ret < size) {
+        LOG(ERROR) << "Incomplete record at the end of file.";
         return -1;
     }
+    return 1;
+}
+
+int RecordReader::NextV2() {
+    for (;;) {
+        bool meta;
+        int ret = ReadRecordV2(&meta);
+        if (ret <= 0 || !meta) {
+            return ret;
+        }
+    }
+}
 
-    if (ret == m_file_size) {
+int RecordReader::ReadRecordV2(bool* meta) {
+    if (m_end_offset >= 0 && m_fragment_offset >= m_end_offset) {
         return 0;
-    } else if (m_file_size - ret >= static_cast<int64_t>(sizeof(m_data_size))) { // NO_LINT
-        if (!Read(reinterpret_cast<char*>(&m_data_size), sizeof(m_data_size))) {
-            LOG(ERROR) << "Read size error.";
-            return -1;
+    }
+    // Whether fragments of a record are being assembled.
+    bool in_record = false;
+    bool compressed = false;
+    for (;;) {
+        StringPiece fragment;
+        int type;
+        int64_t skipped_bytes = m_skipped_bytes;
+        int ret = ReadFragment(&fragment, &type);
+        if (in_record && m_skipped_bytes != skipped_bytes) {
+            // Fragments were lost in the middle of the record.
+            m_skipped_bytes += m_fragments.size();
+            in_record = false;
+        }
+        if (ret <= 0) {
+            if (ret == 0 && in_record) {
+                // Torn by a crash while writing.
+                LOG(WARNING) << "Incomplete record at the end of file.";
+                m_skipped_bytes += m_fragments.size();
+            }
+            return ret;
+        }
+
+        bool fragment_compressed = (type & kCompressedFlag) != 0;
+        bool fragment_meta = (type & kMetaFlag) != 0;
+        type &= ~(kCompressedFlag | kMetaFlag);
+        if (type == FragmentType_Full || type == FragmentType_First) {
+            if (in_record) {
+                LOG(WARNING) << "Incomplete record, skipped.";
+                m_skipped_bytes += m_fragments.size();
+                in_record = false;
+            }
+            if (m_end_offset >= 0 && m_fragment_offset >= m_end_offset) {
+                return 0;
+            }
+        }
+        switch (type) {
+        case FragmentType_Full:
+            if (SetRecordV2(fragment, fragment_compressed)) {
+                *meta = fragment_meta;
+                return 1;
+            }
+            break;
+        case FragmentType_First:
+            m_fragments.assign(fragment.data(), fragment.size());
+            compressed = fragment_compressed;
+            *meta = fragment_meta;
+            in_record = true;
+            break;
+        case FragmentType_Middle:
+        case FragmentType_Last:
+            if (!in_record) {
+                // Rest of a record began in skipped data.
+                m_skipped_bytes += kFragmentHeaderSize + fragment.size();
+                break;
+            }
+            m_fragments.append(fragment.data(), fragment.size());
+            if (type == FragmentType_Last) {
+                in_record = false;
+                if (SetRecordV2(m_fragments, compressed)) {
+                    return 1;
+                }
+            }
+            break;
+        default:
+            LOG(WARNING) << "Unknown fragment type " << type << ", skipped.";
+            m_skipped_bytes += kFragmentHeaderSize + fragment.size();
+            break;
         }
     }
+}
 
-    // read data
-    ret = m_file->Tell();
-    if (ret == -1) {
-        LOG(ERROR) << "Tell error.";
-        return -1;
+bool RecordReader::SetRecordV2(const StringPiece& data, bool compressed) {
+    if (!compressed) {
+        m_record = data;
+        return true;
+    }
+    m_uncompressed.clear();
+    if (m_compression == NULL ||
+        !m_compression->Uncompress(data.data(), data.size(), &m_uncompressed)) {
+        LOG(WARNING) << "Can't uncompress record, skipped.";
+        m_skipped_bytes += data.size();
+        return false;
     }
+    m_record = m_uncompressed;
+    return true;
+}
 
-    if (ret >= m_file_size && m_data_size != 0) {
-        LOG(ERROR) << "read error.";
-        return -1;
-    } else if (m_file_size - ret >= m_data_size) { // NO_LINT
-        if (m_data_size > m_buffer_size) {
-            while (m_data_size > m_buffer_size) {
-                m_buffer_size *= 2;
+bool RecordReader::ReadBlock() {
+    // To the end of the block, the first block begins after the header.
+    uint32_t size = m_block_size - m_reader->Tell() % m_block_size;
+    int64_t ret = m_reader->Read(size, &m_block);
+    if (ret < 0) {
+        return false;
+    }
+    m_block_offset = 0;
+    m_last_block = ret < size;
+    return true;
+}
+
+void RecordReader::SkipBlock(const char* reason) {
+    LOG(WARNING) << "Skip " << m_block.size() - m_block_offset
+                 << " bytes to the next block: " << reason;
+    m_skipped_bytes += m_block.size() - m_block_offset;
+    m_block_offset = m_block.size();
+}
+
+int RecordReader::ReadFragment(StringPiece* fragment, int* type) {
+    for (;;) {
+        uint32_t left = m_block.size() - m_block_offset;
+        if (left < kFragmentHeaderSize) {
+            // The end of file, or zeros at the tail of the block.
+            if (m_last_block) {
+                m_skipped_bytes += left;
+                m_block_offset = m_block.size();
+                return 0;
+            }
+            if (!ReadBlock()) {
+                return -1;
             }
-            m_buffer.reset(new char[m_buffer_size]);
+            continue;
         }
 
-        if (!Read(m_buffer.get(), m_data_size)) {
-            LOG(ERROR) << "Read data error.";
-            return -1;
+        const char* header = m_block.data() + m_block_offset;
+        uint32_t masked_crc = DecodeFixed32(header);
+        uint32_t length = DecodeFixed16(header + 4);
+        *type = static_cast<unsigned char>(header[6]);
+        if (*type == FragmentType_Zero && length == 0 && masked_crc == 0) {
+            // Space preallocated but not written, nothing more in the block.
+            m_block_offset = m_block.size();
+            continue;
         }
+        if (kFragmentHeaderSize + length > left) {
+            if (m_last_block) {
+                // Torn by a crash while writing.
+                LOG(WARNING) << "Incomplete fragment at the end of file.";
+                m_skipped_bytes += left;
+                m_block_offset = m_block.size();
+                return 0;
+            }
+            SkipBlock("bad fragment length");
+            continue;
+        }
+        const char* data = header + kFragmentHeaderSize;
+        if (FragmentCrc(header[6], data, length) != masked_crc) {
+            SkipBlock("checksum mismatch");
+            continue;
+        }
+        m_fragment_offset = m_reader->Tell() - left;
+        fragment->set(data, length);
+        m_block_offset += kFragmentHeaderSize + length;
+        return 1;
     }
+}
 
-    return 1;
+bool RecordReader::SeekV2(int64_t offset) {
+    if (!m_reader->Seek(offset)) {
+        return false;
+    }
+    m_record.clear();
+    m_block.clear();
+    m_block_offset = 0;
+    m_last_block = false;
+    m_fragment_offset = offset;
+    return true;
+}
+
+bool RecordReader::LoadIndex() {
+    if (m_file_size >= 0) {
+        return true;
+    }
+    int64_t size = m_reader->Size();
+    if (size < 0) {
+        return false;
+    }
+    m_indexed = false;
+    m_num_records = 0;
+    m_index.clear();
+    m_end_offset = -1;
+    if (m_format != RecordFormat_V2) {
+        m_file_size = size;
+        return true;
+    }
+
+    // From the last segment to the first.
+    std::vector<IndexEntry> index;
+    int64_t num_records = 0;
+    int64_t end = size;
+    for (;;) {
+        int64_t index_offset;
+        int64_t segment_start;
+        int64_t segment_records;
+        std::vector<IndexEntry> entries;
+        if (!ReadTrailer(end, &index_offset)) {
+            if (end != size) {
+                LOG(WARNING) << "Records before offset " << end << " are not indexed.";
+            }
+            m_file_size = size;
+            return true;
+        }
+        if (!ReadIndexRecord(index_offset, &segment_start, &segment_records, &entries)) {
+            LOG(WARNING) << "Corrupted index at offset " << index_offset;
+            m_file_size = size;
+            return true;
+        }
+        // Records of later segments are numbered after these.
+        for (size_t i = 0; i < index.size(); ++i) {
+            index[i].record += segment_records;
+        }
+        index.insert(index.begin(), entries.begin(), entries.end());
+        num_records += segment_records;
+        if (segment_start == 0) {
+            break;
+        }
+        end = segment_start;
+    }
+    m_file_size = size;
+    m_indexed = true;
+    m_num_records = num_records;
+    m_index.swap(index);
+    return true;
+}
+
+bool RecordReader::ReadTrailer(int64_t end, int64_t* index_offset) {
+    const uint32_t kTrailerFragmentSize = kFragmentHeaderSize + kTrailerSize;
+    if (end < kFileHeaderSize + kTrailerFragmentSize) {
+        return false;
+    }
+    // Never across blocks.
+    int64_t offset = end - kTrailerFragmentSize;
+    if (offset % m_block_size + kTrailerFragmentSize > m_block_size) {
+        return false;
+    }
+    StringPiece data;
+    if (!m_reader->Seek(offset) ||
+        m_reader->Read(kTrailerFragmentSize, &data) != kTrailerFragmentSize) {
+        return false;
+    }
+    const char* header = data.data();
+    const char* payload = header + kFragmentHeaderSize;
+    if (DecodeFixed16(header + 4) != kTrailerSize ||
+        static_cast<unsigned char>(header[6]) != (FragmentType_Full | kMetaFlag) ||
+        FragmentCrc(header[6], payload, kTrailerSize) != DecodeFixed32(header) ||
+        payload[0] != MetaKind_Trailer) {
+        return false;
+    }
+    *index_offset = DecodeFixed64(payload + 1);
+    return *index_offset >= kFileHeaderSize && *index_offset < offset;
+}
+
+bool RecordReader::ReadIndexRecord(int64_t offset, int64_t* segment_start,
+                                   int64_t* num_records,
+                                   std::vector<IndexEntry>* entries) {
+    bool meta;
+    if (!SeekV2(offset) || ReadRecordV2(&meta) != 1 || !meta ||
+        m_record.size() < kIndexHeaderSize || m_record[0] != MetaKind_Index) {
+        return false;
+    }
+    const char* data = m_record.data();
+    *segment_start = DecodeFixed64(data + 1);
+    *num_records = DecodeFixed64(data + 9);
+    uint64_t num_entries = DecodeFixed64(data + 17);
+    if (num_entries != (m_record.size() - kIndexHeaderSize) / 16 ||
+        m_record.size() != kIndexHeaderSize + num_entries * 16) {
+        return false;
+    }
+    data += kIndexHeaderSize;
+    entries->resize(num_entries);
+    for (uint64_t i = 0; i < num_entries; ++i) {
+        (*entries)[i].record = DecodeFixed64(data + i * 16);
+        (*entries)[i].offset = DecodeFixed64(data + i * 16 + 8);
+    }
+    return *segment_start < offset;
+}
+
+bool RecordReader::Split(int n, std::vector<RecordSplit>* splits) {
+    CHECK_GT(n, 0);
+    splits->clear();
+    if (!LoadIndex()) {
+        return false;
+    }
+    if (!m_indexed) {
+        RecordSplit split = { 0, m_file_size, 0, -1 };
+        splits->push_back(split);
+        return true;
+    }
+    if (m_index.empty()) {
+        return true;
+    }
+
+    // Cut at the first entries after every n-th of the bytes.
+    int64_t begin = m_index[0].offset;
+    int64_t bytes = m_file_size - begin;
+    size_t next = 0;
+    for (int i = 1; i <= n && next < m_index.size(); ++i) {
+        int64_t boundary = begin + bytes * i / n;
+        size_t end = next + 1;
+        while (end < m_index.size() && m_index[end].offset < boundary) {
+            ++end;
+        }
+        RecordSplit split;
+        split.begin = m_index[next].offset;
+        split.first_record = m_index[next].record;
+        if (end < m_index.size()) {
+            split.end = m_index[end].offset;
+            split.num_records = m_index[end].record - split.first_record;
+        } else {
+            split.end = m_file_size;
+            split.num_records = m_num_records - split.first_record;
+        }
+        splits->push_back(split);
+        next = end;
+    }
+    return true;
+}
+
+bool RecordReader::SeekToSplit(const RecordSplit& split) {
+    if (split.begin == 0) {
+        if (!Reset()) {
+            return false;
+        }
+    } else if (m_format != RecordFormat_V2 || !SeekV2(split.begin)) {
+        LOG(ERROR) << "Can't seek to offset " << split.begin;
+        return false;
+    }
+    m_end_offset = split.end;
+    return true;
+}
+
+bool RecordReader::SeekToRecord(int64_t index) {
+    if (!LoadIndex()) {
+        return false;
+    }
+    if (!m_indexed) {
+        LOG(ERROR) << "RecordReader is not indexed.";
+        return false;
+    }
+    if (index < 0 || index > m_num_records) {
+        LOG(ERROR) << "Record " << index << " out of range.";
+        return false;
+    }
+    m_end_offset = -1;
+    if (m_index.empty()) {
+        return SeekV2(m_file_size);
+    }
+
+    // The last entry at or before the record.
+    size_t low = 0;
+    size_t high = m_index.size();
+    while (high - low > 1) {
+        size_t middle = (low + high) / 2;
+        if (m_index[middle].record <= index) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    if (!SeekV2(m_index[low].offset)) {
+        return false;
+    }
+    for (int64_t i = m_index[low].record; i < index; ++i) {
+        if (NextV2() != 1) {
+            LOG(ERROR) << "Can't read record " << i;
+            return false;
+        }
+    }
+    return true;
 }
 
 bool RecordReader::ReadMessage(::google::protobuf::Message *message) {
-    std::string str(m_buffer.get(), m_data_size);
-    if (!message->ParseFromArray(m_buffer.get(), m_data_size)) {
+    if (!message->ParseFromArray(m_record.data(), m_record.size())) {
         LOG(WARNING) << "Missing required fields.";
         return false;
     }
@@ -141,8 +884,7 @@ bool RecordReader::ReadMessage(::google::protobuf::Message *message) {
 
 bool RecordReader::ReadNextMessage(::google::protobuf::Message *message) {
     while (Next() == 1) {
-        std::string str(m_buffer.get(), m_data_size);
-        if (message->ParseFromArray(m_buffer.get(), m_data_size)) {
+        if (message->ParseFromArray(m_record.data(), m_record.size())) {
             return true;
         }
     }
@@ -150,13 +892,13 @@ bool RecordReader::ReadNextMessage(::google::protobuf::Message *message) {
 }
 
 bool RecordReader::ReadRecord(const char **data, uint32_t *size) {
-    *data = m_buffer.get();
-    *size = m_data_size;
+    *data = m_record.data();
+    *size = m_record.size();
     return true;
 }
 
 bool RecordReader::ReadRecord(std::string *data) {
-    data->assign(m_buffer.get(), m_data_size);
+    data->assign(m_record.data(), m_record.size());
     return true;
 }
 
@@ -170,19 +912,4 @@ bool RecordReader::ReadRecord(StringPiece* data) {
     return true;
 }
 
-bool RecordReader::Read(char *data, uint32_t size) {
-    // Read
-    uint32_t read_size = 0;
-    while (read_size < size) {
-        int64_t ret = m_file->Read(data + read_size, size - read_size);
-        if (ret == -1) {
-            LOG(ERROR) << "Read error.";
-            return false;
-        }
-        read_size += ret;
-    }
-
-    return true;
-}
-
 } // namespace toft
@@ -7,17 +7,56 @@
 #define TOFT_STORAGE_RECORDIO_RECORDIO_H
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "thirdparty/protobuf/message.h"
-#include "toft/base/scoped_array.h"
+#include "toft/base/scoped_ptr.h"
 #include "toft/base/string/string_piece.h"
 #include "toft/storage/file/file.h"
 
 namespace toft {
 
+class BlockCompression;
+class ReadaheadReader;
+
+enum RecordFormat {
+    // A 4 bytes native endian size before every record, nothing else.
+    RecordFormat_V1 = 1,
+    // Records are cut into fragments with CRC32C in blocks of fixed size, a
+    // reader skips corrupted data to the next block. See recordio.cc.
+    RecordFormat_V2 = 2
+};
+
+struct RecordWriterOptions {
+    static const uint32_t kDefaultBlockSize = 32 * 1024;
+    static const uint32_t kMinBlockSize = 64;
+    static const uint32_t kMaxBlockSize = 64 * 1024;
+
+    RecordWriterOptions()
+        : format(RecordFormat_V1), block_size(kDefaultBlockSize),
+          index_interval_records(0), index_interval_bytes(0), overwrite(false) {}
+
+    RecordFormat format;
+    // Only for V2, in [kMinBlockSize, kMaxBlockSize].
+    uint32_t block_size;
+    // Only for V2, name of BlockCompression such as "snappy", empty for no
+    // compression. Records are compressed when they get smaller.
+    std::string compression;
+    // Only for V2, index the offset of a record every so many records or
+    // bytes, or both, for RecordReader::SeekToRecord and Split. 0 for none.
+    uint32_t index_interval_records;
+    int64_t index_interval_bytes;
+    // Only for V2, write from the current position of the file over what is
+    // there instead of appending, for files of zeros preallocated.
+    bool overwrite;
+};
+
 class RecordWriter {
 public:
     explicit RecordWriter(File *file);
+    // Files of V2 are appended to with the same options as they were created.
+    RecordWriter(File *file, const RecordWriterOptions& options);
     ~RecordWriter();
 
     bool WriteMessage(const ::google::protobuf::Message& message);
@@ -25,16 +64,74 @@ public:
     bool WriteRecord(const std::string& data);
     bool WriteRecord(const StringPiece& data);
 
+    // Write the file header of V2 now rather than with the first record,
+    // for files overwritten, which are read as V1 without it.
+    bool WriteHeader();
+
+    // Write the index of records written so far at the end of the file, if
+    // indexed. Readers find the index only at the end of the file, so call
+    // it last, or after records written since. Files appended to keep the
+    // index of what was there if they ended with one.
+    bool WriteIndex();
+
 private:
+    bool WriteRecordV2(const char *data, uint32_t size);
+    bool WriteFileHeader();
+    // Fill the tail of the block with zeros if less than size is left.
+    bool PadBlock(uint32_t size);
+    bool WriteFragments(int flags, const char *data, uint32_t size);
+    bool WriteFragment(int type, const char *data, uint32_t size);
     bool Write(const char *data, uint32_t size);
 
 private:
     File* m_file;
+    RecordWriterOptions m_options;
+    scoped_ptr<BlockCompression> m_compression;
+    std::string m_compressed;
+    bool m_started;
+    // Offset in the current block of V2.
+    uint32_t m_block_offset;
+    int64_t m_offset;
+
+    // Index of records written by this writer, numbered from 0 at
+    // m_segment_start where it began to write.
+    bool m_indexed;
+    int64_t m_segment_start;
+    int64_t m_num_records;
+    std::vector<std::pair<int64_t, int64_t> > m_index;
 };
 
+struct RecordReaderOptions {
+    static const size_t kDefaultBufferSize = 1024 * 1024;
+
+    RecordReaderOptions() : buffer_size(kDefaultBufferSize), readahead(false) {}
+
+    // Size of each of the two read buffers. Records in a buffer are returned
+    // without copying.
+    size_t buffer_size;
+    // Read the next buffer in a background thread while records of the
+    // current one are parsed. It costs a thread and a second buffer for each
+    // reader, so it's for long sequential scans only.
+    bool readahead;
+};
+
+// A range of an indexed file from RecordReader::Split, records starting in
+// [begin, end). It's plain data to be passed to other threads or processes.
+struct RecordSplit {
+    int64_t begin;
+    int64_t end;
+    // Number of the first record in the file, and number of records. -1 if
+    // not known, for files not indexed.
+    int64_t first_record;
+    int64_t num_records;
+};
+
+// Reads files of both formats, V2 files are known by the file header.
+// Records returned are valid until the next Next or Reset.
 class RecordReader {
 public:
     explicit RecordReader(File *file);
+    RecordReader(File *file, const RecordReaderOptions& options);
     ~RecordReader();
 
     bool Reset();
@@ -50,15 +147,67 @@ public:
     bool ReadRecord(std::string *data);
     bool ReadRecord(StringPiece* data);
 
+    RecordFormat Format() const { return m_format; }
+    // Bytes of corrupted data skipped in V2 files.
+    int64_t SkippedBytes() const { return m_skipped_bytes; }
+
+    // Cut the file into at most n splits of about the same size by the
+    // index. Files not indexed have a single split of the whole file.
+    // The reading position is lost, Reset or seek after it.
+    bool Split(int n, std::vector<RecordSplit>* splits);
+    // Read only records of the split from now on.
+    bool SeekToSplit(const RecordSplit& split);
+    // Go to the record numbered index from 0, false if not indexed.
+    bool SeekToRecord(int64_t index);
+
 private:
-    bool Read(char *data, uint32_t size);
+    struct IndexEntry {
+        int64_t record;
+        int64_t offset;
+    };
+
+    int NextV1();
+    int NextV2();
+    // Next record of V2 including meta records.
+    int ReadRecordV2(bool* meta);
+    bool SeekV2(int64_t offset);
+    bool LoadIndex();
+    bool ReadTrailer(int64_t end, int64_t* index_offset);
+    bool ReadIndexRecord(int64_t offset, int64_t* segment_start,
+                         int64_t* num_records, std::vector<IndexEntry>* entries);
+    bool ReadFileHeader(bool* is_v2);
+    bool ReadBlock();
+    int ReadFragment(StringPiece* fragment, int* type);
+    void SkipBlock(const char* reason);
+    bool SetRecordV2(const StringPiece& data, bool compressed);
 
 private:
     File* m_file;
-    scoped_array<char> m_buffer;
-    uint32_t m_file_size;
-    uint32_t m_buffer_size;
-    uint32_t m_data_size;
+    scoped_ptr<ReadaheadReader> m_reader;
+    RecordFormat m_format;
+    StringPiece m_record;
+
+    uint32_t m_block_size;
+    scoped_ptr<BlockCompression> m_compression;
+    // The rest of the current block of V2 from m_reader.
+    StringPiece m_block;
+    uint32_t m_block_offset;
+    // The block is shorter than it should be, at the end of file.
+    bool m_last_block;
+    // Offset of the last fragment read.
+    int64_t m_fragment_offset;
+    // Records starting from here are not read, -1 for the end of file.
+    int64_t m_end_offset;
+    // Fragments assembled, or the uncompressed record.
+    std::string m_fragments;
+    std::string m_uncompressed;
+    int64_t m_skipped_bytes;
+
+    // Loaded on demand, m_file_size is -1 before.
+    int64_t m_file_size;
+    bool m_indexed;
+    int64_t m_num_records;
+    std::vector<IndexEntry> m_index;
 };
 
 } // namespace toft
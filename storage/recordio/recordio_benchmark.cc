@@ -0,0 +1,182 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Read throughput of RecordReader with and without readahead. A synthetic
+// file of random records is written once, then read through with both
+// settings, with the page cache of the file dropped before every pass, and
+// each record is checksummed as a consumer would parse it. With --threads,
+// a v2 file is indexed and its splits are read in parallel as well:
+//
+//   recordio_benchmark --file_size_mb=10240 --format=v2 --buffer_size=1048576
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/base/random.h"
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/string_piece.h"
+#include "toft/hash/crc32c.h"
+#include "toft/storage/file/file.h"
+#include "toft/storage/recordio/recordio.h"
+#include "toft/system/threading/thread.h"
+#include "toft/system/time/clock.h"
+
+#include "thirdparty/gflags/gflags.h"
+#include "thirdparty/glog/logging.h"
+
+DEFINE_string(path, "./recordio_benchmark.dat", "file to write and read");
+DEFINE_int64(file_size_mb, 10240, "size of the synthetic file");
+DEFINE_int32(record_size, 1000, "average record size, sizes are uniform in [1, 2x]");
+DEFINE_string(format, "v2", "v1 | v2");
+DEFINE_string(compression, "", "compression of v2 files, such as snappy");
+DEFINE_int64(buffer_size, 1024 * 1024, "size of each read buffer");
+DEFINE_int32(passes, 1, "read passes of each setting");
+DEFINE_int32(threads, 1, "also read splits of a v2 file in so many threads");
+DEFINE_bool(drop_cache, true, "drop the page cache of the file before every pass");
+DEFINE_bool(keep_file, false, "reuse an existing file and keep it at exit");
+
+namespace toft {
+
+static void WriteFile() {
+    RecordWriterOptions options;
+    options.format = FLAGS_format == "v1" ? RecordFormat_V1 : RecordFormat_V2;
+    options.compression = FLAGS_compression;
+    if (FLAGS_threads > 1) {
+        options.index_interval_bytes = 1024 * 1024;
+    }
+    scoped_ptr<File> file(File::Open(FLAGS_path, "w"));
+    CHECK(file != NULL) << "Can't open " << FLAGS_path;
+    RecordWriter writer(file.get(), options);
+
+    // Records are cut from a random pool, generating every byte would take
+    // longer than reading them.
+    Random random(1);
+    std::string pool;
+    for (int i = 0; i < 4 * FLAGS_record_size + 4096; ++i)
+        pool.push_back(random.Uniform(256));
+    int64_t size = FLAGS_file_size_mb * 1024 * 1024;
+    int64_t written = 0;
+    int64_t start = RealtimeClock.MicroSeconds();
+    while (written < size) {
+        uint32_t record_size = 1 + random.Uniform(2 * FLAGS_record_size);
+        uint32_t offset = random.Uniform(pool.size() - record_size);
+        CHECK(writer.WriteRecord(pool.data() + offset, record_size));
+        written += record_size;
+    }
+    if (FLAGS_threads > 1) {
+        CHECK(writer.WriteIndex());
+    }
+    CHECK(file->Close());
+    double elapsed = (RealtimeClock.MicroSeconds() - start) / 1000000.0;
+    printf("written %lld MB in %.1fs\n",
+           static_cast<long long>(written >> 20), elapsed);  // NOLINT
+}
+
+static void DropCache() {
+    int fd = open(FLAGS_path.c_str(), O_RDONLY);
+    CHECK_GE(fd, 0);
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+struct ReadResult {
+    ReadResult() : records(0), bytes(0), crc(0) {}
+    int64_t records;
+    int64_t bytes;
+    uint32_t crc;
+};
+
+static void ReadSplit(bool readahead, const RecordSplit* split, ReadResult* result) {
+    scoped_ptr<File> file(File::Open(FLAGS_path, "r"));
+    CHECK(file != NULL) << "Can't open " << FLAGS_path;
+    RecordReaderOptions options;
+    options.buffer_size = FLAGS_buffer_size;
+    options.readahead = readahead;
+    RecordReader reader(file.get(), options);
+    if (split != NULL) {
+        CHECK(reader.SeekToSplit(*split));
+    }
+    int ret;
+    while ((ret = reader.Next()) == 1) {
+        StringPiece record;
+        CHECK(reader.ReadRecord(&record));
+        result->crc = CRC32C::Extend(result->crc, record.data(), record.size());
+        ++result->records;
+        result->bytes += record.size();
+    }
+    CHECK_EQ(0, ret);
+}
+
+static void ReadFile(bool readahead, int threads) {
+    if (FLAGS_drop_cache)
+        DropCache();
+    int64_t start = RealtimeClock.MicroSeconds();
+    std::vector<ReadResult> results(threads);
+    if (threads == 1) {
+        ReadSplit(readahead, NULL, &results[0]);
+    } else {
+        std::vector<RecordSplit> splits;
+        {
+            scoped_ptr<File> file(File::Open(FLAGS_path, "r"));
+            RecordReader reader(file.get());
+            CHECK(reader.Split(threads, &splits));
+        }
+        results.resize(splits.size());
+        std::vector<Thread*> workers;
+        for (size_t i = 0; i < splits.size(); ++i) {
+            workers.push_back(new Thread(
+                    std::bind(&ReadSplit, readahead, &splits[i], &results[i])));
+        }
+        for (size_t i = 0; i < workers.size(); ++i) {
+            workers[i]->Join();
+            delete workers[i];
+        }
+    }
+    double elapsed = (RealtimeClock.MicroSeconds() - start) / 1000000.0;
+
+    ReadResult total;
+    for (size_t i = 0; i < results.size(); ++i) {
+        total.records += results[i].records;
+        total.bytes += results[i].bytes;
+        total.crc ^= results[i].crc;
+    }
+    printf("%7d %9s %10.1f %12.0f %8.2f %08x\n",
+           threads, readahead ? "on" : "off", total.bytes / elapsed / 1024 / 1024,
+           total.records / elapsed, elapsed, total.crc);
+    fflush(stdout);
+}
+
+} // namespace toft
+
+int main(int argc, char** argv) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    using namespace toft;
+    if (FLAGS_format != "v1" && FLAGS_format != "v2")
+        LOG(FATAL) << "Unknown format: " << FLAGS_format;
+    if (!FLAGS_keep_file || !File::Exists(FLAGS_path))
+        WriteFile();
+
+    printf("format=%s record_size=%d buffer_size=%lld drop_cache=%d\n",
+           FLAGS_format.c_str(), FLAGS_record_size,
+           static_cast<long long>(FLAGS_buffer_size), FLAGS_drop_cache);  // NOLINT
+    // The crc32c of splits read in threads is the xor of them.
+    printf("threads readahead       MB/s    records/s  time(s)    crc32c\n");
+    for (int i = 0; i < FLAGS_passes; ++i) {
+        ReadFile(false, 1);
+        ReadFile(true, 1);
+        if (FLAGS_threads > 1 && FLAGS_format == "v2") {
+            ReadFile(true, FLAGS_threads);
+        }
+    }
+    if (!FLAGS_keep_file)
+        File::Delete(FLAGS_path);
+    return 0;
+}
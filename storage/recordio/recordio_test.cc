@@ -5,9 +5,14 @@
 
 #include "toft/storage/recordio/recordio.h"
 
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "thirdparty/gtest/gtest.h"
+#include "toft/base/random.h"
 #include "toft/base/scoped_ptr.h"
 #include "toft/base/string/string_piece.h"
 #include "toft/storage/file/file.h"
@@ -130,4 +135,431 @@ TEST_F(RecordIOTest, StringPiece) {
     ASSERT_TRUE(file->Close());
 }
 
+static std::string MakeRecord(Random* random, size_t size) {
+    std::string record;
+    // Half of them compress well.
+    bool repeated = random->Uniform(2) == 0;
+    for (size_t i = 0; i < size; ++i)
+        record.push_back(repeated ? 'a' + i / 16 % 3 : random->Uniform(256));
+    return record;
+}
+
+static void WriteRecords(const std::string& path, const RecordWriterOptions& options,
+                         const std::vector<std::string>& records, const char* mode) {
+    scoped_ptr<File> file(File::Open(path, mode));
+    ASSERT_TRUE(file != NULL);
+    RecordWriter writer(file.get(), options);
+    for (size_t i = 0; i < records.size(); ++i)
+        ASSERT_TRUE(writer.WriteRecord(records[i]));
+    ASSERT_TRUE(file->Close());
+}
+
+static void ReadRecords(const std::string& path, std::vector<std::string>* records,
+                        int64_t* skipped_bytes) {
+    records->clear();
+    scoped_ptr<File> file(File::Open(path, "r"));
+    ASSERT_TRUE(file != NULL);
+    RecordReader reader(file.get());
+    EXPECT_EQ(RecordFormat_V2, reader.Format());
+    int ret;
+    while ((ret = reader.Next()) == 1) {
+        StringPiece record;
+        ASSERT_TRUE(reader.ReadRecord(&record));
+        records->push_back(record.as_string());
+    }
+    EXPECT_EQ(0, ret);
+    *skipped_bytes = reader.SkippedBytes();
+}
+
+static std::string ReadFile(const std::string& path) {
+    std::string content;
+    FILE* fp = fopen(path.c_str(), "rb");
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        content.append(buffer, size);
+    fclose(fp);
+    return content;
+}
+
+static void WriteFile(const std::string& path, const std::string& content) {
+    FILE* fp = fopen(path.c_str(), "wb");
+    fwrite(content.data(), 1, content.size(), fp);
+    fclose(fp);
+}
+
+class RecordIOV2Test : public ::testing::TestWithParam<const char*> {
+protected:
+    RecordIOV2Test() : m_random(1), m_path("./test_v2.dat") {
+        m_options.format = RecordFormat_V2;
+        m_options.compression = GetParam();
+    }
+
+    Random m_random;
+    std::string m_path;
+    RecordWriterOptions m_options;
+};
+
+TEST_P(RecordIOV2Test, Fragments) {
+    const uint32_t kBlockSizes[] = { 64, 100, 1024, RecordWriterOptions::kDefaultBlockSize };
+    for (size_t i = 0; i < sizeof(kBlockSizes) / sizeof(kBlockSizes[0]); ++i) {
+        m_options.block_size = kBlockSizes[i];
+        std::vector<std::string> records;
+        records.push_back("");
+        for (size_t size = 1; size < 100000; size = size * 2 + m_random.Uniform(7))
+            records.push_back(MakeRecord(&m_random, size));
+        // Sizes around fragment and block boundaries.
+        for (size_t size = 0; size < 80; ++size)
+            records.push_back(MakeRecord(&m_random, size));
+        WriteRecords(m_path, m_options, records, "w");
+
+        std::vector<std::string> read_records;
+        int64_t skipped_bytes;
+        ReadRecords(m_path, &read_records, &skipped_bytes);
+        EXPECT_EQ(0, skipped_bytes);
+        ASSERT_EQ(records.size(), read_records.size()) << kBlockSizes[i];
+        for (size_t j = 0; j < records.size(); ++j)
+            ASSERT_EQ(records[j], read_records[j]) << kBlockSizes[i] << " " << j;
+    }
+}
+
+TEST_P(RecordIOV2Test, Append) {
+    m_options.block_size = 100;
+    std::vector<std::string> records;
+    for (int i = 0; i < 10; ++i)
+        records.push_back(MakeRecord(&m_random, m_random.Uniform(300)));
+    WriteRecords(m_path, m_options, records, "w");
+    std::vector<std::string> more_records;
+    for (int i = 0; i < 10; ++i)
+        more_records.push_back(MakeRecord(&m_random, m_random.Uniform(300)));
+    WriteRecords(m_path, m_options, more_records, "a");
+    records.insert(records.end(), more_records.begin(), more_records.end());
+
+    std::vector<std::string> read_records;
+    int64_t skipped_bytes;
+    ReadRecords(m_path, &read_records, &skipped_bytes);
+    EXPECT_TRUE(records == read_records);
+}
+
+TEST_P(RecordIOV2Test, Corruption) {
+    m_options.block_size = 1024;
+    std::vector<std::string> records;
+    for (int i = 0; i < 1000; ++i)
+        records.push_back(MakeRecord(&m_random, 1 + m_random.Uniform(300)));
+    WriteRecords(m_path, m_options, records, "w");
+
+    // Flip a byte in block 20, and one in block 40.
+    std::string content = ReadFile(m_path);
+    ASSERT_GT(content.size(), 41U * 1024);
+    content[20 * 1024 + 500] ^= 0x10;
+    content[40 * 1024 + 3] ^= 0x01;
+    WriteFile(m_path, content);
+
+    std::vector<std::string> read_records;
+    int64_t skipped_bytes;
+    ReadRecords(m_path, &read_records, &skipped_bytes);
+    EXPECT_GT(skipped_bytes, 0);
+    EXPECT_LT(skipped_bytes, 4 * 1024);
+    // Records read are in order, and only those around the corrupted blocks
+    // are lost.
+    size_t j = 0;
+    for (size_t i = 0; i < read_records.size(); ++i) {
+        while (j < records.size() && records[j] != read_records[i])
+            ++j;
+        ASSERT_LT(j, records.size()) << i;
+        ++j;
+    }
+    EXPECT_LT(read_records.size(), records.size());
+    EXPECT_GT(read_records.size(), records.size() - 40);
+    EXPECT_EQ(records.back(), read_records.back());
+}
+
+TEST_P(RecordIOV2Test, TornTail) {
+    m_options.block_size = 256;
+    std::vector<std::string> records;
+    for (int i = 0; i < 20; ++i)
+        records.push_back(MakeRecord(&m_random, 100 + i * 37));
+    WriteRecords(m_path, m_options, records, "w");
+    std::string content = ReadFile(m_path);
+
+    // Cut in the last record, at every byte of its last fragment.
+    for (size_t cut = 1; cut < 64; ++cut) {
+        WriteFile(m_path, content.substr(0, content.size() - cut));
+        std::vector<std::string> read_records;
+        int64_t skipped_bytes;
+        ReadRecords(m_path, &read_records, &skipped_bytes);
+        ASSERT_EQ(records.size() - 1, read_records.size()) << cut;
+        EXPECT_EQ(records[records.size() - 2], read_records.back());
+    }
+}
+
+TEST_P(RecordIOV2Test, Preallocated) {
+    m_options.block_size = 512;
+    std::vector<std::string> records;
+    for (int i = 0; i < 30; ++i)
+        records.push_back(MakeRecord(&m_random, m_random.Uniform(1000)));
+    WriteRecords(m_path, m_options, records, "w");
+    // Zeros after the records, as in a preallocated log.
+    WriteFile(m_path, ReadFile(m_path) + std::string(5000, '\0'));
+
+    std::vector<std::string> read_records;
+    int64_t skipped_bytes;
+    ReadRecords(m_path, &read_records, &skipped_bytes);
+    EXPECT_TRUE(records == read_records);
+}
+
+static void WriteIndexedRecords(const std::string& path, const RecordWriterOptions& options,
+                                const std::vector<std::string>& records, const char* mode) {
+    scoped_ptr<File> file(File::Open(path, mode));
+    ASSERT_TRUE(file != NULL);
+    RecordWriter writer(file.get(), options);
+    for (size_t i = 0; i < records.size(); ++i)
+        ASSERT_TRUE(writer.WriteRecord(records[i]));
+    ASSERT_TRUE(writer.WriteIndex());
+    ASSERT_TRUE(file->Close());
+}
+
+static void ReadSplits(const std::string& path, int n, std::vector<std::string>* records) {
+    records->clear();
+    std::vector<RecordSplit> splits;
+    {
+        scoped_ptr<File> file(File::Open(path, "r"));
+        RecordReader reader(file.get());
+        ASSERT_TRUE(reader.Split(n, &splits));
+    }
+    ASSERT_LE(splits.size(), static_cast<size_t>(n));
+    for (size_t i = 0; i < splits.size(); ++i) {
+        if (i > 0) {
+            EXPECT_EQ(splits[i - 1].end, splits[i].begin);
+            EXPECT_EQ(splits[i - 1].first_record + splits[i - 1].num_records,
+                      splits[i].first_record);
+        }
+        // As another process would.
+        scoped_ptr<File> file(File::Open(path, "r"));
+        RecordReader reader(file.get());
+        ASSERT_TRUE(reader.SeekToSplit(splits[i]));
+        int64_t num_records = 0;
+        while (reader.Next() == 1) {
+            StringPiece record;
+            ASSERT_TRUE(reader.ReadRecord(&record));
+            records->push_back(record.as_string());
+            ++num_records;
+        }
+        if (splits[i].num_records >= 0)
+            EXPECT_EQ(splits[i].num_records, num_records);
+    }
+}
+
+TEST_P(RecordIOV2Test, SeekToRecord) {
+    m_options.block_size = 512;
+    m_options.index_interval_records = 10;
+    std::vector<std::string> records;
+    for (int i = 0; i < 1000; ++i)
+        records.push_back(MakeRecord(&m_random, m_random.Uniform(1000)));
+    WriteIndexedRecords(m_path, m_options, records, "w");
+
+    // The index is not read as records.
+    std::vector<std::string> read_records;
+    int64_t skipped_bytes;
+    ReadRecords(m_path, &read_records, &skipped_bytes);
+    EXPECT_TRUE(records == read_records);
+    EXPECT_EQ(0, skipped_bytes);
+
+    scoped_ptr<File> file(File::Open(m_path, "r"));
+    RecordReader reader(file.get());
+    const int64_t kIndexes[] = { 0, 1, 9, 10, 11, 500, 999, 123, 5 };
+    for (size_t i = 0; i < sizeof(kIndexes) / sizeof(kIndexes[0]); ++i) {
+        ASSERT_TRUE(reader.SeekToRecord(kIndexes[i]));
+        for (int64_t j = kIndexes[i]; j < std::min<int64_t>(kIndexes[i] + 3, 1000); ++j) {
+            ASSERT_EQ(1, reader.Next());
+            StringPiece record;
+            ASSERT_TRUE(reader.ReadRecord(&record));
+            ASSERT_EQ(records[j], record) << j;
+        }
+    }
+    ASSERT_TRUE(reader.SeekToRecord(1000));
+    EXPECT_EQ(0, reader.Next());
+    EXPECT_FALSE(reader.SeekToRecord(1001));
+}
+
+TEST_P(RecordIOV2Test, Split) {
+    m_options.block_size = 512;
+    m_options.index_interval_bytes = 2000;
+    std::vector<std::string> records;
+    for (int i = 0; i < 500; ++i)
+        records.push_back(MakeRecord(&m_random, m_random.Uniform(1000)));
+    WriteIndexedRecords(m_path, m_options, records, "w");
+
+    const int kSplits[] = { 1, 2, 3, 7, 100, 10000 };
+    for (size_t i = 0; i < sizeof(kSplits) / sizeof(kSplits[0]); ++i) {
+        std::vector<std::string> read_records;
+        ReadSplits(m_path, kSplits[i], &read_records);
+        EXPECT_TRUE(records == read_records) << kSplits[i] << " splits";
+    }
+}
+
+TEST_P(RecordIOV2Test, IndexAppended) {
+    m_options.block_size = 512;
+    m_options.index_interval_records = 7;
+    std::vector<std::string> records;
+    for (int i = 0; i < 300; ++i)
+        records.push_back(MakeRecord(&m_random, m_random.Uniform(1000)));
+    WriteIndexedRecords(m_path, m_options, records, "w");
+    std::vector<std::string> more_records;
+    for (int i = 0; i < 200; ++i)
+        more_records.push_back(MakeRecord(&m_random, m_random.Uniform(1000)));
+    WriteIndexedRecords(m_path, m_options, more_records, "a");
+    records.insert(records.end(), more_records.begin(), more_records.end());
+
+    scoped_ptr<File> file(File::Open(m_path, "r"));
+    RecordReader reader(file.get());
+    ASSERT_TRUE(reader.SeekToRecord(350));
+    ASSERT_EQ(1, reader.Next());
+    StringPiece record;
+    ASSERT_TRUE(reader.ReadRecord(&record));
+    EXPECT_EQ(records[350], record);
+
+    std::vector<std::string> read_records;
+    ReadSplits(m_path, 5, &read_records);
+    EXPECT_TRUE(records == read_records);
+}
+
+TEST_P(RecordIOV2Test, NotIndexed) {
+    std::vector<std::string> records;
+    for (int i = 0; i < 100; ++i)
+        records.push_back(MakeRecord(&m_random, m_random.Uniform(1000)));
+    WriteRecords(m_path, m_options, records, "w");
+    // Records after the index make it unusable.
+    RecordWriterOptions options = m_options;
+    options.index_interval_records = 10;
+    WriteIndexedRecords(m_path, options, records, "a");
+    WriteRecords(m_path, m_options, records, "a");
+    std::vector<std::string> all_records;
+    for (int i = 0; i < 3; ++i)
+        all_records.insert(all_records.end(), records.begin(), records.end());
+
+    scoped_ptr<File> file(File::Open(m_path, "r"));
+    RecordReader reader(file.get());
+    EXPECT_FALSE(reader.SeekToRecord(0));
+    std::vector<RecordSplit> splits;
+    ASSERT_TRUE(reader.Split(4, &splits));
+    ASSERT_EQ(1U, splits.size());
+    EXPECT_EQ(0, splits[0].first_record);
+    EXPECT_EQ(-1, splits[0].num_records);
+
+    std::vector<std::string> read_records;
+    ReadSplits(m_path, 4, &read_records);
+    EXPECT_TRUE(all_records == read_records);
+}
+
+INSTANTIATE_TEST_CASE_P(Compression, RecordIOV2Test, ::testing::Values("", "snappy"));
+
+TEST(RecordIOV2, Messages) {
+    RecordWriterOptions options;
+    options.format = RecordFormat_V2;
+    scoped_ptr<File> file(File::Open("./test_v2_message.dat", "w"));
+    RecordWriter writer(file.get(), options);
+    recordio_test::Document document;
+    document.set_docid(10);
+    ASSERT_TRUE(writer.WriteMessage(document));
+    document.set_docid(20);
+    ASSERT_TRUE(writer.WriteMessage(document));
+    ASSERT_TRUE(file->Close());
+
+    file.reset(File::Open("./test_v2_message.dat", "r"));
+    RecordReader reader(file.get());
+    ASSERT_TRUE(reader.ReadNextMessage(&document));
+    EXPECT_EQ(10, document.docid());
+    ASSERT_TRUE(reader.ReadNextMessage(&document));
+    EXPECT_EQ(20, document.docid());
+    EXPECT_FALSE(reader.ReadNextMessage(&document));
+}
+
+static void ReadRecordsWithOptions(const std::string& path, const RecordReaderOptions& options,
+                                   std::vector<std::string>* records) {
+    records->clear();
+    scoped_ptr<File> file(File::Open(path, "r"));
+    ASSERT_TRUE(file != NULL);
+    RecordReader reader(file.get(), options);
+    int ret;
+    while ((ret = reader.Next()) == 1) {
+        StringPiece record;
+        ASSERT_TRUE(reader.ReadRecord(&record));
+        records->push_back(record.as_string());
+    }
+    EXPECT_EQ(0, ret);
+}
+
+// Records across the read buffers, smaller or larger than them.
+TEST(RecordReader, Buffers) {
+    Random random(1);
+    std::vector<std::string> records;
+    for (int i = 0; i < 300; ++i)
+        records.push_back(MakeRecord(&random, random.Uniform(10000)));
+    const RecordFormat kFormats[] = { RecordFormat_V1, RecordFormat_V2 };
+    const size_t kBufferSizes[] = { 100, 4096, 1 << 20 };
+    for (size_t i = 0; i < sizeof(kFormats) / sizeof(kFormats[0]); ++i) {
+        RecordWriterOptions writer_options;
+        writer_options.format = kFormats[i];
+        WriteRecords("./test_buffers.dat", writer_options, records, "w");
+        for (size_t j = 0; j < sizeof(kBufferSizes) / sizeof(kBufferSizes[0]); ++j) {
+            for (int readahead = 0; readahead < 2; ++readahead) {
+                RecordReaderOptions options;
+                options.buffer_size = kBufferSizes[j];
+                options.readahead = readahead;
+                std::vector<std::string> read_records;
+                ReadRecordsWithOptions("./test_buffers.dat", options, &read_records);
+                EXPECT_TRUE(records == read_records)
+                    << "format " << kFormats[i] << ", buffer size " << kBufferSizes[j]
+                    << ", readahead " << readahead;
+            }
+        }
+    }
+}
+
+TEST(RecordReader, ResetWhileReading) {
+    Random random(1);
+    std::vector<std::string> records;
+    for (int i = 0; i < 100; ++i)
+        records.push_back(MakeRecord(&random, random.Uniform(1000)));
+    RecordWriterOptions writer_options;
+    writer_options.format = RecordFormat_V2;
+    WriteRecords("./test_reset.dat", writer_options, records, "w");
+
+    scoped_ptr<File> file(File::Open("./test_reset.dat", "r"));
+    RecordReaderOptions options;
+    options.buffer_size = 1000;
+    RecordReader reader(file.get(), options);
+    for (int round = 0; round < 3; ++round) {
+        for (size_t i = 0; i < records.size() / (round + 1); ++i) {
+            ASSERT_EQ(1, reader.Next());
+            StringPiece record;
+            ASSERT_TRUE(reader.ReadRecord(&record));
+            ASSERT_EQ(records[i], record);
+        }
+        ASSERT_TRUE(reader.Reset());
+    }
+}
+
+// Offsets beyond 4G in a sparse file, zeros are skipped as preallocated.
+TEST(RecordReader, LargeFile) {
+    const std::string path = "./test_large.dat";
+    const int64_t kHoleSize = 4500LL * 1024 * 1024;
+    std::vector<std::string> records(1, "first");
+    RecordWriterOptions writer_options;
+    writer_options.format = RecordFormat_V2;
+    WriteRecords(path, writer_options, records, "w");
+    ASSERT_EQ(0, truncate(path.c_str(), kHoleSize));
+    std::vector<std::string> more_records;
+    more_records.push_back("second");
+    more_records.push_back("third");
+    WriteRecords(path, writer_options, more_records, "a");
+    records.insert(records.end(), more_records.begin(), more_records.end());
+
+    std::vector<std::string> read_records;
+    ReadRecordsWithOptions(path, RecordReaderOptions(), &read_records);
+    EXPECT_TRUE(records == read_records);
+    unlink(path.c_str());
+}
+
 } // namespace toft
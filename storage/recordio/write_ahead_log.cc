@@ -0,0 +1,301 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/recordio/write_ahead_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "toft/base/scoped_array.h"
+#include "toft/system/threading/this_thread.h"
+
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+
+namespace {
+
+const char kSegmentSuffix[] = ".log";
+
+std::string SegmentPath(const std::string& dir, int64_t sequence) {
+    char name[32];
+    snprintf(name, sizeof(name), "%010lld%s",
+             static_cast<long long>(sequence), kSegmentSuffix);  // NOLINT
+    return dir + "/" + name;
+}
+
+// Make the entry of a file created in dir durable.
+bool SyncDir(const std::string& dir) {
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const std::string& dir,
+                             const WriteAheadLogOptions& options)
+    : m_dir(dir),
+      m_options(options),
+      m_sequence(0),
+      m_pending_cond(&m_mutex),
+      m_space_cond(&m_mutex),
+      m_pending_bytes(0),
+      m_opened(false),
+      m_stopping(false),
+      m_failed(false),
+      m_log_thread_id(-1),
+      m_num_commits(0) {
+    m_options.record_options.format = RecordFormat_V2;
+    m_options.record_options.index_interval_records = 0;
+    m_options.record_options.index_interval_bytes = 0;
+    m_options.record_options.overwrite = true;
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    Close();
+}
+
+bool WriteAheadLog::ListSegments(const std::string& dir,
+                                 std::vector<std::string>* paths) {
+    paths->clear();
+    scoped_ptr<FileIterator> iter(
+        File::Iterate(dir, std::string("*") + kSegmentSuffix, FileType_Regular));
+    if (iter == NULL) {
+        LOG(ERROR) << "Can't list " << dir;
+        return false;
+    }
+    FileEntry entry;
+    while (iter->GetNext(&entry)) {
+        paths->push_back(dir + "/" + entry.name);
+    }
+    // Names are of the same length.
+    std::sort(paths->begin(), paths->end());
+    return true;
+}
+
+bool WriteAheadLog::Open() {
+    CHECK(!m_opened) << "WriteAheadLog is already opened.";
+    std::vector<std::string> paths;
+    if (!ListSegments(m_dir, &paths)) {
+        return false;
+    }
+    m_sequence = 0;
+    if (!paths.empty()) {
+        std::string name = paths.back().substr(m_dir.size() + 1);
+        m_sequence = strtoll(name.c_str(), NULL, 10);
+    }
+    if (!OpenSegment()) {
+        return false;
+    }
+    m_opened = true;
+    m_stopping = false;
+    m_failed = false;
+    m_thread.reset(new Thread(std::bind(&WriteAheadLog::LogLoop, this)));
+    return true;
+}
+
+bool WriteAheadLog::Close() {
+    {
+        MutexLocker locker(&m_mutex);
+        if (!m_opened) {
+            return true;
+        }
+        m_stopping = true;
+        m_pending_cond.Signal();
+        m_space_cond.Broadcast();
+    }
+    m_thread->Join();
+    m_thread.reset();
+    bool ok = CloseSegment();
+
+    MutexLocker locker(&m_mutex);
+    m_opened = false;
+    return ok && !m_failed;
+}
+
+void WriteAheadLog::Append(const StringPiece& record, const Callback& callback) {
+    {
+        MutexLocker locker(&m_mutex);
+        // Space is made only by the log thread.
+        bool can_wait = ThisThread::GetId() != m_log_thread_id;
+        while (can_wait && m_pending_bytes > 0 &&
+               m_pending_bytes + record.size() > m_options.max_pending_bytes &&
+               !m_stopping && !m_failed) {
+            m_space_cond.Wait();
+        }
+        if (m_opened && !m_stopping && !m_failed) {
+            m_pending.push_back(PendingRecord());
+            m_pending.back().data.assign(record.data(), record.size());
+            m_pending.back().callback = callback;
+            m_pending_bytes += record.size();
+            m_pending_cond.Signal();
+            return;
+        }
+    }
+    callback(false);
+}
+
+Future<bool> WriteAheadLog::Append(const StringPiece& record) {
+    Promise<bool> promise;
+    Append(record, std::bind(&Promise<bool>::SetValue, promise, std::placeholders::_1));
+    return promise.GetFuture();
+}
+
+int64_t WriteAheadLog::NumCommits() const {
+    MutexLocker locker(&m_mutex);
+    return m_num_commits;
+}
+
+void WriteAheadLog::LogLoop() {
+    {
+        MutexLocker locker(&m_mutex);
+        m_log_thread_id = ThisThread::GetId();
+    }
+    std::vector<PendingRecord> group;
+    for (;;) {
+        bool failed;
+        {
+            MutexLocker locker(&m_mutex);
+            while (m_pending.empty() && !m_stopping) {
+                m_pending_cond.Wait();
+            }
+            if (m_pending.empty()) {
+                m_log_thread_id = -1;
+                return;
+            }
+            // Records appended since the last commit.
+            group.swap(m_pending);
+            m_pending_bytes = 0;
+            m_space_cond.Broadcast();
+            failed = m_failed;
+        }
+
+        bool ok = !failed && CommitGroup(group);
+        // Records committed are not affected if it fails.
+        bool rotated = !ok || RotateSegment();
+        {
+            MutexLocker locker(&m_mutex);
+            if (ok) {
+                ++m_num_commits;
+            }
+            if (!ok || !rotated) {
+                // What was written is unknown, nothing can be committed after.
+                m_failed = true;
+                m_space_cond.Broadcast();
+            }
+        }
+        for (size_t i = 0; i < group.size(); ++i) {
+            group[i].callback(ok);
+        }
+        group.clear();
+    }
+}
+
+bool WriteAheadLog::CommitGroup(const std::vector<PendingRecord>& group) {
+    for (size_t i = 0; i < group.size(); ++i) {
+        if (!m_writer->WriteRecord(group[i].data)) {
+            LOG(ERROR) << "Can't write to the log segment " << m_sequence;
+            return false;
+        }
+    }
+    bool ok = m_options.sync ? m_file->Sync() : m_file->Flush();
+    if (!ok) {
+        LOG(ERROR) << "Can't commit to the log segment " << m_sequence
+                   << ": " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool WriteAheadLog::RotateSegment() {
+    if (m_file->Tell() < m_options.segment_size) {
+        return true;
+    }
+    return CloseSegment() && OpenSegment();
+}
+
+bool WriteAheadLog::OpenSegment() {
+    ++m_sequence;
+    std::string path = SegmentPath(m_dir, m_sequence);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        LOG(ERROR) << "Can't create " << path << ": " << strerror(errno);
+        return false;
+    }
+    close(fd);
+
+    // Records are written from the start, over the zeros if any.
+    m_file.reset(File::Open(path, "r+"));
+    if (m_file == NULL) {
+        LOG(ERROR) << "Can't open " << path;
+        return false;
+    }
+    m_writer.reset(new RecordWriter(m_file.get(), m_options.record_options));
+    // Before the zeros, which are not known as V2 otherwise.
+    if (!m_writer->WriteHeader() || !m_file->Flush()) {
+        LOG(ERROR) << "Can't write the header of " << path;
+        return false;
+    }
+    if (m_options.preallocate && !FillZeros(path, m_file->Tell())) {
+        return false;
+    }
+    if (m_options.sync && !SyncDir(m_dir)) {
+        LOG(ERROR) << "Can't sync " << m_dir << ": " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool WriteAheadLog::FillZeros(const std::string& path, int64_t offset) {
+    // Space only reserved by fallocate is still converted and the size is
+    // changed by writes, which are journaled by every fdatasync. Real zeros
+    // written and synced once leave only data to later commits.
+    int fd = open(path.c_str(), O_WRONLY);
+    if (fd < 0) {
+        LOG(ERROR) << "Can't open " << path << ": " << strerror(errno);
+        return false;
+    }
+    const size_t kChunkSize = 1024 * 1024;
+    scoped_array<char> zeros(new char[kChunkSize]);
+    memset(zeros.get(), 0, kChunkSize);
+    bool ok = true;
+    while (ok && offset < m_options.segment_size) {
+        size_t size = std::min<int64_t>(kChunkSize, m_options.segment_size - offset);
+        ssize_t ret = pwrite(fd, zeros.get(), size, offset);
+        if (ret >= 0) {
+            offset += ret;
+        } else if (errno != EINTR) {
+            LOG(ERROR) << "Can't preallocate " << path << ": " << strerror(errno);
+            ok = false;
+        }
+    }
+    if (ok && m_options.sync && fsync(fd) != 0) {
+        LOG(ERROR) << "Can't sync " << path << ": " << strerror(errno);
+        ok = false;
+    }
+    close(fd);
+    return ok;
+}
+
+bool WriteAheadLog::CloseSegment() {
+    m_writer.reset();
+    if (m_file == NULL) {
+        return true;
+    }
+    bool ok = m_file->Close();
+    m_file.reset();
+    return ok;
+}
+
+} // namespace toft
@@ -0,0 +1,133 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Write-ahead log of records with group commit. Records appended by many
+// threads while the log is busy are written together by the log thread and
+// made durable by one fdatasync, then their callbacks run:
+//
+//   WriteAheadLog log("/data/redo", WriteAheadLogOptions());
+//   CHECK(log.Open());
+//   if (!log.Append(record).Get())
+//       LOG(FATAL) << "Can't log " << record;
+//
+// The log is a sequence of segment files in V2 of recordio, replayed by
+// RecordReader on ListSegments in order.
+
+#ifndef TOFT_STORAGE_RECORDIO_WRITE_AHEAD_LOG_H
+#define TOFT_STORAGE_RECORDIO_WRITE_AHEAD_LOG_H
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/string_piece.h"
+#include "toft/base/uncopyable.h"
+#include "toft/storage/file/file.h"
+#include "toft/storage/recordio/recordio.h"
+#include "toft/system/threading/condition_variable.h"
+#include "toft/system/threading/future.h"
+#include "toft/system/threading/mutex.h"
+#include "toft/system/threading/thread.h"
+
+namespace toft {
+
+struct WriteAheadLogOptions {
+    static const int64_t kDefaultSegmentSize = 64 * 1024 * 1024;
+    static const size_t kDefaultMaxPendingBytes = 16 * 1024 * 1024;
+
+    WriteAheadLogOptions()
+        : segment_size(kDefaultSegmentSize),
+          preallocate(true),
+          sync(true),
+          max_pending_bytes(kDefaultMaxPendingBytes) {}
+
+    // A new segment is started when the current one gets larger.
+    int64_t segment_size;
+    // Fill a segment with segment_size of zeros when it's created. Records
+    // are written over them, so a commit syncs only data, not the size or
+    // extents of the file.
+    bool preallocate;
+    // Commit by fdatasync, otherwise records are only written to the file
+    // system and lost if the machine crashes.
+    bool sync;
+    // Append blocks while so many bytes are waiting for the log thread.
+    size_t max_pending_bytes;
+    // Of segments, only the block size and the compression are used.
+    RecordWriterOptions record_options;
+};
+
+class WriteAheadLog {
+    TOFT_DECLARE_UNCOPYABLE(WriteAheadLog);
+
+public:
+    typedef std::function<void (bool)> Callback;
+
+    // Segments are files in dir, which must exist.
+    WriteAheadLog(const std::string& dir, const WriteAheadLogOptions& options);
+    ~WriteAheadLog();
+
+    // Start a new segment after the existing ones.
+    bool Open();
+    // Commit records appended, then close. Return false if the log failed.
+    bool Close();
+
+    // The callback is called with true when the record is committed, with
+    // false if the log failed or is closed. Callbacks run in the log thread
+    // in the order records are appended, and the next commit waits for
+    // them, keep them short.
+    //
+    // Append blocks while max_pending_bytes are waiting, except when called
+    // by a callback, as the log thread can't wait for itself.
+    void Append(const StringPiece& record, const Callback& callback);
+    Future<bool> Append(const StringPiece& record);
+
+    // Number of groups committed.
+    int64_t NumCommits() const;
+
+    // Segments in dir in order.
+    static bool ListSegments(const std::string& dir, std::vector<std::string>* paths);
+
+private:
+    struct PendingRecord {
+        std::string data;
+        Callback callback;
+    };
+
+    void LogLoop();
+    bool CommitGroup(const std::vector<PendingRecord>& group);
+    // Start a new segment if the current one is full.
+    bool RotateSegment();
+    bool OpenSegment();
+    bool CloseSegment();
+    // Fill the segment with zeros from offset to segment_size.
+    bool FillZeros(const std::string& path, int64_t offset);
+
+private:
+    std::string m_dir;
+    WriteAheadLogOptions m_options;
+
+    // Of the log thread.
+    int64_t m_sequence;
+    scoped_ptr<File> m_file;
+    scoped_ptr<RecordWriter> m_writer;
+
+    mutable Mutex m_mutex;
+    ConditionVariable m_pending_cond;
+    ConditionVariable m_space_cond;
+    std::vector<PendingRecord> m_pending;
+    size_t m_pending_bytes;
+    bool m_opened;
+    bool m_stopping;
+    bool m_failed;
+    int m_log_thread_id;
+    int64_t m_num_commits;
+    scoped_ptr<Thread> m_thread;
+};
+
+} // namespace toft
+
+#endif // TOFT_STORAGE_RECORDIO_WRITE_AHEAD_LOG_H
@@ -0,0 +1,173 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Commits/s of WriteAheadLog against the number of writer threads. Every
+// thread appends records and waits for each to be committed, as callers of
+// a redo log do. The baseline, per_record, is a RecordWriter shared under a
+// mutex with a Sync after every record:
+//
+//   write_ahead_log_benchmark --threads=1,2,4,8,16,32,64 --seconds=3
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/algorithm.h"
+#include "toft/base/string/number.h"
+#include "toft/storage/file/file.h"
+#include "toft/storage/recordio/recordio.h"
+#include "toft/storage/recordio/write_ahead_log.h"
+#include "toft/system/threading/mutex.h"
+#include "toft/system/threading/thread.h"
+#include "toft/system/time/clock.h"
+
+#include "thirdparty/gflags/gflags.h"
+#include "thirdparty/glog/logging.h"
+
+DEFINE_string(dir, "./wal_benchmark", "directory of log segments, on the disk to test");
+DEFINE_string(threads, "1,2,4,8,16,32,64", "numbers of writer threads to run");
+DEFINE_string(modes, "per_record,group", "per_record | group");
+DEFINE_int32(record_size, 100, "bytes of every record");
+DEFINE_int32(seconds, 3, "seconds to run for every number of threads and mode");
+
+namespace toft {
+
+struct WriterResult {
+    std::vector<int64_t> latencies;  // in us
+};
+
+// Commits records one by one, the way before WriteAheadLog.
+class PerRecordLog {
+public:
+    bool Open() {
+        m_file.reset(File::Open(FLAGS_dir + "/per_record.dat", "w"));
+        if (m_file == NULL)
+            return false;
+        RecordWriterOptions options;
+        options.format = RecordFormat_V2;
+        m_writer.reset(new RecordWriter(m_file.get(), options));
+        return true;
+    }
+    bool Append(const std::string& record) {
+        MutexLocker locker(&m_mutex);
+        return m_writer->WriteRecord(record) && m_file->Sync();
+    }
+    void Close() {
+        m_writer.reset();
+        m_file.reset();
+        File::Delete(FLAGS_dir + "/per_record.dat");
+    }
+
+private:
+    Mutex m_mutex;
+    scoped_ptr<File> m_file;
+    scoped_ptr<RecordWriter> m_writer;
+};
+
+static void RunWriter(PerRecordLog* per_record_log, WriteAheadLog* log,
+                      int64_t deadline, WriterResult* result) {
+    std::string record(FLAGS_record_size, 'x');
+    for (;;) {
+        int64_t start = RealtimeClock.MicroSeconds();
+        if (start >= deadline)
+            break;
+        bool ok = per_record_log != NULL ? per_record_log->Append(record)
+                                         : log->Append(record).Get();
+        CHECK(ok) << "Can't append";
+        result->latencies.push_back(RealtimeClock.MicroSeconds() - start);
+    }
+}
+
+static int64_t Percentile(const std::vector<int64_t>& sorted, double percent) {
+    if (sorted.empty())
+        return 0;
+    size_t index = static_cast<size_t>(sorted.size() * percent / 100);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void RemoveSegments() {
+    std::vector<std::string> paths;
+    CHECK(WriteAheadLog::ListSegments(FLAGS_dir, &paths));
+    for (size_t i = 0; i < paths.size(); ++i)
+        File::Delete(paths[i]);
+}
+
+static void RunBenchmark(int num_threads, const std::string& mode) {
+    PerRecordLog per_record_log;
+    WriteAheadLog log(FLAGS_dir, WriteAheadLogOptions());
+    bool per_record = mode == "per_record";
+    if (per_record) {
+        CHECK(per_record_log.Open()) << "Can't open log in " << FLAGS_dir;
+    } else {
+        CHECK(log.Open()) << "Can't open log in " << FLAGS_dir;
+    }
+
+    int64_t start = RealtimeClock.MicroSeconds();
+    int64_t deadline = start + FLAGS_seconds * 1000000LL;
+    std::vector<WriterResult> results(num_threads);
+    std::vector<Thread*> threads;
+    for (int i = 0; i < num_threads; ++i) {
+        threads.push_back(new Thread(
+                std::bind(&RunWriter, per_record ? &per_record_log : NULL,
+                          &log, deadline, &results[i])));
+    }
+    std::vector<int64_t> latencies;
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->Join();
+        delete threads[i];
+        latencies.insert(latencies.end(), results[i].latencies.begin(),
+                         results[i].latencies.end());
+    }
+    double elapsed = (RealtimeClock.MicroSeconds() - start) / 1000000.0;
+    int64_t syncs = latencies.size();
+    if (per_record) {
+        per_record_log.Close();
+    } else {
+        CHECK(log.Close());
+        syncs = log.NumCommits();
+        RemoveSegments();
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("%7d %10s %12.0f %10.0f %12.1f %10lld %10lld\n",
+           num_threads, mode.c_str(), latencies.size() / elapsed, syncs / elapsed,
+           syncs > 0 ? static_cast<double>(latencies.size()) / syncs : 0.0,
+           static_cast<long long>(Percentile(latencies, 50)),  // NOLINT
+           static_cast<long long>(Percentile(latencies, 99)));  // NOLINT
+    fflush(stdout);
+}
+
+} // namespace toft
+
+int main(int argc, char** argv) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    google::InitGoogleLogging(argv[0]);
+
+    using namespace toft;
+    mkdir(FLAGS_dir.c_str(), 0755);
+    RemoveSegments();
+
+    std::vector<std::string> threads;
+    SplitString(FLAGS_threads, ",", &threads);
+    std::vector<std::string> modes;
+    SplitString(FLAGS_modes, ",", &modes);
+    printf("dir=%s record_size=%d seconds=%d\n",
+           FLAGS_dir.c_str(), FLAGS_record_size, FLAGS_seconds);
+    printf("threads       mode    commits/s    syncs/s  records/sync   p50(us)    p99(us)\n");
+    for (size_t i = 0; i < threads.size(); ++i) {
+        int num_threads;
+        CHECK(StringToNumber(threads[i], &num_threads))
+            << "Invalid --threads: " << FLAGS_threads;
+        for (size_t j = 0; j < modes.size(); ++j) {
+            if (modes[j] != "per_record" && modes[j] != "group")
+                LOG(FATAL) << "Unknown mode: " << modes[j];
+            RunBenchmark(num_threads, modes[j]);
+        }
+    }
+    return 0;
+}
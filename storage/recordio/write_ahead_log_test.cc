@@ -0,0 +1,232 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/recordio/write_ahead_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "thirdparty/gtest/gtest.h"
+#include "toft/base/functional.h"
+#include "toft/system/threading/event.h"
+#include "toft/system/threading/mutex.h"
+#include "toft/system/threading/thread.h"
+
+namespace toft {
+
+static const char kDir[] = "./wal_test";
+
+class WriteAheadLogTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        mkdir(kDir, 0755);
+        std::vector<std::string> paths;
+        ASSERT_TRUE(WriteAheadLog::ListSegments(kDir, &paths));
+        for (size_t i = 0; i < paths.size(); ++i)
+            ASSERT_TRUE(File::Delete(paths[i]));
+    }
+
+    // Records of all segments in order.
+    void Replay(std::vector<std::string>* records) {
+        records->clear();
+        std::vector<std::string> paths;
+        ASSERT_TRUE(WriteAheadLog::ListSegments(kDir, &paths));
+        for (size_t i = 0; i < paths.size(); ++i) {
+            scoped_ptr<File> file(File::Open(paths[i], "r"));
+            ASSERT_TRUE(file != NULL);
+            RecordReader reader(file.get());
+            int ret;
+            while ((ret = reader.Next()) == 1) {
+                std::string record;
+                ASSERT_TRUE(reader.ReadRecord(&record));
+                records->push_back(record);
+            }
+            ASSERT_EQ(0, ret);
+            EXPECT_EQ(0, reader.SkippedBytes());
+        }
+    }
+
+    int NumSegments() {
+        std::vector<std::string> paths;
+        WriteAheadLog::ListSegments(kDir, &paths);
+        return paths.size();
+    }
+};
+
+static std::string MakeRecord(int thread, int index) {
+    char record[64];
+    snprintf(record, sizeof(record), "%d:%d:", thread, index);
+    return std::string(record) + std::string(index % 100, 'x');
+}
+
+TEST_F(WriteAheadLogTest, Append) {
+    WriteAheadLog log(kDir, WriteAheadLogOptions());
+    ASSERT_TRUE(log.Open());
+    std::vector<std::string> records;
+    for (int i = 0; i < 100; ++i) {
+        records.push_back(MakeRecord(0, i));
+        ASSERT_TRUE(log.Append(records.back()).Get());
+    }
+    EXPECT_LE(log.NumCommits(), 100);
+    ASSERT_TRUE(log.Close());
+
+    std::vector<std::string> read_records;
+    Replay(&read_records);
+    EXPECT_TRUE(records == read_records);
+}
+
+static void PushBack(Mutex* mutex, std::vector<int>* values, int value, bool ok) {
+    EXPECT_TRUE(ok);
+    MutexLocker locker(mutex);
+    values->push_back(value);
+}
+
+TEST_F(WriteAheadLogTest, CallbackOrder) {
+    WriteAheadLog log(kDir, WriteAheadLogOptions());
+    ASSERT_TRUE(log.Open());
+    Mutex mutex;
+    std::vector<int> values;
+    for (int i = 0; i < 1000; ++i) {
+        log.Append(MakeRecord(0, i),
+                   std::bind(&PushBack, &mutex, &values, i, std::placeholders::_1));
+    }
+    // Committed before closed.
+    ASSERT_TRUE(log.Close());
+    ASSERT_EQ(1000U, values.size());
+    for (int i = 0; i < 1000; ++i)
+        ASSERT_EQ(i, values[i]);
+    // Far less commits than records as they were appended without waiting.
+    EXPECT_LT(log.NumCommits(), 1000);
+}
+
+static void AppendRecords(WriteAheadLog* log, int thread, int count) {
+    for (int i = 0; i < count; ++i)
+        ASSERT_TRUE(log->Append(MakeRecord(thread, i)).Get());
+}
+
+TEST_F(WriteAheadLogTest, Threads) {
+    const int kThreads = 8;
+    const int kRecords = 200;
+    WriteAheadLog log(kDir, WriteAheadLogOptions());
+    ASSERT_TRUE(log.Open());
+    std::vector<Thread*> threads;
+    for (int i = 0; i < kThreads; ++i)
+        threads.push_back(new Thread(std::bind(&AppendRecords, &log, i, kRecords)));
+    for (int i = 0; i < kThreads; ++i) {
+        threads[i]->Join();
+        delete threads[i];
+    }
+    ASSERT_TRUE(log.Close());
+
+    // Records of every thread are in order.
+    std::vector<std::string> read_records;
+    Replay(&read_records);
+    ASSERT_EQ(static_cast<size_t>(kThreads * kRecords), read_records.size());
+    std::vector<int> next(kThreads, 0);
+    for (size_t i = 0; i < read_records.size(); ++i) {
+        int thread = atoi(read_records[i].c_str());
+        ASSERT_EQ(MakeRecord(thread, next[thread]), read_records[i]);
+        ++next[thread];
+    }
+}
+
+TEST_F(WriteAheadLogTest, Segments) {
+    WriteAheadLogOptions options;
+    options.segment_size = 4096;
+    options.max_pending_bytes = 1000;
+    std::vector<std::string> records;
+    for (int round = 0; round < 2; ++round) {
+        // Reopened after the existing segments.
+        WriteAheadLog log(kDir, options);
+        ASSERT_TRUE(log.Open());
+        std::vector<Future<bool> > futures;
+        for (int i = 0; i < 500; ++i) {
+            records.push_back(MakeRecord(round, i));
+            futures.push_back(log.Append(records.back()));
+        }
+        for (size_t i = 0; i < futures.size(); ++i)
+            ASSERT_TRUE(futures[i].Get());
+        ASSERT_TRUE(log.Close());
+    }
+    EXPECT_GT(NumSegments(), 10);
+
+    std::vector<std::string> read_records;
+    Replay(&read_records);
+    EXPECT_TRUE(records == read_records);
+}
+
+TEST_F(WriteAheadLogTest, Preallocate) {
+    WriteAheadLogOptions options;
+    options.segment_size = 1024 * 1024;
+    WriteAheadLog log(kDir, options);
+    ASSERT_TRUE(log.Open());
+    std::vector<std::string> records;
+    for (int i = 0; i < 100; ++i) {
+        records.push_back(MakeRecord(0, i));
+        ASSERT_TRUE(log.Append(records.back()).Get());
+    }
+    ASSERT_TRUE(log.Close());
+    // A segment of zeros only.
+    WriteAheadLog empty_log(kDir, options);
+    ASSERT_TRUE(empty_log.Open());
+    ASSERT_TRUE(empty_log.Close());
+
+    // Written from the start of the zeros, which are skipped by readers.
+    std::vector<std::string> paths;
+    ASSERT_TRUE(WriteAheadLog::ListSegments(kDir, &paths));
+    ASSERT_EQ(2U, paths.size());
+    struct stat st;
+    ASSERT_EQ(0, stat(paths[0].c_str(), &st));
+    EXPECT_EQ(options.segment_size, st.st_size);
+    std::vector<std::string> read_records;
+    Replay(&read_records);
+    EXPECT_TRUE(records == read_records);
+}
+
+static void AppendInCallback(WriteAheadLog* log, int* count, AutoResetEvent* done,
+                             bool ok) {
+    EXPECT_TRUE(ok);
+    if (++*count < 100) {
+        log->Append(MakeRecord(0, *count),
+                    std::bind(&AppendInCallback, log, count, done, std::placeholders::_1));
+    } else if (*count == 100) {
+        done->Set();
+    }
+}
+
+TEST_F(WriteAheadLogTest, AppendInCallback) {
+    WriteAheadLogOptions options;
+    options.max_pending_bytes = 10;
+    WriteAheadLog log(kDir, options);
+    ASSERT_TRUE(log.Open());
+    int count = 0;
+    AutoResetEvent done;
+    // More than max_pending_bytes are appended by callbacks.
+    for (int i = 0; i < 20; ++i) {
+        log.Append(MakeRecord(1, i),
+                   std::bind(&AppendInCallback, &log, &count, &done, std::placeholders::_1));
+    }
+    ASSERT_TRUE(done.TimedWait(10000));
+    ASSERT_TRUE(log.Close());
+}
+
+TEST_F(WriteAheadLogTest, Closed) {
+    WriteAheadLog log(kDir, WriteAheadLogOptions());
+    EXPECT_FALSE(log.Append("not opened").Get());
+    ASSERT_TRUE(log.Open());
+    ASSERT_TRUE(log.Append("opened").Get());
+    ASSERT_TRUE(log.Close());
+    EXPECT_FALSE(log.Append("closed").Get());
+    EXPECT_TRUE(log.Close());
+}
+
+TEST_F(WriteAheadLogTest, MissingDir) {
+    WriteAheadLog log("./wal_test_missing", WriteAheadLogOptions());
+    EXPECT_FALSE(log.Open());
+}
+
+} // namespace toft
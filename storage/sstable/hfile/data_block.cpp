@@ -5,9 +5,12 @@
 
 #include "toft/storage/sstable/hfile/data_block.h"
 
+#include <algorithm>
+
 #include "toft/base/string/algorithm.h"
 #include "toft/base/string/format.h"
 #include "toft/compress/block/block_compression.h"
+#include "toft/encoding/varint.h"
 #include "toft/storage/sstable/hfile/coding.h"
 
 #include "thirdparty/glog/logging.h"
@@ -16,6 +19,9 @@
 
 namespace {
 static const std::string kDataBlockMagic = "DATABLK\42";
+static const std::string kPrefixDataBlockMagic = "DATABLK\43";
+// Restart interval, item count and restart count end a prefix encoded block.
+static const size_t kPrefixBlockTrailerSize = 3 * sizeof(uint32_t);
 }
 
 namespace toft {
@@ -24,15 +30,20 @@ namespace hfile {
 DataBlock::~DataBlock() {
 }
 
-DataBlock::DataBlock(CompressType codec)
-                : compression_(NULL),
+DataBlock::DataBlock(CompressType codec, BlockEncoding encoding, int restart_interval)
+                : encoding_(encoding),
+                  restart_interval_(restart_interval),
+                  restarts_begin_(NULL),
+                  restart_count_(0),
+                  item_count_(0),
                   compressed_size_(0) {
+    CHECK_GT(restart_interval_, 0);
     switch (codec) {
     case CompressType_kSnappy:
-        compression_ = TOFT_CREATE_BLOCK_COMPRESSION("snappy");
+        compression_.reset(TOFT_CREATE_BLOCK_COMPRESSION("snappy"));
         break;
     case CompressType_kLzo:
-        compression_ = TOFT_CREATE_BLOCK_COMPRESSION("snappy");
+        compression_.reset(TOFT_CREATE_BLOCK_COMPRESSION("snappy"));
         break;
     case CompressType_kUnCompress:
         break;
@@ -42,9 +53,21 @@ DataBlock::DataBlock(CompressType codec)
 }
 
 const std::string DataBlock::EncodeToString() const {
+    std::string prefix_block;
+    const std::string *content = &buffer_;
+    if (encoding_ == BlockEncoding_kPrefix && !buffer_.empty()) {
+        prefix_block.reserve(GetUncompressedBufferSize());
+        prefix_block = buffer_;
+        for (size_t i = 0; i < restarts_.size(); ++i)
+            PutFixed32(&prefix_block, restarts_[i]);
+        PutFixed32(&prefix_block, restart_interval_);
+        PutFixed32(&prefix_block, item_count_);
+        PutFixed32(&prefix_block, restarts_.size());
+        content = &prefix_block;
+    }
     if (compression_ != NULL) {
         std::string compressed;
-        if (!compression_->Compress(buffer_.c_str(), buffer_.size(), &compressed)) {
+        if (!compression_->Compress(content->c_str(), content->size(), &compressed)) {
             LOG(ERROR)<< "compress failed!";
             return "";
         }
@@ -52,52 +75,175 @@ const std::string DataBlock::EncodeToString() const {
         compressed_size_ = compressed.size();
         return compressed;
     }
-    compressed_size_ = buffer_.size();
-    return buffer_;
+    compressed_size_ = content->size();
+    return *content;
 }
 
 bool DataBlock::DecodeFromString(const std::string &str) {
+    std::string buffer(str);
+    return DecodeFromBuffer(&buffer);
+}
+
+bool DataBlock::DecodeFromBuffer(std::string *buffer) {
+    if (compression_ != NULL) {
+        decoded_.clear();
+        if (!compression_->Uncompress(buffer->data(), buffer->size(), &decoded_)) {
+            LOG(ERROR)<< "uncompress failed!";
+            data_items_.clear();
+            return false;
+        }
+    } else {
+        decoded_.swap(*buffer);
+    }
+    return DecodeInternal(decoded_);
+}
+
+bool DataBlock::DecodeFromPiece(StringPiece data) {
     if (compression_ != NULL) {
-        std::string uncompressed;
-        if (!compression_->Uncompress(str.c_str(), str.size(), &uncompressed)) {
+        decoded_.clear();
+        if (!compression_->Uncompress(data.data(), data.size(), &decoded_)) {
             LOG(ERROR)<< "uncompress failed!";
+            data_items_.clear();
             return false;
         }
-        return DecodeInternal(uncompressed);
+        return DecodeInternal(decoded_);
     }
-    return DecodeInternal(str);
+    decoded_.clear();
+    return DecodeInternal(data);
 }
 
-bool DataBlock::DecodeInternal(const std::string &str) {
-    if (!StringStartsWith(str, kDataBlockMagic)) {
+bool DataBlock::DecodeInternal(StringPiece data) {
+    if (encoding_ == BlockEncoding_kPrefix)
+        return DecodePrefix(data);
+    return DecodePlain(data);
+}
+
+bool DataBlock::DecodePlain(StringPiece data) {
+    data_items_.clear();
+    if (!data.starts_with(kDataBlockMagic)) {
         LOG(INFO)<< "invalid data block header.";
         return false;
     }
-    data_items_.clear();
-    const char *begin = str.c_str() + kDataBlockMagic.size();
-    const char *end = str.c_str() + str.length();
-    while (begin < end) {
+    const char *begin = data.data() + kDataBlockMagic.size();
+    const char *end = data.data() + data.size();
+    while (end - begin >= static_cast<ptrdiff_t>(2 * sizeof(int32_t))) {
         int key_length = ReadInt32(&begin);
         int value_length = ReadInt32(&begin);
-        std::string key = std::string(begin, key_length);
+        if (key_length < 0 || value_length < 0 ||
+            key_length + value_length > end - begin) {
+            break;
+        }
+        StringPiece key(begin, key_length);
         begin += key_length;
-        std::string value = std::string(begin, value_length);
+        StringPiece value(begin, value_length);
         begin += value_length;
-        data_items_.push_back(make_pair(key, value));
+        data_items_.push_back(std::make_pair(key, value));
     }
-    if (begin > end) {
+    if (begin != end) {
         LOG(ERROR) << "not a complete data block, "
         << StringPrint("begin: %p, end: %p", begin, end);
+        data_items_.clear();
+        return false;
+    }
+    return true;
+}
+
+bool DataBlock::DecodePrefix(StringPiece data) {
+    content_.clear();
+    restarts_begin_ = NULL;
+    restart_count_ = 0;
+    item_count_ = 0;
+    if (!data.starts_with(kPrefixDataBlockMagic)) {
+        LOG(INFO)<< "invalid prefix data block header.";
+        return false;
+    }
+    data.remove_prefix(kPrefixDataBlockMagic.size());
+    if (data.size() < kPrefixBlockTrailerSize) {
+        LOG(ERROR)<< "not a complete prefix data block, size: " << data.size();
         return false;
     }
+    const char *trailer = data.data() + data.size() - kPrefixBlockTrailerSize;
+    int64_t restart_interval = DecodeFixed32(trailer);
+    int64_t item_count = DecodeFixed32(trailer + sizeof(uint32_t));
+    int64_t restart_count = DecodeFixed32(trailer + 2 * sizeof(uint32_t));
+    int64_t max_restart_count =
+        (data.size() - kPrefixBlockTrailerSize) / sizeof(uint32_t);
+    if (restart_interval <= 0 || restart_count <= 0 ||
+        restart_count > max_restart_count ||
+        item_count <= (restart_count - 1) * restart_interval ||
+        item_count > restart_count * restart_interval) {
+        LOG(ERROR)<< "corrupted prefix data block trailer, restart interval: "
+                  << restart_interval << ", items: " << item_count
+                  << ", restarts: " << restart_count;
+        return false;
+    }
+    restart_interval_ = restart_interval;
+    item_count_ = item_count;
+    restart_count_ = restart_count;
+    restarts_begin_ = trailer - restart_count * sizeof(uint32_t);
+    content_ = StringPiece(data.data(), restarts_begin_ - data.data());
+    for (int i = 0; i < restart_count_; ++i) {
+        if (GetRestartOffset(i) >= content_.size()) {
+            LOG(ERROR)<< "corrupted prefix data block restart point: "
+                      << GetRestartOffset(i);
+            content_.clear();
+            item_count_ = 0;
+            return false;
+        }
+    }
     return true;
 }
 
+uint32_t DataBlock::GetRestartOffset(int restart) const {
+    return DecodeFixed32(restarts_begin_ + restart * sizeof(uint32_t));
+}
+
+const std::string DataBlock::GetKey(size_t index) const {
+    CHECK_LT(index, static_cast<size_t>(GetDataItemSize()));
+    if (encoding_ == BlockEncoding_kPlain)
+        return data_items_[index].first.as_string();
+    Iterator iter(this);
+    iter.SeekToIndex(index);
+    CHECK(iter.Valid()) << "corrupted prefix data block";
+    return iter.key().as_string();
+}
+
+const std::string DataBlock::GetValue(size_t index) const {
+    CHECK_LT(index, static_cast<size_t>(GetDataItemSize()));
+    if (encoding_ == BlockEncoding_kPlain)
+        return data_items_[index].second.as_string();
+    Iterator iter(this);
+    iter.SeekToIndex(index);
+    CHECK(iter.Valid()) << "corrupted prefix data block";
+    return iter.value().as_string();
+}
+
 void DataBlock::AddItem(const std::string &key, const std::string &value) {
     // ignore totally empty item
     if (key.empty() && value.empty())
         return;
 
+    if (encoding_ == BlockEncoding_kPrefix) {
+        if (buffer_.empty())
+            buffer_ = kPrefixDataBlockMagic;
+        size_t shared = 0;
+        if (item_count_ % restart_interval_ == 0) {
+            restarts_.push_back(buffer_.size() - kPrefixDataBlockMagic.size());
+        } else {
+            size_t max_shared = std::min(last_key_.size(), key.size());
+            while (shared < max_shared && last_key_[shared] == key[shared])
+                ++shared;
+        }
+        Varint::Put32(&buffer_, shared);
+        Varint::Put32(&buffer_, key.size() - shared);
+        Varint::Put32(&buffer_, value.size());
+        buffer_.append(key, shared, std::string::npos);
+        buffer_ += value;
+        last_key_ = key;
+        ++item_count_;
+        return;
+    }
+
     if (buffer_.empty())
         buffer_ = kDataBlockMagic;
 
@@ -107,5 +253,119 @@ void DataBlock::AddItem(const std::string &key, const std::string &value) {
     buffer_ += value;
 }
 
+DataBlock::Iterator::Iterator(const DataBlock *block)
+    : block_(block),
+      valid_(false),
+      index_(-1),
+      next_(NULL) {
+}
+
+void DataBlock::Iterator::SeekToIndex(int index) {
+    valid_ = false;
+    if (index < 0 || index >= block_->GetDataItemSize())
+        return;
+    if (block_->encoding_ == BlockEncoding_kPlain) {
+        index_ = index;
+        valid_ = true;
+        return;
+    }
+    SeekToRestart(index / block_->restart_interval_);
+    while (ParseNextItem() && index_ < index) {
+    }
+}
+
+void DataBlock::Iterator::Seek(StringPiece target) {
+    if (block_->encoding_ == BlockEncoding_kPlain) {
+        // Plain blocks of unsorted sstables may be out of order, just scan.
+        for (SeekToFirst(); valid_; Next()) {
+            if (key() >= target)
+                break;
+        }
+        return;
+    }
+    valid_ = false;
+    if (block_->restart_count_ == 0)
+        return;
+    // Find the last restart point whose key is less than target.
+    int left = 0;
+    int right = block_->restart_count_ - 1;
+    while (left < right) {
+        int mid = (left + right + 1) / 2;
+        SeekToRestart(mid);
+        if (!ParseNextItem())
+            return;
+        if (key() < target) {
+            left = mid;
+        } else {
+            right = mid - 1;
+        }
+    }
+    SeekToRestart(left);
+    while (ParseNextItem()) {
+        if (key() >= target)
+            break;
+    }
+}
+
+void DataBlock::Iterator::Next() {
+    if (!valid_)
+        return;
+    if (block_->encoding_ == BlockEncoding_kPlain) {
+        ++index_;
+        valid_ = index_ < block_->GetDataItemSize();
+        return;
+    }
+    ParseNextItem();
+}
+
+StringPiece DataBlock::Iterator::key() const {
+    CHECK(valid_);
+    if (block_->encoding_ == BlockEncoding_kPlain)
+        return block_->data_items_[index_].first;
+    return key_;
+}
+
+StringPiece DataBlock::Iterator::value() const {
+    CHECK(valid_);
+    if (block_->encoding_ == BlockEncoding_kPlain)
+        return block_->data_items_[index_].second;
+    return value_;
+}
+
+void DataBlock::Iterator::SeekToRestart(int restart) {
+    valid_ = false;
+    key_.clear();
+    index_ = restart * block_->restart_interval_ - 1;
+    next_ = block_->content_.data() + block_->GetRestartOffset(restart);
+}
+
+bool DataBlock::Iterator::ParseNextItem() {
+    valid_ = false;
+    const char *limit = block_->content_.data() + block_->content_.size();
+    if (next_ >= limit || index_ + 1 >= block_->item_count_)
+        return false;
+    uint32_t shared = 0;
+    uint32_t non_shared = 0;
+    uint32_t value_length = 0;
+    const char *p = Varint::Decode32(next_, limit, &shared);
+    if (p != NULL)
+        p = Varint::Decode32(p, limit, &non_shared);
+    if (p != NULL)
+        p = Varint::Decode32(p, limit, &value_length);
+    if (p == NULL || shared > key_.size() ||
+        non_shared > static_cast<uint32_t>(limit - p) ||
+        value_length > static_cast<uint32_t>(limit - p) - non_shared) {
+        LOG(ERROR)<< "corrupted item in prefix data block, index: " << index_ + 1;
+        return false;
+    }
+    key_.resize(shared);
+    key_.append(p, non_shared);
+    value_ = StringPiece(p + non_shared, value_length);
+    next_ = p + non_shared + value_length;
+    ++index_;
+    valid_ = true;
+    return true;
+}
+
 }  // namespace hfile
 }  // namespace toft
@@ -10,6 +10,8 @@
 #include <utility>
 #include <vector>
 
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/string_piece.h"
 #include "toft/storage/sstable/hfile/block.h"
 #include "toft/storage/sstable/types.h"
 
@@ -20,56 +22,140 @@ class BlockCompression;
 
 namespace hfile {
 
+// Items of a block are either in plain encoding: full key and value of
+// every item, or in prefix encoding: each key is stored as the length of the
+// prefix shared with the previous key and the rest part, and every N items
+// there is a restart point with the full key to binary search on.
 class DataBlock : public Block {
     TOFT_DECLARE_UNCOPYABLE(DataBlock);
 
 public:
-    explicit DataBlock(CompressType codec);
+    class Iterator;
+
+    explicit DataBlock(CompressType codec,
+                       BlockEncoding encoding = BlockEncoding_kPlain,
+                       int restart_interval = 16);
     ~DataBlock();
 
     virtual const std::string EncodeToString() const;
     virtual bool DecodeFromString(const std::string &str);
+    // Same as DecodeFromString, but take over the content of buffer to avoid
+    // one copy when the block is not compressed. buffer is left unspecified.
+    bool DecodeFromBuffer(std::string *buffer);
+    // Same as DecodeFromString, but the items of an uncompressed block point
+    // into data directly, which must outlive the block.
+    bool DecodeFromPiece(StringPiece data);
 
     // It is the caller's responsibility to keep the item ordered
     // and decide when to finish adding items
     void AddItem(const std::string &key, const std::string &value);
     void ClearItems() {
         buffer_.clear();
+        last_key_.clear();
+        restarts_.clear();
+        item_count_ = 0;
         compressed_size_ = 0;
     }
 
     int64_t GetUncompressedBufferSize() const {
+        if (encoding_ == BlockEncoding_kPrefix && !buffer_.empty())
+            return buffer_.size() + (restarts_.size() + 3) * sizeof(uint32_t);
         return buffer_.size();
     }
     int64_t GetCompressedBufferSize() const {
         return compressed_size_;
     }
 
+    BlockEncoding encoding() const {
+        return encoding_;
+    }
+
     // Getters
     int GetDataItemSize() const {
-        return data_items_.size();
-    }
-    const std::string GetKey(size_t index) const {
-        CHECK(index < data_items_.size());
-        return data_items_[index].first;
+        return encoding_ == BlockEncoding_kPlain ? data_items_.size() : item_count_;
     }
-    const std::string GetValue(size_t index) const {
-        CHECK(index < data_items_.size());
-        return data_items_[index].second;
+    // Random access costs up to one restart interval in prefix encoding, use
+    // Iterator to walk through the block.
+    const std::string GetKey(size_t index) const;
+    const std::string GetValue(size_t index) const;
+
+    // Approximate bytes held by the decoded block.
+    int64_t GetMemoryUsage() const {
+        return sizeof(*this) + decoded_.capacity() + buffer_.capacity() +
+            data_items_.capacity() * sizeof(data_items_[0]);
     }
 
 private:
-    bool DecodeInternal(const std::string &str);
-
-    BlockCompression* compression_;
-
-    // Save parsed data from string
-    std::vector<std::pair<std::string, std::string> > data_items_;
+    bool DecodeInternal(StringPiece data);
+    bool DecodePlain(StringPiece data);
+    bool DecodePrefix(StringPiece data);
+    // Offset of the restart point in the block content.
+    uint32_t GetRestartOffset(int restart) const;
+
+    toft::scoped_ptr<BlockCompression> compression_;
+    BlockEncoding encoding_;
+    int restart_interval_;
+
+    // Uncompressed content of the decoded block
+    std::string decoded_;
+    // Parsed items of plain encoding, point into decoded_ or the piece to
+    // decode from
+    std::vector<std::pair<StringPiece, StringPiece> > data_items_;
+    // Decoded prefix encoding content, items end at restarts_begin_
+    StringPiece content_;
+    const char *restarts_begin_;
+    int restart_count_;
+    int item_count_;
     // To save the inputed data info
     std::string buffer_;
+    // The last added key and restart points in prefix encoding
+    std::string last_key_;
+    std::vector<uint32_t> restarts_;
     mutable int64_t compressed_size_;
 };
 
+// Walk through the items of a decoded block. An iterator is cheap and owned
+// by one reader, while the block can be shared. The block must outlive it.
+class DataBlock::Iterator {
+    TOFT_DECLARE_UNCOPYABLE(Iterator);
+
+public:
+    explicit Iterator(const DataBlock *block);
+
+    bool Valid() const {
+        return valid_;
+    }
+    void SeekToFirst() {
+        SeekToIndex(0);
+    }
+    void SeekToIndex(int index);
+    // Seek to the first item whose key is not less than target, it binary
+    // searches the restart points in prefix encoding.
+    void Seek(StringPiece target);
+    void Next();
+
+    // Index of the current item in the block.
+    int index() const {
+        return index_;
+    }
+    // The pieces keep valid until the iterator is moved or destroyed.
+    StringPiece key() const;
+    StringPiece value() const;
+
+private:
+    // Position before the restart point, the next parsed item is on it.
+    void SeekToRestart(int restart);
+    bool ParseNextItem();
+
+    const DataBlock *block_;
+    bool valid_;
+    int index_;
+    // The item to parse next in prefix encoding
+    const char *next_;
+    std::string key_;
+    StringPiece value_;
+};
+
 }  // namespace hfile
 }  // namespace toft
 
@@ -0,0 +1,113 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/sstable/hfile/data_block.h"
+
+#include <stdio.h>
+
+#include "toft/base/string/number.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+namespace hfile {
+
+static std::string MakeKey(int i) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "http://www.example.com/page/%08d", i);
+    return buffer;
+}
+
+// Keys are MakeKey(0), MakeKey(2), ..., values are the index.
+static void BuildBlock(DataBlock *block, int num_items) {
+    for (int i = 0; i < num_items; ++i)
+        block->AddItem(MakeKey(i * 2), IntegerToString(i));
+}
+
+static void TestIterate(BlockEncoding encoding) {
+    DataBlock writer(CompressType_kSnappy, encoding, 4);
+    BuildBlock(&writer, 101);
+    std::string encoded = writer.EncodeToString();
+    EXPECT_EQ(writer.GetCompressedBufferSize(), static_cast<int64_t>(encoded.size()));
+
+    DataBlock block(CompressType_kSnappy, encoding);
+    ASSERT_TRUE(block.DecodeFromString(encoded));
+    ASSERT_EQ(101, block.GetDataItemSize());
+    DataBlock::Iterator iter(&block);
+    int count = 0;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next(), ++count) {
+        EXPECT_EQ(count, iter.index());
+        EXPECT_EQ(MakeKey(count * 2), iter.key().as_string());
+        EXPECT_EQ(IntegerToString(count), iter.value().as_string());
+    }
+    EXPECT_EQ(101, count);
+    EXPECT_EQ(MakeKey(50), block.GetKey(25));
+    EXPECT_EQ("99", block.GetValue(99));
+}
+
+static void TestSeek(BlockEncoding encoding) {
+    DataBlock writer(CompressType_kUnCompress, encoding, 4);
+    BuildBlock(&writer, 101);
+    DataBlock block(CompressType_kUnCompress, encoding);
+    // The block points into encoded.
+    std::string encoded = writer.EncodeToString();
+    ASSERT_TRUE(block.DecodeFromPiece(encoded));
+
+    DataBlock::Iterator iter(&block);
+    for (int i = 0; i <= 200; ++i) {
+        iter.Seek(MakeKey(i));
+        ASSERT_TRUE(iter.Valid()) << i;
+        EXPECT_EQ((i + 1) / 2, iter.index());
+        EXPECT_EQ(MakeKey((i + 1) / 2 * 2), iter.key().as_string());
+    }
+    iter.Seek("");
+    EXPECT_EQ(0, iter.index());
+    iter.Seek(MakeKey(201));
+    EXPECT_FALSE(iter.Valid());
+}
+
+TEST(DataBlock, IteratePlain) {
+    TestIterate(BlockEncoding_kPlain);
+}
+
+TEST(DataBlock, IteratePrefix) {
+    TestIterate(BlockEncoding_kPrefix);
+}
+
+TEST(DataBlock, SeekPlain) {
+    TestSeek(BlockEncoding_kPlain);
+}
+
+TEST(DataBlock, SeekPrefix) {
+    TestSeek(BlockEncoding_kPrefix);
+}
+
+TEST(DataBlock, PrefixEncodingIsSmaller) {
+    DataBlock plain(CompressType_kUnCompress);
+    DataBlock prefix(CompressType_kUnCompress, BlockEncoding_kPrefix);
+    BuildBlock(&plain, 1000);
+    BuildBlock(&prefix, 1000);
+    EXPECT_LT(prefix.GetUncompressedBufferSize() * 2, plain.GetUncompressedBufferSize());
+    EXPECT_EQ(prefix.GetUncompressedBufferSize(),
+              static_cast<int64_t>(prefix.EncodeToString().size()));
+}
+
+TEST(DataBlock, BadPrefixBlock) {
+    DataBlock writer(CompressType_kUnCompress, BlockEncoding_kPrefix);
+    BuildBlock(&writer, 10);
+    std::string encoded = writer.EncodeToString();
+
+    // Mismatched encoding.
+    DataBlock plain(CompressType_kUnCompress);
+    EXPECT_FALSE(plain.DecodeFromString(encoded));
+
+    DataBlock block(CompressType_kUnCompress, BlockEncoding_kPrefix);
+    EXPECT_FALSE(block.DecodeFromString(encoded.substr(0, encoded.size() - 1)));
+    std::string bad = encoded;
+    bad[bad.size() - 1] = 100;  // restart count
+    EXPECT_FALSE(block.DecodeFromString(bad));
+    EXPECT_EQ(0, block.GetDataItemSize());
+}
+
+}  // namespace hfile
+}  // namespace toft
@@ -20,13 +20,18 @@ const std::string FileInfo::COMPARATOR = FileInfo::RESERVED_PREFIX
     + "COMPARATOR";
 const std::string FileInfo::LASTKEY = FileInfo::RESERVED_PREFIX
     + "LASTKEY";
+const std::string FileInfo::FILTER_BLOCK = FileInfo::RESERVED_PREFIX
+    + "FILTER_BLOCK";
+const std::string FileInfo::BLOCK_ENCODING = FileInfo::RESERVED_PREFIX
+    + "DATA_BLOCK_ENCODING";
 
 FileInfo::FileInfo()
     : item_num_(4),
       last_key_(""),
       avg_key_len_(0),
       avg_value_len_(0),
-      comparator_("org.apache.hadoop.hbase.util.Bytes$ByteArrayComparator") {
+      comparator_("org.apache.hadoop.hbase.util.Bytes$ByteArrayComparator"),
+      block_encoding_(BlockEncoding_kPlain) {
 }
 
 FileInfo::~FileInfo() {
@@ -34,7 +39,13 @@ FileInfo::~FileInfo() {
 
 const std::string FileInfo::EncodeToString() const {
     std::string result;
-    PutFixed32(&result, item_num_);
+    // The filter block and block encoding are counted only when present.
+    int32_t item_num = item_num_;
+    if (!filter_block_.empty())
+        ++item_num;
+    if (block_encoding_ != BlockEncoding_kPlain)
+        ++item_num;
+    PutFixed32(&result, item_num);
     Varint::Put32(&result, AVG_KEY_LEN.length());
     result += AVG_KEY_LEN;
     result += "\1";  // for cmpatible with HFile
@@ -55,6 +66,20 @@ const std::string FileInfo::EncodeToString() const {
     result += "\1";
     Varint::Put32(&result, last_key_.length());
     result += last_key_;
+    if (!filter_block_.empty()) {
+        Varint::Put32(&result, FILTER_BLOCK.length());
+        result += FILTER_BLOCK;
+        result += "\1";
+        Varint::Put32(&result, filter_block_.length());
+        result += filter_block_;
+    }
+    if (block_encoding_ != BlockEncoding_kPlain) {
+        Varint::Put32(&result, BLOCK_ENCODING.length());
+        result += BLOCK_ENCODING;
+        result += "\1";
+        Varint::Put32(&result, sizeof(int32_t));
+        PutFixed32(&result, block_encoding_);
+    }
     return result + buffer_;
 }
 
@@ -81,6 +106,15 @@ bool FileInfo::DecodeFromString(const std::string &str) {
             last_key_ = std::string(begin, value_length);
             begin += value_length;
             continue;
+        } else if (key == FILTER_BLOCK) {
+            filter_block_ = std::string(begin, value_length);
+            begin += value_length;
+            --item_num_;
+            continue;
+        } else if (key == BLOCK_ENCODING) {
+            block_encoding_ = static_cast<BlockEncoding>(ReadInt32(&begin));
+            --item_num_;
+            continue;
         }
         std::string value = std::string(begin, value_length);
         begin += value_length;
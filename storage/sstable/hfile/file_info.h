@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "toft/storage/sstable/hfile/block.h"
+#include "toft/storage/sstable/types.h"
 
 namespace toft {
 namespace hfile {
@@ -46,6 +47,14 @@ public:
     std::string comparator() const {
         return comparator_;
     }
+    // Encoding of all data blocks.
+    BlockEncoding block_encoding() const {
+        return block_encoding_;
+    }
+    // Encoded FilterBlock, empty if the sstable has no filter.
+    const std::string &filter_block() const {
+        return filter_block_;
+    }
     void set_item_num(int32_t item_num) {
         item_num_ = item_num;
     }
@@ -61,6 +70,12 @@ public:
     void set_comparator(std::string comparator) {
         comparator_ = comparator;
     }
+    void set_block_encoding(BlockEncoding encoding) {
+        block_encoding_ = encoding;
+    }
+    void set_filter_block(const std::string &filter_block) {
+        filter_block_ = filter_block;
+    }
 
 private:
     static const std::string RESERVED_PREFIX;
@@ -68,6 +83,8 @@ private:
     static const std::string AVG_KEY_LEN;
     static const std::string AVG_VALUE_LEN;
     static const std::string COMPARATOR;
+    static const std::string FILTER_BLOCK;
+    static const std::string BLOCK_ENCODING;
 
     // Item num in this list
     int32_t item_num_;
@@ -79,6 +96,10 @@ private:
     int32_t avg_value_len_;
     // Comparator class name of data keys
     std::string comparator_;
+    // Written only when it's not plain, for old readers
+    BlockEncoding block_encoding_;
+    // Bloom filter of all keys
+    std::string filter_block_;
     // Save input meta data
     std::string buffer_;
 };
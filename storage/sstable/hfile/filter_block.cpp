@@ -0,0 +1,81 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/sstable/hfile/filter_block.h"
+
+#include <exception>
+
+#include "toft/container/bloom_filter.h"
+#include "toft/hash/murmur.h"
+#include "toft/storage/sstable/hfile/coding.h"
+
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+namespace hfile {
+
+FilterBlock::FilterBlock(double false_positive_prob)
+                : false_positive_prob_(false_positive_prob) {
+}
+
+FilterBlock::~FilterBlock() {
+}
+
+uint64_t FilterBlock::HashKey(const StringPiece &key) {
+    return MurmurHash64A(key.data(), key.size(), 0);
+}
+
+void FilterBlock::AddKey(const StringPiece &key) {
+    key_hashes_.push_back(HashKey(key));
+}
+
+const std::string FilterBlock::EncodeToString() const {
+    if (key_hashes_.empty())
+        return std::string();
+    std::string result;
+    try {
+        BloomFilter filter(key_hashes_.size(), false_positive_prob_);
+        char buf[sizeof(uint64_t)];
+        for (size_t i = 0; i < key_hashes_.size(); ++i) {
+            EncodeFixed64(buf, key_hashes_[i]);
+            filter.Insert(buf, sizeof(buf));
+        }
+        PutFixed32(&result, filter.HashNumber());
+        result.append(reinterpret_cast<const char*>(filter.GetBitmap()),
+                      filter.MemorySize());
+    } catch (const std::exception &e) {
+        // Too many keys for one bitmap, the sstable is still usable without it.
+        LOG(WARNING) << "fail to build filter block for " << key_hashes_.size()
+                     << " keys: " << e.what();
+        result.clear();
+    }
+    return result;
+}
+
+bool FilterBlock::DecodeFromString(const std::string &str) {
+    filter_.reset();
+    if (str.size() <= sizeof(uint32_t)) {
+        LOG(ERROR) << "invalid filter block size: " << str.size();
+        return false;
+    }
+    const char *begin = str.data();
+    int32_t num_hashes = ReadInt32(&begin);
+    if (num_hashes <= 0) {
+        LOG(ERROR) << "invalid hash number of filter block: " << num_hashes;
+        return false;
+    }
+    bitmap_.assign(begin, str.data() + str.size());
+    filter_.reset(new BloomFilter(&bitmap_[0], bitmap_.size(), num_hashes, false));
+    return true;
+}
+
+bool FilterBlock::MayContain(const StringPiece &key) const {
+    if (!filter_.get())
+        return true;
+    char buf[sizeof(uint64_t)];
+    EncodeFixed64(buf, HashKey(key));
+    return filter_->MayContain(buf, sizeof(buf));
+}
+
+}  // namespace hfile
+}  // namespace toft
@@ -0,0 +1,59 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_STORAGE_SSTABLE_HFILE_FILTER_BLOCK_H
+#define TOFT_STORAGE_SSTABLE_HFILE_FILTER_BLOCK_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/string_piece.h"
+#include "toft/storage/sstable/hfile/block.h"
+
+namespace toft {
+class BloomFilter;
+
+namespace hfile {
+
+// A bloom filter over all keys of one sstable, used to answer negative
+// lookups without touching any data block.
+// It is saved as a reserved item of FileInfo, so it is loaded together with
+// the file info and old readers just see it as an unknown meta item.
+class FilterBlock : public Block {
+    TOFT_DECLARE_UNCOPYABLE(FilterBlock);
+
+public:
+    explicit FilterBlock(double false_positive_prob = 0.01);
+    ~FilterBlock();
+
+    virtual const std::string EncodeToString() const;
+    virtual bool DecodeFromString(const std::string &str);
+
+    // Called by writers for every key, duplicated keys are allowed.
+    void AddKey(const StringPiece &key);
+
+    // Return false only if the key is definitely not in the sstable.
+    bool MayContain(const StringPiece &key) const;
+
+    int64_t GetKeyCount() const {
+        return key_hashes_.size();
+    }
+
+private:
+    static uint64_t HashKey(const StringPiece &key);
+
+    double false_positive_prob_;
+    // Hashes of added keys, the filter is sized by the key count at encoding.
+    std::vector<uint64_t> key_hashes_;
+    // Decoded filter
+    std::string bitmap_;
+    toft::scoped_ptr<BloomFilter> filter_;
+};
+
+}  // namespace hfile
+}  // namespace toft
+
+#endif  // TOFT_STORAGE_SSTABLE_HFILE_FILTER_BLOCK_H
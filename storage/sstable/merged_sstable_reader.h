@@ -52,6 +52,8 @@ public:
     void IterateMetaData(
                     toft::Closure<bool(const std::string &, const std::string &)> *callback) const;
 
+    // True if any of the sstables may contain the key.
+    virtual bool MayContain(const std::string &key) const;
     bool Lookup(const std::string &key, std::string *value);
 
 private:
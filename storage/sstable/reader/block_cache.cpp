@@ -0,0 +1,211 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/sstable/reader/block_cache.h"
+
+#include <vector>
+
+#include "toft/storage/sstable/hfile/data_block.h"
+#include "toft/system/atomic/atomic.h"
+
+#include "thirdparty/gflags/gflags.h"
+#include "thirdparty/glog/logging.h"
+
+DEFINE_int64(sstable_block_cache_size, 256 * 1024 * 1024,
+             "max bytes of decoded data blocks cached for all on disk sstables");
+DEFINE_int32(sstable_block_cache_shards, 16,
+             "# of lock shards of the sstable block cache");
+DEFINE_string(sstable_block_cache_policy, "lru",
+              "eviction policy of the sstable block cache: lru, clock, or "
+              "tinylfu for caches shared by point lookups and scans");
+
+namespace toft {
+
+// Only to size the state of policies, such as the sketch of TinyLFU. Blocks
+// are rarely smaller, and the sketch takes only 16 bytes per block expected.
+static const int64_t kExpectedBlockCharge = 4 * 1024;
+
+template <typename Policy>
+class BlockCache::ShardPolicyImpl : public BlockCache::ShardPolicy {
+public:
+    explicit ShardPolicyImpl(int64_t capacity) {
+        policy_.Init(capacity, capacity / kExpectedBlockCharge);
+    }
+    virtual void RecordAccess(uint64_t hash) { policy_.RecordAccess(hash); }
+    virtual void Insert(CacheEntry *entry) { policy_.Insert(entry); }
+    virtual CacheEntry *Evict() { return policy_.Evict(); }
+    virtual void Touch(CacheEntry *entry) { policy_.Touch(entry); }
+    virtual void Remove(CacheEntry *entry) { policy_.Remove(entry); }
+    virtual void Clear() { policy_.Clear(); }
+
+private:
+    Policy policy_;
+};
+
+static BlockCache *NewDefaultCache() {
+    BlockCache::PolicyType policy;
+    CHECK(BlockCache::ParsePolicy(FLAGS_sstable_block_cache_policy, &policy))
+        << "Unknown --sstable_block_cache_policy: " << FLAGS_sstable_block_cache_policy;
+    return new BlockCache(FLAGS_sstable_block_cache_size,
+                          FLAGS_sstable_block_cache_shards, policy);
+}
+
+BlockCache::BlockCache(int64_t capacity, int num_shards, PolicyType policy)
+    : capacity_(capacity), num_shards_(num_shards), policy_(policy) {
+    CHECK_GT(num_shards, 0);
+    shards_ = new Shard[num_shards_];
+    for (int i = 0; i < num_shards_; ++i) {
+        // Spread the remainder to make the sum equal to the capacity.
+        Shard *shard = &shards_[i];
+        shard->capacity = capacity / num_shards + (i < capacity % num_shards ? 1 : 0);
+        switch (policy) {
+        case CLOCK:
+            shard->policy.reset(new ShardPolicyImpl<ClockPolicy>(shard->capacity));
+            break;
+        case TINY_LFU:
+            shard->policy.reset(new ShardPolicyImpl<TinyLfuPolicy>(shard->capacity));
+            break;
+        default:
+            shard->policy.reset(new ShardPolicyImpl<LruPolicy>(shard->capacity));
+            break;
+        }
+    }
+}
+
+BlockCache::~BlockCache() {
+    Clear();
+    delete[] shards_;
+}
+
+BlockCache *BlockCache::Default() {
+    // Never destroyed, readers may be released during static destruction.
+    static BlockCache *cache = NewDefaultCache();
+    return cache;
+}
+
+bool BlockCache::ParsePolicy(const std::string &name, PolicyType *policy) {
+    if (name == "lru") {
+        *policy = LRU;
+    } else if (name == "clock") {
+        *policy = CLOCK;
+    } else if (name == "tinylfu") {
+        *policy = TINY_LFU;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+uint64_t BlockCache::NewFileId() {
+    static uint64_t next_id = 0;
+    return AtomicIncrement(&next_id);
+}
+
+bool BlockCache::Lookup(uint64_t file_id, int64_t offset,
+                        std::shared_ptr<hfile::DataBlock> *block) {
+    Key key(file_id, offset);
+    Shard *shard = GetShard(key);
+    MutexLocker locker(&shard->mutex);
+    // Inserts follow missed lookups, they are not counted again.
+    shard->policy->RecordAccess(KeyHash()(key));
+    Index::iterator it = shard->index.find(key);
+    if (it == shard->index.end()) {
+        ++shard->stats.misses;
+        return false;
+    }
+    ++shard->stats.hits;
+    shard->policy->Touch(it->second);
+    *block = it->second->block;
+    return true;
+}
+
+void BlockCache::Insert(uint64_t file_id, int64_t offset,
+                        const std::shared_ptr<hfile::DataBlock> &block,
+                        int64_t charge) {
+    Key key(file_id, offset);
+    Shard *shard = GetShard(key);
+    if (charge > shard->capacity)
+        return;
+
+    Entry *entry = new Entry;
+    entry->key = key;
+    entry->block = block;
+    entry->hash = KeyHash()(key);
+    entry->charge = charge;
+    // The evicted blocks are released out of the lock.
+    std::vector<Entry*> evicted;
+    {
+        MutexLocker locker(&shard->mutex);
+        Index::iterator it = shard->index.find(key);
+        if (it != shard->index.end()) {
+            Entry *old = it->second;
+            shard->policy->Remove(old);
+            shard->stats.usage -= old->charge;
+            shard->index.erase(it);
+            evicted.push_back(old);
+        }
+
+        shard->index[key] = entry;
+        shard->stats.usage += charge;
+        shard->policy->Insert(entry);
+        // May be the new one if it's not admitted.
+        Entry *victim;
+        while ((victim = static_cast<Entry*>(shard->policy->Evict())) != NULL) {
+            shard->stats.usage -= victim->charge;
+            shard->index.erase(victim->key);
+            ++shard->stats.evictions;
+            evicted.push_back(victim);
+        }
+    }
+    for (size_t i = 0; i < evicted.size(); ++i)
+        delete evicted[i];
+}
+
+bool BlockCache::Erase(uint64_t file_id, int64_t offset) {
+    Key key(file_id, offset);
+    Shard *shard = GetShard(key);
+    Entry *entry = NULL;
+    {
+        MutexLocker locker(&shard->mutex);
+        Index::iterator it = shard->index.find(key);
+        if (it == shard->index.end())
+            return false;
+        entry = it->second;
+        shard->policy->Remove(entry);
+        shard->stats.usage -= entry->charge;
+        shard->index.erase(it);
+    }
+    delete entry;
+    return true;
+}
+
+void BlockCache::Clear() {
+    for (int i = 0; i < num_shards_; ++i) {
+        Index evicted;
+        Shard *shard = &shards_[i];
+        {
+            MutexLocker locker(&shard->mutex);
+            shard->policy->Clear();
+            evicted.swap(shard->index);
+            shard->stats.usage = 0;
+        }
+        for (Index::iterator it = evicted.begin(); it != evicted.end(); ++it)
+            delete it->second;
+    }
+}
+
+BlockCache::Stats BlockCache::GetStats() const {
+    Stats total;
+    for (int i = 0; i < num_shards_; ++i) {
+        const Shard &shard = shards_[i];
+        MutexLocker locker(&shard.mutex);
+        total.hits += shard.stats.hits;
+        total.misses += shard.stats.misses;
+        total.evictions += shard.stats.evictions;
+        total.usage += shard.stats.usage;
+        total.entries += shard.index.size();
+    }
+    return total;
+}
+
+}  // namespace toft
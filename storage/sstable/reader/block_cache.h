@@ -0,0 +1,150 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_STORAGE_SSTABLE_READER_BLOCK_CACHE_H
+#define TOFT_STORAGE_SSTABLE_READER_BLOCK_CACHE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+
+#include "toft/base/cxx11.h"
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/shared_ptr.h"
+#include "toft/base/uncopyable.h"
+#include "toft/base/unordered_map.h"
+#include "toft/container/cache_policy.h"
+#include "toft/system/threading/mutex.h"
+
+namespace toft {
+namespace hfile {
+class DataBlock;
+}  // namespace hfile
+
+// Cache of decoded data blocks, shared by all on disk sstables in the process.
+//
+// Blocks are keyed by (file id, block offset) and charged by their memory
+// usage, so the total memory is bounded no matter how many sstables are
+// opened. The cache is split into shards, each has its own lock and eviction
+// policy. It's thread safe.
+class BlockCache {
+    TOFT_DECLARE_UNCOPYABLE(BlockCache);
+
+public:
+    // Policies of cache_policy.h.
+    enum PolicyType {
+        // Evict the least recently used block.
+        LRU = 0,
+        // Blocks never hit again since loaded, such as by scans, are evicted
+        // before the ones hit.
+        CLOCK = 1,
+        // Blocks are admitted if accessed more often than the ones to be
+        // evicted, a scan can't flush the blocks of point lookups.
+        TINY_LFU = 2,
+    };
+
+    struct Stats {
+        Stats() : hits(0), misses(0), evictions(0), usage(0), entries(0) {}
+        int64_t hits;
+        int64_t misses;
+        int64_t evictions;
+        // Bytes charged by cached blocks.
+        int64_t usage;
+        int64_t entries;
+    };
+
+    // capacity in bytes, will be split equally into num_shards.
+    BlockCache(int64_t capacity, int num_shards, PolicyType policy = LRU);
+    ~BlockCache();
+
+    // The process wide cache, sized by --sstable_block_cache_size and
+    // --sstable_block_cache_shards, of --sstable_block_cache_policy.
+    static BlockCache *Default();
+
+    // Parse "lru", "clock" or "tinylfu".
+    static bool ParsePolicy(const std::string &name, PolicyType *policy);
+
+    // Each opened sstable gets an unique id to compose keys of its blocks.
+    static uint64_t NewFileId();
+
+    // Every lookup is an access counted by the policy, hit or not.
+    bool Lookup(uint64_t file_id, int64_t offset,
+                std::shared_ptr<hfile::DataBlock> *block);
+
+    // Replace the old one if the key is already cached. A block larger than
+    // the capacity of its shard is not cached, and the policy may not admit
+    // a block.
+    void Insert(uint64_t file_id, int64_t offset,
+                const std::shared_ptr<hfile::DataBlock> &block,
+                int64_t charge);
+
+    // Return false if it's not cached.
+    bool Erase(uint64_t file_id, int64_t offset);
+
+    void Clear();
+
+    int64_t Capacity() const {
+        return capacity_;
+    }
+
+    PolicyType GetPolicy() const {
+        return policy_;
+    }
+
+    Stats GetStats() const;
+
+private:
+    typedef std::pair<uint64_t, int64_t> Key;
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const {
+            // Offsets are not random, mix them with a large odd number.
+            return static_cast<size_t>(key.first * 0x9E3779B97F4A7C15ULL ^ key.second);
+        }
+    };
+
+    // Charged by CacheEntry::charge.
+    struct Entry : public CacheEntry {
+        Key key;
+        std::shared_ptr<hfile::DataBlock> block;
+    };
+
+    typedef std::unordered_map<Key, Entry*, KeyHash> Index;
+
+    // Policies behind one interface, selected at run time.
+    class ShardPolicy {
+    public:
+        virtual ~ShardPolicy() {}
+        virtual void RecordAccess(uint64_t hash) = 0;
+        virtual void Insert(CacheEntry *entry) = 0;
+        virtual CacheEntry *Evict() = 0;
+        virtual void Touch(CacheEntry *entry) = 0;
+        virtual void Remove(CacheEntry *entry) = 0;
+        virtual void Clear() = 0;
+    };
+
+    template <typename Policy> class ShardPolicyImpl;
+
+    struct Shard {
+        Shard() : capacity(0) {}
+        mutable Mutex mutex;
+        scoped_ptr<ShardPolicy> policy;
+        Index index;
+        int64_t capacity;
+        Stats stats;
+    };
+
+    Shard *GetShard(const Key &key) {
+        return &shards_[KeyHash()(key) % num_shards_];
+    }
+
+    int64_t capacity_;
+    int num_shards_;
+    PolicyType policy_;
+    Shard *shards_;
+};
+
+}  // namespace toft
+
+#endif  // TOFT_STORAGE_SSTABLE_READER_BLOCK_CACHE_H
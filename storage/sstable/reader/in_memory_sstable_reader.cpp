@@ -17,24 +17,24 @@ SSTableReader::Iterator *InMemorySSTableReader::Seek(const std::string &key) {
     return new InMemoryIterator(this, key);
 }
 
-void InMemorySSTableReader::Init() {
-    cached_block_.reset(new hfile::DataBlock(impl_->file_trailer_->compress_type()));
+bool InMemorySSTableReader::Init() {
+    cached_block_.reset(impl_->NewDataBlock());
     std::vector<std::string> values;
     std::string ori_key = "";
     for (int block_id = 0; block_id < impl_->file_trailer_->data_index_count(); block_id++) {
         impl_->LoadDataBlock(block_id, cached_block_.get());
-        for (int data_idx = 0; data_idx < cached_block_->GetDataItemSize(); data_idx++) {
-            if (block_id == 0 && data_idx == 0) {
-                ori_key = cached_block_->GetKey(0);
+        hfile::DataBlock::Iterator iter(cached_block_.get());
+        for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+            if (block_id == 0 && iter.index() == 0) {
+                iter.key().copy_to_string(&ori_key);
             }
-            std::string key = cached_block_->GetKey(data_idx);
-            std::string value = cached_block_->GetValue(data_idx);
+            StringPiece key = iter.key();
             if (key != ori_key) {
                 data_.push_back(make_pair(ori_key, values));
-                ori_key = key;
+                key.copy_to_string(&ori_key);
                 values.clear();
             }
-            values.push_back(value);
+            values.push_back(iter.value().as_string());
         }
     }
     data_.push_back(make_pair(ori_key, values));
@@ -42,14 +42,12 @@ void InMemorySSTableReader::Init() {
     for (DataVector::iterator it = data_.begin(); it != data_.end(); it++) {
         index_.insert(make_pair(it->first, it));
     }
+    return true;
 }
 
 InMemoryIterator::InMemoryIterator(InMemorySSTableReader *sstable, const std::string &key)
                 : sstable_(sstable) {
     SeekKey(key);
-    if (valid_) {
-        LoadItem();
-    }
 }
 
 InMemoryIterator::~InMemoryIterator() {
@@ -57,9 +55,6 @@ InMemoryIterator::~InMemoryIterator() {
 
 void InMemoryIterator::Next() {
     NextItem();
-    if (valid_) {
-        LoadItem();
-    }
 }
 
 bool InMemoryIterator::NextItem() {
@@ -79,9 +74,16 @@ bool InMemoryIterator::NextItem() {
     return true;
 }
 
-void InMemoryIterator::LoadItem() {
-    key_ = cur_it_->first;
-    value_ = cur_it_->second.at(pos_);
+StringPiece InMemoryIterator::key_piece() const {
+    if (!valid_)
+        return StringPiece();
+    return cur_it_->first;
+}
+
+StringPiece InMemoryIterator::value_piece() const {
+    if (!valid_)
+        return StringPiece();
+    return cur_it_->second[pos_];
 }
 
 void InMemoryIterator::SeekKey(const std::string &key) {
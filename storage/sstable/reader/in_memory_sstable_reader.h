@@ -27,7 +27,7 @@ public:
     InMemorySSTableReader();
     ~InMemorySSTableReader();
 
-    virtual void Init();
+    virtual bool Init();
 
     virtual Iterator *Seek(const std::string &key);
 
@@ -50,9 +50,12 @@ public:
     void SeekKey(const std::string &key);
     virtual void Next();
 
+    // Point into the table loaded in memory, no copy.
+    virtual StringPiece key_piece() const;
+    virtual StringPiece value_piece() const;
+
 private:
     bool NextItem();
-    void LoadItem();
 
     InMemorySSTableReader *sstable_;
     DataVector::iterator cur_it_;
@@ -0,0 +1,83 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/sstable/reader/iterator_heap.h"
+
+#include "toft/base/stl_util.h"
+
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+
+IteratorHeap::IteratorHeap() {
+}
+
+IteratorHeap::~IteratorHeap() {
+    Clear();
+}
+
+void IteratorHeap::Clear() {
+    DeleteElements(&heap_);
+}
+
+bool IteratorHeap::Less(const SSTableReader::Iterator *lhs,
+                        const SSTableReader::Iterator *rhs) {
+    int result = lhs->key_piece().compare(rhs->key_piece());
+    if (result != 0)
+        return result < 0;
+    return lhs->value_piece() < rhs->value_piece();
+}
+
+void IteratorHeap::Push(SSTableReader::Iterator *iter) {
+    if (!iter->Valid()) {
+        delete iter;
+        return;
+    }
+    heap_.push_back(iter);
+    SiftUp(heap_.size() - 1);
+}
+
+void IteratorHeap::Next() {
+    DCHECK(!heap_.empty());
+    SSTableReader::Iterator *top = heap_.front();
+    top->Next();
+    if (!top->Valid()) {
+        delete top;
+        heap_.front() = heap_.back();
+        heap_.pop_back();
+        if (heap_.empty())
+            return;
+    }
+    SiftDown(0);
+}
+
+void IteratorHeap::SiftUp(size_t index) {
+    SSTableReader::Iterator *iter = heap_[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!Less(iter, heap_[parent]))
+            break;
+        heap_[index] = heap_[parent];
+        index = parent;
+    }
+    heap_[index] = iter;
+}
+
+void IteratorHeap::SiftDown(size_t index) {
+    SSTableReader::Iterator *iter = heap_[index];
+    size_t size = heap_.size();
+    for (;;) {
+        size_t child = 2 * index + 1;
+        if (child >= size)
+            break;
+        if (child + 1 < size && Less(heap_[child + 1], heap_[child]))
+            ++child;
+        if (!Less(heap_[child], iter))
+            break;
+        heap_[index] = heap_[child];
+        index = child;
+    }
+    heap_[index] = iter;
+}
+
+}  // namespace toft
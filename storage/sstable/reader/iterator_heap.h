@@ -0,0 +1,60 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_STORAGE_SSTABLE_READER_ITERATOR_HEAP_H
+#define TOFT_STORAGE_SSTABLE_READER_ITERATOR_HEAP_H
+
+#include <vector>
+
+#include "toft/base/uncopyable.h"
+#include "toft/storage/sstable/sstable_reader.h"
+
+namespace toft {
+
+// A binary min-heap of sstable iterators, ordered by (key, value) of their
+// current entries. It's the k-way merge engine of MergedSSTableReader.
+//
+// Entries are compared through key_piece()/value_piece(), so no string is
+// copied, and advancing the smallest iterator only sifts the root down,
+// which costs at most 2*log(k) comparisons and no memory allocation.
+class IteratorHeap {
+    TOFT_DECLARE_UNCOPYABLE(IteratorHeap);
+
+public:
+    IteratorHeap();
+    // Delete all iterators still in the heap.
+    ~IteratorHeap();
+
+    // Take the ownership of iter, invalid iterator is deleted directly.
+    void Push(SSTableReader::Iterator *iter);
+
+    bool IsEmpty() const {
+        return heap_.empty();
+    }
+    size_t Size() const {
+        return heap_.size();
+    }
+
+    // The iterator points to the smallest entry, the heap must not be empty.
+    SSTableReader::Iterator *Top() const {
+        return heap_.front();
+    }
+
+    // Move the top iterator to its next entry and restore the heap.
+    // The top iterator is deleted if it reaches the end.
+    void Next();
+
+    void Clear();
+
+private:
+    static bool Less(const SSTableReader::Iterator *lhs,
+                     const SSTableReader::Iterator *rhs);
+    void SiftUp(size_t index);
+    void SiftDown(size_t index);
+
+    std::vector<SSTableReader::Iterator*> heap_;
+};
+
+}  // namespace toft
+
+#endif  // TOFT_STORAGE_SSTABLE_READER_ITERATOR_HEAP_H
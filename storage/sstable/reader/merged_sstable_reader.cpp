@@ -6,13 +6,13 @@
 #include "toft/storage/sstable/merged_sstable_reader.h"
 
 #include <map>
-#include <set>
 
 #include "toft/base/scoped_ptr.h"
 #include "toft/base/stl_util.h"
 #include "toft/base/string/format.h"
 #include "toft/base/string/number.h"
 #include "toft/storage/sharding/sharding.h"
+#include "toft/storage/sstable/reader/iterator_heap.h"
 #include "toft/storage/sstable/reader/on_disk_sstable_reader.h"
 #include "toft/storage/sstable/sstable.h"
 #include "toft/storage/sstable/sstable_reader.h"
@@ -128,17 +128,6 @@ public:
     std::vector<SSTableReader*> tables_;
 };
 
-struct IteratorComp {
-    inline bool operator()(const SSTableReader::Iterator *iter1,
-                           const SSTableReader::Iterator *iter2) const {
-        if (iter1->key() < iter2->key())
-            return true;
-        if (iter1->key() == iter2->key())
-            return iter1->value() < iter2->value();
-        return false;
-    }
-};
-
 class MergedIterator : public SSTableReader::Iterator {
     TOFT_DECLARE_UNCOPYABLE(MergedIterator);
 
@@ -146,55 +135,36 @@ public:
     MergedIterator(MergedSSTableReader::Impl *sstable, const std::string &key)
                     : sstable_(sstable) {
         SeekKey(key);
-        if (valid_) {
-            LoadItem();
-        }
-    }
-    ~MergedIterator() {
-        DeleteElements(&iter_queue_);
     }
+    ~MergedIterator() {}
 
     virtual void Next() {
-        valid_ = !iter_queue_.empty();
-        if (valid_) {
-            LoadItem();
-        }
+        if (!iter_heap_.IsEmpty())
+            iter_heap_.Next();
+        valid_ = !iter_heap_.IsEmpty();
     }
     virtual void SeekKey(const std::string &key);
 
-private:
-    void LoadItem();
+    // The current entry is the one of the smallest child iterator.
+    virtual StringPiece key_piece() const {
+        return valid_ ? iter_heap_.Top()->key_piece() : StringPiece();
+    }
+    virtual StringPiece value_piece() const {
+        return valid_ ? iter_heap_.Top()->value_piece() : StringPiece();
+    }
 
+private:
     MergedSSTableReader::Impl *sstable_;
-    std::multiset<SSTableReader::Iterator*, IteratorComp> iter_queue_;
+    IteratorHeap iter_heap_;
 };
 
 void MergedIterator::SeekKey(const std::string &key) {
-    valid_ = false;
+    iter_heap_.Clear();
     std::vector<SSTableReader*>::iterator iter = sstable_->tables_.begin();
     for (; iter != sstable_->tables_.end(); ++iter) {
-        SSTableReader::Iterator *it = (*iter)->Seek(key);
-        if (it->Valid()) {
-            iter_queue_.insert(it);
-            valid_ = true;
-        } else {
-            delete it;
-        }
-    }
-}
-
-void MergedIterator::LoadItem() {
-    std::multiset<SSTableReader::Iterator*>::iterator iter = iter_queue_.begin();
-    SSTableReader::Iterator *it = *iter;
-    key_ = it->key();
-    value_ = it->value();
-    it->Next();
-    iter_queue_.erase(iter);
-    if (it->Valid()) {
-        iter_queue_.insert(it);
-    } else {
-        delete it;
+        iter_heap_.Push((*iter)->Seek(key));
     }
+    valid_ = !iter_heap_.IsEmpty();
 }
 
 MergedSSTableReader::MergedSSTableReader()
@@ -321,6 +291,17 @@ void MergedSSTableReader::IterateMetaData(
     }
 }
 
+bool MergedSSTableReader::MayContain(const std::string &key) const {
+    std::vector<SSTableReader*>::const_iterator iter = impl_->tables_.begin();
+    for (; iter != impl_->tables_.end(); iter++) {
+        if ((*iter)->MayContain(key))
+            return true;
+    }
+    return false;
+}
+
+// Every sstable checks its own filter in SSTableReader::Lookup, so a miss
+// costs no disk I/O whether the sets are sharded or not.
 bool MergedSSTableReader::Lookup(const std::string &key, std::string *value) {
     VLOG(1) << "Lookup " << key << ", set num: " << impl_->sets_.size();
     for (std::map<std::string, SSTableReaderSet*>::iterator it = impl_->sets_.begin();
@@ -0,0 +1,165 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/sstable/reader/mmap_sstable_reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "toft/storage/sstable/hfile/coding.h"
+#include "toft/storage/sstable/reader/block_cache.h"
+
+#include "thirdparty/gflags/gflags.h"
+#include "thirdparty/glog/logging.h"
+
+DEFINE_bool(sstable_mmap_willneed, false,
+            "advise the kernel to read the whole mmapped sstable ahead, "
+            "otherwise pages are read on demand");
+
+namespace toft {
+
+static const std::string kIndexBlockMagic = "IDXBLK\41\43";
+
+MmapSSTableReader::MmapSSTableReader()
+    : data_(NULL), size_(0) {
+}
+
+MmapSSTableReader::~MmapSSTableReader() {
+    // Cached blocks may point into the mapping.
+    BlockCache *cache = BlockCache::Default();
+    for (size_t i = 0; i < blocks_.size(); ++i)
+        cache->Erase(file_id_, blocks_[i].offset);
+    if (data_ != NULL)
+        munmap(data_, size_);
+}
+
+bool MmapSSTableReader::Init() {
+    int fd = open(impl_->path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG(ERROR)<< "open sstable failed: " << impl_->path_ << ", " << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        LOG(ERROR)<< "stat sstable failed: " << impl_->path_ << ", " << strerror(errno);
+        close(fd);
+        return false;
+    }
+    size_ = st.st_size;
+    void *data = size_ > 0 ? mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    // The mapping is kept after the fd is closed.
+    close(fd);
+    if (data == MAP_FAILED) {
+        LOG(ERROR)<< "mmap sstable failed: " << impl_->path_ << ", " << strerror(errno);
+        size_ = 0;
+        return false;
+    }
+    data_ = static_cast<char*>(data);
+    madvise(data_, size_, FLAGS_sstable_mmap_willneed ? MADV_WILLNEED : MADV_RANDOM);
+    return LoadDataIndex();
+}
+
+bool MmapSSTableReader::LoadDataIndex() {
+    const hfile::FileTrailer *trailer = impl_->file_trailer_.get();
+    int64_t index_end = trailer->meta_index_offset() > 0 ?
+        trailer->meta_index_offset() :
+        static_cast<int64_t>(size_) - hfile::FileTrailer::TrailerSize();
+    int64_t index_begin = trailer->data_index_offset();
+    int64_t data_end = trailer->file_info_offset();
+    if (index_begin < 0 || index_end < index_begin ||
+        index_end > static_cast<int64_t>(size_) || data_end > index_begin) {
+        LOG(ERROR)<< "invalid data index range: [" << index_begin << ", " << index_end << ")";
+        return false;
+    }
+
+    StringPiece index(data_ + index_begin, index_end - index_begin);
+    if (!index.starts_with(kIndexBlockMagic)) {
+        LOG(ERROR)<< "invalid data index header";
+        return false;
+    }
+    const char *begin = index.data() + kIndexBlockMagic.size();
+    const char *end = index.data() + index.size();
+    blocks_.clear();
+    while (begin < end) {
+        if (end - begin < 12) {
+            LOG(ERROR)<< "incomplete data index";
+            return false;
+        }
+        BlockRef ref;
+        ref.offset = hfile::ReadInt64(&begin);
+        hfile::ReadInt32(&begin);  // uncompressed size
+        int key_len = hfile::ReadVint(&begin, end);
+        if (key_len < 0 || key_len > end - begin) {
+            LOG(ERROR)<< "incomplete data index";
+            return false;
+        }
+        ref.first_key.set(begin, key_len);
+        begin += key_len;
+        blocks_.push_back(ref);
+    }
+
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+        int64_t next = i + 1 < blocks_.size() ? blocks_[i + 1].offset : data_end;
+        blocks_[i].length = next - blocks_[i].offset;
+        if (blocks_[i].offset < 0 || blocks_[i].length < 0) {
+            LOG(ERROR)<< "invalid data block " << i << ", offset: " << blocks_[i].offset;
+            return false;
+        }
+    }
+    return true;
+}
+
+int MmapSSTableReader::FindMinimalBlock(const std::string &key) const {
+    // The last block whose first key is less than the key, the key may
+    // also be at the end of the previous block if it equals a first key.
+    StringPiece target(key);
+    size_t begin = 0;
+    size_t end = blocks_.size();
+    while (begin < end) {
+        size_t mid = begin + (end - begin) / 2;
+        if (blocks_[mid].first_key < target) {
+            begin = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+    return begin > 0 ? begin - 1 : 0;
+}
+
+void MmapSSTableReader::WillNeed(int block_id) const {
+    static const uintptr_t kPageMask = ~static_cast<uintptr_t>(getpagesize() - 1);
+    const BlockRef &ref = blocks_[block_id];
+    uintptr_t begin = reinterpret_cast<uintptr_t>(data_ + ref.offset) & kPageMask;
+    uintptr_t end = reinterpret_cast<uintptr_t>(data_ + ref.offset + ref.length);
+    madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+}
+
+std::shared_ptr<hfile::DataBlock> MmapSSTableReader::LoadDataBlock(int block_id) {
+    CHECK(block_id >= 0 && block_id < GetBlockSize()) << "invalid block_id: " << block_id;
+    const BlockRef &ref = blocks_[block_id];
+    BlockCache *cache = BlockCache::Default();
+    std::shared_ptr<hfile::DataBlock> block;
+    if (cache->Lookup(file_id_, ref.offset, &block))
+        return block;
+
+    block.reset(impl_->NewDataBlock());
+    if (!block->DecodeFromPiece(StringPiece(data_ + ref.offset, ref.length))) {
+        LOG(ERROR)<< "fail to load data block!";
+        return std::shared_ptr<hfile::DataBlock>();
+    }
+    // Iterators usually go on with the next block.
+    if (block_id + 1 < GetBlockSize())
+        WillNeed(block_id + 1);
+    // Only the parsed items are charged for uncompressed blocks, the
+    // content is in the page cache.
+    cache->Insert(file_id_, ref.offset, block, block->GetMemoryUsage());
+    return block;
+}
+
+}  // namespace toft
@@ -0,0 +1,57 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_STORAGE_SSTABLE_READER_MMAP_SSTABLE_READER_H
+#define TOFT_STORAGE_SSTABLE_READER_MMAP_SSTABLE_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "toft/base/string/string_piece.h"
+#include "toft/storage/sstable/reader/on_disk_sstable_reader.h"
+
+namespace toft {
+
+// MmapSSTableReader maps the whole sstable file into memory. The data index
+// is searched in the mapping, and the items of uncompressed blocks point
+// into the mapped pages, so no data is copied to user space. The page cache
+// is shared by all processes reading the same file.
+class MmapSSTableReader : public OnDiskSSTableReader {
+    TOFT_DECLARE_UNCOPYABLE(MmapSSTableReader);
+
+public:
+    MmapSSTableReader();
+    ~MmapSSTableReader();
+
+    virtual bool Init();
+
+    virtual std::shared_ptr<hfile::DataBlock> LoadDataBlock(int block_id);
+
+    virtual int GetBlockSize() const {
+        return blocks_.size();
+    }
+
+    virtual int FindMinimalBlock(const std::string &key) const;
+
+private:
+    struct BlockRef {
+        int64_t offset;
+        int64_t length;
+        StringPiece first_key;  // Point into the mapping
+    };
+
+    bool LoadDataIndex();
+    // Tell the kernel the block would be read soon.
+    void WillNeed(int block_id) const;
+
+    char *data_;
+    size_t size_;
+    std::vector<BlockRef> blocks_;
+};
+
+}  // namespace toft
+
+#endif  // TOFT_STORAGE_SSTABLE_READER_MMAP_SSTABLE_READER_H
@@ -7,33 +7,44 @@
 
 #include <algorithm>
 
+#include "toft/storage/sstable/reader/block_cache.h"
+
 #include "thirdparty/gflags/gflags.h"
 
+// Kept for command line compatibility, use --sstable_block_cache_size instead.
 DEFINE_int32(on_disk_sstable_block_cache, 128,
-             "max # of item in the block cache for one on disk sstable");
+             "deprecated, blocks are cached in the shared block cache now");
 
 namespace toft {
 
 OnDiskSSTableReader::OnDiskSSTableReader()
-                : block_cache_(new LruCache<int, std::shared_ptr<hfile::DataBlock> >(
-                               FLAGS_on_disk_sstable_block_cache)) {
+                : file_id_(BlockCache::NewFileId()) {
 }
 
 OnDiskSSTableReader::~OnDiskSSTableReader() {
+    // Blocks of the file are never looked up again, don't let them take the
+    // space of others until evicted.
+    if (impl_->data_index_ == NULL)
+        return;
+    BlockCache *cache = BlockCache::Default();
+    for (int i = 0; i < impl_->data_index_->GetBlockSize(); ++i)
+        cache->Erase(file_id_, impl_->data_index_->GetOffset(i));
 }
 
 std::shared_ptr<hfile::DataBlock> OnDiskSSTableReader::LoadDataBlock(int block_id) {
+    BlockCache *cache = BlockCache::Default();
+    const int64_t offset = impl_->data_index_->GetOffset(block_id);
     std::shared_ptr<hfile::DataBlock> block;
-    if (!block_cache_->Get(block_id, &block)) {
+    if (!cache->Lookup(file_id_, offset, &block)) {
         // not in cache,
-        hfile::DataBlock *new_block = new hfile::DataBlock(impl_->file_trailer_->compress_type());
+        hfile::DataBlock *new_block = impl_->NewDataBlock();
         if (!impl_->LoadDataBlock(block_id, new_block)) {
             delete new_block;
             LOG(ERROR)<< "fail to load data block!";
             return std::shared_ptr<hfile::DataBlock>();
         }
         block.reset(new_block);
-        block_cache_->Put(block_id, block);
+        cache->Insert(file_id_, offset, block, block->GetMemoryUsage());
     }
     return block;
 }
@@ -44,12 +55,8 @@ SSTableReader::Iterator *OnDiskSSTableReader::Seek(const std::string &key) {
 
 OnDiskIterator::OnDiskIterator(OnDiskSSTableReader *sstable, const std::string &key)
                 : sstable_(sstable),
-                  block_idx_(-1),
-                  data_idx_(-1) {
+                  block_idx_(-1) {
     SeekKey(key);
-    if (valid_) {
-        LoadItem();
-    }
 }
 
 OnDiskIterator::~OnDiskIterator() {
@@ -57,8 +64,6 @@ OnDiskIterator::~OnDiskIterator() {
 
 void OnDiskIterator::Next() {
     NextItem();
-    if (valid_)
-        LoadItem();
 }
 
 void OnDiskIterator::SeekKey(const std::string &key) {
@@ -71,50 +76,59 @@ void OnDiskIterator::SeekKey(const std::string &key) {
     return;
 
     int tmp_block_idx = sstable_->FindMinimalBlock(key);
-    if (block_idx_ != tmp_block_idx) {
+    if (block_idx_ != tmp_block_idx || !cached_block_.get()) {
         block_idx_ = tmp_block_idx;
+        block_iter_.reset(NULL);
         cached_block_ = sstable_->LoadDataBlock(block_idx_);
         if (!cached_block_.get())
         return;
+        block_iter_.reset(new hfile::DataBlock::Iterator(cached_block_.get()));
     }
 
-    data_idx_ = 0;
-    key_ = cached_block_->GetKey(data_idx_);
-    if (key_ < key) {  // check if the first item is what we need
-        while (NextItem()) {
-            key_ = cached_block_->GetKey(data_idx_);
-            if (key_ >= key) break;
-        }
-        if (!valid_) return;
-    } else {
+    block_iter_->Seek(key);
+    if (block_iter_->Valid()) {
         valid_ = true;
+    } else {
+        // all items in the block are less than the key, go on with the next
+        // block.
+        NextItem();
     }
-    value_ = cached_block_->GetValue(data_idx_);
 }
 
 bool OnDiskIterator::NextItem() {
     valid_ = false;
+    if (!block_iter_.get())
+        return false;
+    if (block_iter_->Valid())
+        block_iter_->Next();
     // reaches the last item in the block
-    if (data_idx_ == cached_block_->GetDataItemSize() - 1) {
+    while (!block_iter_->Valid()) {
         // reaches the last block, no more data
         if (block_idx_ == sstable_->GetBlockSize() - 1) {
             return false;
         }
         ++block_idx_;
-        data_idx_ = 0;
+        block_iter_.reset(NULL);
         cached_block_ = sstable_->LoadDataBlock(block_idx_);
         if (!cached_block_.get())
             return false;
-    } else {
-        ++data_idx_;
+        block_iter_.reset(new hfile::DataBlock::Iterator(cached_block_.get()));
+        block_iter_->SeekToFirst();
     }
     valid_ = true;
     return true;
 }
 
-void OnDiskIterator::LoadItem() {
-    key_ = cached_block_->GetKey(data_idx_);
-    value_ = cached_block_->GetValue(data_idx_);
+StringPiece OnDiskIterator::key_piece() const {
+    if (!valid_)
+        return StringPiece();
+    return block_iter_->key();
+}
+
+StringPiece OnDiskIterator::value_piece() const {
+    if (!valid_)
+        return StringPiece();
+    return block_iter_->value();
 }
 
 }  // namespace toft
@@ -8,9 +8,7 @@
 
 #include <string>
 
-#include "toft/base/scoped_ptr.h"
 #include "toft/base/shared_ptr.h"
-#include "toft/container/lru_cache.h"
 #include "toft/storage/sstable/reader/sstable_reader_impl.h"
 #include "toft/storage/sstable/sstable.h"
 
@@ -26,19 +24,21 @@ public:
 
     virtual Iterator *Seek(const std::string &key);
 
-    std::shared_ptr<hfile::DataBlock> LoadDataBlock(int block_id);
+    // Blocks are cached in BlockCache::Default() shared by all sstables.
+    virtual std::shared_ptr<hfile::DataBlock> LoadDataBlock(int block_id);
 
-    int GetBlockSize() const {
+    virtual int GetBlockSize() const {
         return impl_->data_index_->GetBlockSize();
     }
 
     // For one key, find the minimal block that the key would probably in it.
-    int FindMinimalBlock(const std::string &key) const {
+    virtual int FindMinimalBlock(const std::string &key) const {
         return impl_->data_index_->FindMinimalBlock(key);
     }
 
-private:
-    toft::scoped_ptr<LruCache<int, std::shared_ptr<hfile::DataBlock> > > block_cache_;
+protected:
+    // Identify blocks of this sstable in the block cache.
+    uint64_t file_id_;
 };
 
 class OnDiskIterator : public SSTableReader::Iterator {
@@ -51,18 +51,20 @@ public:
     // return false if there's no item equal or larger than the query key
     void SeekKey(const std::string &key);
 
+    // Point into the cached data block, no copy.
+    virtual StringPiece key_piece() const;
+    virtual StringPiece value_piece() const;
+
 private:
     // let the info point to next data item
     // return false if it meets end of the table.
     bool NextItem();
 
-    // get the key and value info of current item
-    void LoadItem();
-
     OnDiskSSTableReader *sstable_;
     std::shared_ptr<hfile::DataBlock> cached_block_;
+    // walks through cached_block_
+    toft::scoped_ptr<hfile::DataBlock::Iterator> block_iter_;
     int block_idx_;  // index of the current block
-    int data_idx_;   // index of the current item in the block
 
 TOFT_DECLARE_UNCOPYABLE(OnDiskIterator);
 };
@@ -13,6 +13,7 @@
 
 #include "toft/storage/file/file.h"
 #include "toft/storage/sstable/reader/in_memory_sstable_reader.h"
+#include "toft/storage/sstable/reader/mmap_sstable_reader.h"
 #include "toft/storage/sstable/reader/on_disk_sstable_reader.h"
 #include "toft/storage/sstable/reader/sstable_reader_impl.h"
 
@@ -34,14 +35,21 @@ SSTableReader *SSTableReader::Open(const std::string &path, ReadMode type) {
     case IN_MEMORY:
         ptr.reset(new InMemorySSTableReader);
         break;
+    case MMAP:
+        ptr.reset(new MmapSSTableReader);
+        break;
     default:
         DCHECK(false) << "invalid sstable type: " << type;
     }
     if (ptr.get()) {
-        if (!ptr->impl_->LoadFile(path)) {
+        // The data index of MMAP mode is read from the mapping.
+        if (!ptr->impl_->LoadFile(path, type != MMAP)) {
+            return NULL;
+        }
+        if (!ptr->Init()) {
+            LOG(ERROR)<< "init sstable failed: " << path;
             return NULL;
         }
-        ptr->Init();
     } else {
         CHECK(false) << "fail to new sstable";
     }
@@ -105,10 +113,16 @@ std::string SSTableReader::GetPath() const {
     return impl_->path_;
 }
 
+bool SSTableReader::MayContain(const std::string &key) const {
+    return impl_->MayContain(key);
+}
+
 bool SSTableReader::Lookup(const std::string &key, std::string *value) {
+    if (!MayContain(key))
+        return false;
     toft::scoped_ptr<Iterator> iter(Seek(key));
-    if (iter->key() == key) {
-        *value = iter->value();
+    if (iter->Valid() && iter->key_piece() == key) {
+        iter->value_piece().copy_to_string(value);
         return true;
     }
     return false;
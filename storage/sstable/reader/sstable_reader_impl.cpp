@@ -136,7 +136,7 @@ SSTableReader::Impl::Impl()
 
 SSTableReader::Impl::~Impl() {}
 
-bool SSTableReader::Impl::LoadFile(const std::string &path) {
+bool SSTableReader::Impl::LoadFile(const std::string &path, bool load_data_index) {
     CHECK(!file_base_.get()) << "the sstable is already opened.";
     path_ = path;
     MutexLocker l(&mutex_);
@@ -146,7 +146,21 @@ bool SSTableReader::Impl::LoadFile(const std::string &path) {
         return false;
     }
 
-    return LoadFileInfo(file_base_.get(), data_index_.get(), file_info_.get(), file_trailer_.get());
+    if (!LoadFileInfo(file_base_.get(),
+                      load_data_index ? data_index_.get() : NULL,
+                      file_info_.get(), file_trailer_.get())) {
+        return false;
+    }
+    if (!file_info_->filter_block().empty()) {
+        filter_.reset(new hfile::FilterBlock);
+        if (!filter_->DecodeFromString(file_info_->filter_block())) {
+            LOG(WARNING) << "ignore bad filter block of sstable: " << path;
+            filter_.reset();
+        }
+        // The decoded filter keeps its own copy.
+        file_info_->set_filter_block(std::string());
+    }
+    return true;
 }
 
 const std::string SSTableReader::Impl::GetMetaData(const std::string &key) const {
@@ -170,6 +184,10 @@ void SSTableReader::Impl::IterMetaData(
     }
 }
 
+hfile::DataBlock *SSTableReader::Impl::NewDataBlock() const {
+    return new hfile::DataBlock(file_trailer_->compress_type(), file_info_->block_encoding());
+}
+
 bool SSTableReader::Impl::LoadDataBlock(int block_id, hfile::DataBlock *block) {
     CHECK(block_id >= 0 && block_id < data_index_->GetBlockSize())
                     << "invalid block_id: " << block_id;
@@ -196,7 +214,7 @@ bool SSTableReader::Impl::LoadDataBlock(int block_id, hfile::DataBlock *block) {
             return false;
         }
     }
-    return block->DecodeFromString(buffer);
+    return block->DecodeFromBuffer(&buffer);
 }
 
 }  // namespace toft
@@ -37,9 +37,12 @@ public:
     Impl();
     ~Impl();
 
+    // Create an empty block in the compression and encoding of the file.
+    hfile::DataBlock *NewDataBlock() const;
     bool LoadDataBlock(int block_id, hfile::DataBlock *block);
 
-    bool LoadFile(const std::string &path);
+    // The data index is not loaded if load_data_index is false.
+    bool LoadFile(const std::string &path, bool load_data_index = true);
 
     const std::string GetMetaData(const std::string &key) const;
 
@@ -49,12 +52,18 @@ public:
         return file_trailer_->entry_count();
     }
 
+    // Return true if there is no filter block in the file.
+    bool MayContain(const std::string &key) const {
+        return !filter_.get() || filter_->MayContain(key);
+    }
+
     toft::scoped_ptr<hfile::FileTrailer> file_trailer_;
     toft::scoped_ptr<hfile::DataIndex> data_index_;
     std::string path_;
 
 private:
     toft::scoped_ptr<hfile::FileInfo> file_info_;
+    toft::scoped_ptr<hfile::FilterBlock> filter_;
     uint32_t buffer_size_;
 
     toft::Mutex mutex_;  // protects file_base_
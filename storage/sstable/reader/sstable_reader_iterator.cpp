@@ -15,10 +15,18 @@ SSTableReader::Iterator::~Iterator() {
 }
 
 const std::string SSTableReader::Iterator::key() const {
-    return key_;
+    return key_piece().as_string();
 }
 
 const std::string SSTableReader::Iterator::value() const {
+    return value_piece().as_string();
+}
+
+StringPiece SSTableReader::Iterator::key_piece() const {
+    return key_;
+}
+
+StringPiece SSTableReader::Iterator::value_piece() const {
     return value_;
 }
 
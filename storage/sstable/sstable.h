@@ -10,5 +10,6 @@
 #include "toft/storage/sstable/hfile/data_index.h"
 #include "toft/storage/sstable/hfile/file_info.h"
 #include "toft/storage/sstable/hfile/file_trailer.h"
+#include "toft/storage/sstable/hfile/filter_block.h"
 
 #endif  // TOFT_STORAGE_SSTABLE_SSTABLE_H
@@ -14,6 +14,7 @@
 
 #include "toft/base/closure.h"
 #include "toft/base/scoped_ptr.h"
+#include "toft/base/string/string_piece.h"
 #include "toft/base/uncopyable.h"
 
 // GLOBAL_NOLINT(readability/casting)
@@ -38,7 +39,8 @@ public:
 
     enum ReadMode {
         ON_DISK = 0,
-        IN_MEMORY = 1
+        IN_MEMORY = 1,
+        MMAP = 2
     };
 
     explicit SSTableReader(ReadMode type);
@@ -47,11 +49,16 @@ public:
 
     // ON_DISK mode is not good at looking key
     // IN_MEMORY mode load data to memory, which is more efficient
+    // MMAP mode maps the file into memory, keys and values of uncompressed
+    // sstables are read from the mapped pages without copy. Only for local
+    // files.
     static SSTableReader *Open(const std::string &path, ReadMode type);
     static bool GetMetaData(const std::string &path, const std::string &key, std::string *value);
     static bool GetEntryCount(const std::string &path, int *count);
 
-    virtual void Init() {
+    // Return false to fail the Open.
+    virtual bool Init() {
+        return true;
     }
 
     // return value of key, when can't find key, return empty string
@@ -60,6 +67,11 @@ public:
                     toft::Closure<bool(const std::string &, const std::string &)>* callback) const;
 
     virtual int EntryCount() const;
+
+    // Return false if the key is definitely not in the sstable, it's checked
+    // against the bloom filter of the sstable without any disk I/O.
+    // Always return true if the sstable was built without filter.
+    virtual bool MayContain(const std::string &key) const;
     virtual bool Lookup(const std::string &key, std::string *value);
 
     // New a iterator to the key, or the first one after the key if it's not found.
@@ -87,6 +99,12 @@ public:
     const std::string key() const;
     const std::string value() const;
 
+    // Views of the current entry, only meaningful when Valid() is true.
+    // They don't copy the data, and keep valid until the iterator is moved
+    // or destroyed.
+    virtual StringPiece key_piece() const;
+    virtual StringPiece value_piece() const;
+
     virtual void Next() = 0;
     //  If exist, seek to first position of this key.
     //  If not exist then
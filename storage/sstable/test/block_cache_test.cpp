@@ -0,0 +1,182 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/format.h"
+#include "toft/storage/sstable/hfile/data_block.h"
+#include "toft/storage/sstable/reader/block_cache.h"
+#include "toft/storage/sstable/sstable_reader.h"
+#include "toft/storage/sstable/sstable_writer.h"
+#include "toft/storage/sstable/test/test_util.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+static std::shared_ptr<hfile::DataBlock> NewBlock() {
+    return std::shared_ptr<hfile::DataBlock>(new hfile::DataBlock(CompressType_kUnCompress));
+}
+
+TEST(BlockCache, LookupAndInsert) {
+    BlockCache cache(1000, 1);
+    std::shared_ptr<hfile::DataBlock> block = NewBlock();
+    std::shared_ptr<hfile::DataBlock> result;
+    EXPECT_FALSE(cache.Lookup(1, 0, &result));
+    cache.Insert(1, 0, block, 100);
+    EXPECT_TRUE(cache.Lookup(1, 0, &result));
+    EXPECT_EQ(block.get(), result.get());
+    // Same offset of another file is another block.
+    EXPECT_FALSE(cache.Lookup(2, 0, &result));
+
+    BlockCache::Stats stats = cache.GetStats();
+    EXPECT_EQ(1, stats.hits);
+    EXPECT_EQ(2, stats.misses);
+    EXPECT_EQ(0, stats.evictions);
+    EXPECT_EQ(100, stats.usage);
+    EXPECT_EQ(1, stats.entries);
+}
+
+TEST(BlockCache, EvictByCharge) {
+    BlockCache cache(1000, 1);
+    for (int i = 0; i < 10; ++i)
+        cache.Insert(1, i, NewBlock(), 100);
+    std::shared_ptr<hfile::DataBlock> result;
+    // Make block 0 the most recently used one.
+    EXPECT_TRUE(cache.Lookup(1, 0, &result));
+    cache.Insert(1, 10, NewBlock(), 250);
+
+    EXPECT_TRUE(cache.Lookup(1, 0, &result));
+    EXPECT_FALSE(cache.Lookup(1, 1, &result));
+    EXPECT_FALSE(cache.Lookup(1, 2, &result));
+    EXPECT_FALSE(cache.Lookup(1, 3, &result));
+    EXPECT_TRUE(cache.Lookup(1, 4, &result));
+    EXPECT_TRUE(cache.Lookup(1, 10, &result));
+
+    BlockCache::Stats stats = cache.GetStats();
+    EXPECT_EQ(3, stats.evictions);
+    EXPECT_EQ(950, stats.usage);
+    EXPECT_EQ(8, stats.entries);
+}
+
+TEST(BlockCache, ReplaceAndOversize) {
+    BlockCache cache(1000, 2);
+    std::shared_ptr<hfile::DataBlock> block = NewBlock();
+    cache.Insert(1, 0, NewBlock(), 100);
+    cache.Insert(1, 0, block, 200);
+    std::shared_ptr<hfile::DataBlock> result;
+    EXPECT_TRUE(cache.Lookup(1, 0, &result));
+    EXPECT_EQ(block.get(), result.get());
+    EXPECT_EQ(200, cache.GetStats().usage);
+
+    // Larger than one shard.
+    cache.Insert(1, 1, NewBlock(), 600);
+    EXPECT_FALSE(cache.Lookup(1, 1, &result));
+
+    cache.Clear();
+    EXPECT_FALSE(cache.Lookup(1, 0, &result));
+    EXPECT_EQ(0, cache.GetStats().usage);
+    EXPECT_EQ(0, cache.GetStats().entries);
+}
+
+// Lookups of a hot set of blocks, then a long scan, then the hot set again.
+// Return the # of hot blocks hit after the scan.
+static int HotHitsAfterScan(BlockCache::PolicyType policy) {
+    const int kHotBlocks = 50;
+    const int64_t kCharge = 4096;
+    BlockCache cache(100 * kCharge, 1, policy);
+    std::shared_ptr<hfile::DataBlock> result;
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < kHotBlocks; ++i) {
+            if (!cache.Lookup(1, i, &result))
+                cache.Insert(1, i, NewBlock(), kCharge);
+        }
+    }
+    // Blocks of another file read only once, as by an iterator.
+    for (int i = 0; i < 1000; ++i) {
+        if (!cache.Lookup(2, i, &result))
+            cache.Insert(2, i, NewBlock(), kCharge);
+    }
+    EXPECT_LE(cache.GetStats().usage, cache.Capacity());
+
+    int hits = 0;
+    for (int i = 0; i < kHotBlocks; ++i) {
+        if (cache.Lookup(1, i, &result))
+            ++hits;
+    }
+    return hits;
+}
+
+TEST(BlockCache, ScanAndLookup) {
+    // Flushed by the scan.
+    EXPECT_EQ(0, HotHitsAfterScan(BlockCache::LRU));
+    EXPECT_GE(HotHitsAfterScan(BlockCache::TINY_LFU), 49);
+}
+
+TEST(BlockCache, Policies) {
+    BlockCache::PolicyType policy;
+    ASSERT_TRUE(BlockCache::ParsePolicy("clock", &policy));
+    EXPECT_EQ(BlockCache::CLOCK, policy);
+    EXPECT_FALSE(BlockCache::ParsePolicy("fifo", &policy));
+
+    // Evicted by charge in every policy.
+    const BlockCache::PolicyType kPolicies[] = {
+        BlockCache::LRU, BlockCache::CLOCK, BlockCache::TINY_LFU
+    };
+    for (size_t i = 0; i < sizeof(kPolicies) / sizeof(kPolicies[0]); ++i) {
+        BlockCache cache(1000, 1, kPolicies[i]);
+        EXPECT_EQ(kPolicies[i], cache.GetPolicy());
+        for (int j = 0; j < 20; ++j)
+            cache.Insert(1, j, NewBlock(), 10 + j * 10);
+        BlockCache::Stats stats = cache.GetStats();
+        EXPECT_LE(stats.usage, 1000);
+        EXPECT_GT(stats.entries, 0);
+        cache.Clear();
+        EXPECT_EQ(0, cache.GetStats().usage);
+    }
+}
+
+TEST(BlockCache, SharedByReaders) {
+    SSTableWriteOption option;
+    std::string path = "/tmp/test_block_cache.sstable";
+    option.set_path(path);
+    option.set_compress_type(CompressType_kSnappy);
+    SingleSSTableWriter builder(option);
+    for (int i = 0; i < kTestNum; ++i)
+        builder.Add(GenKey(i, kMaxLength), GenValue(i, kMaxLength));
+    EXPECT_TRUE(builder.Flush());
+
+    BlockCache *cache = BlockCache::Default();
+    cache->Clear();
+    scoped_ptr<SSTableReader> sstable1(SSTableReader::Open(path, SSTableReader::ON_DISK));
+    scoped_ptr<SSTableReader> sstable2(SSTableReader::Open(path, SSTableReader::ON_DISK));
+    ASSERT_TRUE(sstable1.get() != NULL);
+    ASSERT_TRUE(sstable2.get() != NULL);
+
+    for (int round = 0; round < 2; ++round) {
+        int count = 0;
+        scoped_ptr<SSTableReader::Iterator> iter(sstable1->NewIterator());
+        for (; iter->Valid(); iter->Next())
+            ++count;
+        EXPECT_EQ(kTestNum, count);
+    }
+    BlockCache::Stats stats = cache->GetStats();
+    EXPECT_GT(stats.entries, 0);
+    EXPECT_GT(stats.usage, 0);
+    // The second round is fully served by the cache.
+    EXPECT_GE(stats.hits, stats.entries);
+
+    // Another reader of the same file has its own blocks.
+    scoped_ptr<SSTableReader::Iterator> iter(sstable2->NewIterator());
+    EXPECT_TRUE(iter->Valid());
+    EXPECT_EQ(stats.misses + 1, cache->GetStats().misses);
+    iter.reset();
+
+    // Blocks of a deleted reader are erased at once.
+    sstable1.reset();
+    EXPECT_EQ(1, cache->GetStats().entries);
+    sstable2.reset();
+    EXPECT_EQ(0, cache->GetStats().entries);
+    EXPECT_EQ(0, cache->GetStats().usage);
+}
+
+}  // namespace toft
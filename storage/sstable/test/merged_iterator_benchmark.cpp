@@ -0,0 +1,137 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Compare the heap based k-way merge of MergedSSTableReader with the
+// std::multiset based one it replaced, the range is the number of inputs.
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "toft/base/benchmark.h"
+#include "toft/base/stl_util.h"
+#include "toft/base/string/format.h"
+#include "toft/storage/sstable/reader/iterator_heap.h"
+#include "toft/storage/sstable/sstable_reader.h"
+
+namespace toft {
+
+// Iterate over sorted keys in memory, so only the merge itself is measured.
+class VectorIterator : public SSTableReader::Iterator {
+public:
+    explicit VectorIterator(const std::vector<std::string> *keys)
+        : keys_(keys), pos_(0) {
+        valid_ = !keys_->empty();
+    }
+
+    virtual void Next() {
+        ++pos_;
+        valid_ = pos_ < keys_->size();
+    }
+    virtual void SeekKey(const std::string &key) {
+        pos_ = std::lower_bound(keys_->begin(), keys_->end(), key) - keys_->begin();
+        valid_ = pos_ < keys_->size();
+    }
+    virtual StringPiece key_piece() const {
+        return (*keys_)[pos_];
+    }
+    virtual StringPiece value_piece() const {
+        return StringPiece();
+    }
+
+private:
+    const std::vector<std::string> *keys_;
+    size_t pos_;
+};
+
+// The comparator used by MergedIterator before, it copies keys and values.
+struct IteratorComp {
+    bool operator()(const SSTableReader::Iterator *iter1,
+                    const SSTableReader::Iterator *iter2) const {
+        if (iter1->key() < iter2->key())
+            return true;
+        if (iter1->key() == iter2->key())
+            return iter1->value() < iter2->value();
+        return false;
+    }
+};
+
+static const int kNumItems = 1 << 20;
+static std::vector<std::vector<std::string> > g_inputs;
+
+// Spread kNumItems keys over num_inputs sorted inputs, round robin.
+static void PrepareInputs(int num_inputs) {
+    if (g_inputs.size() == static_cast<size_t>(num_inputs))
+        return;
+    StopBenchmarkTiming();
+    g_inputs.assign(num_inputs, std::vector<std::string>());
+    for (int i = 0; i < kNumItems; ++i) {
+        g_inputs[i % num_inputs].push_back(StringPrint("%012d", i));
+    }
+    StartBenchmarkTiming();
+}
+
+// Merge all inputs, but stop after n items.
+static int MultisetMergeOnce(int n, int num_inputs) {
+    std::multiset<SSTableReader::Iterator*, IteratorComp> iter_queue;
+    for (int i = 0; i < num_inputs; ++i) {
+        SSTableReader::Iterator *iter = new VectorIterator(&g_inputs[i]);
+        if (iter->Valid())
+            iter_queue.insert(iter);
+        else
+            delete iter;
+    }
+    std::string key;
+    std::string value;
+    int count = 0;
+    for (; count < n && !iter_queue.empty(); ++count) {
+        std::multiset<SSTableReader::Iterator*>::iterator it = iter_queue.begin();
+        SSTableReader::Iterator *iter = *it;
+        key = iter->key();
+        value = iter->value();
+        iter->Next();
+        iter_queue.erase(it);
+        if (iter->Valid())
+            iter_queue.insert(iter);
+        else
+            delete iter;
+    }
+    DeleteElements(&iter_queue);
+    return count;
+}
+
+static int HeapMergeOnce(int n, int num_inputs) {
+    IteratorHeap heap;
+    for (int i = 0; i < num_inputs; ++i) {
+        heap.Push(new VectorIterator(&g_inputs[i]));
+    }
+    int count = 0;
+    for (; count < n && !heap.IsEmpty(); ++count) {
+        StringPiece key = heap.Top()->key_piece();
+        StringPiece value = heap.Top()->value_piece();
+        (void) key;
+        (void) value;
+        heap.Next();
+    }
+    return count;
+}
+
+static void MultisetMerge(int n, int num_inputs) {
+    PrepareInputs(num_inputs);
+    for (int left = n; left > 0;)
+        left -= MultisetMergeOnce(left, num_inputs);
+    SetBenchmarkItemsProcessed(n);
+}
+
+static void HeapMerge(int n, int num_inputs) {
+    PrepareInputs(num_inputs);
+    for (int left = n; left > 0;)
+        left -= HeapMergeOnce(left, num_inputs);
+    SetBenchmarkItemsProcessed(n);
+}
+
+TOFT_BENCHMARK_RANGE(MultisetMerge, 2, 1024)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(HeapMerge, 2, 1024)->ThreadRange(1, 1);
+
+}  // namespace toft
@@ -134,4 +134,40 @@ TEST(MergedSSTableReader, Lookup) {
     LOG(INFO)<< "done!";
 }
 
+TEST(MergedSSTableReader, IterateInterleavedFiles) {
+    const int kNumFiles = 8;
+    std::vector<std::string> paths;
+    for (int k = 0; k < kNumFiles; ++k) {
+        SSTableWriteOption option;
+        std::string path = StringPrint("/tmp/test_merged_interleaved_%d.sstable", k);
+        option.set_path(path);
+        option.set_block_size(128);
+        SingleSSTableWriter builder(option);
+        for (int i = k; i < kTestNum; i += kNumFiles) {
+            builder.AddOrDie(GenKey(i, kMaxLength), GenValue(i, kMaxLength));
+        }
+        ASSERT_TRUE(builder.Flush());
+        paths.push_back(path);
+    }
+
+    MergedSSTableReader sstable;
+    ASSERT_TRUE(sstable.Open(paths, SSTableReader::ON_DISK, false));
+    toft::scoped_ptr<SSTableReader::Iterator> iter(sstable.NewIterator());
+    for (int i = 0; i < kTestNum; ++i) {
+        ASSERT_TRUE(iter->Valid()) << i;
+        EXPECT_EQ(GenKey(i, kMaxLength), iter->key_piece().as_string()) << i;
+        EXPECT_EQ(GenValue(i, kMaxLength), iter->value()) << i;
+        iter->Next();
+    }
+    EXPECT_FALSE(iter->Valid());
+
+    iter.reset(sstable.Seek(GenKey(kTestNum / 2, kMaxLength)));
+    for (int i = kTestNum / 2; i < kTestNum; ++i) {
+        ASSERT_TRUE(iter->Valid()) << i;
+        EXPECT_EQ(GenKey(i, kMaxLength), iter->key()) << i;
+        iter->Next();
+    }
+    EXPECT_FALSE(iter->Valid());
+}
+
 }  // namespace toft
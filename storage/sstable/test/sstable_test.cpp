@@ -18,6 +18,8 @@ TEST(SSTableReader, BadCases) {
                                   SSTableReader::ON_DISK));
     EXPECT_EQ(NULL, SSTableReader::Open("toft/storage/sstable/test/testdata/empty",
                                         SSTableReader::ON_DISK));
+    EXPECT_EQ(NULL, SSTableReader::Open("toft/storage/sstable/test/testdata/empty",
+                                        SSTableReader::MMAP));
 }
 
 TEST(SSTableReader, MetaData) {
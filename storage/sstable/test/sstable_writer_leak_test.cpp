@@ -0,0 +1,55 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Run under the strict heap checker: every block of a pipelined build is a
+// new DataBlock with its own codec, which must be released with the block.
+
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/string/format.h"
+#include "toft/storage/file/file.h"
+#include "toft/storage/sstable/sstable_reader.h"
+#include "toft/storage/sstable/sstable_writer.h"
+#include "toft/storage/sstable/test/test_util.h"
+#include "toft/storage/sstable/types.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+static void BuildAndRead(bool sorted, CompressType codec, const std::string &path) {
+    SSTableWriteOption option;
+    option.set_path(path);
+    option.set_block_size(256);
+    option.set_compress_type(codec);
+    option.set_compress_threads(4);
+    {
+        toft::scoped_ptr<SSTableWriter> builder;
+        if (sorted) {
+            builder.reset(new SingleSSTableWriter(option));
+        } else {
+            builder.reset(new UnsortedSSTableWriter(option));
+        }
+        for (int i = 0; i < kTestNum; ++i)
+            ASSERT_TRUE(builder->Add(GenKey(i, kMaxLength), GenValue(i, kMaxLength)));
+        ASSERT_TRUE(builder->Flush());
+    }
+
+    toft::scoped_ptr<SSTableReader> reader(SSTableReader::Open(path, SSTableReader::ON_DISK));
+    ASSERT_TRUE(reader.get() != NULL);
+    toft::scoped_ptr<SSTableReader::Iterator> iter(reader->NewIterator());
+    int count = 0;
+    for (; iter->Valid(); iter->Next())
+        ASSERT_EQ(GenKey(count++, kMaxLength), iter->key());
+    EXPECT_EQ(kTestNum, count);
+    File::Delete(path);
+}
+
+TEST(SSTableWriterLeak, PipelinedSnappySorted) {
+    BuildAndRead(true, CompressType_kSnappy, "/tmp/test_leak_single_snappy.sstable");
+}
+
+TEST(SSTableWriterLeak, PipelinedSnappyUnsorted) {
+    BuildAndRead(false, CompressType_kSnappy, "/tmp/test_leak_unsorted_snappy.sstable");
+}
+
+}  // namespace toft
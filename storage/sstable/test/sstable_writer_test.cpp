@@ -92,6 +92,112 @@ TEST(SingleSSTableWriter, BuildMultiBlock) {
     delete callback;
 }
 
+void TestIteratePieces(const std::string &path, SSTableReader::ReadMode type) {
+    SSTableWriteOption option;
+    option.set_block_size(64);
+    option.set_path(path);
+    SingleSSTableWriter builder(option);
+    for (int i = 0; i < kTestNum; ++i) {
+        builder.AddOrDie(GenKey(i, kMaxLength), GenValue(i, kMaxLength));
+    }
+    EXPECT_TRUE(builder.Flush());
+
+    toft::scoped_ptr<SSTableReader> sstable(SSTableReader::Open(path, type));
+    ASSERT_TRUE(sstable.get());
+    toft::scoped_ptr<SSTableReader::Iterator> iter(sstable->NewIterator());
+    for (int i = 0; i < kTestNum; ++i) {
+        ASSERT_TRUE(iter->Valid()) << i;
+        EXPECT_EQ(GenKey(i, kMaxLength), iter->key_piece().as_string()) << i;
+        EXPECT_EQ(GenValue(i, kMaxLength), iter->value_piece().as_string()) << i;
+        EXPECT_EQ(iter->key(), iter->key_piece().as_string()) << i;
+        iter->Next();
+    }
+    EXPECT_FALSE(iter->Valid());
+    EXPECT_TRUE(iter->key_piece().empty());
+
+    std::string value;
+    EXPECT_TRUE(sstable->Lookup(GenKey(10, kMaxLength), &value));
+    EXPECT_EQ(GenValue(10, kMaxLength), value);
+    EXPECT_FALSE(sstable->Lookup("not_exist", &value));
+}
+
+TEST(SSTableReader, IteratePiecesOnDisk) {
+    TestIteratePieces("/tmp/test_pieces_disk.sstable", SSTableReader::ON_DISK);
+}
+
+TEST(SSTableReader, IteratePiecesInMem) {
+    TestIteratePieces("/tmp/test_pieces_mem.sstable", SSTableReader::IN_MEMORY);
+}
+
+TEST(SSTableReader, IteratePiecesMmap) {
+    TestIteratePieces("/tmp/test_pieces_mmap.sstable", SSTableReader::MMAP);
+}
+
+void TestBloomFilter(SSTableWriter *builder, const std::string &path,
+                     SSTableReader::ReadMode type) {
+    for (int i = 0; i < kTestNum; i += 2) {
+        builder->AddOrDie(GenKey(i, kMaxLength), GenValue(i, kMaxLength));
+    }
+    builder->AddMetaData("123", "456");
+    EXPECT_TRUE(builder->Flush());
+
+    toft::scoped_ptr<SSTableReader> sstable(SSTableReader::Open(path, type));
+    ASSERT_TRUE(sstable.get());
+    EXPECT_EQ("456", sstable->GetMetaData("123"));
+    int false_positives = 0;
+    std::string value;
+    for (int i = 0; i < kTestNum; ++i) {
+        std::string key = GenKey(i, kMaxLength);
+        if (i % 2 == 0) {
+            EXPECT_TRUE(sstable->MayContain(key)) << i;
+            EXPECT_TRUE(sstable->Lookup(key, &value)) << i;
+            EXPECT_EQ(GenValue(i, kMaxLength), value) << i;
+        } else {
+            if (sstable->MayContain(key))
+                ++false_positives;
+            EXPECT_FALSE(sstable->Lookup(key, &value)) << i;
+        }
+    }
+    EXPECT_LT(false_positives, kTestNum / 20);
+}
+
+TEST(SingleSSTableWriter, BloomFilter) {
+    SSTableWriteOption option;
+    std::string path = "/tmp/test_single_bloom_filter.sstable";
+    option.set_path(path);
+    option.set_block_size(256);
+    option.set_bloom_filter_false_positive_prob(0.01);
+    SingleSSTableWriter builder(option);
+    TestBloomFilter(&builder, path, SSTableReader::ON_DISK);
+}
+
+TEST(UnsortedSSTableWriter, BloomFilter) {
+    SSTableWriteOption option;
+    std::string path = "/tmp/test_unsorted_bloom_filter.sstable";
+    option.set_path(path);
+    option.set_compress_type(CompressType_kSnappy);
+    option.set_bloom_filter_false_positive_prob(0.01);
+    UnsortedSSTableWriter builder(option);
+    TestBloomFilter(&builder, path, SSTableReader::IN_MEMORY);
+}
+
+TEST(SingleSSTableWriter, NoBloomFilter) {
+    SSTableWriteOption option;
+    std::string path = "/tmp/test_single_no_bloom_filter.sstable";
+    option.set_path(path);
+    SingleSSTableWriter builder(option);
+    builder.AddOrDie("111", "222");
+    EXPECT_TRUE(builder.Flush());
+
+    toft::scoped_ptr<SSTableReader> sstable(SSTableReader::Open(path, SSTableReader::ON_DISK));
+    ASSERT_TRUE(sstable.get());
+    EXPECT_TRUE(sstable->MayContain("not_exist"));
+    std::string value;
+    EXPECT_FALSE(sstable->Lookup("not_exist", &value));
+    EXPECT_TRUE(sstable->Lookup("111", &value));
+    EXPECT_EQ("222", value);
+}
+
 void TestSSTableWriter(SSTableWriter *builder,
                         const std::string &sstable_path,
                         int test_number,
@@ -182,6 +288,145 @@ TEST(SingleSSTableWriter, BuildLargeSingleFileInMem) {
     TestSSTableWriter(&builder, path, kTestNum, kMaxLength, SSTableReader::IN_MEMORY);
 }
 
+TEST(SingleSSTableWriter, BuildLargeSingleFileMmap) {
+    SSTableWriteOption option;
+    std::string path = "/tmp/test_single_large_mmap.sstable";
+    option.set_path(path);
+    option.set_block_size(1024);
+    SingleSSTableWriter builder(option);
+    TestSSTableWriterSeek(&builder, path, kTestNum, kMaxLength, SSTableReader::MMAP);
+}
+
+TEST(SingleSSTableWriter, BuildSnappySingleFileMmap) {
+    SSTableWriteOption option;
+    std::string path = "/tmp/test_single_snappy_mmap.sstable";
+    option.set_path(path);
+    option.set_block_size(1024);
+    option.set_compress_type(CompressType_kSnappy);
+    SingleSSTableWriter builder(option);
+    TestSSTableWriterSeek(&builder, path, kTestNum, kMaxLength, SSTableReader::MMAP);
+}
+
+// Build the same data in pipelined and synchronous mode, the files should
+// be identical.
+void TestPipelinedWriter(bool sorted, CompressType codec, const std::string &path) {
+    std::string files[2];
+    for (int i = 0; i < 2; ++i) {
+        SSTableWriteOption option;
+        option.set_path(path + (i == 0 ? ".sync" : ".pipelined"));
+        option.set_block_size(256);
+        option.set_compress_type(codec);
+        option.set_compress_threads(i == 0 ? 0 : 4);
+        toft::scoped_ptr<SSTableWriter> builder;
+        if (sorted) {
+            builder.reset(new SingleSSTableWriter(option));
+        } else {
+            builder.reset(new UnsortedSSTableWriter(option));
+        }
+        TestSSTableWriterSeek(builder.get(), option.path(), kTestNum, kMaxLength,
+                              SSTableReader::ON_DISK);
+        ASSERT_TRUE(File::ReadAll(option.path(), &files[i]));
+    }
+    EXPECT_TRUE(files[0] == files[1]);
+}
+
+TEST(SingleSSTableWriter, PipelinedSnappy) {
+    TestPipelinedWriter(true, CompressType_kSnappy, "/tmp/test_single_pipelined");
+}
+
+TEST(SingleSSTableWriter, PipelinedUnCompress) {
+    TestPipelinedWriter(true, CompressType_kUnCompress, "/tmp/test_single_pipelined_raw");
+}
+
+TEST(UnsortedSSTableWriter, PipelinedSnappy) {
+    TestPipelinedWriter(false, CompressType_kSnappy, "/tmp/test_unsorted_pipelined");
+}
+
+// Build the same unsorted data in memory and with a tiny sort memory budget
+// which spills many runs, the files should be identical.
+TEST(SingleSSTableWriter, ExternalSort) {
+    const int kNumEntries = 5000;
+    std::string files[2];
+    for (int i = 0; i < 2; ++i) {
+        SSTableWriteOption option;
+        option.set_path(std::string("/tmp/test_single_external_sort") +
+                        (i == 0 ? ".mem" : ".spill"));
+        option.set_block_size(1024);
+        option.set_compress_type(CompressType_kSnappy);
+        option.set_sort_memory_budget(i == 0 ? 0 : 16 * 1024);
+        SingleSSTableWriter builder(option);
+        for (int j = 0; j < kNumEntries; ++j) {
+            // Many duplicated keys, whose values must keep the adding order.
+            std::string key = IntegerToString((j * 7919) % (kNumEntries / 4));
+            ASSERT_TRUE(builder.Add(key, IntegerToString(j)));
+        }
+        ASSERT_TRUE(builder.Flush());
+        ASSERT_TRUE(File::ReadAll(option.path(), &files[i]));
+    }
+    EXPECT_TRUE(files[0] == files[1]);
+
+    toft::scoped_ptr<SSTableReader> reader(SSTableReader::Open(
+        "/tmp/test_single_external_sort.spill", SSTableReader::ON_DISK));
+    ASSERT_TRUE(reader.get() != NULL);
+    toft::scoped_ptr<SSTableReader::Iterator> iter(reader->NewIterator());
+    std::string last_key;
+    int last_value = -1;
+    int count = 0;
+    for (; iter->Valid(); iter->Next(), ++count) {
+        int value = 0;
+        ASSERT_TRUE(StringToNumber(iter->value(), &value));
+        ASSERT_LE(last_key, iter->key());
+        if (iter->key() == last_key)
+            ASSERT_LT(last_value, value);
+        last_key = iter->key();
+        last_value = value;
+    }
+    EXPECT_EQ(kNumEntries, count);
+}
+
+TEST(SingleSSTableWriter, ParallelSort) {
+    const int kNumEntries = 50000;
+    std::string files[2];
+    for (int i = 0; i < 2; ++i) {
+        SSTableWriteOption option;
+        option.set_path(std::string("/tmp/test_single_parallel_sort") +
+                        (i == 0 ? ".serial" : ".parallel"));
+        option.set_compress_type(CompressType_kSnappy);
+        option.set_sort_threads(i == 0 ? 0 : 4);
+        SingleSSTableWriter builder(option);
+        for (int j = 0; j < kNumEntries; ++j) {
+            std::string key = IntegerToString((j * 7919) % (kNumEntries / 4));
+            ASSERT_TRUE(builder.Add(key, IntegerToString(j)));
+        }
+        ASSERT_TRUE(builder.Flush());
+        ASSERT_TRUE(File::ReadAll(option.path(), &files[i]));
+    }
+    EXPECT_TRUE(files[0] == files[1]);
+}
+
+void TestPrefixEncoding(const std::string &path, SSTableReader::ReadMode mode) {
+    SSTableWriteOption option;
+    option.set_path(path);
+    option.set_block_size(1024);
+    option.set_compress_type(CompressType_kSnappy);
+    option.set_block_encoding(BlockEncoding_kPrefix);
+    option.set_block_restart_interval(4);
+    SingleSSTableWriter builder(option);
+    TestSSTableWriterSeek(&builder, path, kTestNum, kMaxLength, mode);
+}
+
+TEST(SingleSSTableWriter, PrefixEncodingOnDisk) {
+    TestPrefixEncoding("/tmp/test_single_prefix_disk.sstable", SSTableReader::ON_DISK);
+}
+
+TEST(SingleSSTableWriter, PrefixEncodingInMem) {
+    TestPrefixEncoding("/tmp/test_single_prefix_mem.sstable", SSTableReader::IN_MEMORY);
+}
+
+TEST(SingleSSTableWriter, PrefixEncodingMmap) {
+    TestPrefixEncoding("/tmp/test_single_prefix_mmap.sstable", SSTableReader::MMAP);
+}
+
 TEST(SingleSSTableWriter, BuildSnappySingleFileOnDisk) {
     SSTableWriteOption option;
     std::string path = "/tmp/test_single_snappy_disk.sstable";
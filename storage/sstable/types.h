@@ -26,11 +26,26 @@ enum CompressType {
     CompressType_kUnKnown
 };
 
+// Layout of items in data blocks.
+enum BlockEncoding {
+    // Full key and value of every item.
+    BlockEncoding_kPlain = 0,
+    // Keys share the prefix with the previous key, with restart points of
+    // full keys for binary search. Only used for sorted sstables.
+    BlockEncoding_kPrefix = 1
+};
+
 class SSTableWriteOption {
 public:
     SSTableWriteOption()
         : compress_type_(CompressType_kUnCompress),
-          block_size_(64 * 1024) {
+          block_size_(64 * 1024),
+          bloom_filter_false_positive_prob_(0),
+          compress_threads_(0),
+          sort_memory_budget_(0),
+          sort_threads_(0),
+          block_encoding_(BlockEncoding_kPlain),
+          block_restart_interval_(16) {
     }
 
     void set_path(const std::string &path) {
@@ -40,6 +55,16 @@ public:
         return path_;
     }
 
+    // The sstable is written to a temp file in the dir and renamed to path,
+    // so they must be on the same file system. Empty means
+    // FLAGS_temp_sstable_dir.
+    void set_temp_dir(const std::string &dir) {
+        temp_dir_ = dir;
+    }
+    const std::string& temp_dir() const {
+        return temp_dir_;
+    }
+
     void set_block_size(int block_size) {
         block_size_ = block_size;
     }
@@ -54,6 +79,61 @@ public:
         return compress_type_;
     }
 
+    // Build a bloom filter of all keys into the sstable to speed up negative
+    // lookups, 0 means no filter.
+    void set_bloom_filter_false_positive_prob(double prob) {
+        bloom_filter_false_positive_prob_ = prob;
+    }
+    double bloom_filter_false_positive_prob() const {
+        return bloom_filter_false_positive_prob_;
+    }
+
+    // Compress data blocks on so many background threads while the writer
+    // goes on, blocks are still written in order. 0 means compressing
+    // synchronously in the writing thread.
+    void set_compress_threads(int num_threads) {
+        compress_threads_ = num_threads;
+    }
+    int compress_threads() const {
+        return compress_threads_;
+    }
+
+    // Bytes of buffered entries kept in memory by the sorted writer, sorted
+    // runs over it are spilled to temp files and merged at flush.
+    // 0 means unlimited.
+    void set_sort_memory_budget(int64_t bytes) {
+        sort_memory_budget_ = bytes;
+    }
+    int64_t sort_memory_budget() const {
+        return sort_memory_budget_;
+    }
+
+    // Sort buffered entries of the sorted writer on so many threads, along
+    // with the writing thread. 0 means sorting in the writing thread only.
+    void set_sort_threads(int num_threads) {
+        sort_threads_ = num_threads;
+    }
+    int sort_threads() const {
+        return sort_threads_;
+    }
+
+    // Prefix encoding only applies to sorted sstables, unsorted sstables are
+    // always written in plain encoding.
+    void set_block_encoding(BlockEncoding encoding) {
+        block_encoding_ = encoding;
+    }
+    BlockEncoding block_encoding() const {
+        return block_encoding_;
+    }
+
+    // Number of items between restart points in prefix encoded blocks.
+    void set_block_restart_interval(int interval) {
+        block_restart_interval_ = interval;
+    }
+    int block_restart_interval() const {
+        return block_restart_interval_;
+    }
+
     const std::string& sharding_policy() const {
         return sharding_policy_;
     }
@@ -64,7 +144,14 @@ public:
 private:
     int compress_type_;
     int64_t block_size_;
+    double bloom_filter_false_positive_prob_;
+    int compress_threads_;
+    int64_t sort_memory_budget_;
+    int sort_threads_;
+    BlockEncoding block_encoding_;
+    int block_restart_interval_;
     std::string path_;
+    std::string temp_dir_;
     std::string sharding_policy_;
 };
 }  // namespace toft
@@ -30,8 +30,9 @@ void SSTableWriter::AddOrDie(const std::string &key, const std::string &value) {
 }
 
 std::string SSTableWriter::GetTempSSTablePath(const std::string &path) {
-    std::string base_path =
-        Path::Join(FLAGS_temp_sstable_dir, Fingerprint64ToString(Fingerprint64(path)));
+    const std::string &dir =
+        option_.temp_dir().empty() ? FLAGS_temp_sstable_dir : option_.temp_dir();
+    std::string base_path = Path::Join(dir, Fingerprint64ToString(Fingerprint64(path)));
     return base_path + ".sstmp";
 }
 
@@ -16,6 +16,7 @@ namespace hfile {
 class ShardingPolicy;
 class DataBlock;
 class DataIndex;
+class FilterBlock;
 } // namespace hfile
 
 class SSTableWriter {
@@ -0,0 +1,117 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/storage/sstable/writer/block_pipeline.h"
+
+#include "toft/base/closure.h"
+#include "toft/storage/file/file.h"
+#include "toft/storage/sstable/hfile/data_block.h"
+#include "toft/storage/sstable/hfile/data_index.h"
+#include "toft/system/threading/thread_pool.h"
+
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+
+struct BlockPipeline::Job {
+    int64_t seq;
+    toft::scoped_ptr<hfile::DataBlock> block;
+    std::string encoded;
+};
+
+BlockPipeline::BlockPipeline(File *file, int num_threads, int max_pending)
+                : file_(file),
+                  max_pending_(max_pending > 0 ? max_pending : 2 * num_threads),
+                  pool_(new ThreadPool(num_threads)),
+                  cond_(&mutex_),
+                  next_seq_(0),
+                  next_write_(0),
+                  writing_(false),
+                  failed_(false) {
+    CHECK_GT(num_threads, 0);
+}
+
+BlockPipeline::~BlockPipeline() {
+    WaitForAll();
+    pool_.reset();
+}
+
+bool BlockPipeline::AddBlock(hfile::DataBlock *block, const std::string &first_key) {
+    Job *job = new Job;
+    job->block.reset(block);
+    int64_t uncompressed_size = block->GetUncompressedBufferSize();
+    {
+        MutexLocker locker(&mutex_);
+        while (next_seq_ - next_write_ >= max_pending_ && !failed_)
+            cond_.Wait();
+        if (failed_) {
+            delete job;
+            return false;
+        }
+        job->seq = next_seq_++;
+        first_keys_.push_back(first_key);
+        uncompressed_sizes_.push_back(uncompressed_size);
+    }
+    pool_->AddTask(NewClosure(this, &BlockPipeline::Compress, job), job->seq);
+    return true;
+}
+
+void BlockPipeline::Compress(Job *job) {
+    job->encoded = job->block->EncodeToString();
+    job->block.reset();
+
+    MutexLocker locker(&mutex_);
+    ready_jobs_[job->seq] = job;
+    if (!writing_)
+        WriteReadyJobs();
+}
+
+void BlockPipeline::WriteReadyJobs() {
+    writing_ = true;
+    std::map<int64_t, Job*>::iterator it;
+    while ((it = ready_jobs_.begin()) != ready_jobs_.end() && it->first == next_write_) {
+        Job *job = it->second;
+        ready_jobs_.erase(it);
+        bool ok = true;
+        if (!failed_) {
+            // Other threads go on compressing while the block is written.
+            mutex_.Unlock();
+            int64_t size = job->encoded.size();
+            ok = size == 0 || file_->Write(job->encoded.data(), size) == size;
+            mutex_.Lock();
+        }
+        if (!ok) {
+            LOG(ERROR)<< "fail to write data block " << job->seq;
+            failed_ = true;
+        }
+        written_sizes_.push_back(job->encoded.size());
+        ++next_write_;
+        delete job;
+        cond_.Broadcast();
+    }
+    writing_ = false;
+}
+
+void BlockPipeline::WaitForAll() {
+    MutexLocker locker(&mutex_);
+    while (next_write_ < next_seq_)
+        cond_.Wait();
+}
+
+bool BlockPipeline::Finish(hfile::DataIndex *index, int64_t *written_bytes) {
+    WaitForAll();
+    MutexLocker locker(&mutex_);
+    if (failed_)
+        return false;
+    *written_bytes = 0;
+    for (size_t i = 0; i < written_sizes_.size(); ++i) {
+        index->AddDataBlockInfo(written_sizes_[i], uncompressed_sizes_[i], first_keys_[i]);
+        *written_bytes += written_sizes_[i];
+    }
+    first_keys_.clear();
+    uncompressed_sizes_.clear();
+    written_sizes_.clear();
+    return true;
+}
+
+}  // namespace toft
@@ -0,0 +1,78 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_STORAGE_SSTABLE_WRITER_BLOCK_PIPELINE_H
+#define TOFT_STORAGE_SSTABLE_WRITER_BLOCK_PIPELINE_H
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "toft/base/scoped_ptr.h"
+#include "toft/base/uncopyable.h"
+#include "toft/system/threading/condition_variable.h"
+#include "toft/system/threading/mutex.h"
+
+namespace toft {
+class File;
+class ThreadPool;
+
+namespace hfile {
+class DataBlock;
+class DataIndex;
+}  // namespace hfile
+
+// Compress data blocks on a thread pool and append them to the file in the
+// order they are added, so compression, I/O and the caller building the
+// next blocks overlap. Completed blocks wait in a reorder buffer until all
+// blocks before them are written.
+class BlockPipeline {
+    TOFT_DECLARE_UNCOPYABLE(BlockPipeline);
+
+public:
+    // file must outlive the pipeline. At most max_pending blocks are in
+    // flight to bound the memory, 0 means 2 * num_threads.
+    BlockPipeline(File *file, int num_threads, int max_pending = 0);
+    // Wait for all blocks to be written.
+    ~BlockPipeline();
+
+    // Take over the block, first_key is the key of its first item. Block
+    // the caller when there are too many blocks in flight. Return false if
+    // any block failed to be written.
+    bool AddBlock(hfile::DataBlock *block, const std::string &first_key);
+
+    // Wait for all added blocks to be written, then add them into index
+    // and return the total bytes written. Return false on failure.
+    bool Finish(hfile::DataIndex *index, int64_t *written_bytes);
+
+private:
+    struct Job;
+
+    void WaitForAll();
+    void Compress(Job *job);
+    // Write blocks in the reorder buffer as long as the next one is there.
+    void WriteReadyJobs();
+
+    File *file_;
+    int max_pending_;
+    toft::scoped_ptr<ThreadPool> pool_;
+
+    toft::Mutex mutex_;
+    toft::ConditionVariable cond_;
+    // Compressed blocks waiting to be written, by sequence number.
+    std::map<int64_t, Job*> ready_jobs_;
+    int64_t next_seq_;    // of the next block added
+    int64_t next_write_;  // of the next block to write
+    bool writing_;        // one thread is writing
+    bool failed_;
+    // Of every block by sequence number.
+    std::vector<std::string> first_keys_;
+    std::vector<int64_t> uncompressed_sizes_;
+    std::vector<int64_t> written_sizes_;
+};
+
+}  // namespace toft
+
+#endif  // TOFT_STORAGE_SSTABLE_WRITER_BLOCK_PIPELINE_H
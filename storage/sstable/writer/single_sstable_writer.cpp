@@ -5,13 +5,84 @@
 
 #include "toft/storage/sstable/writer/single_sstable_writer.h"
 
+#include <stdio.h>
+
 #include <algorithm>
+#include <queue>
 
+#include "toft/base/string/number.h"
 #include "toft/storage/file/file.h"
+#include "toft/storage/recordio/recordio.h"
 #include "toft/storage/sstable/sstable.h"
+#include "toft/storage/sstable/writer/block_pipeline.h"
+#include "toft/system/threading/parallel.h"
+#include "toft/system/threading/thread_pool.h"
 
 namespace toft {
 
+typedef std::deque<std::pair<std::string, std::string> > EntryDeque;
+
+// Memory taken by one buffered entry besides the key and the value.
+static const int64_t kEntryOverhead =
+    sizeof(EntryDeque::value_type) + sizeof(EntryDeque::iterator);
+
+// Sorted entries of a spilled run, a key record followed by a value record.
+class SingleSSTableWriter::Run {
+public:
+    Run(int index, File *file)
+        : index_(index), file_(file), reader_(file, ReaderOptions()), failed_(false) {}
+
+    // Return false at the end or on error.
+    bool Next() {
+        int r = reader_.Next();
+        if (r == 1 && reader_.ReadRecord(&key_) && reader_.Next() == 1 &&
+            reader_.ReadRecord(&value_)) {
+            return true;
+        }
+        if (r != 0)
+            failed_ = true;
+        return false;
+    }
+
+    int index() const { return index_; }
+    bool failed() const { return failed_; }
+    const std::string &key() const { return key_; }
+    const std::string &value() const { return value_; }
+
+private:
+    // All runs are open at once while merging, so buffers are small and
+    // nothing is read ahead.
+    static RecordReaderOptions ReaderOptions() {
+        RecordReaderOptions options;
+        options.buffer_size = 64 * 1024;
+        options.readahead = false;
+        return options;
+    }
+
+    int index_;
+    toft::scoped_ptr<File> file_;
+    RecordReader reader_;
+    std::string key_;
+    std::string value_;
+    bool failed_;
+};
+
+namespace {
+
+// Order runs by the current key, then the run index to keep the order of
+// equal keys as they were added.
+struct RunGreater {
+    bool operator()(const SingleSSTableWriter::Run *a,
+                    const SingleSSTableWriter::Run *b) const {
+        int r = a->key().compare(b->key());
+        if (r != 0)
+            return r > 0;
+        return a->index() > b->index();
+    }
+};
+
+}  // namespace
+
 SingleSSTableWriter::SingleSSTableWriter(const SSTableWriteOption &option)
                 : SSTableWriter(option),
                   entry_count_(0),
@@ -21,17 +92,32 @@ SingleSSTableWriter::SingleSSTableWriter(const SSTableWriteOption &option)
                   key_length_(0),
                   value_length_(0),
                   file_info_offset_(0),
+                  buffered_bytes_(0),
+                  failed_(false),
                   flushed_(false) {
-    block_.reset(new hfile::DataBlock(static_cast<CompressType>(option.compress_type())));
+    block_.reset(NewDataBlock());
     index_.reset(new hfile::DataIndex);
+    if (option_.sort_threads() > 0)
+        sort_pool_.reset(new ThreadPool(option_.sort_threads()));
     CHECK(!option_.path().empty());
 }
 
 SingleSSTableWriter::~SingleSSTableWriter() {
+    RemoveRuns();
 }
 
 bool SingleSSTableWriter::Add(const std::string &key, const std::string &value) {
+    if (failed_)
+        return false;
     d_data_.push_back(make_pair(key, value));
+    buffered_bytes_ += key.size() + value.size() + kEntryOverhead;
+    if (option_.sort_memory_budget() > 0 &&
+        buffered_bytes_ >= option_.sort_memory_budget()) {
+        if (!SpillRun()) {
+            failed_ = true;
+            return false;
+        }
+    }
     return true;
 }
 
@@ -44,71 +130,170 @@ bool CompairString(std::deque<std::pair<std::string, std::string> >::iterator a,
     return a->first < b->first;
 }
 
-bool SingleSSTableWriter::Flush() {
-    CHECK(!flushed_) << "do not flush twice!";
-    flushed_ = true;
+void SingleSSTableWriter::SortBufferedEntries() {
+    data_index_.clear();
     data_index_.reserve(d_data_.size());
     std::deque<std::pair<std::string, std::string> >::iterator it_d_data = d_data_.begin();
     for (; it_d_data != d_data_.end(); it_d_data++) {
         data_index_.push_back(it_d_data);
     }
-    stable_sort(data_index_.begin(), data_index_.end(), CompairString);
+    ParallelSort(sort_pool_.get(), data_index_.begin(), data_index_.end(), CompairString);
+}
 
-    hfile::FileTrailer trailer;
-    hfile::FileInfo fileInfo;
-    std::map<std::string, std::string>::iterator it_fi_meta = file_info_meta_.begin();
-    std::vector<std::deque<std::pair<std::string, std::string> >::iterator>::iterator it_d_index =
-                    data_index_.begin();
+bool SingleSSTableWriter::SpillRun() {
+    SortBufferedEntries();
+    std::string path = GetTempSSTablePath(option_.path()) + ".run" +
+        IntegerToString(run_paths_.size());
+    run_paths_.push_back(path);
+    toft::scoped_ptr<File> file(File::Open(path, "w"));
+    if (!file.get()) {
+        LOG(ERROR)<< "open sort run file error: " << path;
+        return false;
+    }
+    RecordWriter writer(file.get());
+    for (size_t i = 0; i < data_index_.size(); ++i) {
+        if (!writer.WriteRecord(data_index_[i]->first) ||
+            !writer.WriteRecord(data_index_[i]->second)) {
+            LOG(ERROR)<< "write sort run file error: " << path;
+            return false;
+        }
+    }
+    if (!file->Flush() || !file->Close()) {
+        LOG(ERROR)<< "close sort run file error: " << path;
+        return false;
+    }
+    VLOG(1) << "spilled " << data_index_.size() << " entries to " << path;
+    data_index_.clear();
+    // Release the memory.
+    EntryDeque().swap(d_data_);
+    buffered_bytes_ = 0;
+    return true;
+}
+
+void SingleSSTableWriter::RemoveRuns() {
+    for (size_t i = 0; i < run_paths_.size(); ++i)
+        remove(run_paths_[i].c_str());
+    run_paths_.clear();
+}
+
+bool SingleSSTableWriter::MergeRuns() {
+    // The buffered entries make up the last run.
+    if (!d_data_.empty() && !SpillRun())
+        return false;
+
+    std::vector<Run*> runs;
+    std::priority_queue<Run*, std::vector<Run*>, RunGreater> heap;
+    bool result = true;
+    for (size_t i = 0; i < run_paths_.size() && result; ++i) {
+        File *file = File::Open(run_paths_[i], "r");
+        if (!file) {
+            LOG(ERROR)<< "open sort run file error: " << run_paths_[i];
+            result = false;
+            break;
+        }
+        runs.push_back(new Run(i, file));
+        if (runs.back()->Next()) {
+            heap.push(runs.back());
+        } else if (runs.back()->failed()) {
+            result = false;
+        }
+    }
+
+    while (result && !heap.empty()) {
+        Run *run = heap.top();
+        heap.pop();
+        if (!AddEntry(run->key(), run->value())) {
+            result = false;
+            break;
+        }
+        if (run->Next()) {
+            heap.push(run);
+        } else if (run->failed()) {
+            LOG(ERROR)<< "read sort run file error: " << run_paths_[run->index()];
+            result = false;
+        }
+    }
+    for (size_t i = 0; i < runs.size(); ++i)
+        delete runs[i];
+    return result;
+}
 
-    if (data_index_.empty()) {
+bool SingleSSTableWriter::Flush() {
+    CHECK(!flushed_) << "do not flush twice!";
+    flushed_ = true;
+    if (failed_) {
+        RemoveRuns();
+        return false;
+    }
+    if (d_data_.empty() && run_paths_.empty()) {
         LOG(WARNING)<< "SingleSSTableWriter flush with no data, just ignore.";
-        goto FAILED;
+        return false;
     }
 
     file_base_.reset(File::Open(GetTempSSTablePath(option_.path()), "w"));
     CHECK(file_base_.get()) << "open file error: "
                             << GetTempSSTablePath(option_.path());
-    first_key_ = data_index_.front()->first;
-    last_key_ = data_index_.back()->first;
+    if (option_.bloom_filter_false_positive_prob() > 0)
+        filter_.reset(new hfile::FilterBlock(option_.bloom_filter_false_positive_prob()));
+    if (option_.compress_threads() > 0)
+        pipeline_.reset(new BlockPipeline(file_base_.get(), option_.compress_threads()));
+
+    bool result = true;
+    if (run_paths_.empty()) {
+        SortBufferedEntries();
+        for (size_t i = 0; i < data_index_.size() && result; ++i)
+            result = AddEntry(data_index_[i]->first, data_index_[i]->second);
+    } else {
+        result = MergeRuns();
+        RemoveRuns();
+    }
+
+    if (!result || !WriteFileTail()) {
+        pipeline_.reset(NULL);
+        file_base_.reset(NULL);
+        remove(GetTempSSTablePath(option_.path()).c_str());
+        return false;
+    }
+    return MoveToRealPath(option_.path());
+}
 
-    for (; it_d_index != data_index_.end(); it_d_index++) {
-        size_t block_size = block_->GetUncompressedBufferSize();
+bool SingleSSTableWriter::AddEntry(const std::string &key, const std::string &value) {
+    if (entry_count_ == 0) {
+        first_key_ = key;
+    } else if (block_->GetUncompressedBufferSize() >=
+               static_cast<int64_t>(option_.block_size())) {
         // write the block to disk
-        if (block_size >= option_.block_size()) {
-            if (!block_->WriteToFile(file_base_.get())) {
-                LOG(ERROR)<< "fwrite error.";
-                goto FAILED;
-            }
-            index_->AddDataBlockInfo(block_->GetCompressedBufferSize(),
-                            block_->GetUncompressedBufferSize(), first_key_);
-            total_bytes_ += block_size;
-            first_key_ = (*it_d_index)->first;
-            index_offset_ += block_->GetCompressedBufferSize();
-            block_->ClearItems();
-            ++index_count_;
-        }
-        key_length_ += (*it_d_index)->first.size();
-        value_length_ += (*it_d_index)->second.size();
-        block_->AddItem((*it_d_index)->first, (*it_d_index)->second);
-        ++entry_count_;
+        if (!WriteBlock())
+            return false;
+        first_key_ = key;
     }
+    key_length_ += key.size();
+    value_length_ += value.size();
+    block_->AddItem(key, value);
+    if (filter_.get())
+        filter_->AddKey(key);
+    last_key_ = key;
+    ++entry_count_;
+    return true;
+}
+
+bool SingleSSTableWriter::WriteFileTail() {
+    hfile::FileTrailer trailer;
+    hfile::FileInfo fileInfo;
 
     // add file info meta
+    std::map<std::string, std::string>::iterator it_fi_meta = file_info_meta_.begin();
     for (; it_fi_meta != file_info_meta_.end(); ++it_fi_meta) {
         fileInfo.AddItem(it_fi_meta->first, it_fi_meta->second);
     }
     // write the last block
-    if (!block_->WriteToFile(file_base_.get())) {
-        LOG(ERROR)<< "fwrite error.";
-        goto FAILED;
-    }
-    index_->AddDataBlockInfo(block_->GetCompressedBufferSize(), block_->GetUncompressedBufferSize(),
-                             first_key_);
-    total_bytes_ += block_->GetUncompressedBufferSize();
-    index_offset_ += block_->GetCompressedBufferSize();
-    ++index_count_;
+    if (!WriteBlock() || !FinishBlocks())
+        return false;
 
     fileInfo.set_last_key(last_key_);
+    fileInfo.set_block_encoding(option_.block_encoding());
+    if (filter_.get())
+        fileInfo.set_filter_block(filter_->EncodeToString());
     if (entry_count_ != 0) {
         fileInfo.set_avg_key_len(key_length_ / entry_count_);
         fileInfo.set_avg_value_len(value_length_ / entry_count_);
@@ -119,12 +304,12 @@ bool SingleSSTableWriter::Flush() {
 
     if (!fileInfo.WriteToFile(file_base_.get())) {
         LOG(ERROR)<< "fwrite error.";
-        goto FAILED;
+        return false;
     }
 
     if (!index_->WriteToFile(file_base_.get())) {
         LOG(ERROR)<< "fwrite error, size: " << index_->EncodeToString().size();
-        goto FAILED;
+        return false;
     }
     trailer.set_file_info_offset(file_info_offset_);
     trailer.set_data_index_offset(index_offset_);
@@ -134,15 +319,50 @@ bool SingleSSTableWriter::Flush() {
     trailer.set_compress_type(option_.compress_type());
     if (!trailer.WriteToFile(file_base_.get())) {
         LOG(ERROR)<< "fwrite error.";
-        goto FAILED;
+        return false;
     }
     file_base_->Flush();
     file_base_.reset(NULL);
-    return MoveToRealPath(option_.path());
+    return true;
+}
+
+hfile::DataBlock *SingleSSTableWriter::NewDataBlock() const {
+    return new hfile::DataBlock(static_cast<CompressType>(option_.compress_type()),
+                                option_.block_encoding(),
+                                option_.block_restart_interval());
+}
+
+bool SingleSSTableWriter::WriteBlock() {
+    total_bytes_ += block_->GetUncompressedBufferSize();
+    ++index_count_;
+    if (pipeline_.get()) {
+        bool result = pipeline_->AddBlock(block_.release(), first_key_);
+        block_.reset(NewDataBlock());
+        return result;
+    }
+    if (!block_->WriteToFile(file_base_.get())) {
+        LOG(ERROR)<< "fwrite error.";
+        return false;
+    }
+    index_->AddDataBlockInfo(block_->GetCompressedBufferSize(),
+                             block_->GetUncompressedBufferSize(), first_key_);
+    index_offset_ += block_->GetCompressedBufferSize();
+    block_->ClearItems();
+    return true;
+}
 
-    FAILED: file_base_.reset(NULL);
-    remove(GetTempSSTablePath(option_.path()).c_str());
-    return false;
+bool SingleSSTableWriter::FinishBlocks() {
+    if (!pipeline_.get())
+        return true;
+    int64_t written_bytes = 0;
+    bool result = pipeline_->Finish(index_.get(), &written_bytes);
+    pipeline_.reset(NULL);
+    if (!result) {
+        LOG(ERROR)<< "fail to write data blocks.";
+        return false;
+    }
+    index_offset_ += written_bytes;
+    return true;
 }
 
 }  // namespace toft
@@ -17,12 +17,16 @@
 #include "toft/storage/sstable/writer/base_sstable_writer.h"
 
 namespace toft {
+class BlockPipeline;
 class File;
+class ThreadPool;
 
 class SingleSSTableWriter : public SSTableWriter {
     TOFT_DECLARE_UNCOPYABLE(SingleSSTableWriter);
 
 public:
+    class Run;
+
     explicit SingleSSTableWriter(const SSTableWriteOption &option);
     ~SingleSSTableWriter();
 
@@ -34,12 +38,38 @@ public:
     virtual bool Flush();
 
 private:
+    // Sort buffered entries into data_index_, on sort_pool_ if there.
+    void SortBufferedEntries();
+    // Sort buffered entries and write them to a new run file, then release
+    // them from memory.
+    bool SpillRun();
+    // Merge all run files into the table.
+    bool MergeRuns();
+    void RemoveRuns();
+
+    // Append an entry in key order to the table.
+    bool AddEntry(const std::string &key, const std::string &value);
+    // Write the last block, file info, index and trailer.
+    bool WriteFileTail();
+    hfile::DataBlock *NewDataBlock() const;
+    // Write block_ started with first_key_ and update the index, the block
+    // is compressed in background if pipeline_ is there.
+    bool WriteBlock();
+    // Wait for blocks in pipeline_ to be written.
+    bool FinishBlocks();
+
     std::vector<std::deque<std::pair<std::string, std::string> >::iterator> data_index_;  // NOLINT
     std::deque<std::pair<std::string, std::string> > d_data_;
 
     std::map<std::string, std::string> file_info_meta_;
 
+    // Paths of spilled sorted runs.
+    std::vector<std::string> run_paths_;
+
     toft::scoped_ptr<File> file_base_;
+    toft::scoped_ptr<hfile::FilterBlock> filter_;
+    toft::scoped_ptr<BlockPipeline> pipeline_;
+    toft::scoped_ptr<ThreadPool> sort_pool_;
     toft::scoped_ptr<hfile::DataBlock> block_;
     toft::scoped_ptr<hfile::DataIndex> index_;
     std::string first_key_;
@@ -52,6 +82,9 @@ private:
     int64_t value_length_;
     int64_t file_info_offset_;
     std::string last_key_;
+    // Bytes taken by entries in d_data_.
+    int64_t buffered_bytes_;
+    bool failed_;
     bool flushed_;
 };
 
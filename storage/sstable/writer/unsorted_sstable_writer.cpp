@@ -7,6 +7,7 @@
 
 #include "toft/storage/file/file.h"
 #include "toft/storage/sstable/sstable.h"
+#include "toft/storage/sstable/writer/block_pipeline.h"
 
 #include "thirdparty/gflags/gflags.h"
 
@@ -25,13 +26,19 @@ UnsortedSSTableWriter::UnsortedSSTableWriter(const SSTableWriteOption &option)
                   file_info_offset_(0) {
     block_.reset(new hfile::DataBlock(static_cast<CompressType>(option.compress_type())));
     index_.reset(new hfile::DataIndex);
+    if (option_.bloom_filter_false_positive_prob() > 0)
+        filter_.reset(new hfile::FilterBlock(option_.bloom_filter_false_positive_prob()));
     CHECK(!option_.path().empty());
     std::string path = GetTempSSTablePath(option_.path());
     file_base_.reset(File::Open(path, "w"));
     CHECK(file_base_.get()) << "open file error: " << option_.path();
+    if (option_.compress_threads() > 0)
+        pipeline_.reset(new BlockPipeline(file_base_.get(), option_.compress_threads()));
 }
 
 UnsortedSSTableWriter::~UnsortedSSTableWriter() {
+    // Wait for the pending blocks before closing the file.
+    pipeline_.reset(NULL);
 }
 
 bool UnsortedSSTableWriter::Add(const std::string &key, const std::string &value) {
@@ -52,6 +59,8 @@ bool UnsortedSSTableWriter::Add(const std::string &key, const std::string &value
         first_key_ = key;
     }
     block_->AddItem(key, value);
+    if (filter_.get())
+        filter_->AddKey(key);
     key_length_ += key.length();
     value_length_ += value.length();
     last_key_ = key;
@@ -69,8 +78,10 @@ bool UnsortedSSTableWriter::Flush() {
     CHECK(file_base_.get()) << "don't call Flush twice!";
 
     // Write the last block
-    if (!WriteBlockAndUpdateIndex())
+    if (!WriteBlockAndUpdateIndex() || !FinishBlocks()) {
+        failed_ = true;
         return false;
+    }
 
     hfile::FileInfo fileInfo;
     std::map<std::string, std::string>::iterator it_fi_meta = file_info_meta_.begin();
@@ -79,6 +90,8 @@ bool UnsortedSSTableWriter::Flush() {
         fileInfo.AddItem(it_fi_meta->first, it_fi_meta->second);
     }
     fileInfo.set_last_key(last_key_);
+    if (filter_.get())
+        fileInfo.set_filter_block(filter_->EncodeToString());
     if (entry_count_ != 0) {
         fileInfo.set_avg_key_len(key_length_ / entry_count_);
         fileInfo.set_avg_value_len(value_length_ / entry_count_);
@@ -115,6 +128,12 @@ bool UnsortedSSTableWriter::Flush() {
 
 bool UnsortedSSTableWriter::WriteBlockAndUpdateIndex() {
     ++index_count_;
+    if (pipeline_.get()) {
+        total_bytes_ += block_->GetUncompressedBufferSize();
+        bool result = pipeline_->AddBlock(block_.release(), first_key_);
+        block_.reset(new hfile::DataBlock(static_cast<CompressType>(option_.compress_type())));
+        return result;
+    }
     // Write the last block
     bool result = block_->WriteToFile(file_base_.get());
     index_->AddDataBlockInfo(block_->GetCompressedBufferSize(), block_->GetUncompressedBufferSize(),
@@ -128,4 +147,18 @@ bool UnsortedSSTableWriter::WriteBlockAndUpdateIndex() {
     return result;
 }
 
+bool UnsortedSSTableWriter::FinishBlocks() {
+    if (!pipeline_.get())
+        return true;
+    int64_t written_bytes = 0;
+    bool result = pipeline_->Finish(index_.get(), &written_bytes);
+    pipeline_.reset(NULL);
+    if (!result) {
+        LOG(ERROR)<< "fail to write data blocks.";
+        return false;
+    }
+    index_offset_ += written_bytes;
+    return true;
+}
+
 }  // namespace toft
@@ -14,6 +14,7 @@
 #include "toft/storage/sstable/writer/base_sstable_writer.h"
 
 namespace toft {
+class BlockPipeline;
 class DataBlock;
 class DataIndex;
 class File;
@@ -30,12 +31,17 @@ public:
     virtual bool Flush();
 
 private:
+    // The block is compressed in background if pipeline_ is there.
     bool WriteBlockAndUpdateIndex();
+    // Wait for blocks in pipeline_ to be written.
+    bool FinishBlocks();
 
     toft::scoped_ptr<File> file_base_;
+    toft::scoped_ptr<BlockPipeline> pipeline_;
     bool failed_;
     toft::scoped_ptr<hfile::DataBlock> block_;
     toft::scoped_ptr<hfile::DataIndex> index_;
+    toft::scoped_ptr<hfile::FilterBlock> filter_;
     std::map<std::string, std::string> file_info_meta_;
     std::string first_key_;
     bool is_first_key_;
@@ -4,15 +4,105 @@
 // Author: CHEN Feng <chen3feng@gmail.com>
 
 #include "toft/system/event_dispatcher/event_dispatcher.h"
+#include "toft/system/atomic/atomic.h"
+#include "toft/system/threading/this_thread.h"
 #include "thirdparty/libev/ev++.h"
 
 namespace toft {
 
-EventDispatcher::EventDispatcher() : m_loop(ev_loop_new()) {
+struct EventDispatcher::PostedTask {
+    explicit PostedTask(const std::function<void ()>& t) : task(t), next(NULL) {}
+    std::function<void ()> task;
+    PostedTask* next;
+};
+
+EventDispatcher::EventDispatcher()
+    : m_loop(ev_loop_new()), m_loop_thread_id(0), m_posted_tasks(NULL) {
+    ev_async_init(&m_post_watcher, OnPostWakeup);
+    m_post_watcher.data = this;
+    ev_async_start(m_loop, &m_post_watcher);
+    ev_unref(m_loop);
+
+    // Checks run after the events of every iteration, with the lowest
+    // priority it runs after all other callbacks.
+    ev_check_init(&m_check_watcher, OnCheck);
+    ev_set_priority(&m_check_watcher, EV_MINPRI);
+    m_check_watcher.data = this;
+    ev_check_start(m_loop, &m_check_watcher);
+    ev_unref(m_loop);
 }
 
 EventDispatcher::~EventDispatcher() {
+    ev_ref(m_loop);
+    ev_check_stop(m_loop, &m_check_watcher);
+    ev_ref(m_loop);
+    ev_async_stop(m_loop, &m_post_watcher);
     ev_loop_destroy(m_loop);
+
+    PostedTask* task = m_posted_tasks;
+    while (task != NULL) {
+        PostedTask* next = task->next;
+        delete task;
+        task = next;
+    }
+}
+
+void EventDispatcher::Run() {
+    m_loop_thread_id = ThisThread::GetId();
+    ev_run(m_loop);
+    m_loop_thread_id = 0;
+}
+
+void EventDispatcher::RunOnce() {
+    m_loop_thread_id = ThisThread::GetId();
+    ev_run(m_loop, EVRUN_ONCE);
+    m_loop_thread_id = 0;
+}
+
+void EventDispatcher::Post(const std::function<void ()>& task) {
+    PostedTask* posted = new PostedTask(task);
+    PostedTask* head;
+    do {
+        head = AtomicGet(&m_posted_tasks);
+        posted->next = head;
+    } while (!AtomicCompareExchange(&m_posted_tasks, head, posted));
+
+    // Only the first post of a batch wakes the loop up. Posts in the loop
+    // thread are run in OnCheck of this iteration without waking up.
+    if (head == NULL && m_loop_thread_id != ThisThread::GetId())
+        ev_async_send(m_loop, &m_post_watcher);
+}
+
+void EventDispatcher::OnPostWakeup(struct ev_loop* loop, ev_async* watcher,
+                                   int events) {
+    // Only to wake the loop up, tasks are run in OnCheck.
+}
+
+void EventDispatcher::OnCheck(struct ev_loop* loop, ev_check* watcher, int events) {
+    EventDispatcher* dispatcher = static_cast<EventDispatcher*>(watcher->data);
+    if (AtomicGet(&dispatcher->m_posted_tasks) != NULL)
+        dispatcher->RunPostedTasks();
+}
+
+void EventDispatcher::RunPostedTasks() {
+    PostedTask* tasks = AtomicExchange(&m_posted_tasks, static_cast<PostedTask*>(NULL));
+    // Reverse into the order of posting.
+    PostedTask* ordered = NULL;
+    while (tasks != NULL) {
+        PostedTask* next = tasks->next;
+        tasks->next = ordered;
+        ordered = tasks;
+        tasks = next;
+    }
+    while (ordered != NULL) {
+        PostedTask* task = ordered;
+        ordered = task->next;
+        task->task();
+        delete task;
+    }
+    // Tasks posted by tasks, run them in the next iteration without blocking.
+    if (AtomicGet(&m_posted_tasks) != NULL)
+        ev_async_send(m_loop, &m_post_watcher);
 }
 
 } // namespace toft
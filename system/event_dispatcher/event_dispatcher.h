@@ -44,12 +44,41 @@ class EventDispatcher {
     friend class EventWatcherBase;
 public:
     EventDispatcher();
+    // Tasks not run yet are dropped.
     ~EventDispatcher();
-    void Run() { ev_run(m_loop); }
-    void RunOnce() { ev_run(m_loop, EVRUN_ONCE); }
+    void Run();
+    void RunOnce();
     void Break() { ev_break(m_loop); }
+
+    // Time of the loop in milliseconds, cached when the current iteration
+    // started to handle events. Timers of the loop count from it.
+    int64_t NowMilliSeconds() const {
+        return static_cast<int64_t>(ev_now(m_loop) * 1000);
+    }
+
+    // Run task in the loop thread, can be called in any thread. Tasks run in
+    // the order of posting after all other callbacks of an iteration: posts
+    // in the loop thread run at the end of the current iteration, and posts
+    // in other threads wake the loop up, many of them in one wakeup. Tasks
+    // posted by tasks run in the next iteration. Posted tasks do not keep Run
+    // from returning, those left run in the next Run.
+    void Post(const std::function<void ()>& task);
+
+private:
+    struct PostedTask;
+
+    static void OnPostWakeup(struct ev_loop* loop, ev_async* watcher, int events);
+    static void OnCheck(struct ev_loop* loop, ev_check* watcher, int events);
+    void RunPostedTasks();
+
 private:
     struct ev_loop* m_loop;
+    // Id of the thread running the loop, 0 if not running.
+    int m_loop_thread_id;
+    // Lock free stack of posted tasks, the latest first.
+    PostedTask* m_posted_tasks;
+    ev_async m_post_watcher;
+    ev_check m_check_watcher;
 };
 
 // Used as base template class of concrete EventWatcher class.
@@ -105,6 +134,12 @@ public:
         : EventWatcherBase(dispatcher, callback) {
         ev_timer_set(c_watcher(), after_ms / 1000.0, repeat_ms / 1000.0);
     }
+    // Change the time, an active timer is restarted.
+    void Set(int64_t after_ms, int64_t repeat_ms = 0) {
+        ev_timer_stop(loop(), c_watcher());
+        ev_timer_set(c_watcher(), after_ms / 1000.0, repeat_ms / 1000.0);
+        ev_timer_start(loop(), c_watcher());
+    }
     void Start() {
         ev_timer_start(loop(), c_watcher());
     }
@@ -152,7 +187,7 @@ public:
     }
 
     void Set(int fd, int events) {
-        ev_io_set(c_watcher(), c_watcher()->fd, events);
+        ev_io_set(c_watcher(), fd, events);
     }
 
     void Set(int events) {
@@ -168,6 +203,28 @@ public:
     }
 };
 
+// Wake up the event loop from any thread. Send can be called in any thread,
+// the callback runs in the loop thread, and close sends before it runs are
+// merged into one call.
+class AsyncEventWatcher : public EventWatcherBase<AsyncEventWatcher, ev_async> {
+public:
+    AsyncEventWatcher(EventDispatcher* dispatcher, const CallbackType& callback)
+        : EventWatcherBase(dispatcher, callback) {
+        ev_async_set(c_watcher());
+    }
+    void Start() {
+        ev_async_start(loop(), c_watcher());
+    }
+
+    void Stop() {
+        ev_async_stop(loop(), c_watcher());
+    }
+
+    void Send() {
+        ev_async_send(loop(), c_watcher());
+    }
+};
+
 } // namespace toft
 
 #endif // TOFT_SYSTEM_EVENT_DISPATCHER_EVENT_DISPATCHER_H
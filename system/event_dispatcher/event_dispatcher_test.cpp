@@ -8,6 +8,9 @@
 #include <signal.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <vector>
+#include "toft/system/atomic/atomic.h"
+#include "toft/system/threading/thread.h"
 #include "thirdparty/gtest/gtest.h"
 
 namespace toft {
@@ -73,5 +76,151 @@ TEST(EventDispatcher, Io) {
     EXPECT_EQ(0, c);
 }
 
-} // namespace toft
+static void OnAsync(EventDispatcher* dispatcher, int* count, int) {
+    ++*count;
+    dispatcher->Break();
+}
+
+static void SendAsync(AsyncEventWatcher* watcher) {
+    watcher->Send();
+}
+
+TEST(EventDispatcher, Async) {
+    using namespace std::placeholders;
+    EventDispatcher dispatcher;
+    int count = 0;
+    AsyncEventWatcher watcher(&dispatcher,
+                              std::bind(OnAsync, &dispatcher, &count, _1));
+    watcher.Start();
+    // Sends before the loop runs are merged.
+    watcher.Send();
+    watcher.Send();
+    dispatcher.Run();
+    EXPECT_EQ(1, count);
+
+    Thread thread(std::bind(SendAsync, &watcher));
+    dispatcher.Run();
+    thread.Join();
+    EXPECT_EQ(2, count);
+    watcher.Stop();
+}
+
+static void AppendNumber(std::vector<int>* numbers, int n) {
+    numbers->push_back(n);
+}
+
+TEST(EventDispatcher, Post) {
+    EventDispatcher dispatcher;
+    std::vector<int> numbers;
+    for (int i = 0; i < 10; ++i)
+        dispatcher.Post(std::bind(AppendNumber, &numbers, i));
+    // Posted tasks do not keep the loop running.
+    dispatcher.Run();
+    ASSERT_EQ(10U, numbers.size());
+    for (int i = 0; i < 10; ++i)
+        EXPECT_EQ(i, numbers[i]);
+    dispatcher.Run();
+    EXPECT_EQ(10U, numbers.size());
+}
+
+static void PostAppendNumber(EventDispatcher* dispatcher,
+                             std::vector<int>* numbers, int n, int) {
+    dispatcher->Post(std::bind(AppendNumber, numbers, n));
+    numbers->push_back(n - 1);
+}
+
+TEST(EventDispatcher, PostInLoopThread) {
+    using namespace std::placeholders;
+    EventDispatcher dispatcher;
+    std::vector<int> numbers;
+    TimerEventWatcher watcher(&dispatcher,
+                              std::bind(PostAppendNumber, &dispatcher, &numbers, 2, _1),
+                              10);
+    watcher.Start();
+    // Run at the end of the same iteration.
+    dispatcher.RunOnce();
+    ASSERT_EQ(2U, numbers.size());
+    EXPECT_EQ(1, numbers[0]);
+    EXPECT_EQ(2, numbers[1]);
+}
 
+static void PostAgain(EventDispatcher* dispatcher, int* count) {
+    if (++*count < 3)
+        dispatcher->Post(std::bind(PostAgain, dispatcher, count));
+}
+
+TEST(EventDispatcher, PostInTask) {
+    EventDispatcher dispatcher;
+    int count = 0;
+    dispatcher.Post(std::bind(PostAgain, &dispatcher, &count));
+    dispatcher.RunOnce();
+    EXPECT_EQ(1, count);
+    dispatcher.RunOnce();
+    EXPECT_EQ(2, count);
+    dispatcher.Run();
+    EXPECT_EQ(3, count);
+}
+
+static const int kPostThreads = 4;
+static const int kPostsPerThread = 20000;
+
+struct ThreadPosts {
+    ThreadPosts(EventDispatcher* d, int* c, int t) : dispatcher(d), count(c), thread(t) {}
+    EventDispatcher* dispatcher;
+    int* count;
+    int thread;
+    int next;
+};
+
+static void CountThreadPost(ThreadPosts* posts, int n) {
+    EXPECT_EQ(posts->next, n);
+    posts->next = n + 1;
+    if (++*posts->count == kPostThreads * kPostsPerThread)
+        posts->dispatcher->Break();
+}
+
+static void PostMany(ThreadPosts* posts) {
+    for (int i = 0; i < kPostsPerThread; ++i)
+        posts->dispatcher->Post(std::bind(CountThreadPost, posts, i));
+}
+
+static void Nothing(int) {}
+
+TEST(EventDispatcher, PostFromThreads) {
+    EventDispatcher dispatcher;
+    // Keep the loop running until all tasks are run.
+    TimerEventWatcher watcher(&dispatcher, std::bind(Nothing, std::placeholders::_1),
+                              100000);
+    watcher.Start();
+    int count = 0;
+    std::vector<ThreadPosts*> posts;
+    std::vector<Thread*> threads;
+    for (int i = 0; i < kPostThreads; ++i) {
+        posts.push_back(new ThreadPosts(&dispatcher, &count, i));
+        posts.back()->next = 0;
+        threads.push_back(new Thread(std::bind(PostMany, posts.back())));
+    }
+    dispatcher.Run();
+    EXPECT_EQ(kPostThreads * kPostsPerThread, count);
+    for (int i = 0; i < kPostThreads; ++i) {
+        threads[i]->Join();
+        delete threads[i];
+        EXPECT_EQ(kPostsPerThread, posts[i]->next);
+        delete posts[i];
+    }
+}
+
+static void SetTrue(bool* value) {
+    *value = true;
+}
+
+TEST(EventDispatcher, DropPostedTasks) {
+    bool run = false;
+    {
+        EventDispatcher dispatcher;
+        dispatcher.Post(std::bind(SetTrue, &run));
+    }
+    EXPECT_FALSE(run);
+}
+
+} // namespace toft
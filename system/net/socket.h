@@ -150,6 +150,9 @@ public:
     static int GetLastError();
     static std::string GetErrorString(int error);
     static std::string GetLastErrorString();
+    // Whether the last call of a nonblocking socket failed only because it
+    // would block or was interrupted, to be tried again later.
+    static bool IsLastErrorWouldBlock();
 
 protected:
     bool CheckError(int result, const char* info = "socket") const;
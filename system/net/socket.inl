@@ -222,6 +222,14 @@ inline std::string Socket::GetLastErrorString()
     return SocketGetErrorString(GetLastError());
 }
 
+inline bool Socket::IsLastErrorWouldBlock()
+{
+    int error = GetLastError();
+    return error == SOCKET_ERROR_CODE(EAGAIN) ||
+        error == SOCKET_ERROR_CODE(EWOULDBLOCK) ||
+        error == SOCKET_ERROR_CODE(EINTR);
+}
+
 inline void Socket::SetLastError(int error)
 {
     SocketSetLastError(error);
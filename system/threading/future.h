@@ -0,0 +1,321 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Future and Promise with continuations, for fan-out/fan-in on ThreadPool
+// without blocking any thread:
+//
+//   std::vector<Future<Result> > futures;
+//   for (size_t i = 0; i < shards.size(); ++i)
+//       futures.push_back(Async<Result>(&pool, std::bind(&Query, shards[i])));
+//   WhenAll(futures).Then<Result>(std::bind(&MergeResults, _1));
+
+#ifndef TOFT_SYSTEM_THREADING_FUTURE_H
+#define TOFT_SYSTEM_THREADING_FUTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/base/shared_ptr.h"
+#include "toft/base/uncopyable.h"
+#include "toft/system/atomic/atomic.h"
+#include "toft/system/threading/condition_variable.h"
+#include "toft/system/threading/mutex.h"
+#include "toft/system/threading/thread_pool.h"
+#include "toft/system/time/clock.h"
+
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+
+template <typename T> class Future;
+template <typename T> class Promise;
+
+namespace internal {
+
+// Shared by a Promise and all Futures got from it.
+template <typename T>
+class FutureState {
+    TOFT_DECLARE_UNCOPYABLE(FutureState);
+
+public:
+    typedef std::function<void (const T&)> Callback;
+
+    FutureState() : m_cond(&m_mutex), m_ready(false) {}
+
+    bool IsReady() const {
+        MutexLocker locker(&m_mutex);
+        return m_ready;
+    }
+
+    void Wait() {
+        MutexLocker locker(&m_mutex);
+        while (!m_ready)
+            m_cond.Wait();
+    }
+
+    bool TimedWait(int64_t timeout_in_ms) {
+        int64_t deadline = RealtimeClock.MilliSeconds() + timeout_in_ms;
+        MutexLocker locker(&m_mutex);
+        // Wakeups may be spurious.
+        while (!m_ready) {
+            int64_t remaining = deadline - RealtimeClock.MilliSeconds();
+            if (remaining <= 0)
+                break;
+            m_cond.TimedWait(remaining);
+        }
+        return m_ready;
+    }
+
+    // Never changes once ready.
+    const T& Value() const {
+        return m_value;
+    }
+
+    void SetValue(const T& value) {
+        std::vector<Continuation> continuations;
+        {
+            MutexLocker locker(&m_mutex);
+            CHECK(!m_ready) << "Promise is already satisfied";
+            m_value = value;
+            m_ready = true;
+            continuations.swap(m_continuations);
+            m_cond.Broadcast();
+        }
+        for (size_t i = 0; i < continuations.size(); ++i)
+            Dispatch(continuations[i].callback, continuations[i].pool);
+    }
+
+    // Run callback in this thread if ready, otherwise in the thread setting
+    // the value, or in pool if it's not NULL.
+    static void OnReady(const std::shared_ptr<FutureState>& state,
+                        const Callback& callback,
+                        ThreadPool* pool) {
+        {
+            MutexLocker locker(&state->m_mutex);
+            if (!state->m_ready) {
+                Continuation continuation;
+                continuation.callback = std::bind(&RunCallback, state, callback);
+                continuation.pool = pool;
+                state->m_continuations.push_back(continuation);
+                return;
+            }
+        }
+        callback(state->m_value);
+    }
+
+private:
+    struct Continuation {
+        std::function<void ()> callback;
+        ThreadPool* pool;
+    };
+
+    // The bound state keeps the value alive until the callback is done.
+    static void RunCallback(const std::shared_ptr<FutureState>& state,
+                            const Callback& callback) {
+        callback(state->m_value);
+    }
+
+    static void Dispatch(const std::function<void ()>& callback,
+                         ThreadPool* pool) {
+        if (pool != NULL) {
+            pool->AddTask(callback);
+        } else {
+            callback();
+        }
+    }
+
+    mutable Mutex m_mutex;
+    ConditionVariable m_cond;
+    bool m_ready;
+    T m_value;
+    std::vector<Continuation> m_continuations;
+};
+
+template <typename T, typename U>
+void ContinueWith(Promise<U> promise,
+                  const std::function<U (const T&)>& function,
+                  const T& value) {
+    promise.SetValue(function(value));
+}
+
+template <typename T>
+void RunAndSetValue(Promise<T> promise, const std::function<T ()>& function) {
+    promise.SetValue(function());
+}
+
+template <typename T>
+class WhenAllContext {
+public:
+    explicit WhenAllContext(size_t count)
+        : m_values(count), m_num_pending(count) {}
+
+    void SetValue(size_t index, const T& value) {
+        m_values[index] = value;
+        // Full barrier, all values are visible to the last one.
+        if (AtomicDecrement(&m_num_pending) == 0)
+            m_promise.SetValue(m_values);
+    }
+
+    Future<std::vector<T> > GetFuture() const {
+        return m_promise.GetFuture();
+    }
+
+private:
+    std::vector<T> m_values;
+    size_t m_num_pending;
+    Promise<std::vector<T> > m_promise;
+};
+
+template <typename T>
+class WhenAnyContext {
+public:
+    WhenAnyContext() : m_done(0) {}
+
+    void SetValue(size_t index, const T& value) {
+        if (AtomicCompareExchange(&m_done, 0, 1))
+            m_promise.SetValue(std::make_pair(index, value));
+    }
+
+    Future<std::pair<size_t, T> > GetFuture() const {
+        return m_promise.GetFuture();
+    }
+
+private:
+    int m_done;
+    Promise<std::pair<size_t, T> > m_promise;
+};
+
+} // namespace internal
+
+// Read side of a value which will be set by a Promise. Copies share the
+// same value. T must be default constructible and copyable.
+template <typename T>
+class Future {
+    friend class Promise<T>;
+
+public:
+    // Not valid until assigned from a Promise.
+    Future() {}
+
+    bool IsValid() const {
+        return m_state.get() != NULL;
+    }
+
+    bool IsReady() const {
+        return m_state->IsReady();
+    }
+
+    // Block until the value is set. Don't call it in a pool thread with the
+    // value set by tasks of the same pool, which may deadlock, use Then.
+    const T& Get() const {
+        m_state->Wait();
+        return m_state->Value();
+    }
+
+    // Return false if timeout.
+    bool TimedWait(int64_t timeout_in_ms) const {
+        return m_state->TimedWait(timeout_in_ms);
+    }
+
+    // Call callback with the value. It runs inline if the value is already
+    // ready, otherwise in the thread which sets the value, or as a task of
+    // pool if pool is not NULL.
+    void OnReady(const std::function<void (const T&)>& callback,
+                 ThreadPool* pool = NULL) const {
+        internal::FutureState<T>::OnReady(m_state, callback, pool);
+    }
+
+    // Return the future of function applied to the value, the function
+    // runs as the callback of OnReady. U can't be deduced from a bind
+    // expression, so call it as:
+    //   future.Then<std::string>(std::bind(&Format, _1));
+    template <typename U>
+    Future<U> Then(const std::function<U (const T&)>& function,
+                   ThreadPool* pool = NULL) const {
+        Promise<U> promise;
+        OnReady(std::bind(&internal::ContinueWith<T, U>,
+                          promise, function, std::placeholders::_1),
+                pool);
+        return promise.GetFuture();
+    }
+
+private:
+    explicit Future(const std::shared_ptr<internal::FutureState<T> >& state)
+        : m_state(state) {}
+
+private:
+    std::shared_ptr<internal::FutureState<T> > m_state;
+};
+
+// Write side, the value can be set only once. If a Promise is destroyed
+// without setting, its futures are never ready.
+template <typename T>
+class Promise {
+public:
+    Promise() : m_state(new internal::FutureState<T>()) {}
+
+    Future<T> GetFuture() const {
+        return Future<T>(m_state);
+    }
+
+    // Ready continuations run in this thread before return.
+    void SetValue(const T& value) {
+        m_state->SetValue(value);
+    }
+
+private:
+    std::shared_ptr<internal::FutureState<T> > m_state;
+};
+
+template <typename T>
+Future<T> MakeReadyFuture(const T& value) {
+    Promise<T> promise;
+    promise.SetValue(value);
+    return promise.GetFuture();
+}
+
+// Run function as a task of pool, return the future of its result.
+template <typename T>
+Future<T> Async(ThreadPool* pool, const std::function<T ()>& function) {
+    Promise<T> promise;
+    pool->AddTask(std::bind(&internal::RunAndSetValue<T>, promise, function));
+    return promise.GetFuture();
+}
+
+// Ready when all futures are ready, with their values in the same order.
+template <typename T>
+Future<std::vector<T> > WhenAll(const std::vector<Future<T> >& futures) {
+    if (futures.empty())
+        return MakeReadyFuture(std::vector<T>());
+    std::shared_ptr<internal::WhenAllContext<T> > context(
+        new internal::WhenAllContext<T>(futures.size()));
+    Future<std::vector<T> > result = context->GetFuture();
+    for (size_t i = 0; i < futures.size(); ++i) {
+        futures[i].OnReady(std::bind(&internal::WhenAllContext<T>::SetValue,
+                                     context, i, std::placeholders::_1));
+    }
+    return result;
+}
+
+// Ready when any future is ready, with its index and value. futures must
+// not be empty.
+template <typename T>
+Future<std::pair<size_t, T> > WhenAny(const std::vector<Future<T> >& futures) {
+    CHECK(!futures.empty());
+    std::shared_ptr<internal::WhenAnyContext<T> > context(
+        new internal::WhenAnyContext<T>());
+    Future<std::pair<size_t, T> > result = context->GetFuture();
+    for (size_t i = 0; i < futures.size(); ++i) {
+        futures[i].OnReady(std::bind(&internal::WhenAnyContext<T>::SetValue,
+                                     context, i, std::placeholders::_1));
+    }
+    return result;
+}
+
+} // namespace toft
+
+#endif // TOFT_SYSTEM_THREADING_FUTURE_H
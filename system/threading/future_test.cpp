@@ -0,0 +1,153 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/system/threading/future.h"
+
+#include <string>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/base/string/number.h"
+#include "toft/system/threading/this_thread.h"
+#include "toft/system/threading/thread_pool.h"
+#include "toft/system/time/clock.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+static int Square(int x) {
+    return x * x;
+}
+
+static std::string Format(int x) {
+    return IntegerToString(x);
+}
+
+static int Sum(const std::vector<int>& values) {
+    int sum = 0;
+    for (size_t i = 0; i < values.size(); ++i)
+        sum += values[i];
+    return sum;
+}
+
+static void SaveThreadId(int* thread_id, int) {
+    *thread_id = ThisThread::GetId();
+}
+
+static int SleepAndReturn(int ms, int value) {
+    ThisThread::Sleep(ms);
+    return value;
+}
+
+TEST(Future, SetThenGet) {
+    Promise<int> promise;
+    Future<int> future = promise.GetFuture();
+    EXPECT_TRUE(future.IsValid());
+    EXPECT_FALSE(future.IsReady());
+    EXPECT_FALSE(future.TimedWait(1));
+    promise.SetValue(42);
+    EXPECT_TRUE(future.IsReady());
+    EXPECT_TRUE(future.TimedWait(1));
+    EXPECT_EQ(42, future.Get());
+    EXPECT_FALSE(Future<int>().IsValid());
+}
+
+TEST(Future, TimedWait) {
+    ThreadPool pool(1);
+    Future<int> future = Async<int>(&pool, std::bind(&SleepAndReturn, 50, 7));
+    // Set before the deadline.
+    EXPECT_TRUE(future.TimedWait(100));
+    EXPECT_EQ(7, future.Get());
+
+    // Never set, the whole timeout is waited.
+    Promise<int> promise;
+    int64_t start = RealtimeClock.MilliSeconds();
+    EXPECT_FALSE(promise.GetFuture().TimedWait(50));
+    EXPECT_GE(RealtimeClock.MilliSeconds() - start, 49);
+}
+
+TEST(Future, ThenInlineWhenReady) {
+    int thread_id = 0;
+    Future<int> future = MakeReadyFuture(3);
+    future.OnReady(std::bind(&SaveThreadId, &thread_id, std::placeholders::_1));
+    EXPECT_EQ(ThisThread::GetId(), thread_id);
+
+    Future<std::string> result = future.Then<int>(Square).Then<std::string>(Format);
+    ASSERT_TRUE(result.IsReady());
+    EXPECT_EQ("9", result.Get());
+}
+
+TEST(Future, ThenInSettingThread) {
+    Promise<int> promise;
+    Future<std::string> result =
+        promise.GetFuture().Then<int>(Square).Then<std::string>(Format);
+    EXPECT_FALSE(result.IsReady());
+    promise.SetValue(5);
+    ASSERT_TRUE(result.IsReady());
+    EXPECT_EQ("25", result.Get());
+}
+
+TEST(Future, ThenInPool) {
+    ThreadPool pool(2);
+    Promise<int> promise;
+    int thread_id = ThisThread::GetId();
+    promise.GetFuture().OnReady(
+        std::bind(&SaveThreadId, &thread_id, std::placeholders::_1), &pool);
+    Future<int> result = promise.GetFuture().Then<int>(Square, &pool);
+    promise.SetValue(7);
+    EXPECT_EQ(49, result.Get());
+    pool.WaitForIdle();
+    EXPECT_NE(ThisThread::GetId(), thread_id);
+}
+
+TEST(Future, Async) {
+    ThreadPool pool(4);
+    std::vector<Future<int> > futures;
+    for (int i = 0; i < 100; ++i) {
+        futures.push_back(Async<int>(&pool, std::bind(&Square, i)));
+    }
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(i * i, futures[i].Get());
+    }
+}
+
+TEST(Future, WhenAll) {
+    ThreadPool pool(4, ThreadPool::kWorkStealing);
+    for (int round = 0; round < 20; ++round) {
+        std::vector<Future<int> > futures;
+        int expected = 0;
+        for (int i = 0; i < 64; ++i) {
+            futures.push_back(Async<int>(&pool, std::bind(&Square, i)));
+            expected += i * i;
+        }
+        Future<std::vector<int> > all = WhenAll(futures);
+        Future<int> sum = all.Then<int>(Sum);
+        EXPECT_EQ(expected, sum.Get());
+        ASSERT_EQ(64U, all.Get().size());
+        for (int i = 0; i < 64; ++i)
+            EXPECT_EQ(i * i, all.Get()[i]);
+    }
+}
+
+TEST(Future, WhenAllEmpty) {
+    Future<std::vector<int> > all = WhenAll(std::vector<Future<int> >());
+    ASSERT_TRUE(all.IsReady());
+    EXPECT_TRUE(all.Get().empty());
+}
+
+TEST(Future, WhenAny) {
+    ThreadPool pool(2);
+    Promise<int> never;
+    std::vector<Future<int> > futures;
+    futures.push_back(never.GetFuture());
+    futures.push_back(Async<int>(&pool, std::bind(&SleepAndReturn, 10, 2)));
+    futures.push_back(never.GetFuture());
+    Future<std::pair<size_t, int> > any = WhenAny(futures);
+    EXPECT_EQ(1U, any.Get().first);
+    EXPECT_EQ(2, any.Get().second);
+    never.SetValue(0);
+    EXPECT_EQ(1U, any.Get().first);
+}
+
+} // namespace toft
@@ -0,0 +1,263 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Bounded multi-producer multi-consumer queue of Dmitry Vyukov, see
+// http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+
+#ifndef TOFT_SYSTEM_THREADING_MPMC_QUEUE_H
+#define TOFT_SYSTEM_THREADING_MPMC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "toft/base/uncopyable.h"
+#include "toft/system/atomic/atomic.h"
+#include "toft/system/threading/event.h"
+#include "toft/system/threading/this_thread.h"
+
+namespace toft {
+
+// Lock-free when not blocking. Each cell carries a sequence number telling
+// whether it's ready for the producer or the consumer of its position, so
+// producers and consumers only contend on their own position counters.
+//
+// Blocking operations spin a while then park on an AutoResetEvent, the spin
+// count adapts to how long the waits used to be.
+//
+// T must be default constructible and assignable.
+template <typename T>
+class MpmcQueue {
+    TOFT_DECLARE_UNCOPYABLE(MpmcQueue);
+
+public:
+    // capacity is rounded up to power of 2.
+    explicit MpmcQueue(size_t capacity)
+        : m_cells(NULL), m_mask(0),
+          m_num_waiting_consumers(0), m_num_waiting_producers(0),
+          m_spin_limit(kMaxSpinCount / 2),
+          m_enqueue_pos(0), m_dequeue_pos(0) {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        m_cells = new Cell[size];
+        m_mask = size - 1;
+        for (size_t i = 0; i < size; ++i)
+            m_cells[i].sequence = i;
+    }
+
+    ~MpmcQueue() {
+        delete[] m_cells;
+    }
+
+    size_t Capacity() const {
+        return m_mask + 1;
+    }
+
+    // Approximate number of items.
+    size_t Size() const {
+        size_t enqueue_pos = m_enqueue_pos;
+        size_t dequeue_pos = m_dequeue_pos;
+        return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+    }
+
+    bool IsEmpty() const {
+        return Size() == 0;
+    }
+
+    // Return false if full.
+    bool TryPush(const T& item) {
+        Cell* cell;
+        size_t pos = m_enqueue_pos;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            size_t sequence = AcquireLoad(&cell->sequence);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (__sync_bool_compare_and_swap(&m_enqueue_pos, pos, pos + 1))
+                    break;
+                pos = m_enqueue_pos;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_enqueue_pos;
+            }
+        }
+        cell->data = item;
+        ReleaseStore(&cell->sequence, pos + 1);
+        WakeUp(&m_num_waiting_consumers, &m_not_empty);
+        return true;
+    }
+
+    // Return false if empty.
+    bool TryPop(T* item) {
+        return TryPopBatch(item, 1) == 1;
+    }
+
+    // Pop up to max_count items into items, all at once. Return the number of
+    // popped items, 0 if empty.
+    size_t TryPopBatch(T* items, size_t max_count) {
+        size_t pos = m_dequeue_pos;
+        size_t count;
+        for (;;) {
+            // Count the ready cells from pos.
+            count = 0;
+            while (count < max_count) {
+                Cell* cell = &m_cells[(pos + count) & m_mask];
+                size_t sequence = AcquireLoad(&cell->sequence);
+                if (sequence != pos + count + 1)
+                    break;
+                ++count;
+            }
+            if (count == 0) {
+                Cell* cell = &m_cells[pos & m_mask];
+                intptr_t diff = static_cast<intptr_t>(AcquireLoad(&cell->sequence)) -
+                    static_cast<intptr_t>(pos + 1);
+                if (diff < 0)
+                    return 0;
+                // Taken by other consumers.
+                pos = m_dequeue_pos;
+                continue;
+            }
+            if (__sync_bool_compare_and_swap(&m_dequeue_pos, pos, pos + count))
+                break;
+            pos = m_dequeue_pos;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            Cell* cell = &m_cells[(pos + i) & m_mask];
+            items[i] = cell->data;
+            cell->data = T();
+            ReleaseStore(&cell->sequence, pos + i + m_mask + 1);
+        }
+        WakeUp(&m_num_waiting_producers, &m_not_full);
+        return count;
+    }
+
+    // Block until there is room.
+    void Push(const T& item) {
+        int spins = 0;
+        while (!TryPush(item)) {
+            if (Spin(&spins))
+                continue;
+            Park(&m_num_waiting_producers, &m_not_full);
+        }
+        AdaptSpinLimit(spins);
+        // Items may have been popped in batch with only one wakeup.
+        if (Size() < Capacity())
+            WakeUp(&m_num_waiting_producers, &m_not_full);
+    }
+
+    // Block until there is an item.
+    void Pop(T* item) {
+        PopBatch(item, 1);
+    }
+
+    // Block until there are some items, pop up to max_count of them.
+    size_t PopBatch(T* items, size_t max_count) {
+        int spins = 0;
+        size_t count;
+        while ((count = TryPopBatch(items, max_count)) == 0) {
+            if (Spin(&spins))
+                continue;
+            Park(&m_num_waiting_consumers, &m_not_empty);
+        }
+        AdaptSpinLimit(spins);
+        // Wakeups of close pushes may be merged by the event, pass it on.
+        if (!IsEmpty())
+            WakeUp(&m_num_waiting_consumers, &m_not_empty);
+        return count;
+    }
+
+private:
+    static const int kMaxSpinCount = 4096;
+    static const int kYieldCount = 8;
+
+    struct Cell {
+        volatile size_t sequence;
+        T data;
+    };
+
+    static void CompilerBarrier() {
+#if defined(__i386__) || defined(__x86_64__)
+        __asm__ __volatile__("" ::: "memory");  // NOLINT
+#else
+        __sync_synchronize();
+#endif
+    }
+
+    static size_t AcquireLoad(const volatile size_t* p) {
+        size_t value = *p;
+        CompilerBarrier();
+        return value;
+    }
+
+    static void ReleaseStore(volatile size_t* p, size_t value) {
+        CompilerBarrier();
+        *p = value;
+    }
+
+    // Return false if it's time to park.
+    bool Spin(int* spins) {
+        ++*spins;
+        if (*spins <= m_spin_limit) {
+#if defined(__i386__) || defined(__x86_64__)
+            __asm__ __volatile__("pause");  // NOLINT
+#endif
+            return true;
+        }
+        if (*spins <= m_spin_limit + kYieldCount) {
+            ThisThread::Yield();
+            return true;
+        }
+        return false;
+    }
+
+    // Spin longer if the waits used to end in spinning, shorter otherwise.
+    void AdaptSpinLimit(int spins) {
+        if (spins == 0)
+            return;
+        int limit = m_spin_limit;
+        if (spins <= limit) {
+            limit = limit * 2 < kMaxSpinCount ? limit * 2 : kMaxSpinCount;
+        } else {
+            limit = limit / 2 > 16 ? limit / 2 : 16;
+        }
+        m_spin_limit = limit;
+    }
+
+    // The full barriers pair between Park and WakeUp, either the parking
+    // thread sees the change, or the waking thread sees it's waiting.
+    void Park(volatile int* num_waiting, AutoResetEvent* event) {
+        AtomicIncrement(const_cast<int*>(num_waiting));
+        __sync_synchronize();
+        // Check again after counted as waiting.
+        bool ready = (event == &m_not_empty) ? !IsEmpty() : Size() < Capacity();
+        if (!ready)
+            event->Wait();
+        AtomicDecrement(const_cast<int*>(num_waiting));
+    }
+
+    void WakeUp(volatile int* num_waiting, AutoResetEvent* event) {
+        __sync_synchronize();
+        if (*num_waiting > 0)
+            event->Set();
+    }
+
+    Cell* m_cells;
+    size_t m_mask;
+    AutoResetEvent m_not_empty;
+    AutoResetEvent m_not_full;
+    volatile int m_num_waiting_consumers;
+    volatile int m_num_waiting_producers;
+    volatile int m_spin_limit;
+
+    // Producers and consumers work on different cache lines.
+    char m_padding0[64];
+    volatile size_t m_enqueue_pos __attribute__((aligned(64)));
+    char m_padding1[64 - sizeof(size_t)];
+    volatile size_t m_dequeue_pos __attribute__((aligned(64)));
+    char m_padding2[64 - sizeof(size_t)];
+};
+
+} // namespace toft
+
+#endif // TOFT_SYSTEM_THREADING_MPMC_QUEUE_H
@@ -0,0 +1,114 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Throughput of MpmcQueue against a std::deque protected by Mutex and
+// ConditionVariable. The range is the number of producers, and also the
+// number of consumers.
+
+#include <deque>
+#include <vector>
+
+#include "toft/base/benchmark.h"
+#include "toft/base/functional.h"
+#include "toft/system/threading/condition_variable.h"
+#include "toft/system/threading/mpmc_queue.h"
+#include "toft/system/threading/mutex.h"
+#include "toft/system/threading/thread.h"
+
+namespace toft {
+
+static const size_t kCapacity = 1024;
+static const size_t kBatchSize = 32;
+
+// The way our pipelines pass items before MpmcQueue.
+template <typename T>
+class MutexDequeQueue {
+public:
+    explicit MutexDequeQueue(size_t capacity)
+        : m_capacity(capacity), m_not_empty(&m_mutex), m_not_full(&m_mutex) {}
+
+    void Push(const T& item) {
+        MutexLocker locker(&m_mutex);
+        while (m_items.size() >= m_capacity)
+            m_not_full.Wait();
+        m_items.push_back(item);
+        m_not_empty.Signal();
+    }
+
+    size_t PopBatch(T* items, size_t max_count) {
+        MutexLocker locker(&m_mutex);
+        while (m_items.empty())
+            m_not_empty.Wait();
+        size_t count = 0;
+        while (count < max_count && !m_items.empty()) {
+            items[count++] = m_items.front();
+            m_items.pop_front();
+        }
+        m_not_full.Broadcast();
+        return count;
+    }
+
+private:
+    size_t m_capacity;
+    std::deque<T> m_items;
+    Mutex m_mutex;
+    ConditionVariable m_not_empty;
+    ConditionVariable m_not_full;
+};
+
+template <typename Queue>
+static void Produce(Queue* queue, int count) {
+    for (int i = 0; i < count; ++i)
+        queue->Push(i);
+}
+
+template <typename Queue>
+static void Consume(Queue* queue, int count, size_t batch_size) {
+    std::vector<int> items(batch_size);
+    while (count > 0) {
+        size_t max_count = batch_size < static_cast<size_t>(count) ? batch_size : count;
+        count -= queue->PopBatch(&items[0], max_count);
+    }
+}
+
+template <typename Queue>
+static void RunThreads(int n, int num_threads, size_t batch_size) {
+    StopBenchmarkTiming();
+    Queue queue(kCapacity);
+    int count = n / num_threads + 1;
+    std::vector<Thread*> threads;
+    StartBenchmarkTiming();
+    for (int i = 0; i < num_threads; ++i) {
+        threads.push_back(new Thread(
+                std::bind(&Consume<Queue>, &queue, count, batch_size)));
+        threads.push_back(new Thread(std::bind(&Produce<Queue>, &queue, count)));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->Join();
+        delete threads[i];
+    }
+    SetBenchmarkItemsProcessed(count * num_threads);
+}
+
+static void MutexDequePushPop(int n, int num_threads) {
+    RunThreads<MutexDequeQueue<int> >(n, num_threads, 1);
+}
+
+static void MpmcQueuePushPop(int n, int num_threads) {
+    RunThreads<MpmcQueue<int> >(n, num_threads, 1);
+}
+
+static void MutexDequePushPopBatch(int n, int num_threads) {
+    RunThreads<MutexDequeQueue<int> >(n, num_threads, kBatchSize);
+}
+
+static void MpmcQueuePushPopBatch(int n, int num_threads) {
+    RunThreads<MpmcQueue<int> >(n, num_threads, kBatchSize);
+}
+
+TOFT_BENCHMARK_RANGE(MutexDequePushPop, 1, 64)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(MpmcQueuePushPop, 1, 64)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(MutexDequePushPopBatch, 1, 64)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(MpmcQueuePushPopBatch, 1, 64)->ThreadRange(1, 1);
+
+}  // namespace toft
@@ -0,0 +1,115 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/system/threading/mpmc_queue.h"
+
+#include <string>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/system/threading/thread.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+TEST(MpmcQueue, TryPushPop) {
+    MpmcQueue<std::string> queue(3);
+    EXPECT_EQ(4U, queue.Capacity());
+    std::string item;
+    EXPECT_FALSE(queue.TryPop(&item));
+    EXPECT_TRUE(queue.TryPush("a"));
+    EXPECT_TRUE(queue.TryPush("b"));
+    EXPECT_TRUE(queue.TryPush("c"));
+    EXPECT_TRUE(queue.TryPush("d"));
+    EXPECT_FALSE(queue.TryPush("e"));
+    EXPECT_EQ(4U, queue.Size());
+    ASSERT_TRUE(queue.TryPop(&item));
+    EXPECT_EQ("a", item);
+    EXPECT_TRUE(queue.TryPush("e"));
+
+    std::string items[8];
+    EXPECT_EQ(4U, queue.TryPopBatch(items, 8));
+    EXPECT_EQ("b", items[0]);
+    EXPECT_EQ("e", items[3]);
+    EXPECT_TRUE(queue.IsEmpty());
+    EXPECT_EQ(0U, queue.TryPopBatch(items, 8));
+}
+
+TEST(MpmcQueue, PartialBatch) {
+    MpmcQueue<int> queue(16);
+    for (int i = 0; i < 10; ++i)
+        queue.Push(i);
+    int items[4];
+    EXPECT_EQ(4U, queue.PopBatch(items, 4));
+    EXPECT_EQ(3, items[3]);
+    EXPECT_EQ(4U, queue.PopBatch(items, 4));
+    EXPECT_EQ(2U, queue.PopBatch(items, 4));
+    EXPECT_EQ(9, items[1]);
+}
+
+static const int kItemsPerProducer = 100000;
+
+static void Produce(MpmcQueue<int>* queue, int id) {
+    for (int i = 0; i < kItemsPerProducer; ++i)
+        queue->Push(id * kItemsPerProducer + i);
+}
+
+// Pop until got a negative item, batch_size 1 means Pop.
+static void Consume(MpmcQueue<int>* queue, size_t batch_size, std::vector<int>* counts) {
+    std::vector<int> items(batch_size);
+    for (;;) {
+        size_t count = 1;
+        if (batch_size == 1) {
+            queue->Pop(&items[0]);
+        } else {
+            count = queue->PopBatch(&items[0], batch_size);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (items[i] < 0)
+                return;
+            // Items are unique, so no one else touches this slot.
+            ++(*counts)[items[i]];
+        }
+    }
+}
+
+static void TestProducersConsumers(int num_producers, int num_consumers, size_t batch_size) {
+    // Small capacity to block both sides.
+    MpmcQueue<int> queue(64);
+    std::vector<int> counts(num_producers * kItemsPerProducer);
+    std::vector<Thread*> consumers;
+    for (int i = 0; i < num_consumers; ++i) {
+        consumers.push_back(new Thread(std::bind(&Consume, &queue, batch_size, &counts)));
+    }
+    std::vector<Thread*> producers;
+    for (int i = 0; i < num_producers; ++i)
+        producers.push_back(new Thread(std::bind(&Produce, &queue, i)));
+    for (int i = 0; i < num_producers; ++i) {
+        producers[i]->Join();
+        delete producers[i];
+    }
+    // A batch consumer may take several stop items at once.
+    for (int i = 0; i < num_consumers * static_cast<int>(batch_size); ++i)
+        queue.Push(-1);
+    for (int i = 0; i < num_consumers; ++i) {
+        consumers[i]->Join();
+        delete consumers[i];
+    }
+    for (size_t i = 0; i < counts.size(); ++i)
+        ASSERT_EQ(1, counts[i]) << i;
+}
+
+TEST(MpmcQueue, SingleProducerSingleConsumer) {
+    TestProducersConsumers(1, 1, 1);
+}
+
+TEST(MpmcQueue, MultipleProducersConsumers) {
+    TestProducersConsumers(4, 4, 1);
+}
+
+TEST(MpmcQueue, MultipleProducersBatchConsumers) {
+    TestProducersConsumers(4, 3, 16);
+}
+
+} // namespace toft
@@ -0,0 +1,356 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Data parallel algorithms on ThreadPool. A range is cut into chunks of
+// grain_size, which the calling thread and up to all threads of the pool
+// claim one by one. The calling thread takes part and only waits for
+// chunks being run by others, so it's safe to call them in tasks of the same
+// pool, and pool can be NULL to run all chunks in the calling thread.
+//
+// grain_size 0 means about 4 chunks per thread.
+
+#ifndef TOFT_SYSTEM_THREADING_PARALLEL_H
+#define TOFT_SYSTEM_THREADING_PARALLEL_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/base/shared_ptr.h"
+#include "toft/base/uncopyable.h"
+#include "toft/system/atomic/atomic.h"
+#include "toft/system/threading/condition_variable.h"
+#include "toft/system/threading/mutex.h"
+#include "toft/system/threading/thread_pool.h"
+
+namespace toft {
+
+namespace internal {
+
+// Chunks of one parallel call, shared by the calling thread and the tasks.
+template <typename ChunkFunction>
+class ParallelContext {
+    TOFT_DECLARE_UNCOPYABLE(ParallelContext);
+
+public:
+    ParallelContext(int64_t num_chunks, const ChunkFunction& function)
+        : m_function(function), m_num_chunks(num_chunks),
+          m_next_chunk(0), m_num_done_chunks(0), m_cond(&m_mutex) {}
+
+    // Run chunks until no one is left.
+    void Run() {
+        int64_t num_done = 0;
+        for (;;) {
+            int64_t chunk = AtomicExchangeAdd(&m_next_chunk, static_cast<int64_t>(1));
+            if (chunk >= m_num_chunks)
+                break;
+            m_function(chunk);
+            ++num_done;
+        }
+        if (num_done > 0 && AtomicAdd(&m_num_done_chunks, num_done) == m_num_chunks) {
+            MutexLocker locker(&m_mutex);
+            m_cond.Broadcast();
+        }
+    }
+
+    void Wait() {
+        MutexLocker locker(&m_mutex);
+        while (AtomicGet(&m_num_done_chunks) < m_num_chunks)
+            m_cond.Wait();
+    }
+
+    // Tasks may start after the call returned, the context is kept alive
+    // by them.
+    static void RunTask(const std::shared_ptr<ParallelContext>& context) {
+        context->Run();
+    }
+
+private:
+    ChunkFunction m_function;
+    int64_t m_num_chunks;
+    int64_t m_next_chunk;
+    int64_t m_num_done_chunks;
+    Mutex m_mutex;
+    ConditionVariable m_cond;
+};
+
+inline int NumWorkers(ThreadPool* pool) {
+    return pool == NULL ? 1 : static_cast<int>(pool->num_threads()) + 1;
+}
+
+inline int64_t DefaultGrainSize(ThreadPool* pool, int64_t size) {
+    int64_t grain_size = size / (NumWorkers(pool) * 4);
+    return grain_size > 0 ? grain_size : 1;
+}
+
+// Call function(chunk) for every chunk in [0, num_chunks).
+template <typename ChunkFunction>
+void RunChunks(ThreadPool* pool, int64_t num_chunks, const ChunkFunction& function) {
+    if (num_chunks <= 0)
+        return;
+    if (pool == NULL || num_chunks == 1) {
+        for (int64_t i = 0; i < num_chunks; ++i)
+            function(i);
+        return;
+    }
+    typedef ParallelContext<ChunkFunction> Context;
+    std::shared_ptr<Context> context(new Context(num_chunks, function));
+    int64_t num_tasks = std::min<int64_t>(num_chunks - 1, pool->num_threads());
+    for (int64_t i = 0; i < num_tasks; ++i)
+        pool->AddTask(std::bind(&Context::RunTask, context));
+    context->Run();
+    context->Wait();
+}
+
+template <typename RangeFunction>
+struct RangeChunk {
+    RangeChunk(int64_t b, int64_t e, int64_t g, const RangeFunction& f)
+        : begin(b), end(e), grain_size(g), function(f) {}
+    void operator()(int64_t chunk) const {
+        int64_t chunk_begin = begin + chunk * grain_size;
+        function(chunk_begin, std::min(chunk_begin + grain_size, end));
+    }
+    int64_t begin;
+    int64_t end;
+    int64_t grain_size;
+    RangeFunction function;
+};
+
+template <typename Function>
+struct ForEachIndex {
+    explicit ForEachIndex(const Function& f) : function(f) {}
+    void operator()(int64_t begin, int64_t end) const {
+        for (int64_t i = begin; i < end; ++i)
+            function(i);
+    }
+    Function function;
+};
+
+template <typename T, typename MapFunction>
+struct MapRange {
+    MapRange(const MapFunction& f, std::vector<T>* r, int64_t b, int64_t g)
+        : function(f), results(r), begin(b), grain_size(g) {}
+    void operator()(int64_t chunk_begin, int64_t chunk_end) const {
+        (*results)[(chunk_begin - begin) / grain_size] = function(chunk_begin, chunk_end);
+    }
+    MapFunction function;
+    std::vector<T>* results;
+    int64_t begin;
+    int64_t grain_size;
+};
+
+template <typename InputIterator, typename OutputIterator, typename UnaryFunction>
+struct TransformRange {
+    TransformRange(InputIterator i, OutputIterator o, const UnaryFunction& f)
+        : input(i), output(o), function(f) {}
+    void operator()(int64_t begin, int64_t end) const {
+        std::transform(input + begin, input + end, output + begin, function);
+    }
+    InputIterator input;
+    OutputIterator output;
+    UnaryFunction function;
+};
+
+template <typename Iterator, typename Compare>
+struct SortPiece {
+    SortPiece(Iterator f, int64_t s, int64_t p, const Compare& c)
+        : first(f), size(s), piece_size(p), compare(c) {}
+    void operator()(int64_t piece) const {
+        int64_t begin = piece * piece_size;
+        int64_t end = std::min(begin + piece_size, size);
+        std::stable_sort(first + begin, first + end, compare);
+    }
+    Iterator first;
+    int64_t size;
+    int64_t piece_size;
+    Compare compare;
+};
+
+struct MergeTask {
+    int64_t first_begin, first_end;
+    int64_t second_begin, second_end;
+    int64_t output;
+};
+
+template <typename SourceIterator, typename DestIterator, typename Compare>
+struct MergePart {
+    MergePart(const std::vector<MergeTask>* t, SourceIterator s, DestIterator d,
+              const Compare& c)
+        : tasks(t), source(s), dest(d), compare(c) {}
+    // std::merge takes equal elements from the first range first, which keeps
+    // the sort stable.
+    void operator()(int64_t index) const {
+        const MergeTask& task = (*tasks)[index];
+        std::merge(source + task.first_begin, source + task.first_end,
+                   source + task.second_begin, source + task.second_end,
+                   dest + task.output, compare);
+    }
+    const std::vector<MergeTask>* tasks;
+    SourceIterator source;
+    DestIterator dest;
+    Compare compare;
+};
+
+template <typename SourceIterator, typename DestIterator>
+struct CopyRange {
+    CopyRange(SourceIterator s, DestIterator d) : source(s), dest(d) {}
+    void operator()(int64_t begin, int64_t end) const {
+        std::copy(source + begin, source + end, dest + begin);
+    }
+    SourceIterator source;
+    DestIterator dest;
+};
+
+// Merge sorted runs of width in source into runs of 2 * width in dest. Each
+// pair of runs is cut into about num_parts independent merges: the first run
+// is cut evenly, and the second run at the lower bound of the cut element, so
+// elements equal to it go to the right part after those of the first run.
+template <typename SourceIterator, typename DestIterator, typename Compare>
+void MergeRound(ThreadPool* pool, SourceIterator source, DestIterator dest,
+                int64_t size, int64_t width, int num_parts, const Compare& compare) {
+    std::vector<MergeTask> tasks;
+    for (int64_t start = 0; start < size; start += 2 * width) {
+        int64_t middle = std::min(start + width, size);
+        int64_t stop = std::min(start + 2 * width, size);
+        int64_t parts = std::max<int64_t>(1, std::min<int64_t>(num_parts, middle - start));
+        int64_t second_begin = middle;
+        for (int64_t i = 0; i < parts; ++i) {
+            MergeTask task;
+            task.first_begin = start + (middle - start) * i / parts;
+            task.first_end = start + (middle - start) * (i + 1) / parts;
+            task.second_begin = second_begin;
+            if (i + 1 == parts) {
+                task.second_end = stop;
+            } else {
+                task.second_end = std::lower_bound(source + second_begin, source + stop,
+                                                   *(source + task.first_end),
+                                                   compare) - source;
+            }
+            task.output = task.first_begin + (task.second_begin - middle);
+            second_begin = task.second_end;
+            tasks.push_back(task);
+        }
+    }
+    RunChunks(pool, tasks.size(),
+              MergePart<SourceIterator, DestIterator, Compare>(&tasks, source, dest, compare));
+}
+
+} // namespace internal
+
+// Call function(chunk_begin, chunk_end) for every chunk of [begin, end).
+template <typename RangeFunction>
+void ParallelForRange(ThreadPool* pool, int64_t begin, int64_t end,
+                      RangeFunction function, int64_t grain_size = 0) {
+    if (end <= begin)
+        return;
+    if (grain_size <= 0)
+        grain_size = internal::DefaultGrainSize(pool, end - begin);
+    int64_t num_chunks = (end - begin + grain_size - 1) / grain_size;
+    internal::RunChunks(pool, num_chunks,
+                        internal::RangeChunk<RangeFunction>(begin, end, grain_size, function));
+}
+
+// Call function(i) for every i in [begin, end).
+template <typename Function>
+void ParallelFor(ThreadPool* pool, int64_t begin, int64_t end,
+                 Function function, int64_t grain_size = 0) {
+    ParallelForRange(pool, begin, end, internal::ForEachIndex<Function>(function),
+                     grain_size);
+}
+
+// Reduce [begin, end) to map(chunk_begin, chunk_end) of every chunk combined
+// by reduce in order, so reduce needs to be associative but not commutative.
+template <typename T, typename MapFunction, typename ReduceFunction>
+T ParallelReduce(ThreadPool* pool, int64_t begin, int64_t end, const T& identity,
+                 MapFunction map, ReduceFunction reduce,
+                 int64_t grain_size = 0) {
+    if (end <= begin)
+        return identity;
+    if (grain_size <= 0)
+        grain_size = internal::DefaultGrainSize(pool, end - begin);
+    std::vector<T> results((end - begin + grain_size - 1) / grain_size, identity);
+    ParallelForRange(pool, begin, end,
+                     internal::MapRange<T, MapFunction>(map, &results, begin, grain_size),
+                     grain_size);
+    T result = identity;
+    for (size_t i = 0; i < results.size(); ++i)
+        result = reduce(result, results[i]);
+    return result;
+}
+
+// Parallel std::transform of random access iterators, return the end of
+// output.
+template <typename InputIterator, typename OutputIterator, typename UnaryFunction>
+OutputIterator ParallelTransform(ThreadPool* pool,
+                                 InputIterator first, InputIterator last,
+                                 OutputIterator output, UnaryFunction function,
+                                 int64_t grain_size = 0) {
+    int64_t size = last - first;
+    ParallelForRange(
+        pool, 0, size,
+        internal::TransformRange<InputIterator, OutputIterator, UnaryFunction>(
+            first, output, function),
+        grain_size);
+    return output + size;
+}
+
+// Stable merge sort: pieces are stable sorted in parallel, then merged in
+// rounds, each merge cut into independent parts. It takes a buffer as large
+// as the range, the value type must be default constructible. Small ranges
+// and NULL pool fall back to std::stable_sort.
+template <typename RandomIterator, typename Compare>
+void ParallelSort(ThreadPool* pool, RandomIterator first, RandomIterator last,
+                  Compare compare) {
+    typedef typename std::iterator_traits<RandomIterator>::value_type ValueType;
+    typedef typename std::vector<ValueType>::iterator BufferIterator;
+    static const int64_t kMinPieceSize = 4096;
+
+    int64_t size = last - first;
+    int num_workers = internal::NumWorkers(pool);
+    if (num_workers == 1 || size < 2 * kMinPieceSize) {
+        std::stable_sort(first, last, compare);
+        return;
+    }
+
+    int64_t num_pieces = 1;
+    while (num_pieces < 2 * num_workers && size / (num_pieces * 2) >= kMinPieceSize)
+        num_pieces *= 2;
+    int64_t piece_size = (size + num_pieces - 1) / num_pieces;
+    internal::RunChunks(pool, num_pieces,
+                        internal::SortPiece<RandomIterator, Compare>(
+                            first, size, piece_size, compare));
+
+    std::vector<ValueType> buffer(size);
+    bool in_buffer = false;
+    for (int64_t width = piece_size; width < size; width *= 2) {
+        int num_parts = static_cast<int>(std::max<int64_t>(
+                1, 2 * num_workers * width * 2 / size));
+        if (in_buffer) {
+            internal::MergeRound(pool, buffer.begin(), first, size, width,
+                                 num_parts, compare);
+        } else {
+            internal::MergeRound(pool, first, buffer.begin(), size, width,
+                                 num_parts, compare);
+        }
+        in_buffer = !in_buffer;
+    }
+    if (in_buffer) {
+        ParallelForRange(pool, 0, size,
+                         internal::CopyRange<BufferIterator, RandomIterator>(
+                             buffer.begin(), first));
+    }
+}
+
+template <typename RandomIterator>
+void ParallelSort(ThreadPool* pool, RandomIterator first, RandomIterator last) {
+    typedef typename std::iterator_traits<RandomIterator>::value_type ValueType;
+    ParallelSort(pool, first, last, std::less<ValueType>());
+}
+
+} // namespace toft
+
+#endif // TOFT_SYSTEM_THREADING_PARALLEL_H
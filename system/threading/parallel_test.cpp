@@ -0,0 +1,168 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/system/threading/parallel.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "toft/base/random.h"
+#include "toft/system/atomic/atomic.h"
+#include "toft/system/threading/thread_pool.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+struct Increase {
+    explicit Increase(std::vector<int>* v) : values(v) {}
+    void operator()(int64_t i) const {
+        ++(*values)[i];
+    }
+    std::vector<int>* values;
+};
+
+struct CountChunks {
+    explicit CountChunks(int* c) : count(c) {}
+    void operator()(int64_t begin, int64_t end) const {
+        EXPECT_LE(end - begin, 10);
+        AtomicIncrement(count);
+    }
+    int* count;
+};
+
+struct SumRange {
+    explicit SumRange(const std::vector<int>* v) : values(v) {}
+    int64_t operator()(int64_t begin, int64_t end) const {
+        int64_t sum = 0;
+        for (int64_t i = begin; i < end; ++i)
+            sum += (*values)[i];
+        return sum;
+    }
+    const std::vector<int>* values;
+};
+
+struct Concat {
+    std::string operator()(const std::string& a, const std::string& b) const {
+        return a + b;
+    }
+};
+
+struct Letter {
+    std::string operator()(int64_t begin, int64_t end) const {
+        std::string s;
+        for (int64_t i = begin; i < end; ++i)
+            s += static_cast<char>('a' + i % 26);
+        return s;
+    }
+};
+
+static int Square(int x) {
+    return x * x;
+}
+
+static bool LessFirst(const std::pair<int, int>& a, const std::pair<int, int>& b) {
+    return a.first < b.first;
+}
+
+static int64_t Add(int64_t a, int64_t b) {
+    return a + b;
+}
+
+class ParallelTest : public testing::TestWithParam<int> {
+protected:
+    ParallelTest() : m_pool(GetParam() > 0 ? new ThreadPool(GetParam()) : NULL) {}
+    ~ParallelTest() { delete m_pool; }
+    ThreadPool* m_pool;
+};
+
+TEST_P(ParallelTest, For) {
+    std::vector<int> values(100000);
+    ParallelFor(m_pool, 0, values.size(), Increase(&values));
+    ParallelFor(m_pool, 10, 1000, Increase(&values), 7);
+    for (size_t i = 0; i < values.size(); ++i)
+        ASSERT_EQ(i >= 10 && i < 1000 ? 2 : 1, values[i]) << i;
+    ParallelFor(m_pool, 5, 5, Increase(&values));
+}
+
+TEST_P(ParallelTest, GrainSize) {
+    int count = 0;
+    ParallelForRange(m_pool, 0, 1001, CountChunks(&count), 10);
+    EXPECT_EQ(101, count);
+}
+
+TEST_P(ParallelTest, Reduce) {
+    std::vector<int> values(100001);
+    for (size_t i = 0; i < values.size(); ++i)
+        values[i] = i;
+    int64_t sum = ParallelReduce(m_pool, 0, values.size(), static_cast<int64_t>(0),
+                                 SumRange(&values), Add);
+    EXPECT_EQ(100000LL * 100001 / 2, sum);
+    EXPECT_EQ(0, ParallelReduce(m_pool, 0, 0, static_cast<int64_t>(0),
+                                SumRange(&values), Add));
+
+    // Not commutative.
+    std::string letters = ParallelReduce(m_pool, 0, 1000, std::string(), Letter(),
+                                         Concat(), 3);
+    ASSERT_EQ(1000U, letters.size());
+    for (size_t i = 0; i < letters.size(); ++i)
+        ASSERT_EQ('a' + static_cast<int>(i % 26), letters[i]);
+}
+
+TEST_P(ParallelTest, Transform) {
+    std::vector<int> input(50000);
+    for (size_t i = 0; i < input.size(); ++i)
+        input[i] = i % 1000;
+    std::vector<int> output(input.size());
+    EXPECT_TRUE(output.end() == ParallelTransform(m_pool, input.begin(), input.end(),
+                                                  output.begin(), Square));
+    for (size_t i = 0; i < input.size(); ++i)
+        ASSERT_EQ(input[i] * input[i], output[i]);
+}
+
+TEST_P(ParallelTest, Sort) {
+    Random random(1);
+    for (int size = 0; size < 300000; size = size * 3 + 1) {
+        std::vector<int> values(size);
+        for (int i = 0; i < size; ++i)
+            values[i] = random.Next();
+        std::vector<int> expected = values;
+        std::sort(expected.begin(), expected.end());
+        ParallelSort(m_pool, values.begin(), values.end());
+        ASSERT_TRUE(expected == values) << size;
+    }
+}
+
+TEST_P(ParallelTest, SortIsStable) {
+    Random random(2);
+    // Many duplicated keys, cut points of merges fall in runs of them.
+    for (int size = 10000; size < 300000; size = size * 2 + 1) {
+        std::vector<std::pair<int, int> > values(size);
+        for (int i = 0; i < size; ++i)
+            values[i] = std::make_pair(static_cast<int>(random.Uniform(16)), i);
+        std::vector<std::pair<int, int> > expected = values;
+        std::stable_sort(expected.begin(), expected.end(), LessFirst);
+        ParallelSort(m_pool, values.begin(), values.end(), LessFirst);
+        ASSERT_TRUE(expected == values) << size;
+    }
+}
+
+// 0 means NULL pool, run in the calling thread.
+INSTANTIATE_TEST_CASE_P(Threads, ParallelTest, testing::Values(0, 1, 4, 7));
+
+TEST(Parallel, NestedInPool) {
+    ThreadPool pool(2);
+    std::vector<int> values(8000);
+    // Tasks of the pool use the pool, none of them waits for ever.
+    for (int i = 0; i < 8; ++i) {
+        pool.AddTask(std::bind(&ParallelFor<Increase>, &pool, i * 1000, (i + 1) * 1000,
+                               Increase(&values), 10));
+    }
+    pool.WaitForIdle();
+    for (size_t i = 0; i < values.size(); ++i)
+        ASSERT_EQ(1, values[i]);
+}
+
+} // namespace toft
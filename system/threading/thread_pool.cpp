@@ -9,10 +9,13 @@
 
 #include "thirdparty/glog/logging.h"
 
+#include "toft/base/random.h"
 #include "toft/base/scoped_ptr.h"
 #include "toft/base/string/concat.h"
+#include "toft/system/atomic/atomic.h"
 #include "toft/system/info/info.h"
 #include "toft/system/threading/this_thread.h"
+#include "toft/system/threading/work_stealing_deque.h"
 
 namespace toft {
 
@@ -28,7 +31,8 @@ struct ThreadPool::Task {
 
 struct ThreadPool::ThreadContext {
     typedef intrusive_list<ThreadPool::Task> TaskList;
-    ThreadContext() : cond(&mutex), exit(false) {}
+    ThreadContext() : cond(&mutex), exit(false), pool(NULL),
+        num_pending_tasks(0), random(1) {}
     scoped_ptr<Thread> thread;
     mutable Mutex mutex;
     ConditionVariable cond;
@@ -36,9 +40,25 @@ struct ThreadPool::ThreadContext {
     TaskList free_tasks;  // __attribute__((aligned(64)));
     bool exit __attribute__((aligned(64)));
 
+    // Used in kWorkStealing policy only.
+    ThreadPool* pool;
+    // Size of pending_tasks, which are added with dispatch_key and can't be
+    // stolen.
+    int num_pending_tasks;
+    // Tasks added by this thread.
+    WorkStealingDeque<Task*> deque;
+    // To choose victims to steal.
+    Random random;
+
     bool GetPendingTask(TaskList* tasks);
+    Task* PopPendingTask();
 } __attribute__((aligned(64)));  // Make cache alignment.
 
+ThreadPool::ThreadContext*& ThreadPool::CurrentContext() {
+    static __thread ThreadContext* context = NULL;
+    return context;
+}
+
 // Return whether should exit. Note even if return false, the task may be not
 // empty because of remaining tasks before exit was set.
 bool ThreadPool::ThreadContext::GetPendingTask(TaskList* tasks) {
@@ -51,8 +71,11 @@ bool ThreadPool::ThreadContext::GetPendingTask(TaskList* tasks) {
     return !exit;
 }
 
-ThreadPool::ThreadPool(int num_threads):
-    m_num_threads(0), m_num_busy_threads(0), m_exit_cond(&m_exit_lock), m_exit(false) {
+ThreadPool::ThreadPool(int num_threads, SchedulePolicy policy):
+    m_policy(policy), m_num_threads(0), m_next_dispatch_key(0),
+    m_shared_context(NULL), m_num_pending_tasks(0),
+    m_idle_cond(&m_idle_lock), m_num_idle_threads(0),
+    m_num_busy_threads(0), m_exit_cond(&m_exit_lock), m_exit(false) {
     if (num_threads < 0)
         m_num_threads = GetLogicalCpuNumber();
     else if (num_threads == 0)
@@ -61,11 +84,21 @@ ThreadPool::ThreadPool(int num_threads):
         m_num_threads = num_threads;
 
     m_thread_contexts = new ThreadContext[m_num_threads];
+    if (m_policy == kWorkStealing)
+        m_shared_context = new ThreadContext;
     ThreadAttributes attr;
     for (size_t i = 0; i < m_num_threads; ++i) {
         attr.SetName(StringConcat("threadpool/", i));
-        m_thread_contexts[i].thread.reset(
-            new Thread(attr, std::bind(&ThreadPool::WorkRoutine, this, &m_thread_contexts[i])));
+        ThreadContext* context = &m_thread_contexts[i];
+        context->pool = this;
+        context->random.Reset(i + 1);
+        if (m_policy == kWorkStealing) {
+            context->thread.reset(new Thread(
+                    attr, std::bind(&ThreadPool::WorkStealingRoutine, this, context)));
+        } else {
+            context->thread.reset(new Thread(
+                    attr, std::bind(&ThreadPool::WorkRoutine, this, context)));
+        }
     }
     m_num_busy_threads = m_num_threads;
 }
@@ -81,6 +114,20 @@ void ThreadPool::AddTaskInternal(
     int dispatch_key)
 {
     DCHECK(!m_exit);
+    if (m_policy == kWorkStealing) {
+        Task* task = new Task(callback, function);
+        AtomicIncrement(&m_num_pending_tasks);
+        ThreadContext& context = m_thread_contexts[dispatch_key % m_num_threads];
+        {
+            MutexLocker locker(&context.mutex);
+            context.pending_tasks.push_back(task);
+            AtomicIncrement(&context.num_pending_tasks);
+        }
+        // Any idle thread may be waked up, but only the one can run it.
+        WakeUpIdleThread(true);
+        return;
+    }
+
     ThreadContext& context = m_thread_contexts[dispatch_key % m_num_threads];
     {
         Task* task;
@@ -100,15 +147,17 @@ void ThreadPool::AddTaskInternal(
 }
 
 void ThreadPool::AddTask(Closure<void()>* callback) {
+    if (m_policy == kWorkStealing) {
+        AddStealableTask(callback, NULL);
+        return;
+    }
     // The memory address is random enough for load balance, but need
     // remove low alignment part. (The lowest 5 bits of allocated object
     // address are always 0 for 64 bit system).
     unsigned int dispatch_key = reinterpret_cast<uintptr_t>(callback) / 32;
-    AddTask(callback, dispatch_key);
+    AddTaskInternal(callback, NULL, dispatch_key);
 }
 
-int rdtsc() { return 0; }
-
 void ThreadPool::AddTask(Closure<void ()>* callback, int dispatch_key)
 {
     AddTaskInternal(callback, NULL, dispatch_key);
@@ -116,7 +165,13 @@ void ThreadPool::AddTask(Closure<void ()>* callback, int dispatch_key)
 
 void ThreadPool::AddTask(const std::function<void ()>& callback)
 {
-    AddTask(callback, rdtsc());
+    if (m_policy == kWorkStealing) {
+        AddStealableTask(NULL, callback);
+        return;
+    }
+    // Spread tasks over threads in turn.
+    unsigned int dispatch_key = AtomicIncrement(&m_next_dispatch_key);
+    AddTaskInternal(NULL, callback, dispatch_key);
 }
 
 void ThreadPool::AddTask(const std::function<void ()>& callback, int dispatch_key)
@@ -155,7 +210,134 @@ void ThreadPool::WorkRoutine(ThreadContext* context) {
         m_exit_cond.Signal();
 }
 
+void ThreadPool::AddStealableTask(
+    Closure<void()>* callback,
+    const std::function<void()>& function)
+{
+    ThreadContext* context = CurrentContext();
+    bool in_pool = context != NULL && context->pool == this;
+    // Running tasks can still add subtasks when terminating.
+    DCHECK(!m_exit || in_pool);
+    Task* task = new Task(callback, function);
+    AtomicIncrement(&m_num_pending_tasks);
+    if (in_pool) {
+        context->deque.Push(task);
+    } else {
+        MutexLocker locker(&m_shared_context->mutex);
+        m_shared_context->pending_tasks.push_back(task);
+        AtomicIncrement(&m_shared_context->num_pending_tasks);
+    }
+    WakeUpIdleThread(false);
+}
+
+void ThreadPool::WakeUpIdleThread(bool all) {
+    // Pairs with the barrier in WorkStealingRoutine, either the idle thread
+    // finds the task, or it's counted in m_num_idle_threads here.
+    __sync_synchronize();
+    if (AtomicGet(&m_num_idle_threads) == 0)
+        return;
+    MutexLocker locker(&m_idle_lock);
+    if (all) {
+        m_idle_cond.Broadcast();
+    } else {
+        m_idle_cond.Signal();
+    }
+}
+
+void ThreadPool::RunTask(Task* task) {
+    if (task->callback) {
+        task->callback->Run();
+    } else {
+        task->function();
+    }
+    delete task;
+    AtomicDecrement(&m_num_pending_tasks);
+}
+
+// Pop the first task of pending_tasks, or NULL if it's empty.
+ThreadPool::Task* ThreadPool::ThreadContext::PopPendingTask() {
+    if (AtomicGet(&num_pending_tasks) == 0)
+        return NULL;
+    MutexLocker locker(&mutex);
+    if (pending_tasks.empty())
+        return NULL;
+    Task* task = &pending_tasks.front();
+    pending_tasks.pop_front();
+    AtomicDecrement(&num_pending_tasks);
+    return task;
+}
+
+ThreadPool::Task* ThreadPool::FindTask(ThreadContext* context) {
+    Task* task = context->PopPendingTask();
+    if (task != NULL)
+        return task;
+    if (context->deque.Pop(&task))
+        return task;
+    task = m_shared_context->PopPendingTask();
+    if (task != NULL)
+        return task;
+    return StealTask(context);
+}
+
+ThreadPool::Task* ThreadPool::StealTask(ThreadContext* context) {
+    Task* task = NULL;
+    // Try random victims, then all of them in turn before giving up.
+    for (size_t i = 0; i < m_num_threads; ++i) {
+        ThreadContext* victim = &m_thread_contexts[context->random.Uniform(m_num_threads)];
+        if (victim != context && victim->deque.Steal(&task))
+            return task;
+    }
+    for (size_t i = 0; i < m_num_threads; ++i) {
+        ThreadContext* victim = &m_thread_contexts[i];
+        while (victim != context && !victim->deque.IsEmpty()) {
+            if (victim->deque.Steal(&task))
+                return task;
+        }
+    }
+    return NULL;
+}
+
+void ThreadPool::WorkStealingRoutine(ThreadContext* context) {
+    CurrentContext() = context;
+    for (;;) {
+        Task* task = FindTask(context);
+        if (task != NULL) {
+            RunTask(task);
+            continue;
+        }
+
+        {
+            MutexLocker locker(&m_idle_lock);
+            AtomicIncrement(&m_num_idle_threads);
+            // Check again after counted as idle, pairs with WakeUpIdleThread.
+            __sync_synchronize();
+            task = FindTask(context);
+            if (task == NULL) {
+                if (!m_exit) {
+                    m_idle_cond.Wait();
+                } else if (AtomicGet(&m_num_pending_tasks) > 0) {
+                    // Running tasks may still add subtasks.
+                    m_idle_cond.TimedWait(1);
+                }
+            }
+            AtomicDecrement(&m_num_idle_threads);
+        }
+        if (task != NULL) {
+            RunTask(task);
+        } else if (m_exit && AtomicGet(&m_num_pending_tasks) == 0) {
+            break;
+        }
+    }
+    CurrentContext() = NULL;
+
+    MutexLocker locker(&m_exit_lock);
+    if (--m_num_busy_threads == 0)
+        m_exit_cond.Signal();
+}
+
 bool ThreadPool::AnyTaskPending() const {
+    if (m_policy == kWorkStealing)
+        return AtomicGet(&m_num_pending_tasks) > 0;
     for (size_t i = 0; i < m_num_threads; ++i) {
         MutexLocker locker(&m_thread_contexts[i].mutex);
         if (!m_thread_contexts[i].pending_tasks.empty())
@@ -179,6 +361,10 @@ void ThreadPool::Terminate() {
         return;
 
     m_exit = true;
+    if (m_policy == kWorkStealing) {
+        MutexLocker locker(&m_idle_lock);
+        m_idle_cond.Broadcast();
+    }
     for (size_t i = 0; i < m_num_threads; ++i) {
         MutexLocker locker(&m_thread_contexts[i].mutex);
         m_thread_contexts[i].exit = true;
@@ -192,6 +378,8 @@ void ThreadPool::Terminate() {
 
     delete[] m_thread_contexts;
     m_thread_contexts = NULL;
+    delete m_shared_context;
+    m_shared_context = NULL;
     m_num_threads = 0;
 }
 
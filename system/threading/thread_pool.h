@@ -19,17 +19,33 @@ namespace toft {
 
 class ThreadPool {
 public:
+    enum SchedulePolicy {
+        // Every task is dispatched to one thread and stays there.
+        kDispatchByKey,
+        // Tasks added without dispatch_key go to the deque of the adding
+        // worker, or a shared queue if added outside the pool, and idle
+        // threads steal from random busy ones. It suits tasks of skewed cost
+        // and tasks which add subtasks.
+        kWorkStealing
+    };
+
     /// @param mun_threads number of threads, -1 means cpu number
-    explicit ThreadPool(int num_threads = -1);
+    explicit ThreadPool(int num_threads = -1,
+                        SchedulePolicy policy = kDispatchByKey);
     ~ThreadPool();
 
 
     void AddTask(Closure<void ()>* callback);
     void AddTask(const std::function<void ()>& callback);
 
+    /// Tasks of the same dispatch_key always run on the same thread, in both
+    /// policies.
     void AddTask(Closure<void ()>* callback, int dispatch_key);
     void AddTask(const std::function<void ()>& callback, int dispatch_key);
 
+    SchedulePolicy schedule_policy() const { return m_policy; }
+    size_t num_threads() const { return m_num_threads; }
+
     void WaitForIdle();
     void Terminate();
 
@@ -45,9 +61,33 @@ private:
     void WorkRoutine(ThreadContext* thread);
     bool AnyThreadRunning() const;
 
+    // Work stealing policy.
+    static ThreadContext*& CurrentContext();
+    void AddStealableTask(Closure<void ()>* callback,
+                          const std::function<void ()>& function);
+    void WorkStealingRoutine(ThreadContext* context);
+    Task* FindTask(ThreadContext* context);
+    Task* StealTask(ThreadContext* context);
+    void WakeUpIdleThread(bool all);
+    void RunTask(Task* task);
+
 private:
+    SchedulePolicy m_policy;
     ThreadContext* m_thread_contexts;
     size_t m_num_threads;
+    // Round robin key of std::function tasks in kDispatchByKey policy
+    unsigned int m_next_dispatch_key;
+
+    // Tasks added outside of the pool are queued in its pending_tasks, in
+    // kWorkStealing policy.
+    ThreadContext* m_shared_context;
+    // Added but not finished tasks in kWorkStealing policy.
+    int m_num_pending_tasks;
+    // Idle threads wait on m_idle_cond.
+    Mutex m_idle_lock;
+    ConditionVariable m_idle_cond;
+    int m_num_idle_threads;
+
     size_t m_num_busy_threads;
     Mutex m_exit_lock;
     ConditionVariable m_exit_cond;
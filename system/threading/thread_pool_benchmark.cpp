@@ -0,0 +1,80 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Compare the kDispatchByKey and kWorkStealing policies of ThreadPool, the
+// range is the number of threads.
+// Skewed: tasks are added from outside of the pool, one in 16 tasks costs
+// 64 times of the others.
+// ForkJoin: one task splits the work recursively into two subtasks from
+// inside of the pool, until one item per task.
+
+#include "toft/base/benchmark.h"
+#include "toft/base/functional.h"
+#include "toft/base/random.h"
+#include "toft/system/threading/thread_pool.h"
+
+namespace toft {
+
+static const int kBaseWork = 256;
+
+static void Spin(int work) {
+    volatile int sum = 0;
+    for (int i = 0; i < work; ++i)
+        sum += i;
+}
+
+static void Skewed(int n, int num_threads, ThreadPool::SchedulePolicy policy) {
+    StopBenchmarkTiming();
+    ThreadPool* threadpool = new ThreadPool(num_threads, policy);
+    Random random(num_threads);
+    StartBenchmarkTiming();
+    for (int i = 0; i < n; ++i) {
+        int work = random.OneIn(16) ? kBaseWork * 64 : kBaseWork;
+        threadpool->AddTask(std::bind(Spin, work));
+    }
+    // Wait for all tasks to finish.
+    delete threadpool;
+    SetBenchmarkItemsProcessed(n);
+}
+
+static void Split(ThreadPool* threadpool, int begin, int end) {
+    while (end - begin > 1) {
+        int middle = begin + (end - begin) / 2;
+        threadpool->AddTask(std::bind(Split, threadpool, middle, end));
+        end = middle;
+    }
+    Spin(kBaseWork);
+}
+
+static void ForkJoin(int n, int num_threads, ThreadPool::SchedulePolicy policy) {
+    StopBenchmarkTiming();
+    ThreadPool* threadpool = new ThreadPool(num_threads, policy);
+    StartBenchmarkTiming();
+    threadpool->AddTask(std::bind(Split, threadpool, 0, n));
+    threadpool->WaitForIdle();
+    delete threadpool;
+    SetBenchmarkItemsProcessed(n);
+}
+
+static void DispatchByKeySkewed(int n, int num_threads) {
+    Skewed(n, num_threads, ThreadPool::kDispatchByKey);
+}
+
+static void WorkStealingSkewed(int n, int num_threads) {
+    Skewed(n, num_threads, ThreadPool::kWorkStealing);
+}
+
+static void DispatchByKeyForkJoin(int n, int num_threads) {
+    ForkJoin(n, num_threads, ThreadPool::kDispatchByKey);
+}
+
+static void WorkStealingForkJoin(int n, int num_threads) {
+    ForkJoin(n, num_threads, ThreadPool::kWorkStealing);
+}
+
+TOFT_BENCHMARK_RANGE(DispatchByKeySkewed, 1, 16)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(WorkStealingSkewed, 1, 16)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(DispatchByKeyForkJoin, 1, 16)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(WorkStealingForkJoin, 1, 16)->ThreadRange(1, 1);
+
+}  // namespace toft
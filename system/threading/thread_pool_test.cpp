@@ -177,6 +177,78 @@ TEST(ThreadPool, SlowAddLatency)
     LatencyTest(100, true);
 }
 
+static void CountDown(int* count)
+{
+    AtomicDecrement(count);
+}
+
+TEST(ThreadPool, WorkStealing)
+{
+    int count = 10000;
+    {
+        ThreadPool threadpool(4, ThreadPool::kWorkStealing);
+        Foo foo;
+        for (int i = 0; i < 5000; ++i) {
+            threadpool.AddTask(std::bind(CountDown, &count));
+            threadpool.AddTask(NewClosure(CountDown, &count));
+        }
+        threadpool.AddTask(NewClosure(&foo, &Foo::test1));
+        threadpool.WaitForIdle();
+        EXPECT_EQ(0, count);
+    }
+}
+
+// Add two subtasks until depth reaches 0, from inside of the pool.
+static void Fork(ThreadPool* threadpool, int depth, int* count)
+{
+    AtomicIncrement(count);
+    if (depth == 0)
+        return;
+    threadpool->AddTask(std::bind(Fork, threadpool, depth - 1, count));
+    threadpool->AddTask(std::bind(Fork, threadpool, depth - 1, count));
+}
+
+TEST(ThreadPool, WorkStealingForkJoin)
+{
+    int count = 0;
+    {
+        ThreadPool threadpool(4, ThreadPool::kWorkStealing);
+        threadpool.AddTask(std::bind(Fork, &threadpool, 12, &count));
+        threadpool.WaitForIdle();
+        EXPECT_EQ((1 << 13) - 1, count);
+        // Subtasks can still be added when terminating.
+        threadpool.AddTask(std::bind(Fork, &threadpool, 12, &count));
+    }
+    EXPECT_EQ((1 << 14) - 2, count);
+}
+
+static void RecordThread(int* thread_id)
+{
+    int id = ThisThread::GetId();
+    if (!AtomicCompareExchange(thread_id, 0, id))
+        EXPECT_EQ(id, AtomicGet(thread_id));
+}
+
+TEST(ThreadPool, WorkStealingDispatchKey)
+{
+    int thread_ids[4] = {0};
+    ThreadPool threadpool(4, ThreadPool::kWorkStealing);
+    for (int i = 0; i < 1000; ++i) {
+        threadpool.AddTask(std::bind(RecordThread, &thread_ids[i % 4]), i % 4);
+        threadpool.AddTask(DoNothong);
+    }
+    threadpool.WaitForIdle();
+}
+
+TEST(ThreadPool, WorkStealingTerminate)
+{
+    ThreadPool threadpool(-1, ThreadPool::kWorkStealing);
+    for (int i = 0; i < 10000; ++i)
+        threadpool.AddTask(DoNothong);
+    threadpool.Terminate();
+    threadpool.Terminate();
+}
+
 TEST(ThreadPool, CreateDestroyPerformance)
 {
     for (int i = 0; i < 100; ++i)
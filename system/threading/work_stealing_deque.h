@@ -0,0 +1,157 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Lock-free work stealing deque of Chase and Lev, "Dynamic Circular
+// Work-Stealing Deque", SPAA 2005, with the memory orders of Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP 2013.
+
+#ifndef TOFT_SYSTEM_THREADING_WORK_STEALING_DEQUE_H
+#define TOFT_SYSTEM_THREADING_WORK_STEALING_DEQUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "toft/base/uncopyable.h"
+
+namespace toft {
+
+// The owner thread pushes and pops at the bottom, like a stack, while any
+// other thread can steal from the top. T must be a pointer or integer type.
+template <typename T>
+class WorkStealingDeque {
+    TOFT_DECLARE_UNCOPYABLE(WorkStealingDeque);
+
+public:
+    explicit WorkStealingDeque(int initial_capacity = 256)
+        : m_top(0), m_bottom(0) {
+        int capacity = 1;
+        while (capacity < initial_capacity)
+            capacity <<= 1;
+        m_array = new Array(capacity);
+    }
+
+    ~WorkStealingDeque() {
+        delete m_array;
+        for (size_t i = 0; i < m_retired_arrays.size(); ++i)
+            delete m_retired_arrays[i];
+    }
+
+    // Owner only.
+    void Push(T item) {
+        int64_t bottom = m_bottom;
+        int64_t top = LoadAcquire(&m_top);
+        Array* array = m_array;
+        if (bottom - top > array->mask) {
+            array = Grow(array, top, bottom);
+        }
+        array->Put(bottom, item);
+        StoreRelease(&m_bottom, bottom + 1);
+    }
+
+    // Owner only, return false if empty.
+    bool Pop(T* item) {
+        int64_t bottom = m_bottom - 1;
+        Array* array = m_array;
+        m_bottom = bottom;
+        __sync_synchronize();
+        int64_t top = m_top;
+        if (top > bottom) {
+            m_bottom = bottom + 1;
+            return false;
+        }
+        *item = array->Get(bottom);
+        if (top == bottom) {
+            // The last one, race with thieves.
+            bool won = __sync_bool_compare_and_swap(&m_top, top, top + 1);
+            m_bottom = bottom + 1;
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread, return false if empty or lost the race with others.
+    bool Steal(T* item) {
+        int64_t top = LoadAcquire(&m_top);
+        __sync_synchronize();
+        int64_t bottom = LoadAcquire(&m_bottom);
+        if (top >= bottom)
+            return false;
+        Array* array = LoadAcquire(&m_array);
+        *item = array->Get(top);
+        return __sync_bool_compare_and_swap(&m_top, top, top + 1);
+    }
+
+    // Approximate number of items, exact only in the owner when no thief is
+    // stealing.
+    int64_t Size() const {
+        int64_t size = LoadAcquire(&m_bottom) - LoadAcquire(&m_top);
+        return size > 0 ? size : 0;
+    }
+
+    bool IsEmpty() const {
+        return Size() == 0;
+    }
+
+private:
+    struct Array {
+        explicit Array(int64_t capacity)
+            : mask(capacity - 1), items(new T[capacity]) {}
+        ~Array() {
+            delete[] items;
+        }
+        T Get(int64_t index) const {
+            return const_cast<const volatile T&>(items[index & mask]);
+        }
+        void Put(int64_t index, T item) {
+            const_cast<volatile T&>(items[index & mask]) = item;
+        }
+
+        int64_t mask;
+        T* items;
+    };
+
+    // x86 doesn't reorder loads with loads or stores with stores, only the
+    // compiler need to be stopped.
+    static void AcquireReleaseBarrier() {
+#if defined(__i386__) || defined(__x86_64__)
+        __asm__ __volatile__("" ::: "memory");  // NOLINT
+#else
+        __sync_synchronize();
+#endif
+    }
+
+    template <typename U>
+    static U LoadAcquire(const volatile U* p) {
+        U value = *p;
+        AcquireReleaseBarrier();
+        return value;
+    }
+
+    template <typename U>
+    static void StoreRelease(volatile U* p, U value) {
+        AcquireReleaseBarrier();
+        *p = value;
+    }
+
+    // Thieves may still be reading the old array, so it's kept until the
+    // deque is destroyed.
+    Array* Grow(Array* array, int64_t top, int64_t bottom) {
+        Array* new_array = new Array((array->mask + 1) * 2);
+        for (int64_t i = top; i < bottom; ++i)
+            new_array->Put(i, array->Get(i));
+        m_retired_arrays.push_back(array);
+        StoreRelease(&m_array, new_array);
+        return new_array;
+    }
+
+    volatile int64_t m_top __attribute__((aligned(64)));
+    volatile int64_t m_bottom __attribute__((aligned(64)));
+    Array* volatile m_array;
+    std::vector<Array*> m_retired_arrays;
+};
+
+} // namespace toft
+
+#endif // TOFT_SYSTEM_THREADING_WORK_STEALING_DEQUE_H
@@ -0,0 +1,76 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/system/threading/work_stealing_deque.h"
+
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/system/atomic/atomic.h"
+#include "toft/system/threading/thread.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+TEST(WorkStealingDeque, PushPop) {
+    WorkStealingDeque<intptr_t> deque(2);
+    intptr_t item;
+    EXPECT_FALSE(deque.Pop(&item));
+    EXPECT_FALSE(deque.Steal(&item));
+    for (intptr_t i = 0; i < 100; ++i)
+        deque.Push(i);
+    EXPECT_EQ(100, deque.Size());
+    // Owner pops the newest, thieves steal the oldest.
+    ASSERT_TRUE(deque.Pop(&item));
+    EXPECT_EQ(99, item);
+    ASSERT_TRUE(deque.Steal(&item));
+    EXPECT_EQ(0, item);
+    for (intptr_t i = 98; i >= 1; --i) {
+        ASSERT_TRUE(deque.Pop(&item));
+        EXPECT_EQ(i, item);
+    }
+    EXPECT_FALSE(deque.Pop(&item));
+    EXPECT_TRUE(deque.IsEmpty());
+}
+
+static const int kNumItems = 200000;
+
+static void Steal(WorkStealingDeque<intptr_t>* deque, const volatile bool* done,
+                  std::vector<int>* seen) {
+    intptr_t item;
+    while (!*done || !deque->IsEmpty()) {
+        if (deque->Steal(&item))
+            AtomicIncrement(&(*seen)[item]);
+    }
+}
+
+TEST(WorkStealingDeque, ConcurrentSteal) {
+    WorkStealingDeque<intptr_t> deque(16);
+    std::vector<int> seen(kNumItems);
+    volatile bool done = false;
+    std::vector<Thread*> thieves;
+    for (int i = 0; i < 4; ++i) {
+        thieves.push_back(new Thread(
+                std::bind(&Steal, &deque, const_cast<const volatile bool*>(&done), &seen)));
+    }
+    intptr_t item;
+    for (intptr_t i = 0; i < kNumItems; ++i) {
+        deque.Push(i);
+        // The owner takes some back, racing with thieves on the last one.
+        if (i % 3 == 0 && deque.Pop(&item))
+            AtomicIncrement(&seen[item]);
+    }
+    while (deque.Pop(&item))
+        AtomicIncrement(&seen[item]);
+    done = true;
+    for (size_t i = 0; i < thieves.size(); ++i) {
+        thieves[i]->Join();
+        delete thieves[i];
+    }
+    // Every item is taken exactly once.
+    for (int i = 0; i < kNumItems; ++i)
+        ASSERT_EQ(1, seen[i]) << i;
+}
+
+} // namespace toft
@@ -0,0 +1,150 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/system/timer/timer_wheel.h"
+#include "thirdparty/glog/logging.h"
+
+namespace toft {
+
+WheelTimer::WheelTimer(TimerWheel* wheel, const Callback& callback)
+    : m_wheel(wheel), m_callback(callback), m_expire_tick(0) {
+}
+
+WheelTimer::~WheelTimer() {
+    Stop();
+}
+
+void WheelTimer::Start(int64_t after_ms) {
+    m_wheel->Start(this, after_ms);
+}
+
+void WheelTimer::Stop() {
+    // The wheel may have gone.
+    if (IsActive())
+        m_wheel->Stop(this);
+}
+
+TimerWheel::TimerWheel(EventDispatcher* dispatcher, int64_t tick_ms)
+    : m_dispatcher(dispatcher),
+      m_tick_ms(tick_ms),
+      m_current_tick(0),
+      m_timer_count(0),
+      m_watcher(dispatcher, std::bind(&TimerWheel::OnTick, this, std::placeholders::_1),
+                tick_ms, tick_ms) {
+    CHECK_GT(tick_ms, 0);
+}
+
+TimerWheel::~TimerWheel() {
+    for (size_t i = 0; i < kRootSize; ++i)
+        m_root[i].clear();
+    for (int level = 0; level < kLevelCount; ++level) {
+        for (size_t i = 0; i < kLevelSize; ++i)
+            m_levels[level][i].clear();
+    }
+}
+
+int64_t TimerWheel::NowMilliSeconds() const {
+    return m_dispatcher->NowMilliSeconds();
+}
+
+void TimerWheel::Start(WheelTimer* timer, int64_t after_ms) {
+    int64_t now = NowMilliSeconds();
+    bool idle = m_timer_count == 0;
+    if (idle) {
+        // Ticks are not run when idle, catch up.
+        uint64_t now_tick = now / m_tick_ms;
+        if (now_tick > m_current_tick)
+            m_current_tick = now_tick;
+    }
+    if (after_ms < 0)
+        after_ms = 0;
+    // The first tick at or after the deadline.
+    uint64_t expire_tick = (now + after_ms + m_tick_ms - 1) / m_tick_ms;
+    if (timer->IsActive()) {
+        // Deadlines of connections are pushed back again and again, mostly
+        // within the same tick.
+        if (expire_tick == timer->m_expire_tick)
+            return;
+        timer->m_link.unlink();
+    } else {
+        if (idle)
+            m_watcher.Start();
+        ++m_timer_count;
+    }
+    timer->m_expire_tick = expire_tick;
+    Place(timer);
+}
+
+void TimerWheel::Stop(WheelTimer* timer) {
+    timer->m_link.unlink();
+    if (--m_timer_count == 0)
+        m_watcher.Stop();
+}
+
+void TimerWheel::Place(WheelTimer* timer) {
+    uint64_t expire = timer->m_expire_tick;
+    if (expire < m_current_tick) {
+        m_root[m_current_tick & (kRootSize - 1)].push_back(timer);
+        return;
+    }
+    uint64_t delta = expire - m_current_tick;
+    if (delta < kRootSize) {
+        m_root[expire & (kRootSize - 1)].push_back(timer);
+        return;
+    }
+    int level = 0;
+    for (; level < kLevelCount - 1; ++level) {
+        if (delta < (1ULL << (kRootBits + (level + 1) * kLevelBits)))
+            break;
+    }
+    if (level == kLevelCount - 1) {
+        uint64_t max_delta = (1ULL << (kRootBits + kLevelCount * kLevelBits)) - 1;
+        if (delta > max_delta) {
+            expire = m_current_tick + max_delta;
+            timer->m_expire_tick = expire;
+        }
+    }
+    size_t index = (expire >> (kRootBits + level * kLevelBits)) & (kLevelSize - 1);
+    m_levels[level][index].push_back(timer);
+}
+
+void TimerWheel::Cascade(int level, size_t index) {
+    TimerList timers;
+    timers.splice(m_levels[level][index]);
+    while (!timers.empty()) {
+        WheelTimer* timer = &timers.front();
+        timers.pop_front();
+        Place(timer);
+    }
+}
+
+void TimerWheel::OnTick(int event_mask) {
+    uint64_t now_tick = NowMilliSeconds() / m_tick_ms;
+    while (m_current_tick <= now_tick && m_timer_count > 0) {
+        size_t index = m_current_tick & (kRootSize - 1);
+        if (index == 0) {
+            for (int level = 0; level < kLevelCount; ++level) {
+                size_t level_index = (m_current_tick >> (kRootBits + level * kLevelBits)) &
+                    (kLevelSize - 1);
+                Cascade(level, level_index);
+                if (level_index != 0)
+                    break;
+            }
+        }
+        ++m_current_tick;
+
+        // Timers may be started or stopped in callbacks.
+        TimerList expired;
+        expired.splice(m_root[index]);
+        while (!expired.empty()) {
+            WheelTimer* timer = &expired.front();
+            expired.pop_front();
+            --m_timer_count;
+            timer->m_callback();
+        }
+    }
+    if (m_timer_count == 0)
+        m_watcher.Stop();
+}
+
+} // namespace toft
@@ -0,0 +1,105 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#ifndef TOFT_SYSTEM_TIMER_TIMER_WHEEL_H
+#define TOFT_SYSTEM_TIMER_TIMER_WHEEL_H
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "toft/base/functional.h"
+#include "toft/base/intrusive_list.h"
+#include "toft/base/uncopyable.h"
+#include "toft/system/event_dispatcher/event_dispatcher.h"
+
+namespace toft {
+
+class TimerWheel;
+
+// A timer on a TimerWheel. It is cheap to be embedded in objects such as
+// connections, and to be started again and again.
+class WheelTimer {
+    TOFT_DECLARE_UNCOPYABLE(WheelTimer);
+    friend class TimerWheel;
+
+public:
+    typedef std::function<void ()> Callback;
+
+    WheelTimer(TimerWheel* wheel, const Callback& callback);
+    ~WheelTimer();
+
+    // Fire after after_ms, an active timer is restarted.
+    void Start(int64_t after_ms);
+    void Stop();
+    // A timer is not active in its callback, unless started again there.
+    bool IsActive() const { return m_link.is_linked(); }
+
+private:
+    TimerWheel* m_wheel;
+    Callback m_callback;
+    uint64_t m_expire_tick;
+    list_node m_link;
+};
+
+// Hierarchical timing wheel running in an EventDispatcher, for huge numbers
+// of timers which are started, stopped and restarted all the time, such as
+// deadlines of connections. Starting and stopping a timer take O(1), while
+// a TimerEventWatcher costs O(log n) in the heap of libev.
+//
+// Timers fire in the loop thread at the first tick after their deadlines.
+// Like timers of libev, deadlines count from the cached time of the loop,
+// the time the current iteration started, without reading the clock. The
+// first level has 256 slots of a tick, and each of the 4 upper levels has 64
+// slots of the span of the level below. Timers move down a level when the
+// level below wraps around, like the timers of the Linux kernel. Deadlines
+// later than 2^32 ticks are capped.
+//
+// The wheel ticks only when there are active timers.
+class TimerWheel {
+    TOFT_DECLARE_UNCOPYABLE(TimerWheel);
+    friend class WheelTimer;
+
+public:
+    explicit TimerWheel(EventDispatcher* dispatcher, int64_t tick_ms = 10);
+    // Active timers are stopped.
+    virtual ~TimerWheel();
+
+    EventDispatcher* Dispatcher() const { return m_dispatcher; }
+    int64_t TickMilliSeconds() const { return m_tick_ms; }
+    size_t TimerCount() const { return m_timer_count; }
+
+protected:
+    // Cached time of the dispatcher, overridden in tests.
+    virtual int64_t NowMilliSeconds() const;
+
+private:
+    static const int kRootBits = 8;
+    static const int kLevelBits = 6;
+    static const int kLevelCount = 4;
+    static const size_t kRootSize = 1 << kRootBits;
+    static const size_t kLevelSize = 1 << kLevelBits;
+
+    typedef intrusive_list<WheelTimer, &WheelTimer::m_link> TimerList;
+
+    void Start(WheelTimer* timer, int64_t after_ms);
+    void Stop(WheelTimer* timer);
+    // Put timer into the slot of its expire tick.
+    void Place(WheelTimer* timer);
+    // Move timers of a slot of an upper level down.
+    void Cascade(int level, size_t index);
+    void OnTick(int event_mask);
+
+private:
+    EventDispatcher* m_dispatcher;
+    int64_t m_tick_ms;
+    // The next tick to run.
+    uint64_t m_current_tick;
+    size_t m_timer_count;
+    TimerList m_root[kRootSize];
+    TimerList m_levels[kLevelCount][kLevelSize];
+    TimerEventWatcher m_watcher;
+};
+
+} // namespace toft
+
+#endif // TOFT_SYSTEM_TIMER_TIMER_WHEEL_H
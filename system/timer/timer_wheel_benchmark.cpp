@@ -0,0 +1,150 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+//
+// Cost of restarting and of stopping then starting a timer, picked at random
+// among a number of active timers with random deadlines within a minute, on
+// TimerWheel against TimerEventWatcher. PushBack pushes back deadlines of the
+// same timeout in turn, like connections do on every request. The range is
+// the number of active timers, up to a million.
+
+#include <vector>
+
+#include "toft/base/benchmark.h"
+#include "toft/base/functional.h"
+#include "toft/base/random.h"
+#include "toft/system/event_dispatcher/event_dispatcher.h"
+#include "toft/system/timer/timer_wheel.h"
+
+namespace toft {
+
+static const int kMaxAfterMs = 60000;
+
+static void Nothing() {}
+static void NothingMask(int event_mask) {}
+
+// Active timers are kept between runs of the same range, creating a million
+// timers takes much longer than the runs.
+class WheelTimers {
+public:
+    WheelTimers() : m_wheel(&m_dispatcher, 10), m_random(1) {}
+    ~WheelTimers() { Resize(0); }
+
+    void Resize(size_t size) {
+        while (m_timers.size() > size) {
+            delete m_timers.back();
+            m_timers.pop_back();
+        }
+        while (m_timers.size() < size) {
+            WheelTimer* timer = new WheelTimer(&m_wheel, std::bind(&Nothing));
+            timer->Start(m_random.Uniform(kMaxAfterMs));
+            m_timers.push_back(timer);
+        }
+    }
+    void Restart(int n) {
+        for (int i = 0; i < n; ++i) {
+            WheelTimer* timer = m_timers[m_random.Uniform(m_timers.size())];
+            timer->Start(m_random.Uniform(kMaxAfterMs));
+        }
+    }
+    void StopStart(int n) {
+        for (int i = 0; i < n; ++i) {
+            WheelTimer* timer = m_timers[m_random.Uniform(m_timers.size())];
+            timer->Stop();
+            timer->Start(m_random.Uniform(kMaxAfterMs));
+        }
+    }
+    void PushBack(int n) {
+        for (int i = 0; i < n; ++i)
+            m_timers[i % m_timers.size()]->Start(kMaxAfterMs);
+    }
+
+private:
+    EventDispatcher m_dispatcher;
+    TimerWheel m_wheel;
+    Random m_random;
+    std::vector<WheelTimer*> m_timers;
+};
+
+class WatcherTimers {
+public:
+    WatcherTimers() : m_random(1) {}
+    ~WatcherTimers() { Resize(0); }
+
+    void Resize(size_t size) {
+        while (m_timers.size() > size) {
+            delete m_timers.back();
+            m_timers.pop_back();
+        }
+        while (m_timers.size() < size) {
+            TimerEventWatcher* timer = new TimerEventWatcher(
+                &m_dispatcher, std::bind(&NothingMask, std::placeholders::_1),
+                m_random.Uniform(kMaxAfterMs));
+            timer->Start();
+            m_timers.push_back(timer);
+        }
+    }
+    void Restart(int n) {
+        for (int i = 0; i < n; ++i) {
+            TimerEventWatcher* timer = m_timers[m_random.Uniform(m_timers.size())];
+            timer->Set(m_random.Uniform(kMaxAfterMs));
+        }
+    }
+    void StopStart(int n) {
+        for (int i = 0; i < n; ++i) {
+            TimerEventWatcher* timer = m_timers[m_random.Uniform(m_timers.size())];
+            timer->Stop();
+            timer->Set(m_random.Uniform(kMaxAfterMs));
+        }
+    }
+    void PushBack(int n) {
+        for (int i = 0; i < n; ++i)
+            m_timers[i % m_timers.size()]->Set(kMaxAfterMs);
+    }
+
+private:
+    EventDispatcher m_dispatcher;
+    Random m_random;
+    std::vector<TimerEventWatcher*> m_timers;
+};
+
+template <typename Timers>
+static Timers* GetTimers(int size) {
+    StopBenchmarkTiming();
+    static Timers* timers = new Timers();
+    timers->Resize(size);
+    StartBenchmarkTiming();
+    return timers;
+}
+
+static void WheelTimerRestart(int n, int size) {
+    GetTimers<WheelTimers>(size)->Restart(n);
+}
+
+static void WheelTimerStopStart(int n, int size) {
+    GetTimers<WheelTimers>(size)->StopStart(n);
+}
+
+static void WheelTimerPushBack(int n, int size) {
+    GetTimers<WheelTimers>(size)->PushBack(n);
+}
+
+static void TimerEventWatcherRestart(int n, int size) {
+    GetTimers<WatcherTimers>(size)->Restart(n);
+}
+
+static void TimerEventWatcherStopStart(int n, int size) {
+    GetTimers<WatcherTimers>(size)->StopStart(n);
+}
+
+static void TimerEventWatcherPushBack(int n, int size) {
+    GetTimers<WatcherTimers>(size)->PushBack(n);
+}
+
+TOFT_BENCHMARK_RANGE(WheelTimerRestart, 1 << 10, 1 << 20)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(WheelTimerStopStart, 1 << 10, 1 << 20)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(WheelTimerPushBack, 1 << 10, 1 << 20)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(TimerEventWatcherRestart, 1 << 10, 1 << 20)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(TimerEventWatcherStopStart, 1 << 10, 1 << 20)->ThreadRange(1, 1);
+TOFT_BENCHMARK_RANGE(TimerEventWatcherPushBack, 1 << 10, 1 << 20)->ThreadRange(1, 1);
+
+}  // namespace toft
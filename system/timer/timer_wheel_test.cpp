@@ -0,0 +1,208 @@
+// Copyright (c) 2013, The Toft Authors.
+// All rights reserved.
+
+#include "toft/system/timer/timer_wheel.h"
+
+#include <time.h>
+#include <vector>
+
+#include "toft/base/functional.h"
+#include "toft/base/random.h"
+#include "toft/base/scoped_ptr.h"
+
+#include "thirdparty/gtest/gtest.h"
+
+namespace toft {
+
+// Time goes on only when told.
+class ManualTimerWheel : public TimerWheel {
+public:
+    ManualTimerWheel(EventDispatcher* dispatcher, int64_t tick_ms)
+        : TimerWheel(dispatcher, tick_ms), m_now(1000000) {}
+    void Advance(int64_t ms) { m_now += ms; }
+    int64_t Now() const { return m_now; }
+
+protected:
+    virtual int64_t NowMilliSeconds() const { return m_now; }
+
+private:
+    int64_t m_now;
+};
+
+class TimerWheelTest : public testing::Test {
+protected:
+    TimerWheelTest() : m_wheel(&m_dispatcher, 1), m_last_time(0) {}
+
+    ~TimerWheelTest() {
+        for (size_t i = 0; i < m_timers.size(); ++i)
+            delete m_timers[i];
+    }
+
+    WheelTimer* NewTimer(int id) {
+        WheelTimer* timer = new WheelTimer(
+            &m_wheel, std::bind(&TimerWheelTest::OnTimer, this, id));
+        m_timers.push_back(timer);
+        return timer;
+    }
+
+    void OnTimer(int id) {
+        m_fired.push_back(id);
+        m_fired_times.push_back(m_wheel.Now());
+        m_last_times.push_back(m_last_time);
+    }
+
+    // Advance the time and run the ticks, in 1ms of real time by the tick
+    // watcher.
+    void Advance(int64_t ms) {
+        m_last_time = m_wheel.Now();
+        m_wheel.Advance(ms);
+        if (m_wheel.TimerCount() > 0)
+            m_dispatcher.RunOnce();
+    }
+
+    void RunFor(int64_t ms) {
+        for (int64_t i = 0; i < ms; ++i)
+            Advance(1);
+    }
+
+    EventDispatcher m_dispatcher;
+    ManualTimerWheel m_wheel;
+    std::vector<WheelTimer*> m_timers;
+    std::vector<int> m_fired;
+    std::vector<int64_t> m_fired_times;
+    // Time before the last advance.
+    int64_t m_last_time;
+    std::vector<int64_t> m_last_times;
+};
+
+TEST_F(TimerWheelTest, Order) {
+    int64_t start = m_wheel.Now();
+    NewTimer(3)->Start(30);
+    NewTimer(1)->Start(10);
+    NewTimer(2)->Start(20);
+    NewTimer(0)->Start(0);
+    EXPECT_EQ(4U, m_wheel.TimerCount());
+    RunFor(40);
+    ASSERT_EQ(4U, m_fired.size());
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(i, m_fired[i]);
+    // Time goes before the first run.
+    EXPECT_EQ(start + 1, m_fired_times[0]);
+    EXPECT_EQ(start + 10, m_fired_times[1]);
+    EXPECT_EQ(start + 20, m_fired_times[2]);
+    EXPECT_EQ(start + 30, m_fired_times[3]);
+    EXPECT_EQ(0U, m_wheel.TimerCount());
+}
+
+TEST_F(TimerWheelTest, StopAndRestart) {
+    WheelTimer* a = NewTimer(1);
+    WheelTimer* b = NewTimer(2);
+    a->Start(10);
+    b->Start(10);
+    EXPECT_TRUE(a->IsActive());
+    a->Stop();
+    EXPECT_FALSE(a->IsActive());
+    a->Stop();
+    RunFor(5);
+    b->Start(10);
+    RunFor(9);
+    EXPECT_TRUE(m_fired.empty());
+    EXPECT_EQ(1U, m_wheel.TimerCount());
+    RunFor(1);
+    ASSERT_EQ(1U, m_fired.size());
+    EXPECT_EQ(2, m_fired[0]);
+    EXPECT_FALSE(b->IsActive());
+    EXPECT_EQ(0U, m_wheel.TimerCount());
+}
+
+// Deadlines span all levels, and many ticks are run at once.
+TEST_F(TimerWheelTest, Levels) {
+    static const int kBits[] = { 8, 14, 20, 26, 28 };
+    Random random(1);
+    std::vector<int64_t> deadlines;
+    for (int i = 0; i < 3000; ++i) {
+        int64_t after = random.Uniform(1 << kBits[i % 5]);
+        deadlines.push_back(m_wheel.Now() + after);
+        NewTimer(i)->Start(after);
+        // Timers are also started while the wheel goes.
+        if (i % 10 == 0)
+            Advance(random.Uniform(1000));
+    }
+    while (m_wheel.TimerCount() > 0)
+        Advance(random.Uniform(1 << random.Uniform(24)) + 1);
+    ASSERT_EQ(deadlines.size(), m_fired.size());
+    for (size_t i = 0; i < m_fired.size(); ++i) {
+        // Never early, and at the first run after the deadline. Timers of
+        // zero time started after the tick of the time are run next time.
+        int64_t deadline = deadlines[m_fired[i]];
+        ASSERT_GE(m_fired_times[i], deadline) << i;
+        ASSERT_LE(m_last_times[i], deadline) << i;
+    }
+}
+
+// Deadlines count from the current time rather than the last tick, which
+// may be long ago when the loop is busy.
+TEST_F(TimerWheelTest, LaggingTicks) {
+    NewTimer(0)->Start(100);
+    Advance(10);
+    // Time goes on without ticks.
+    m_wheel.Advance(7);
+    m_timers[0]->Start(10);
+    RunFor(9);
+    EXPECT_TRUE(m_timers[0]->IsActive());
+    RunFor(1);
+    EXPECT_FALSE(m_timers[0]->IsActive());
+}
+
+class Periodic {
+public:
+    Periodic(TimerWheel* wheel, int count)
+        : m_timer(wheel, std::bind(&Periodic::OnTimer, this)), m_count(count) {}
+    void Start() { m_timer.Start(5); }
+    int Count() const { return m_count; }
+private:
+    void OnTimer() {
+        EXPECT_FALSE(m_timer.IsActive());
+        if (--m_count > 0)
+            m_timer.Start(5);
+    }
+    WheelTimer m_timer;
+    int m_count;
+};
+
+TEST_F(TimerWheelTest, RestartInCallback) {
+    Periodic periodic(&m_wheel, 5);
+    periodic.Start();
+    RunFor(24);
+    EXPECT_EQ(1, periodic.Count());
+    RunFor(1);
+    EXPECT_EQ(0, periodic.Count());
+    EXPECT_EQ(0U, m_wheel.TimerCount());
+}
+
+TEST(TimerWheel, RealTime) {
+    EventDispatcher dispatcher;
+    TimerWheel wheel(&dispatcher, 1);
+    WheelTimer timer(&wheel, std::bind(&EventDispatcher::Break, &dispatcher));
+    timer.Start(20);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    dispatcher.Run();
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    int64_t elapsed = (end.tv_sec - start.tv_sec) * 1000 +
+        (end.tv_nsec - start.tv_nsec) / 1000000;
+    EXPECT_GE(elapsed, 19);
+    EXPECT_FALSE(timer.IsActive());
+}
+
+TEST(TimerWheel, DestroyWheelFirst) {
+    EventDispatcher dispatcher;
+    scoped_ptr<TimerWheel> wheel(new TimerWheel(&dispatcher));
+    WheelTimer timer(wheel.get(), WheelTimer::Callback());
+    timer.Start(1000);
+    wheel.reset();
+    EXPECT_FALSE(timer.IsActive());
+}
+
+} // namespace toft